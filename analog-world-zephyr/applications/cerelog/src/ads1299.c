@@ -1,248 +1,391 @@
-#include "ads1299.h"
-#include <zephyr/kernel.h>
-#include <zephyr/device.h>
-#include <zephyr/drivers/spi.h>
-#include <zephyr/sys/printk.h>
-
-/* List of registers to be set. If -2, end WREG. */
-const regVal_pair ADS1299_REGISTER_LS[] = {
-    {0x01, 0b10110000},  // CONFIG1: Data rate 250 SPS
-    {0x02, 0b11010000},  // CONFIG2: Internal test signal enabled
-    {0x03, 0b11101100},  // CONFIG3: Reference buffer enabled, bias enabled
-    {0x04, 0},           // LOFF: Lead-off detection disabled
-    {-2, -2},            // End of first section
-    {0x05, 0b01100000},  // CH1SET: Gain 12, normal input
-    {0x06, 0b01100000},  // CH2SET: Gain 12, normal input
-    {0x07, 0b01100000},  // CH3SET: Gain 12, normal input
-    {0x08, 0b01100000},  // CH4SET: Gain 12, normal input
-    {0x09, 0b01100000},  // CH5SET: Gain 12, normal input
-    {0x0A, 0b01100000},  // CH6SET: Gain 12, normal input
-    {0x0B, 0b01100000},  // CH7SET: Gain 12, normal input
-    {0x0C, 0b01100000},  // CH8SET: Gain 12, normal input
-    {0x0D, 0b11111111},  // BIAS_SENSP: All positive channels for bias
-    {0x0E, 0b11111111},  // BIAS_SENSN: All negative channels for bias
-    {0x0F, 0},           // LOFF_SENSP: Lead-off sensing disabled
-    {0x10, 0},           // LOFF_SENSN: Lead-off sensing disabled
-    {0x11, 0},           // LOFF_FLIP: No lead-off current direction flip
-    {-2, -2},            // End of second section
-    {0x15, 0},           // MISC1: SRB1 disabled
-    {0x16, 0},           // MISC2: Reserved
-    {0x17, 0},           // CONFIG4: Continuous conversion mode
-    {0x02, 0xD0},        // CONFIG2: Test signal settings
-    {0x05, 0x05},        // CH1SET: Test signal input
-    {0x06, 0x05}         // CH2SET: Test signal input
-};
-
-/* This is not an init function that lives in ads1299.c.
-   This file is blessed to sift necessary information from main.c to fill the vessels zephyr_dev and spi_cfg*/
-int ADS1299_INIT(const struct ads1299_config *config) {
-    if (!config || !config->zephyr_spi_dev || !config->spi_cfg) {
-        return -EINVAL;
-    }
-    // No need to store zephyr_dev or spi_cfg, just use config directly
-    return 0;
-}
-
-/* Internal function to send SPI command */
-int ADS1299_SEND_CMD(uint8_t cmd, const struct ads1299_config *config) {
-    struct spi_buf tx_buf = {
-        .buf = &cmd,
-        .len = 1
-    };
-    struct spi_buf_set tx_bufs = {
-        .buffers = &tx_buf,
-        .count = 1
-    };
-
-    int ret = spi_write(config->zephyr_spi_dev, config->spi_cfg, &tx_bufs);
-
-    if (ret != 0) {
-        printk("Failed to send command 0x%02x: %d\n", cmd, ret);
-        return ret;
-    }
-
-    ads1299_prev_cmd = cmd;
-    k_usleep(4 * 1000000 / ADS1299_SPI_FREQ); // Wait 4 tCLK cycles
-
-    return 0;
-}
-
-/* Internal function for register operations */
-static int ADS1299_REG_OPS(uint8_t opcode, uint8_t reg_addr, uint8_t *data, uint8_t len, const struct ads1299_config *config) {
-    uint8_t cmd_buf[2];
-    struct spi_buf tx_bufs_arr[3];
-    struct spi_buf_set tx_bufs;
-    int buf_count = 0;
-
-    // First command byte: opcode + register address
-    cmd_buf[0] = opcode | (reg_addr & 0x1F);
-    tx_bufs_arr[buf_count].buf = &cmd_buf[0];
-    tx_bufs_arr[buf_count].len = 1;
-    buf_count++;
-
-    // Second command byte: number of registers - 1
-    cmd_buf[1] = len - 1;
-    tx_bufs_arr[buf_count].buf = &cmd_buf[1];
-    tx_bufs_arr[buf_count].len = 1;
-    buf_count++;
-
-    // For write operations, add data
-    if ((opcode & 0x60) == 0x40) { // WREG command
-        tx_bufs_arr[buf_count].buf = data;
-        tx_bufs_arr[buf_count].len = len;
-        buf_count++;
-    }
-
-    tx_bufs.buffers = tx_bufs_arr;
-    tx_bufs.count = buf_count;
-
-    int ret = spi_write(config->zephyr_spi_dev, config->spi_cfg, &tx_bufs);
-    if (ret != 0) {
-        printk("Failed register operation: %d\n", ret);
-        return ret;
-    }
-
-    k_usleep(4 * 1000000 / ADS1299_SPI_FREQ); // Wait 4 tCLK cycles
-
-    // For read operations, read the data
-    if ((opcode & 0x60) == 0x20) { // RREG command
-        struct spi_buf rx_buf = {
-            .buf = data,
-            .len = len
-        };
-        struct spi_buf_set rx_bufs = {
-            .buffers = &rx_buf,
-            .count = 1
-        };
-
-        ret = spi_read(config->zephyr_spi_dev, config->spi_cfg, &rx_bufs);
-        if (ret != 0) {
-            printk("Failed to read register data: %d\n", ret);
-            return ret;
-        }
-    }
-
-    return 0;
-}
-
-void ADS1299_WREG(uint8_t reg_addr, uint8_t *data, uint8_t len, const struct ads1299_config *config) {
-    if (ads1299_mode == ADS1299_MODE_RDATAC) {
-        printk("Warning: Cannot write registers in RDATAC mode\n");
-        return;
-    }
-
-    ADS1299_REG_OPS(0x40, reg_addr, data, len, config);
-    ads1299_prev_cmd = CMD_ADC_WREG;
-}
-
-void ADS1299_RREG(uint8_t reg_addr, uint8_t *data, uint8_t len, const struct ads1299_config *config) {
-    if (ads1299_mode == ADS1299_MODE_RDATAC) {
-        printk("Warning: Cannot read registers in RDATAC mode\n");
-        return;
-    }
-
-    ADS1299_REG_OPS(0x20, reg_addr, data, len, config);
-    ads1299_prev_cmd = CMD_ADC_RREG;
-}
-
-void ADS1299_SDATAC(const struct ads1299_config *config) {
-    ADS1299_SEND_CMD(CMD_ADC_SDATAC, config);
-    ads1299_mode = ADS1299_MODE_SDATAC;
-    printk("ADS1299 set to SDATAC mode\n");
-}
-
-void ADS1299_RDATAC(const struct ads1299_config *config) {
-    ADS1299_SEND_CMD(CMD_ADC_RDATAC, config);
-    ads1299_mode = ADS1299_MODE_RDATAC;
-    printk("ADS1299 set to RDATAC mode\n");
-}
-
-void ADS1299_START(const struct ads1299_config *config) {
-    ADS1299_SEND_CMD(CMD_ADC_START, config);
-    printk("ADS1299 START command sent\n");
-}
-
-void ADS1299_RESET(const struct ads1299_config *config) {
-    ADS1299_SEND_CMD(0x06, config); // RESET command
-    k_msleep(18 * 1000000 / ADS1299_SPI_FREQ); // Wait 18 tCLK cycles
-    ads1299_mode = -2;
-    printk("ADS1299 RESET command sent\n");
-}
-
-void ADS1299_WAKEUP(const struct ads1299_config *config) {
-    ADS1299_SEND_CMD(0x02, config); // WAKEUP command
-    printk("ADS1299 WAKEUP command sent\n");
-}
-
-void ADS1299_STANDBY(const struct ads1299_config *config) {
-    ADS1299_SEND_CMD(0x04, config); // STANDBY command
-    printk("ADS1299 STANDBY command sent\n");
-}
-
-int ADS1299_SETUP(const struct ads1299_config *config) {
-    int ret;
-    uint8_t reg_val;
-
-    printk("Configuring ADS1299 registers...\n");
-
-    // Make sure we're in SDATAC mode
-    if (ads1299_mode != ADS1299_MODE_SDATAC) {
-        ADS1299_SDATAC(config);
-        k_msleep(1);
-    }
-
-    // Configure registers according to the register list
-    for (int i = 0; i < ARRAY_SIZE(ADS1299_REGISTER_LS); i++) {
-        const regVal_pair reg_pair = ADS1299_REGISTER_LS[i];
-
-        // Check for end marker
-        if (reg_pair.add == -2) {
-            printk("Register configuration section %d complete\n", i);
-            k_msleep(1); // Small delay between sections
-            continue;
-        }
-
-        reg_val = (uint8_t)reg_pair.reg_val;
-        ADS1299_WREG(reg_pair.add, &reg_val, 1, config);
-
-        // Verify the write by reading back
-        uint8_t readback_val = 0;
-        ADS1299_RREG(reg_pair.add, &readback_val, 1, config);
-
-        if (readback_val != reg_val) {
-            printk("Register 0x%02x verification failed: wrote 0x%02x, read 0x%02x\n",
-                   reg_pair.add, reg_val, readback_val);
-            // Continue with other registers - don't fail completely
-        } else {
-            printk("Register 0x%02x = 0x%02x OK\n", reg_pair.add, reg_val);
-        }
-
-        k_msleep(1);
-    }
-
-    printk("ADS1299 register configuration complete\n");
-    return 0;
-}
-
-// Function to read ADS1299 ID register for verification
-int ADS1299_READ_ID(uint8_t *id_val, const struct ads1299_config *config) {
-    if (ads1299_mode == ADS1299_MODE_RDATAC) {
-        ADS1299_SDATAC(config);
-        k_msleep(1);
-    }
-
-    ADS1299_RREG(0x00, id_val, 1, config); // ID register is at address 0x00
-
-    printk("ADS1299 ID register: 0x%02x\n", *id_val);
-
-    // Decode ID register
-    uint8_t rev_id = (*id_val >> 5) & 0x7;
-    uint8_t dev_id = (*id_val >> 2) & 0x3;
-    uint8_t nu_ch = *id_val & 0x3;
-
-    printk("  Revision ID: %d\n", rev_id);
-    printk("  Device ID: %d\n", dev_id);
-    printk("  Number of channels: %d\n", (nu_ch == 0) ? 4 : (nu_ch == 1) ? 6 : 8);
-
-    return 0;
+#include "ads1299.h"
+#include "packet_format.h"
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/spi.h>
+#include <zephyr/sys/printk.h>
+#include <string.h>
+
+/* List of registers to be set. If -2, end WREG. */
+const regVal_pair ADS1299_REGISTER_LS[] = {
+    {0x01, 0b10110110},  // CONFIG1: Data rate 250 SPS
+    {0x02, 0b11010000},  // CONFIG2: Internal test signal enabled
+    {0x03, 0b11101100},  // CONFIG3: Reference buffer enabled, bias enabled
+    {0x04, 0},           // LOFF: Lead-off detection disabled
+    {-2, -2},            // End of first section
+    {0x05, 0b01100000},  // CH1SET: Gain 12, normal input
+    {0x06, 0b01100000},  // CH2SET: Gain 12, normal input
+    {0x07, 0b01100000},  // CH3SET: Gain 12, normal input
+    {0x08, 0b01100000},  // CH4SET: Gain 12, normal input
+    {0x09, 0b01100000},  // CH5SET: Gain 12, normal input
+    {0x0A, 0b01100000},  // CH6SET: Gain 12, normal input
+    {0x0B, 0b01100000},  // CH7SET: Gain 12, normal input
+    {0x0C, 0b01100000},  // CH8SET: Gain 12, normal input
+    {0x0D, 0b11111111},  // BIAS_SENSP: All positive channels for bias
+    {0x0E, 0b11111111},  // BIAS_SENSN: All negative channels for bias
+    {0x0F, 0},           // LOFF_SENSP: Lead-off sensing disabled
+    {0x10, 0},           // LOFF_SENSN: Lead-off sensing disabled
+    {0x11, 0},           // LOFF_FLIP: No lead-off current direction flip
+    {-2, -2},            // End of second section
+    {0x15, 0},           // MISC1: SRB1 disabled
+    {0x16, 0},           // MISC2: Reserved
+    {0x17, 0},           // CONFIG4: Continuous conversion mode
+    {0x02, 0xD0},        // CONFIG2: Test signal settings
+    {0x05, 0x05},        // CH1SET: Test signal input
+    {0x06, 0x05}         // CH2SET: Test signal input
+};
+
+/* Last known value of every register, kept current by WREG and RREG.
+   A daisy chain shares CS and DIN, so every command and register write
+   reaches all chips at once and they hold the same map; reads come back
+   from the first chip, the one on MISO. */
+static uint8_t ads1299_shadow[ADS1299_NUM_REGS];
+static bool ads1299_converting;
+
+/* Multi-byte commands need tSDECODE between bytes. Clocking them back to back
+   in one transfer is only safe while a byte takes at least that long. */
+BUILD_ASSERT(8ULL * ADS1299_FCLK_HZ >= (uint64_t)ADS1299_CMD_WAIT_TCLK * ADS1299_SPI_FREQ,
+             "ADS1299_SPI_FREQ too fast for back-to-back command bytes");
+
+/* Waits the given number of ADS1299 clock periods. Short waits spin, since a
+   sleep would round up to a whole system tick; tPOR-sized waits sleep. */
+void ADS1299_WAIT_TCLK(uint32_t tclk) {
+    uint32_t us = (uint32_t)(((uint64_t)tclk * 1000000 + ADS1299_FCLK_HZ - 1) / ADS1299_FCLK_HZ);
+
+    if (us < 1000) {
+        k_busy_wait(us);
+    } else {
+        k_usleep(us);
+    }
+}
+
+/* This is not an init function that lives in ads1299.c.
+   This file is blessed to sift necessary information from main.c to fill the vessels zephyr_dev and spi_cfg*/
+int ADS1299_INIT(const struct ads1299_config *config) {
+    if (!config || !config->zephyr_spi_dev || !config->spi_cfg) {
+        return -EINVAL;
+    }
+    // No need to store zephyr_dev or spi_cfg, just use config directly
+    return 0;
+}
+
+/* Internal function to send SPI command */
+int ADS1299_SEND_CMD(uint8_t cmd, const struct ads1299_config *config) {
+    struct spi_buf tx_buf = {
+        .buf = &cmd,
+        .len = 1
+    };
+    struct spi_buf_set tx_bufs = {
+        .buffers = &tx_buf,
+        .count = 1
+    };
+
+    int ret = spi_write(config->zephyr_spi_dev, config->spi_cfg, &tx_bufs);
+
+    if (ret != 0) {
+        printk("Failed to send command 0x%02x: %d\n", cmd, ret);
+        return ret;
+    }
+
+    ads1299_prev_cmd = cmd;
+    ADS1299_WAIT_TCLK(ADS1299_CMD_WAIT_TCLK);
+
+    return 0;
+}
+
+/* Internal function for register operations. The opcode, count and register
+   bytes go in one CS-low transfer; the chip auto-increments the address,
+   so len registers starting at reg_addr are covered by a single command. */
+static int ADS1299_REG_OPS(uint8_t opcode, uint8_t reg_addr, uint8_t *data, uint8_t len, const struct ads1299_config *config) {
+    uint8_t cmd_buf[2];
+    int ret;
+
+    // Opcode + register address, then number of registers - 1
+    cmd_buf[0] = opcode | (reg_addr & 0x1F);
+    cmd_buf[1] = len - 1;
+
+    struct spi_buf tx_bufs_arr[2] = {
+        { .buf = cmd_buf, .len = sizeof(cmd_buf) },
+        { .buf = data, .len = len }
+    };
+    struct spi_buf_set tx_bufs = {
+        .buffers = tx_bufs_arr,
+        .count = 2
+    };
+
+    if ((opcode & 0x60) == 0x40) { // WREG command
+        ret = spi_write(config->zephyr_spi_dev, config->spi_cfg, &tx_bufs);
+    } else { // RREG command: data shifts out while the second half is clocked
+        struct spi_buf rx_bufs_arr[2] = {
+            { .buf = NULL, .len = sizeof(cmd_buf) },
+            { .buf = data, .len = len }
+        };
+        struct spi_buf_set rx_bufs = {
+            .buffers = rx_bufs_arr,
+            .count = 2
+        };
+
+        tx_bufs.count = 1;
+        ret = spi_transceive(config->zephyr_spi_dev, config->spi_cfg, &tx_bufs, &rx_bufs);
+    }
+
+    if (ret != 0) {
+        printk("Failed register operation 0x%02x: %d\n", cmd_buf[0], ret);
+        return ret;
+    }
+
+    ADS1299_WAIT_TCLK(ADS1299_CMD_WAIT_TCLK);
+    return 0;
+}
+
+void ADS1299_WREG(uint8_t reg_addr, uint8_t *data, uint8_t len, const struct ads1299_config *config) {
+    if (ads1299_mode == ADS1299_MODE_RDATAC) {
+        printk("Warning: Cannot write registers in RDATAC mode\n");
+        return;
+    }
+
+    if (ADS1299_REG_OPS(0x40, reg_addr, data, len, config) == 0) {
+        for (uint8_t i = 0; i < len && reg_addr + i < ADS1299_NUM_REGS; i++) {
+            ads1299_shadow[reg_addr + i] = data[i];
+        }
+    }
+    ads1299_prev_cmd = CMD_ADC_WREG;
+}
+
+void ADS1299_RREG(uint8_t reg_addr, uint8_t *data, uint8_t len, const struct ads1299_config *config) {
+    if (ads1299_mode == ADS1299_MODE_RDATAC) {
+        printk("Warning: Cannot read registers in RDATAC mode\n");
+        return;
+    }
+
+    if (ADS1299_REG_OPS(0x20, reg_addr, data, len, config) == 0) {
+        for (uint8_t i = 0; i < len && reg_addr + i < ADS1299_NUM_REGS; i++) {
+            ads1299_shadow[reg_addr + i] = data[i];
+        }
+    }
+    ads1299_prev_cmd = CMD_ADC_RREG;
+}
+
+void ADS1299_SDATAC(const struct ads1299_config *config) {
+    ADS1299_SEND_CMD(CMD_ADC_SDATAC, config);
+    ads1299_mode = ADS1299_MODE_SDATAC;
+    printk("ADS1299 set to SDATAC mode\n");
+}
+
+void ADS1299_RDATAC(const struct ads1299_config *config) {
+    ADS1299_SEND_CMD(CMD_ADC_RDATAC, config);
+    ads1299_mode = ADS1299_MODE_RDATAC;
+    printk("ADS1299 set to RDATAC mode\n");
+}
+
+void ADS1299_START(const struct ads1299_config *config) {
+    ADS1299_SEND_CMD(CMD_ADC_START, config);
+    ads1299_converting = true;
+    printk("ADS1299 START command sent\n");
+}
+
+void ADS1299_STOP(const struct ads1299_config *config) {
+    ADS1299_SEND_CMD(CMD_ADC_STOP, config);
+    ads1299_converting = false;
+    printk("ADS1299 STOP command sent\n");
+}
+
+void ADS1299_RESET(const struct ads1299_config *config) {
+    ADS1299_SEND_CMD(0x06, config); // RESET command
+    ADS1299_WAIT_TCLK(ADS1299_RST_WAIT_TCLK);
+    ads1299_mode = -2;
+    ads1299_converting = false;
+    printk("ADS1299 RESET command sent\n");
+}
+
+void ADS1299_WAKEUP(const struct ads1299_config *config) {
+    ADS1299_SEND_CMD(0x02, config); // WAKEUP command
+    printk("ADS1299 WAKEUP command sent\n");
+}
+
+void ADS1299_STANDBY(const struct ads1299_config *config) {
+    ADS1299_SEND_CMD(0x04, config); // STANDBY command
+    printk("ADS1299 STANDBY command sent\n");
+}
+
+/* Programs ADS1299_REGISTER_LS. The list is first folded into a register
+   image, later entries overriding earlier ones, then every run of
+   consecutive addresses goes out as one WREG and is checked with one RREG.
+   In a chain the writes are broadcast, and CONFIG1 is kept in daisy-chain
+   mode so one read clocks every chip's frame out. */
+int ADS1299_SETUP(const struct ads1299_config *config) {
+    uint8_t image[ADS1299_NUM_REGS];
+    uint8_t readback[ADS1299_NUM_REGS];
+    uint32_t listed = 0;
+    int mismatches = 0;
+
+    printk("Configuring ADS1299 registers...\n");
+
+    for (int i = 0; i < ARRAY_SIZE(ADS1299_REGISTER_LS); i++) {
+        const regVal_pair reg_pair = ADS1299_REGISTER_LS[i];
+
+        // Section markers only mattered for the old one-register-at-a-time writes
+        if (reg_pair.add < 0 || reg_pair.add >= ADS1299_NUM_REGS) {
+            continue;
+        }
+
+        image[reg_pair.add] = (uint8_t)reg_pair.reg_val;
+        listed |= BIT(reg_pair.add);
+    }
+
+#if ADS1299_CHAIN_LENGTH > 1
+    // DAISY_EN set would select multiple readback mode, which needs a CS per chip
+    if (listed & BIT(0x01)) {
+        image[0x01] &= ~ADS1299_CONFIG1_DAISY_EN;
+    }
+#endif
+
+    // Make sure we're in SDATAC mode
+    if (ads1299_mode != ADS1299_MODE_SDATAC) {
+        ADS1299_SDATAC(config);
+    }
+
+    uint8_t addr = 0;
+    while (addr < ADS1299_NUM_REGS) {
+        if (!(listed & BIT(addr))) {
+            addr++;
+            continue;
+        }
+
+        uint8_t first = addr;
+        while (addr < ADS1299_NUM_REGS && (listed & BIT(addr))) {
+            addr++;
+        }
+        uint8_t len = addr - first;
+
+        ADS1299_WREG(first, &image[first], len, config);
+
+        // Verify the whole run by reading it back
+        memset(&readback[first], 0, len);
+        ADS1299_RREG(first, &readback[first], len, config);
+
+        for (uint8_t reg = first; reg < addr; reg++) {
+            if (readback[reg] != image[reg]) {
+                printk("Register 0x%02x verification failed: wrote 0x%02x, read 0x%02x\n",
+                       reg, image[reg], readback[reg]);
+                mismatches++;
+                // Continue with other registers - don't fail completely
+            }
+        }
+
+        printk("Registers 0x%02x-0x%02x written in one burst\n", first, addr - 1);
+    }
+
+    // One burst over the whole map so the shadow also holds the registers the list skips
+    ADS1299_RREG(0x00, readback, ADS1299_NUM_REGS, config);
+
+    printk("ADS1299 register configuration complete (%d mismatches)\n", mismatches);
+    return 0;
+}
+
+void ADS1299_SHADOW_READ(uint8_t *image) {
+    memcpy(image, ads1299_shadow, ADS1299_NUM_REGS);
+}
+
+/* Brings the chip to the given register image while streaming. Only the
+   registers that differ from the shadow are written, one WREG per run of
+   consecutive changes. RDATAC is left just for the writes, and conversions
+   are only stopped and restarted when the data rate changes. Commands go
+   out without the usual console messages to keep the gap short.
+   Returns the number of registers written or a negative errno. */
+int ADS1299_RECONFIGURE(const uint8_t *image, const struct ads1299_config *config) {
+    bool was_rdatac = (ads1299_mode == ADS1299_MODE_RDATAC);
+    bool restart = ads1299_converting && image[0x01] != ads1299_shadow[0x01];
+    uint8_t readback[ADS1299_NUM_REGS];
+    int changed = 0;
+    int ret = 0;
+
+    if (was_rdatac) {
+        ADS1299_SEND_CMD(CMD_ADC_SDATAC, config);
+        ads1299_mode = ADS1299_MODE_SDATAC;
+    }
+    if (restart) {
+        ADS1299_SEND_CMD(CMD_ADC_STOP, config);
+    }
+
+    // ID and the lead-off status registers are read-only and never differ on purpose
+    uint8_t addr = 0x01;
+    while (addr < ADS1299_NUM_REGS) {
+        if (image[addr] == ads1299_shadow[addr]) {
+            addr++;
+            continue;
+        }
+
+        uint8_t first = addr;
+        while (addr < ADS1299_NUM_REGS && image[addr] != ads1299_shadow[addr]) {
+            addr++;
+        }
+        uint8_t len = addr - first;
+
+        ADS1299_WREG(first, (uint8_t *)&image[first], len, config);
+        ADS1299_RREG(first, &readback[first], len, config);
+        if (memcmp(&readback[first], &image[first], len) != 0) {
+            ret = -EIO;
+        }
+        changed += len;
+    }
+
+    if (restart) {
+        ADS1299_SEND_CMD(CMD_ADC_START, config);
+    }
+    if (was_rdatac) {
+        ADS1299_SEND_CMD(CMD_ADC_RDATAC, config);
+        ads1299_mode = ADS1299_MODE_RDATAC;
+    }
+
+    return ret ? ret : changed;
+}
+
+#ifdef CONFIG_CERELOG_SPI_ASYNC
+/* The SPI context keeps pointers to the buffer descriptors until the
+   transfer completes, so they cannot live on the caller's stack */
+static struct spi_buf ads1299_async_rx_buf;
+static const struct spi_buf_set ads1299_async_rx = {
+    .buffers = &ads1299_async_rx_buf,
+    .count = 1
+};
+
+/* Starts clocking one RDATAC frame into frame and returns without waiting.
+   The controller moves the bytes by DMA and calls done from its interrupt
+   once CS is released. Only one read may be in flight; other SPI calls
+   block on the controller lock until it completes. */
+int ADS1299_READ_DATA_ASYNC(uint8_t *frame, size_t len, spi_callback_t done, void *userdata,
+                            const struct ads1299_config *config) {
+    ads1299_async_rx_buf.buf = frame;
+    ads1299_async_rx_buf.len = len;
+
+    return spi_transceive_cb(config->zephyr_spi_dev, config->spi_cfg, NULL, &ads1299_async_rx,
+                             done, userdata);
+}
+#endif
+
+// Function to read ADS1299 ID register for verification
+int ADS1299_READ_ID(uint8_t *id_val, const struct ads1299_config *config) {
+    if (ads1299_mode == ADS1299_MODE_RDATAC) {
+        ADS1299_SDATAC(config);
+    }
+
+    ADS1299_RREG(0x00, id_val, 1, config); // ID register is at address 0x00
+
+    printk("ADS1299 ID register: 0x%02x\n", *id_val);
+
+    // Decode ID register
+    uint8_t rev_id = (*id_val >> 5) & 0x7;
+    uint8_t dev_id = (*id_val >> 2) & 0x3;
+    uint8_t nu_ch = *id_val & 0x3;
+
+    printk("  Revision ID: %d\n", rev_id);
+    printk("  Device ID: %d\n", dev_id);
+    printk("  Number of channels: %d\n", (nu_ch == 0) ? 4 : (nu_ch == 1) ? 6 : 8);
+#if ADS1299_CHAIN_LENGTH > 1
+    printk("  First of %d daisy-chained devices, %d channels in all\n",
+           ADS1299_CHAIN_LENGTH, ADS1299_NUM_CHANNELS);
+#endif
+
+    return 0;
 }
\ No newline at end of file
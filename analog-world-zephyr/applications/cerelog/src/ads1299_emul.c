@@ -0,0 +1,462 @@
+/* SPI emulator for the ADS1299 so the cerelog app runs on native_sim.
+   Models the register file used by ADS1299_WREG/ADS1299_RREG, the
+   SDATAC/RDATAC/START/STOP command states and a DRDY generator that
+   runs at the CONFIG1 data rate. Channel data follows CHnSET: normal
+   inputs get a synthetic EEG trace, MUX=101 gets the CONFIG2 internal
+   test square wave, shorted inputs get noise only.
+   The firmware's daisy chain of ADS1299_CHAIN_LENGTH chips is one target
+   here: commands and register writes reach every chip on the real bus,
+   so the chips share one register file, and a frame is each chip's 27
+   bytes in turn. */
+
+#define DT_DRV_COMPAT ti_ads1299
+
+#include "ads1299_emul.h"
+#include "data_handler.h"
+#include <math.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/emul_stub_device.h>
+#include <zephyr/drivers/spi.h>
+#include <zephyr/drivers/spi_emul.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/gpio/gpio_emul.h>
+
+// Opcodes
+#define ADS1299_OP_WAKEUP   0x02
+#define ADS1299_OP_STANDBY  0x04
+#define ADS1299_OP_RESET    0x06
+#define ADS1299_OP_START    0x08
+#define ADS1299_OP_STOP     0x0A
+#define ADS1299_OP_RDATAC   0x10
+#define ADS1299_OP_SDATAC   0x11
+#define ADS1299_OP_RDATA    0x12
+#define ADS1299_OP_RREG     0x20
+#define ADS1299_OP_WREG     0x40
+#define ADS1299_OP_REG_MASK 0xE0
+
+// Registers the model looks at
+#define ADS1299_REG_ID          0x00
+#define ADS1299_REG_CONFIG1     0x01
+#define ADS1299_REG_CONFIG2     0x02
+#define ADS1299_REG_CH1SET      0x05
+#define ADS1299_REG_LOFF_STATP  0x12
+#define ADS1299_REG_LOFF_STATN  0x13
+#define ADS1299_REG_GPIO        0x14
+
+// CHnSET input mux
+#define ADS1299_MUX_NORMAL      0x0
+#define ADS1299_MUX_SHORTED     0x1
+#define ADS1299_MUX_TEST        0x5
+
+// Analog front end
+#define ADS1299_EMUL_FCLK_HZ    2048000.0
+#define ADS1299_EMUL_VREF       4.5
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Power-on register values, ID reports an 8-channel ADS1299
+static const uint8_t ads1299_emul_reset_regs[ADS1299_EMUL_NUM_REGS] = {
+    0x3E, 0x96, 0xC0, 0x60, 0x00,                   // ID, CONFIG1-3, LOFF
+    0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, // CH1SET-CH8SET
+    0x00, 0x00, 0x00, 0x00, 0x00,                   // BIAS_SENSP/N, LOFF_SENSP/N, LOFF_FLIP
+    0x00, 0x00, 0x0F,                               // LOFF_STATP/N, GPIO
+    0x00, 0x00, 0x00                                // MISC1, MISC2, CONFIG4
+};
+
+static const uint8_t ads1299_emul_gain[8] = {1, 2, 4, 6, 8, 12, 24, 24};
+
+enum ads1299_emul_state {
+    EMUL_IDLE,
+    EMUL_RREG_COUNT,
+    EMUL_RREG_DATA,
+    EMUL_WREG_COUNT,
+    EMUL_WREG_DATA,
+    EMUL_RDATA_OUT,
+};
+
+struct ads1299_emul_cfg {
+    struct gpio_dt_spec drdy;
+};
+
+struct ads1299_emul_data {
+    const struct emul *target;
+    struct k_timer drdy_timer;
+    struct k_spinlock lock;
+
+    uint8_t regs[ADS1299_EMUL_NUM_REGS];
+    bool rdatac;                // Continuous read mode, the power-on default
+    bool converting;            // START received and not stopped
+    bool standby;
+
+    // Command decoder state, kept across transfers so a command split over
+    // several spi calls decodes the same as one sent in a single transfer
+    enum ads1299_emul_state state;
+    uint8_t reg_addr;
+    uint8_t reg_remaining;
+
+    uint8_t frame[ADS1299_TOTAL_DATA_BYTES];
+    size_t frame_pos;
+    bool frame_unread;
+
+    double t_sec;               // Time of the latest conversion
+    uint32_t noise_state;
+    struct ads1299_emul_stats stats;
+};
+
+uint32_t ads1299_emul_data_rate(const struct emul *target) {
+    struct ads1299_emul_data *data = target->data;
+    uint8_t dr = data->regs[ADS1299_REG_CONFIG1] & 0x07;
+
+    // DR = 000 is 16 kSPS, each step halves it, 111 is reserved
+    return 16000U >> MIN(dr, 6);
+}
+
+static double ads1299_emul_noise(struct ads1299_emul_data *data) {
+    // xorshift32, mapped to [-1, 1)
+    uint32_t x = data->noise_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    data->noise_state = x;
+    return ((double)x / 2147483648.0) - 1.0;
+}
+
+static double ads1299_emul_test_signal(struct ads1299_emul_data *data) {
+    uint8_t config2 = data->regs[ADS1299_REG_CONFIG2];
+
+    // INT_CAL clear means the test signal is driven externally
+    if (!(config2 & BIT(4))) {
+        return 0.0;
+    }
+
+    double amplitude = ((config2 & BIT(2)) ? 2.0 : 1.0) * ADS1299_EMUL_VREF / 2400.0;
+    double freq;
+
+    switch (config2 & 0x03) {
+    case 0x0:
+        freq = ADS1299_EMUL_FCLK_HZ / (1 << 21);
+        break;
+    case 0x1:
+        freq = ADS1299_EMUL_FCLK_HZ / (1 << 20);
+        break;
+    default:
+        return amplitude; // DC
+    }
+
+    return (fmod(data->t_sec * freq, 1.0) < 0.5) ? amplitude : -amplitude;
+}
+
+static double ads1299_emul_eeg(struct ads1299_emul_data *data, int ch) {
+    // Alpha and theta components with a per-channel phase, plus broadband noise
+    double t = data->t_sec;
+    return 20e-6 * sin(2.0 * M_PI * 10.0 * t + 0.7 * ch) +
+           8e-6 * sin(2.0 * M_PI * 6.0 * t + 1.3 * ch) +
+           2e-6 * ads1299_emul_noise(data);
+}
+
+// ch counts across the chain; each chip applies its own CHnSET to its eight
+static int32_t ads1299_emul_channel_code(struct ads1299_emul_data *data, int ch) {
+    uint8_t chset = data->regs[ADS1299_REG_CH1SET + ch % ADS1299_CHIP_CHANNELS];
+    double volts;
+
+    // PDn set means the channel is powered down
+    if (chset & BIT(7)) {
+        return 0;
+    }
+
+    switch (chset & 0x07) {
+    case ADS1299_MUX_NORMAL:
+        volts = ads1299_emul_eeg(data, ch);
+        break;
+    case ADS1299_MUX_SHORTED:
+        volts = 1e-6 * ads1299_emul_noise(data);
+        break;
+    case ADS1299_MUX_TEST:
+        volts = ads1299_emul_test_signal(data);
+        break;
+    default:
+        volts = 0.0;
+        break;
+    }
+
+    // Full scale is +/-VREF/gain across the 24-bit range
+    double code = volts * ads1299_emul_gain[(chset >> 4) & 0x07] * (double)(1 << 23) / ADS1299_EMUL_VREF;
+    return (int32_t)CLAMP(code, -8388608.0, 8388607.0);
+}
+
+static void ads1299_emul_latch_frame(struct ads1299_emul_data *data) {
+    uint8_t statp = data->regs[ADS1299_REG_LOFF_STATP];
+    uint8_t statn = data->regs[ADS1299_REG_LOFF_STATN];
+    uint8_t gpio = data->regs[ADS1299_REG_GPIO];
+
+    for (int chip = 0; chip < ADS1299_CHAIN_LENGTH; chip++) {
+        uint8_t *chip_frame = &data->frame[chip * ADS1299_CHIP_DATA_BYTES];
+
+        // Status: 1100 + LOFF_STATP + LOFF_STATN + GPIO[7:4]
+        chip_frame[0] = 0xC0 | (statp >> 4);
+        chip_frame[1] = (statp << 4) | (statn >> 4);
+        chip_frame[2] = (statn << 4) | (gpio >> 4);
+
+        for (int ch = 0; ch < ADS1299_CHIP_CHANNELS; ch++) {
+            int32_t code = ads1299_emul_channel_code(data, chip * ADS1299_CHIP_CHANNELS + ch);
+            uint8_t *dst = &chip_frame[ADS1299_STATUS_BYTES + (ch * ADS1299_BYTES_PER_CHANNEL)];
+            dst[0] = (code >> 16) & 0xFF;
+            dst[1] = (code >> 8) & 0xFF;
+            dst[2] = code & 0xFF;
+        }
+    }
+
+    if (data->frame_unread) {
+        data->stats.frames_overwritten++;
+    }
+    data->frame_pos = 0;
+    data->frame_unread = true;
+    data->stats.frames_generated++;
+}
+
+static void ads1299_emul_drdy_tick(struct k_timer *timer) {
+    struct ads1299_emul_data *data = CONTAINER_OF(timer, struct ads1299_emul_data, drdy_timer);
+    const struct ads1299_emul_cfg *cfg = data->target->cfg;
+
+    k_spinlock_key_t key = k_spin_lock(&data->lock);
+    data->t_sec += 1.0 / ads1299_emul_data_rate(data->target);
+    ads1299_emul_latch_frame(data);
+    k_spin_unlock(&data->lock, key);
+
+    // DRDY pulses high before each new frame, the falling edge is what the firmware sees
+    gpio_emul_input_set(cfg->drdy.port, cfg->drdy.pin, 1);
+    gpio_emul_input_set(cfg->drdy.port, cfg->drdy.pin, 0);
+}
+
+static void ads1299_emul_update_timer(struct ads1299_emul_data *data) {
+    if (data->converting && !data->standby) {
+        k_timeout_t period = K_NSEC(NSEC_PER_SEC / ads1299_emul_data_rate(data->target));
+        k_timer_start(&data->drdy_timer, period, period);
+    } else {
+        k_timer_stop(&data->drdy_timer);
+    }
+}
+
+static void ads1299_emul_reset(struct ads1299_emul_data *data) {
+    memcpy(data->regs, ads1299_emul_reset_regs, sizeof(data->regs));
+    data->rdatac = true;
+    data->converting = false;
+    data->standby = false;
+    data->state = EMUL_IDLE;
+    data->frame_pos = ADS1299_TOTAL_DATA_BYTES;
+    data->frame_unread = false;
+    memset(data->frame, 0, sizeof(data->frame));
+    ads1299_emul_update_timer(data);
+}
+
+static void ads1299_emul_write_reg(struct ads1299_emul_data *data, uint8_t addr, uint8_t val) {
+    // ID and the lead-off status registers are read-only
+    if (addr >= ADS1299_EMUL_NUM_REGS || addr == ADS1299_REG_ID ||
+        addr == ADS1299_REG_LOFF_STATP || addr == ADS1299_REG_LOFF_STATN) {
+        return;
+    }
+
+    data->regs[addr] = val;
+
+    if (addr == ADS1299_REG_CONFIG1) {
+        ads1299_emul_update_timer(data);
+    }
+}
+
+static void ads1299_emul_command(struct ads1299_emul_data *data, uint8_t cmd) {
+    // Register access is ignored while in RDATAC, like the real part
+    if ((cmd & ADS1299_OP_REG_MASK) == ADS1299_OP_RREG ||
+        (cmd & ADS1299_OP_REG_MASK) == ADS1299_OP_WREG) {
+        if (!data->rdatac) {
+            data->reg_addr = cmd & 0x1F;
+            data->state = ((cmd & ADS1299_OP_REG_MASK) == ADS1299_OP_RREG) ? EMUL_RREG_COUNT : EMUL_WREG_COUNT;
+        }
+        return;
+    }
+
+    switch (cmd) {
+    case ADS1299_OP_WAKEUP:
+        data->standby = false;
+        break;
+    case ADS1299_OP_STANDBY:
+        data->standby = true;
+        break;
+    case ADS1299_OP_RESET:
+        ads1299_emul_reset(data);
+        return;
+    case ADS1299_OP_START:
+        data->converting = true;
+        break;
+    case ADS1299_OP_STOP:
+        data->converting = false;
+        break;
+    case ADS1299_OP_RDATAC:
+        data->rdatac = true;
+        return;
+    case ADS1299_OP_SDATAC:
+        data->rdatac = false;
+        return;
+    case ADS1299_OP_RDATA:
+        if (!data->rdatac) {
+            data->frame_pos = 0;
+            data->state = EMUL_RDATA_OUT;
+        }
+        return;
+    default:
+        return; // NOP and undefined opcodes
+    }
+
+    ads1299_emul_update_timer(data);
+}
+
+static uint8_t ads1299_emul_frame_byte(struct ads1299_emul_data *data) {
+    if (data->frame_pos >= sizeof(data->frame)) {
+        return 0;
+    }
+
+    uint8_t out = data->frame[data->frame_pos++];
+    if (data->frame_pos == sizeof(data->frame) && data->frame_unread) {
+        data->frame_unread = false;
+        data->stats.frames_read++;
+    }
+    return out;
+}
+
+/* Clocks one byte through the chip: returns DOUT for the given DIN */
+static uint8_t ads1299_emul_clock_byte(struct ads1299_emul_data *data, uint8_t in) {
+    uint8_t out = 0;
+
+    switch (data->state) {
+    case EMUL_RREG_COUNT:
+    case EMUL_WREG_COUNT:
+        data->reg_remaining = (in & 0x1F) + 1;
+        data->state = (data->state == EMUL_RREG_COUNT) ? EMUL_RREG_DATA : EMUL_WREG_DATA;
+        return 0;
+    case EMUL_RREG_DATA:
+        out = (data->reg_addr < ADS1299_EMUL_NUM_REGS) ? data->regs[data->reg_addr] : 0;
+        data->reg_addr++;
+        if (--data->reg_remaining == 0) {
+            data->state = EMUL_IDLE;
+        }
+        return out;
+    case EMUL_WREG_DATA:
+        ads1299_emul_write_reg(data, data->reg_addr++, in);
+        if (--data->reg_remaining == 0) {
+            data->state = EMUL_IDLE;
+        }
+        return 0;
+    case EMUL_RDATA_OUT:
+        out = ads1299_emul_frame_byte(data);
+        if (data->frame_pos >= sizeof(data->frame)) {
+            data->state = EMUL_IDLE;
+        }
+        return out;
+    case EMUL_IDLE:
+    default:
+        break;
+    }
+
+    // In RDATAC the latest frame shifts out on DOUT whatever DIN carries
+    if (data->rdatac) {
+        out = ads1299_emul_frame_byte(data);
+    }
+
+    ads1299_emul_command(data, in);
+    return out;
+}
+
+static size_t ads1299_emul_buf_set_len(const struct spi_buf_set *bufs) {
+    size_t len = 0;
+
+    for (size_t i = 0; bufs && i < bufs->count; i++) {
+        len += bufs->buffers[i].len;
+    }
+    return len;
+}
+
+static uint8_t *ads1299_emul_buf_set_at(const struct spi_buf_set *bufs, size_t pos) {
+    for (size_t i = 0; bufs && i < bufs->count; i++) {
+        if (pos < bufs->buffers[i].len) {
+            return bufs->buffers[i].buf ? (uint8_t *)bufs->buffers[i].buf + pos : NULL;
+        }
+        pos -= bufs->buffers[i].len;
+    }
+    return NULL;
+}
+
+static int ads1299_emul_io(const struct emul *target, const struct spi_config *config,
+                           const struct spi_buf_set *tx_bufs, const struct spi_buf_set *rx_bufs) {
+    struct ads1299_emul_data *data = target->data;
+    const struct ads1299_emul_cfg *cfg = target->cfg;
+    size_t len = MAX(ads1299_emul_buf_set_len(tx_bufs), ads1299_emul_buf_set_len(rx_bufs));
+
+    ARG_UNUSED(config);
+
+    k_spinlock_key_t key = k_spin_lock(&data->lock);
+    bool frame_started = data->rdatac && data->frame_unread && data->frame_pos == 0;
+
+    for (size_t pos = 0; pos < len; pos++) {
+        const uint8_t *in = ads1299_emul_buf_set_at(tx_bufs, pos);
+        uint8_t *out = ads1299_emul_buf_set_at(rx_bufs, pos);
+        uint8_t dout = ads1299_emul_clock_byte(data, in ? *in : 0x00);
+
+        if (out) {
+            *out = dout;
+        }
+    }
+    k_spin_unlock(&data->lock, key);
+
+    // DRDY returns high on the first SCLK of a frame read
+    if (frame_started && len > 0) {
+        gpio_emul_input_set(cfg->drdy.port, cfg->drdy.pin, 1);
+    }
+
+    return 0;
+}
+
+static const struct spi_emul_api ads1299_emul_api = {
+    .io = ads1299_emul_io,
+};
+
+void ads1299_emul_get_stats(const struct emul *target, struct ads1299_emul_stats *stats) {
+    struct ads1299_emul_data *data = target->data;
+
+    k_spinlock_key_t key = k_spin_lock(&data->lock);
+    *stats = data->stats;
+    k_spin_unlock(&data->lock, key);
+}
+
+uint8_t ads1299_emul_get_reg(const struct emul *target, uint8_t reg_addr) {
+    struct ads1299_emul_data *data = target->data;
+
+    return (reg_addr < ADS1299_EMUL_NUM_REGS) ? data->regs[reg_addr] : 0;
+}
+
+static int ads1299_emul_init(const struct emul *target, const struct device *parent) {
+    struct ads1299_emul_data *data = target->data;
+
+    ARG_UNUSED(parent);
+
+    data->target = target;
+    data->noise_state = 0x2545F491;
+    k_timer_init(&data->drdy_timer, ads1299_emul_drdy_tick, NULL);
+    ads1299_emul_reset(data);
+
+    return 0;
+}
+
+#define ADS1299_EMUL_DEFINE(n)                                                          \
+    static struct ads1299_emul_data ads1299_emul_data_##n;                              \
+    static const struct ads1299_emul_cfg ads1299_emul_cfg_##n = {                       \
+        .drdy = GPIO_DT_SPEC_INST_GET(n, drdy_gpios),                                   \
+    };                                                                                  \
+    EMUL_DT_INST_DEFINE(n, ads1299_emul_init, &ads1299_emul_data_##n,                   \
+                        &ads1299_emul_cfg_##n, &ads1299_emul_api, NULL);                \
+    EMUL_STUB_DEVICE(n)
+
+DT_INST_FOREACH_STATUS_OKAY(ADS1299_EMUL_DEFINE)
\ No newline at end of file
@@ -0,0 +1,22 @@
+#ifndef ADS1299_EMUL_H
+#define ADS1299_EMUL_H
+
+#include <stdint.h>
+#include <zephyr/drivers/emul.h>
+
+// Register map size (ID through CONFIG4)
+#define ADS1299_EMUL_NUM_REGS   0x18
+
+/* Counters kept by the emulator so a benchmark can tell how many frames
+   the chip produced against how many the firmware actually read */
+struct ads1299_emul_stats {
+    uint32_t frames_generated;      // DRDY edges produced
+    uint32_t frames_read;           // Frames clocked out completely
+    uint32_t frames_overwritten;    // Frames replaced before the firmware read them
+};
+
+void ads1299_emul_get_stats(const struct emul *target, struct ads1299_emul_stats *stats);
+uint8_t ads1299_emul_get_reg(const struct emul *target, uint8_t reg_addr);
+uint32_t ads1299_emul_data_rate(const struct emul *target);
+
+#endif // ADS1299_EMUL_H
\ No newline at end of file
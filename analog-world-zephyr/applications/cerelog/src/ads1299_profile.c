@@ -0,0 +1,107 @@
+#include "ads1299_profile.h"
+#include <string.h>
+#include <zephyr/kernel.h>
+
+// Register addresses the profiles touch
+#define REG_CONFIG1     0x01
+#define REG_CONFIG2     0x02
+#define REG_CH1SET      0x05
+#define NUM_CHANNELS    8
+
+// CONFIG2 with the internal 1x amplitude test signal at fCLK/2^21
+#define CONFIG2_TEST_SIGNAL     0xD0
+
+static const ads1299_profile_t profiles[] = {
+    // Data rate: 16 kSPS >> DR
+    {"250sps",  6, PROFILE_KEEP, PROFILE_KEEP, PROFILE_KEEP},
+    {"500sps",  5, PROFILE_KEEP, PROFILE_KEEP, PROFILE_KEEP},
+    {"1ksps",   4, PROFILE_KEEP, PROFILE_KEEP, PROFILE_KEEP},
+    {"2ksps",   3, PROFILE_KEEP, PROFILE_KEEP, PROFILE_KEEP},
+    {"4ksps",   2, PROFILE_KEEP, PROFILE_KEEP, PROFILE_KEEP},
+    {"8ksps",   1, PROFILE_KEEP, PROFILE_KEEP, PROFILE_KEEP},
+    {"16ksps",  0, PROFILE_KEEP, PROFILE_KEEP, PROFILE_KEEP},
+
+    // PGA gain
+    {"gain1",   PROFILE_KEEP, 0, PROFILE_KEEP, PROFILE_KEEP},
+    {"gain2",   PROFILE_KEEP, 1, PROFILE_KEEP, PROFILE_KEEP},
+    {"gain4",   PROFILE_KEEP, 2, PROFILE_KEEP, PROFILE_KEEP},
+    {"gain6",   PROFILE_KEEP, 3, PROFILE_KEEP, PROFILE_KEEP},
+    {"gain8",   PROFILE_KEEP, 4, PROFILE_KEEP, PROFILE_KEEP},
+    {"gain12",  PROFILE_KEEP, 5, PROFILE_KEEP, PROFILE_KEEP},
+    {"gain24",  PROFILE_KEEP, 6, PROFILE_KEEP, PROFILE_KEEP},
+
+    // Input routing
+    {"normal",  PROFILE_KEEP, PROFILE_KEEP, PROFILE_INPUT_NORMAL, PROFILE_KEEP},
+    {"shorted", PROFILE_KEEP, PROFILE_KEEP, PROFILE_INPUT_SHORTED, PROFILE_KEEP},
+    {"test",    PROFILE_KEEP, PROFILE_KEEP, PROFILE_INPUT_TEST, PROFILE_KEEP},
+
+    // On-device decimation: the link carries the chip rate divided by this
+    {"decim1",  PROFILE_KEEP, PROFILE_KEEP, PROFILE_KEEP, 1},
+    {"decim2",  PROFILE_KEEP, PROFILE_KEEP, PROFILE_KEEP, 2},
+    {"decim4",  PROFILE_KEEP, PROFILE_KEEP, PROFILE_KEEP, 4},
+    {"decim8",  PROFILE_KEEP, PROFILE_KEEP, PROFILE_KEEP, 8},
+    {"decim16", PROFILE_KEEP, PROFILE_KEEP, PROFILE_KEEP, 16},
+    {"decim32", PROFILE_KEEP, PROFILE_KEEP, PROFILE_KEEP, 32},
+    {"decim64", PROFILE_KEEP, PROFILE_KEEP, PROFILE_KEEP, 64},
+
+    // Oversampled: 250 SPS out of the chip running at 4, 8 or 16 kSPS
+    {"250sps_os16", 2, PROFILE_KEEP, PROFILE_KEEP, 16},
+    {"250sps_os32", 1, PROFILE_KEEP, PROFILE_KEEP, 32},
+    {"250sps_os64", 0, PROFILE_KEEP, PROFILE_KEEP, 64},
+};
+
+K_MSGQ_DEFINE(profile_requests, sizeof(const ads1299_profile_t *), 4, sizeof(void *));
+
+const ads1299_profile_t *ads1299_profile_find(const char *name) {
+    for (int i = 0; i < ARRAY_SIZE(profiles); i++) {
+        if (strcmp(profiles[i].name, name) == 0) {
+            return &profiles[i];
+        }
+    }
+    return NULL;
+}
+
+/* Edits a full register image, normally a copy of the driver's shadow */
+void ads1299_profile_apply_to(const ads1299_profile_t *profile, uint8_t *image) {
+    if (profile->data_rate != PROFILE_KEEP) {
+        image[REG_CONFIG1] = (image[REG_CONFIG1] & ~0x07) | profile->data_rate;
+    }
+
+    if (profile->input == PROFILE_INPUT_TEST) {
+        image[REG_CONFIG2] = CONFIG2_TEST_SIGNAL;
+    }
+
+    for (int ch = 0; ch < NUM_CHANNELS; ch++) {
+        uint8_t *chset = &image[REG_CH1SET + ch];
+
+        if (profile->gain != PROFILE_KEEP) {
+            *chset = (*chset & ~0x70) | (profile->gain << 4);
+        }
+        if (profile->input != PROFILE_KEEP) {
+            *chset = (*chset & ~0x07) | profile->input;
+        }
+    }
+}
+
+int ads1299_profile_request(const char *name) {
+    const ads1299_profile_t *profile = ads1299_profile_find(name);
+
+    if (!profile) {
+        return -ENOENT;
+    }
+
+    if (!IS_ENABLED(CONFIG_CERELOG_DECIMATE) && profile->decimation > 1) {
+        return -ENOTSUP;
+    }
+
+    return k_msgq_put(&profile_requests, &profile, K_NO_WAIT);
+}
+
+const ads1299_profile_t *ads1299_profile_take_request(void) {
+    const ads1299_profile_t *profile;
+
+    if (k_msgq_get(&profile_requests, &profile, K_NO_WAIT) != 0) {
+        return NULL;
+    }
+    return profile;
+}
\ No newline at end of file
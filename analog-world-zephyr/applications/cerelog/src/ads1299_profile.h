@@ -0,0 +1,34 @@
+#ifndef ADS1299_PROFILE_H
+#define ADS1299_PROFILE_H
+
+#include <stdint.h>
+
+/* Named partial configurations applied on top of the current registers.
+   Each field is a register bit field value, or PROFILE_KEEP to leave that
+   field as it is, so profiles compose: "2ksps" then "gain24" then "test". */
+#define PROFILE_KEEP            -1
+
+// CHnSET input mux settings used by the profiles
+#define PROFILE_INPUT_NORMAL    0x0
+#define PROFILE_INPUT_SHORTED   0x1
+#define PROFILE_INPUT_TEST      0x5
+
+typedef struct {
+    const char *name;
+    int8_t data_rate;           // CONFIG1 DR[2:0]
+    int8_t gain;                // CHnSET GAIN[2:0] on every channel
+    int8_t input;               // CHnSET MUX[2:0] on every channel
+    int8_t decimation;          // On-device decimation ratio, 1 for none
+} ads1299_profile_t;
+
+// Function declarations
+const ads1299_profile_t *ads1299_profile_find(const char *name);
+void ads1299_profile_apply_to(const ads1299_profile_t *profile, uint8_t *image);
+
+/* Requests are queued here and carried out by the acquisition thread.
+   Errors are only returned, since requests come from the host while
+   streaming and the console shares its UART. */
+int ads1299_profile_request(const char *name);
+const ads1299_profile_t *ads1299_profile_take_request(void);
+
+#endif // ADS1299_PROFILE_H
\ No newline at end of file
@@ -0,0 +1,408 @@
+#include "bench.h"
+#include "ads1299_emul.h"
+#include "ads1299_profile.h"
+#include "telemetry_format.h"
+#include "transport.h"
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/sys/printk.h>
+#include <posix_board_if.h>
+#include <cmdline.h>
+#include <soc.h>
+#include <string.h>
+
+// Latency histogram: 16 linear steps per power of two of microseconds, within 6%
+#define BENCH_LATENCY_SUB_BITS      4
+#define BENCH_LATENCY_BINS          ((32 - BENCH_LATENCY_SUB_BITS + 1) << BENCH_LATENCY_SUB_BITS)
+// Batches queued on the link and not yet through it; more than two full transmit buffers of the smallest
+#define BENCH_IN_FLIGHT             256
+
+// Run parameters, from the command line
+static uint32_t bench_dr = CONFIG_CERELOG_BENCH_CONFIG1_DR;
+static uint32_t bench_batch;        // 0 keeps the firmware's batch size
+static uint32_t bench_baud = CONFIG_CERELOG_BENCH_LINK_BAUD;
+static uint32_t bench_seconds = CONFIG_CERELOG_BENCH_SECONDS;
+static char *bench_capture_path;
+
+// Each stage is only ever updated by one thread
+static uint64_t bench_stage_ns[BENCH_STAGE_COUNT];
+static uint32_t bench_samples;
+static uint32_t bench_sent_samples;
+static uint64_t bench_bytes;
+static uint64_t bench_packed_bytes;
+static uint32_t bench_bad_packets;
+static uint32_t bench_missing_samples;
+static uint32_t bench_next_sample_number;
+static uint32_t bench_unsynced_samples;
+static ads1299_sample_t bench_decoded[BATCH_MAX_SAMPLES];
+static uint32_t bench_markers;
+static ads1299_marker_t bench_last_marker;
+static uint32_t bench_telemetry_packets;
+static uint32_t bench_bad_telemetry;
+static telemetry_packet_t bench_last_telemetry;
+
+/* Queued by the transmission thread, taken as the link finishes with
+   them, in its completion context; under bench_link_lock */
+struct bench_in_flight {
+    uint64_t end;               // Link byte offset just past the packet
+    uint64_t first_ns;          // DRDY of its first sample
+    uint32_t count;
+};
+
+static struct k_spinlock bench_link_lock;
+static struct bench_in_flight bench_in_flight[BENCH_IN_FLIGHT];
+static uint32_t bench_in_flight_head;
+static uint32_t bench_in_flight_tail;
+static uint64_t bench_queued_bytes;
+static uint64_t bench_delivered_bytes;
+static uint32_t bench_link_dropped;     // Samples in packets the transport refused
+static uint32_t bench_untimed;          // Samples whose packet found the in-flight list full
+static uint32_t bench_latency[BENCH_LATENCY_BINS];
+static uint32_t bench_latency_count;
+static uint32_t bench_latency_max_us;
+static uint32_t bench_sample_period_ns;
+
+static void bench_add_options(void) {
+    static struct args_struct_t bench_options[] = {
+        { .option = "bench-dr", .name = "bits", .type = 'u', .dest = &bench_dr,
+          .descript = "CONFIG1 data rate bits, 0 (16 kSPS) to 6 (250 SPS)" },
+        { .option = "bench-batch", .name = "samples", .type = 'u', .dest = &bench_batch,
+          .descript = "Samples per batch packet" },
+        { .option = "bench-baud", .name = "baud", .type = 'u', .dest = &bench_baud,
+          .descript = "Baud rate of the modelled link" },
+        { .option = "bench-seconds", .name = "s", .type = 'u', .dest = &bench_seconds,
+          .descript = "Simulated seconds to measure" },
+        { .option = "bench-capture", .name = "path", .type = 's', .dest = &bench_capture_path,
+          .descript = "Write the bytes that leave the link to this file" },
+        ARG_TABLE_ENDMARKER
+    };
+
+    native_add_command_line_opts(bench_options);
+}
+
+NATIVE_TASK(bench_add_options, PRE_BOOT_1, 10);
+
+uint8_t bench_config1_dr(void) {
+    return (uint8_t)(bench_dr & 0x07);
+}
+
+uint32_t bench_link_baud(void) {
+    return bench_baud;
+}
+
+static const char *const bench_stage_names[BENCH_STAGE_COUNT] = {
+    [BENCH_STAGE_READ] = "read",
+    [BENCH_STAGE_PARSE] = "parse",
+    [BENCH_STAGE_DECIMATE] = "decimate",
+    [BENCH_STAGE_BATCH] = "batch",
+    [BENCH_STAGE_PACKET] = "packet",
+    [BENCH_STAGE_TRANSMIT] = "transmit",
+};
+
+void bench_add(enum bench_stage stage, uint64_t ns) {
+    bench_stage_ns[stage] += ns;
+}
+
+void bench_count_sample(void) {
+    bench_samples++;
+}
+
+// Every chip's status word must carry the 1100 sync bits
+static bool bench_status_synced(const ads1299_sample_t *sample) {
+#if ADS1299_CHAIN_LENGTH > 1
+    for (int chip = 0; chip < ADS1299_CHAIN_LENGTH - 1; chip++) {
+        if ((sample->chain_status[chip] & ADS1299_STATUS_SYNC_MASK) != ADS1299_STATUS_SYNC) {
+            return false;
+        }
+    }
+#endif
+    return (sample->status & ADS1299_STATUS_SYNC_MASK) == ADS1299_STATUS_SYNC;
+}
+
+/* Runs every packet back through the decoder, so a broken encoder shows up
+   as bad packets, sample number gaps or lost chain status in the report */
+void bench_count_packet(const uint8_t *packet, size_t length) {
+    bench_bytes += length;
+
+    int count = decode_batch_packet(packet, length, bench_decoded, BATCH_MAX_SAMPLES);
+    if (count <= 0) {
+        bench_bad_packets++;
+        return;
+    }
+    bench_packed_bytes += BATCH_PACKET_SIZE(count);
+    bench_sent_samples += count;
+    // Samples in a packet share their status words
+    if (!bench_status_synced(&bench_decoded[0])) {
+        bench_unsynced_samples += count;
+    }
+
+    if (bench_next_sample_number != 0) {
+        bench_missing_samples += bench_decoded[0].sample_number - bench_next_sample_number;
+    }
+    bench_next_sample_number = bench_decoded[count - 1].sample_number + 1;
+}
+
+/* Every packet the transmission thread hands to the transport. A batch
+   the transport took is timed once the link has carried it; one it
+   refused loses its samples. */
+void bench_count_queued(const uint8_t *packet, size_t length, int result) {
+    const ads1299_batch_header_t *header = (const ads1299_batch_header_t *)packet;
+    bool batch = length >= sizeof(*header) && header->packet_type == PACKET_TYPE_ADS1299_BATCH;
+    k_spinlock_key_t key = k_spin_lock(&bench_link_lock);
+
+    if (result != 0) {
+        if (batch) {
+            bench_link_dropped += header->sample_count;
+        }
+        k_spin_unlock(&bench_link_lock, key);
+        return;
+    }
+    bench_queued_bytes += length;
+    if (batch) {
+        if (bench_in_flight_head - bench_in_flight_tail < BENCH_IN_FLIGHT) {
+            struct bench_in_flight *f = &bench_in_flight[bench_in_flight_head++ % BENCH_IN_FLIGHT];
+            f->end = bench_queued_bytes;
+            f->first_ns = header->timestamp_ns;
+            f->count = header->sample_count;
+        } else {
+            bench_untimed += header->sample_count;
+        }
+    }
+    k_spin_unlock(&bench_link_lock, key);
+}
+
+static uint32_t bench_latency_bin(uint32_t us) {
+    if (us < (1U << BENCH_LATENCY_SUB_BITS)) {
+        return us;
+    }
+    uint32_t e = 31 - __builtin_clz(us);
+    return ((e - BENCH_LATENCY_SUB_BITS + 1) << BENCH_LATENCY_SUB_BITS) |
+           ((us >> (e - BENCH_LATENCY_SUB_BITS)) & ((1U << BENCH_LATENCY_SUB_BITS) - 1));
+}
+
+// Largest latency that falls in bin
+static uint32_t bench_latency_bin_top(uint32_t bin) {
+    if (bin < (1U << BENCH_LATENCY_SUB_BITS)) {
+        return bin;
+    }
+    uint32_t shift = (bin >> BENCH_LATENCY_SUB_BITS) - 1;
+    uint32_t sub = bin & ((1U << BENCH_LATENCY_SUB_BITS) - 1);
+    return (uint32_t)(((uint64_t)(1U << BENCH_LATENCY_SUB_BITS) + sub + 1) << shift) - 1;
+}
+
+/* The link has carried length more bytes, data, to the host. Every batch
+   now wholly through it is decoded there, so each of its samples is timed
+   from DRDY. Called from the transport's completion context. */
+void bench_count_delivered(const uint8_t *data, size_t length) {
+    uint64_t now_ns = cycles_to_ns(get_cycles64());
+    k_spinlock_key_t key = k_spin_lock(&bench_link_lock);
+
+    bench_host_capture_write(data, length);
+    bench_delivered_bytes += length;
+    while (bench_in_flight_tail != bench_in_flight_head &&
+           bench_in_flight[bench_in_flight_tail % BENCH_IN_FLIGHT].end <= bench_delivered_bytes) {
+        const struct bench_in_flight *f = &bench_in_flight[bench_in_flight_tail++ % BENCH_IN_FLIGHT];
+        for (uint32_t i = 0; i < f->count; i++) {
+            uint64_t drdy_ns = f->first_ns + (uint64_t)i * bench_sample_period_ns;
+            uint32_t us = now_ns > drdy_ns ? (uint32_t)MIN((now_ns - drdy_ns) / 1000, UINT32_MAX) : 0;
+            bench_latency[bench_latency_bin(us)]++;
+            bench_latency_max_us = MAX(bench_latency_max_us, us);
+        }
+        bench_latency_count += f->count;
+    }
+    k_spin_unlock(&bench_link_lock, key);
+}
+
+// Latency below which permille of the timed samples fall, to the top of its bin
+static uint32_t bench_latency_percentile(uint32_t permille) {
+    uint64_t target = ((uint64_t)bench_latency_count * permille + 999) / 1000;
+    uint64_t seen = 0;
+
+    for (uint32_t bin = 0; bin < BENCH_LATENCY_BINS; bin++) {
+        seen += bench_latency[bin];
+        if (seen >= target && seen > 0) {
+            return MIN(bench_latency_bin_top(bin), bench_latency_max_us);
+        }
+    }
+    return 0;
+}
+
+void bench_count_marker(const ads1299_marker_t *marker) {
+    // Numbering markers follow every decimator restart and say nothing about the registers
+    if (marker->marker_type == MARKER_NUMBERING) {
+        return;
+    }
+    bench_markers++;
+    bench_last_marker = *marker;
+}
+
+// Checks each telemetry packet the way the host decoder would and keeps the latest
+void bench_count_telemetry(const uint8_t *packet, size_t length) {
+    const telemetry_packet_t *telemetry = (const telemetry_packet_t *)packet;
+
+    if (length != sizeof(telemetry_packet_t) || telemetry->packet_type != PACKET_TYPE_TELEMETRY ||
+        telemetry->stage_count != TELEMETRY_STAGE_COUNT ||
+        telemetry->crc16 != calculate_crc16(packet, offsetof(telemetry_packet_t, crc16))) {
+        bench_bad_telemetry++;
+        return;
+    }
+    bench_telemetry_packets++;
+    bench_last_telemetry = *telemetry;
+}
+
+/* Runs the pipeline for the benchmark's simulated seconds, prints the
+   report, then the same figures as one BENCH_JSON line for scripts, and
+   exits the simulator */
+void bench_run(sample_ring_t *ring) {
+    const struct emul *emul = EMUL_DT_GET(DT_NODELABEL(ads1299));
+    struct ads1299_emul_stats emul_start, emul_end;
+    uint64_t stage_start[BENCH_STAGE_COUNT];
+    uint64_t stage_ns[BENCH_STAGE_COUNT];
+
+    if (bench_dr > 6 || bench_baud < 10 || bench_seconds == 0) {
+        printk("Bad benchmark options: data rate bits %u, baud %u, %u s\n", bench_dr, bench_baud, bench_seconds);
+        posix_exit(2);
+    }
+    if (bench_batch != 0 && (bench_batch > BATCH_MAX_SAMPLES || set_batch_size((uint8_t)bench_batch) != 0)) {
+        printk("Bad benchmark batch size %u (1-%u)\n", bench_batch, BATCH_MAX_SAMPLES);
+        posix_exit(2);
+    }
+    if (bench_capture_path && bench_host_capture_open(bench_capture_path) != 0) {
+        printk("Cannot write capture %s\n", bench_capture_path);
+        posix_exit(2);
+    }
+
+    // Sent samples are spaced by the decimation ratio at boot; the benchmark's profile switch keeps it
+    uint32_t ratio = IS_ENABLED(CONFIG_CERELOG_DECIMATE) ? CONFIG_CERELOG_DECIMATE_RATIO : 1;
+    bench_sample_period_ns = NSEC_PER_SEC / ads1299_emul_data_rate(emul) * ratio;
+
+    // Let the pipeline reach steady state before measuring
+    k_msleep(100);
+
+    ads1299_emul_get_stats(emul, &emul_start);
+    uint32_t samples_start = bench_samples;
+    uint32_t sent_start = bench_sent_samples;
+    uint64_t bytes_start = bench_bytes;
+    uint64_t packed_start = bench_packed_bytes;
+    uint32_t bad_start = bench_bad_packets;
+    uint32_t missing_start = bench_missing_samples;
+    uint32_t unsynced_start = bench_unsynced_samples;
+    uint32_t overruns_start = sample_ring_overruns(ring);
+    transport_stats_t tx_start, tx_end;
+    transport_get_stats(&tx_start);
+    for (int i = 0; i < BENCH_STAGE_COUNT; i++) {
+        stage_start[i] = bench_stage_ns[i];
+    }
+    k_spinlock_key_t key = k_spin_lock(&bench_link_lock);
+    memset(bench_latency, 0, sizeof(bench_latency));
+    bench_latency_count = 0;
+    bench_latency_max_us = 0;
+    uint32_t link_dropped_start = bench_link_dropped;
+    uint32_t untimed_start = bench_untimed;
+    k_spin_unlock(&bench_link_lock, key);
+    uint64_t host_start = bench_host_now_ns();
+
+    // Switch gain halfway through to measure the reconfiguration gap
+    k_msleep(bench_seconds * MSEC_PER_SEC / 2);
+    ads1299_profile_request("gain24");
+    k_msleep(bench_seconds * MSEC_PER_SEC - bench_seconds * MSEC_PER_SEC / 2);
+
+    uint64_t host_ns = bench_host_now_ns() - host_start;
+    ads1299_emul_get_stats(emul, &emul_end);
+    transport_get_stats(&tx_end);
+    key = k_spin_lock(&bench_link_lock);
+    uint32_t link_dropped = bench_link_dropped - link_dropped_start;
+    uint32_t untimed = bench_untimed - untimed_start;
+    uint32_t timed = bench_latency_count;
+    uint32_t p50 = bench_latency_percentile(500);
+    uint32_t p90 = bench_latency_percentile(900);
+    uint32_t p99 = bench_latency_percentile(990);
+    uint32_t p999 = bench_latency_percentile(999);
+    uint32_t latency_max = bench_latency_max_us;
+    k_spin_unlock(&bench_link_lock, key);
+
+    uint32_t samples = bench_samples - samples_start;
+    uint32_t sent = bench_sent_samples - sent_start;
+    uint64_t bytes = bench_bytes - bytes_start;
+    uint64_t packed = bench_packed_bytes - packed_start;
+    uint32_t generated = emul_end.frames_generated - emul_start.frames_generated;
+    uint32_t overwritten = emul_end.frames_overwritten - emul_start.frames_overwritten;
+    uint32_t overruns = sample_ring_overruns(ring) - overruns_start;
+    uint32_t tx_bytes = tx_end.bytes - tx_start.bytes;
+    uint32_t link = transport_link_bytes_per_s() * bench_seconds;
+    uint32_t link_use = link ? (uint32_t)((uint64_t)tx_bytes * 100 / link) : 0;
+    uint32_t busy = (tx_end.busy_us - tx_start.busy_us) / (bench_seconds * 10000);
+    uint32_t missing = bench_missing_samples - missing_start;
+    uint64_t total_ns = 0;
+
+    for (int i = 0; i < BENCH_STAGE_COUNT; i++) {
+        stage_ns[i] = bench_stage_ns[i] - stage_start[i];
+        total_ns += stage_ns[i];
+    }
+    // Share of one host core the pipeline stages took, against simulated time: below 100% keeps up in real time
+    uint32_t cpu_load = (uint32_t)(total_ns * 10000 / ((uint64_t)bench_seconds * NSEC_PER_SEC));
+
+    printk("\n=== Pipeline benchmark: DRDY -> parse -> format ===\n");
+    printk("Nominal rate:      %u SPS\n", ads1299_emul_data_rate(emul));
+    printk("Channels:          %u (%u ADS1299 in the chain, %u-byte frames)\n",
+           ADS1299_NUM_CHANNELS, ADS1299_CHAIN_LENGTH, ADS1299_TOTAL_DATA_BYTES);
+    printk("Duration:          %u s simulated, %u ms host\n",
+           bench_seconds, (uint32_t)(host_ns / 1000000));
+    printk("Frames generated:  %u\n", generated);
+    printk("Samples formatted: %u (%u SPS simulated, %u SPS host)\n", samples,
+           samples / bench_seconds,
+           host_ns ? (uint32_t)((uint64_t)samples * 1000000000ULL / host_ns) : 0);
+    printk("Samples sent:      %u (%u SPS simulated, after decimation)\n", sent,
+           sent / bench_seconds);
+    printk("Link:              %u bytes/s, %u.%02u bytes/sample (batch of %u)\n",
+           (uint32_t)(bytes / bench_seconds),
+           sent ? (uint32_t)(bytes / sent) : 0,
+           sent ? (uint32_t)(bytes * 100 / sent % 100) : 0, get_batch_size());
+    printk("Compression:       %s, %u.%02u:1 against packed 24-bit packets\n",
+           get_batch_compression() ? "on" : "off",
+           bytes ? (uint32_t)(packed / bytes) : 0,
+           bytes ? (uint32_t)(packed * 100 / bytes % 100) : 0);
+    printk("Transport:         %u bytes/s sent, %u%% of the link, busy %u%%, %u stalls, %u drops\n",
+           tx_bytes / bench_seconds, link_use, busy,
+           tx_end.stalls - tx_start.stalls, tx_end.drops - tx_start.drops);
+    printk("Decode:            %u bad packets, %u samples missing from the stream, %u out of sync\n",
+           bench_bad_packets - bad_start, missing, bench_unsynced_samples - unsynced_start);
+    printk("Reconfiguration:   %u markers, last wrote %d registers in %u us\n",
+           bench_markers, bench_last_marker.result, bench_last_marker.gap_us);
+    printk("Drops:             %u overwritten before read, %u ring overruns, %u samples refused by the transport\n",
+           overwritten, overruns, link_dropped);
+    printk("Latency:           DRDY to host %u us median, %u us p90, %u us p99, %u us p99.9, %u us max"
+           " (%u samples, %u untimed)\n", p50, p90, p99, p999, latency_max, timed, untimed);
+    printk("Telemetry:         %u packets, %u bad, last saw %u samples, ring high water %u/%u\n",
+           bench_telemetry_packets, bench_bad_telemetry, bench_last_telemetry.samples,
+           bench_last_telemetry.ring_high_water, bench_last_telemetry.ring_size);
+
+    for (int i = 0; i < BENCH_STAGE_COUNT; i++) {
+        printk("CPU %-14s %u ns/sample\n", bench_stage_names[i],
+               samples ? (uint32_t)(stage_ns[i] / samples) : 0);
+    }
+    printk("CPU total          %u ns/sample, %u.%02u%% of a host core\n",
+           samples ? (uint32_t)(total_ns / samples) : 0, cpu_load / 100, cpu_load % 100);
+
+    // One flat object per run, keys stable across commits so sweeps can be compared
+    printk("BENCH_JSON {\"rate_sps\":%u,\"config1_dr\":%u,\"channels\":%u,\"batch\":%u,\"compression\":%s,"
+           "\"baud\":%u,\"seconds\":%u,\"generated\":%u,\"samples\":%u,\"sent\":%u,\"sent_sps\":%u,"
+           "\"link_bytes_per_s\":%u,\"link_use_pct\":%u,\"link_busy_pct\":%u,"
+           "\"dropped\":%u,\"overwritten\":%u,\"ring_overruns\":%u,\"link_dropped\":%u,"
+           "\"missing\":%u,\"bad_packets\":%u,"
+           "\"latency_p50_us\":%u,\"latency_p90_us\":%u,\"latency_p99_us\":%u,\"latency_p999_us\":%u,"
+           "\"latency_max_us\":%u,\"latency_samples\":%u,",
+           ads1299_emul_data_rate(emul), bench_config1_dr(), ADS1299_NUM_CHANNELS, get_batch_size(),
+           get_batch_compression() ? "true" : "false", bench_baud, bench_seconds, generated, samples, sent,
+           sent / bench_seconds, tx_bytes / bench_seconds, link_use, busy,
+           overwritten + overruns + link_dropped, overwritten, overruns, link_dropped,
+           missing, bench_bad_packets - bad_start, p50, p90, p99, p999, latency_max, timed);
+    for (int i = 0; i < BENCH_STAGE_COUNT; i++) {
+        printk("\"cpu_%s_ns\":%u,", bench_stage_names[i], samples ? (uint32_t)(stage_ns[i] / samples) : 0);
+    }
+    printk("\"cpu_ns_per_sample\":%u,\"cpu_load_pct\":%u.%02u}\n",
+           samples ? (uint32_t)(total_ns / samples) : 0, cpu_load / 100, cpu_load % 100);
+
+    bench_host_capture_close();
+    posix_exit(0);
+}
\ No newline at end of file
@@ -0,0 +1,53 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sample_ring.h"
+
+/* Throughput benchmark for native_sim (CONFIG_CERELOG_BENCH).
+   Stage times are taken from the host's monotonic clock, since simulated
+   time does not advance while firmware code runs. Latency is simulated
+   time from each sample's DRDY to the end of its packet's transfer, when
+   the host would decode it.
+
+   The data rate, batch size, link rate and duration default to their
+   Kconfig values and can be set per run on the zephyr.exe command line
+   (--help lists the --bench-* options), so one build serves a whole
+   sweep; host/tools/bench_sweep.cpp drives it. */
+
+enum bench_stage {
+    BENCH_STAGE_READ,       // Thread time for a frame read (the submission when async)
+    BENCH_STAGE_PARSE,      // process_ads1299_data into the ring
+    BENCH_STAGE_DECIMATE,   // One input sample through the decimator
+    BENCH_STAGE_BATCH,      // Staging samples into the current batch
+    BENCH_STAGE_PACKET,     // batch_frame_finish: pack or compress, CRC
+    BENCH_STAGE_TRANSMIT,   // Copying each packet into a transport buffer and starting its transfer
+    BENCH_STAGE_COUNT
+};
+
+#ifdef CONFIG_CERELOG_BENCH
+uint64_t bench_host_now_ns(void);
+int bench_host_capture_open(const char *path);
+void bench_host_capture_write(const uint8_t *data, size_t length);
+void bench_host_capture_close(void);
+
+uint8_t bench_config1_dr(void);
+uint32_t bench_link_baud(void);
+void bench_add(enum bench_stage stage, uint64_t ns);
+void bench_count_sample(void);
+void bench_count_packet(const uint8_t *packet, size_t length);
+void bench_count_queued(const uint8_t *packet, size_t length, int result);
+void bench_count_delivered(const uint8_t *data, size_t length);
+void bench_count_marker(const ads1299_marker_t *marker);
+void bench_count_telemetry(const uint8_t *packet, size_t length);
+void bench_run(sample_ring_t *ring);
+
+#define BENCH_START(t)          uint64_t t = bench_host_now_ns()
+#define BENCH_END(stage, t)     bench_add(stage, bench_host_now_ns() - (t))
+#else
+#define BENCH_START(t)
+#define BENCH_END(stage, t)
+#endif
+
+#endif // BENCH_H
\ No newline at end of file
@@ -0,0 +1,34 @@
+/* Built into the native simulator runner rather than the Zephyr image,
+   so it can reach the host C library's clocks and files. */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+// Link bytes as the host would receive them, for the host decoder to check
+static FILE *bench_capture;
+
+uint64_t bench_host_now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+int bench_host_capture_open(const char *path) {
+    bench_capture = fopen(path, "wb");
+    return bench_capture ? 0 : -1;
+}
+
+void bench_host_capture_write(const uint8_t *data, size_t length) {
+    if (bench_capture) {
+        fwrite(data, 1, length, bench_capture);
+    }
+}
+
+void bench_host_capture_close(void) {
+    if (bench_capture) {
+        fclose(bench_capture);
+        bench_capture = NULL;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,306 @@
+#include "capture.h"
+#include "data_handler.h"
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <string.h>
+
+#define CAPTURE_FRAME_BYTES     ADS1299_TOTAL_DATA_BYTES
+// Each slot also keeps the DRDY edge count its frame was read at
+#define CAPTURE_FRAMES          ((uint32_t)(CONFIG_CERELOG_CAPTURE_BUFFER_SIZE / (CAPTURE_FRAME_BYTES + sizeof(uint32_t))))
+// CONFIG1 data rate bits run from 16 kSPS at 0 to 250 SPS at 6
+#define CAPTURE_SLOWEST_DR      6
+
+BUILD_ASSERT(CAPTURE_FRAMES >= 2, "CONFIG_CERELOG_CAPTURE_BUFFER_SIZE holds fewer than two frames");
+
+enum capture_state {
+    CAPTURE_IDLE,               // Not recording
+    CAPTURE_ARMED,              // Recording round the ring, waiting for a trigger
+    CAPTURE_RECORDING,          // Triggered, recording the post-trigger frames
+    CAPTURE_DRAINING,           // Frozen, being sent
+};
+
+/* Frames packed back to back as read, so a capture drains in one or two
+   copies: the sample number and time of each follow from its position in
+   the capture */
+static uint8_t capture_buffer[CAPTURE_FRAMES][CAPTURE_FRAME_BYTES];
+// DRDY edge count when each slot's frame was read, for the edges a capture missed
+static uint32_t capture_edges[CAPTURE_FRAMES];
+// Packet being drained, built by the transmission thread
+static uint8_t capture_packet[CAPTURE_PACKET_SIZE(CAPTURE_PACKET_FRAMES)];
+
+// Everything up to the frozen capture is under capture_lock
+static struct k_spinlock capture_lock;
+static capture_settings_t settings;
+static enum capture_state state;
+static bool armed;                  // Go back to armed once a capture is sent
+static uint8_t pending_trigger;     // Source of a trigger the writer has not taken yet
+static bool pending_stop;
+static uint8_t data_rate;
+
+// Recording, by capture_store()
+static uint32_t head;               // Slot of the next frame
+static uint32_t recorded;           // Frames written since recording began
+static uint32_t frames;             // Frames in the capture so far, the trigger frame and those before it included
+static uint32_t post_left;
+
+/* The frozen capture: its description and first slot. The drain position
+   belongs to the transmission thread. */
+static capture_header_t capture;
+static uint32_t capture_start;
+static uint32_t drain_next;
+
+static uint32_t stat_captures;
+static uint32_t stat_packets;
+static uint32_t stat_ignored;
+
+// Starts recording round the ring; a trigger keeps what came before it
+static void begin_locked(void) {
+    state = CAPTURE_ARMED;
+    recorded = 0;
+    pending_trigger = 0;
+    pending_stop = false;
+}
+
+static void freeze_locked(void) {
+    uint32_t last = (head + CAPTURE_FRAMES - 1) % CAPTURE_FRAMES;
+
+    capture_start = (head + CAPTURE_FRAMES - frames) % CAPTURE_FRAMES;
+    /* More DRDY edges from its first frame to its last than frames in it
+       means some went unread; edges missed before it do not count */
+    uint32_t edges = capture_edges[last] - capture_edges[capture_start] + 1;
+    capture.total_frames = frames;
+    capture.missed_drdy = edges > frames ? edges - frames : 0;
+    capture.capture_id = (uint16_t)++stat_captures;
+    drain_next = 0;
+    state = CAPTURE_DRAINING;
+}
+
+static bool over_threshold(const ads1299_sample_t *sample) {
+    for (int ch = 0; ch < ADS1299_NUM_CHANNELS; ch++) {
+        if ((settings.channels & BIT(ch)) &&
+            (sample->channels[ch] >= settings.threshold || sample->channels[ch] <= -settings.threshold)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void capture_init(void) {
+    capture_settings_t boot = {
+        .pre_frames = CONFIG_CERELOG_CAPTURE_PRE_FRAMES,
+        .post_frames = CONFIG_CERELOG_CAPTURE_POST_FRAMES,
+        .sources = (CONFIG_CERELOG_CAPTURE_TRIGGER_PIN >= 0 ? CAPTURE_TRIGGER_GPIO : 0) |
+                   (CONFIG_CERELOG_CAPTURE_THRESHOLD > 0 ? CAPTURE_TRIGGER_THRESHOLD : 0),
+        .threshold = CONFIG_CERELOG_CAPTURE_THRESHOLD,
+        .channels = CONFIG_CERELOG_CAPTURE_THRESHOLD_CHANNELS,
+    };
+
+    capture_arm(&boot);
+    if (!IS_ENABLED(CONFIG_CERELOG_CAPTURE_ARM_AT_BOOT)) {
+        capture_disarm();
+    }
+}
+
+// Ring size and how long it lasts at each data rate
+void capture_report(void) {
+    printk("Capture ring: %u frames of %u bytes, lasting", CAPTURE_FRAMES, CAPTURE_FRAME_BYTES);
+    for (uint8_t dr = 0; dr <= CAPTURE_SLOWEST_DR; dr++) {
+        uint32_t rate = CAPTURE_SAMPLE_RATE(dr);
+        printk("%s %u ms at %u SPS", dr ? "," : "", (uint32_t)((uint64_t)CAPTURE_FRAMES * 1000 / rate), rate);
+    }
+    printk("\n");
+}
+
+/* Arms with new settings, or with those in use when settings is NULL. The
+   pre- and post-trigger lengths are cut to fit the ring, the pre-trigger
+   part first. Settings only change between captures. */
+int capture_arm(const capture_settings_t *new_settings) {
+    capture_settings_t s;
+    int ret = 0;
+
+    if (new_settings) {
+        s = *new_settings;
+        if ((s.sources & CAPTURE_TRIGGER_GPIO) && CONFIG_CERELOG_CAPTURE_TRIGGER_PIN < 0) {
+            return -ENOTSUP;
+        }
+        if ((s.sources & CAPTURE_TRIGGER_THRESHOLD) && s.threshold <= 0) {
+            return -EINVAL;
+        }
+        // The trigger frame takes one slot
+        s.pre_frames = MIN(s.pre_frames, CAPTURE_FRAMES - 1);
+        s.post_frames = MIN(s.post_frames, CAPTURE_FRAMES - 1 - s.pre_frames);
+        s.sources = (s.sources & (CAPTURE_TRIGGER_GPIO | CAPTURE_TRIGGER_THRESHOLD)) | CAPTURE_TRIGGER_COMMAND;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&capture_lock);
+    if (state == CAPTURE_RECORDING || state == CAPTURE_DRAINING) {
+        ret = new_settings ? -EBUSY : 0;
+    } else {
+        if (new_settings) {
+            settings = s;
+        }
+        begin_locked();
+    }
+    if (ret == 0) {
+        armed = true;
+    }
+    k_spin_unlock(&capture_lock, key);
+    return ret;
+}
+
+void capture_disarm(void) {
+    k_spinlock_key_t key = k_spin_lock(&capture_lock);
+    armed = false;
+    if (state == CAPTURE_ARMED) {
+        state = CAPTURE_IDLE;
+    }
+    k_spin_unlock(&capture_lock, key);
+}
+
+/* Triggers the capture; the writer takes it with the next frame. The host
+   can trigger while disarmed, and gets no pre-trigger frames. Any
+   context, interrupts included. */
+void capture_trigger(uint8_t source) {
+    k_spinlock_key_t key = k_spin_lock(&capture_lock);
+    if (state == CAPTURE_IDLE && source == CAPTURE_TRIGGER_COMMAND) {
+        begin_locked();
+    }
+    if (state == CAPTURE_ARMED) {
+        if ((settings.sources & source) && !pending_trigger) {
+            pending_trigger = source;
+        }
+    } else if (state != CAPTURE_IDLE) {
+        stat_ignored++;
+    }
+    k_spin_unlock(&capture_lock, key);
+}
+
+// Ends a capture being recorded with the frames so far
+void capture_stop(uint8_t source) {
+    k_spinlock_key_t key = k_spin_lock(&capture_lock);
+    if (state == CAPTURE_RECORDING && (settings.sources & source)) {
+        pending_stop = true;
+    }
+    k_spin_unlock(&capture_lock, key);
+}
+
+// CONFIG1 data rate bits, recorded with each capture
+void capture_set_data_rate(uint8_t dr) {
+    data_rate = dr & 0x07;
+}
+
+/* Keeps one frame just read, parsed into sample, with the DRDY edge count
+   at the time. Called for every frame, in the order read. */
+void capture_store(const uint8_t *frame, const ads1299_sample_t *sample, uint32_t drdy_edges) {
+    k_spinlock_key_t key = k_spin_lock(&capture_lock);
+
+    if (state == CAPTURE_RECORDING && pending_stop) {
+        freeze_locked();
+    }
+    if (state != CAPTURE_ARMED && state != CAPTURE_RECORDING) {
+        k_spin_unlock(&capture_lock, key);
+        return;
+    }
+
+    memcpy(capture_buffer[head], frame, CAPTURE_FRAME_BYTES);
+    capture_edges[head] = drdy_edges;
+    head = head + 1 == CAPTURE_FRAMES ? 0 : head + 1;
+    if (recorded < UINT32_MAX) {
+        recorded++;
+    }
+
+    if (state == CAPTURE_ARMED) {
+        uint8_t source = pending_trigger;
+        if (!source && (settings.sources & CAPTURE_TRIGGER_THRESHOLD) && over_threshold(sample)) {
+            source = CAPTURE_TRIGGER_THRESHOLD;
+        }
+        if (source) {
+            uint32_t pre = MIN(recorded - 1, settings.pre_frames);
+            capture.trigger_source = source;
+            capture.data_rate = data_rate;
+            capture.trigger_frame = pre;
+            // Read numbering: the decimator, if any, has not seen this frame yet
+            capture.first_read = sample->sample_number - pre;
+            capture.trigger_ns = cycles_to_ns(sample->drdy_cycles);
+            frames = pre + 1;
+            post_left = settings.post_frames;
+            pending_trigger = 0;
+            pending_stop = false;
+            state = CAPTURE_RECORDING;
+        }
+    } else {
+        frames++;
+        post_left--;
+    }
+
+    if (state == CAPTURE_RECORDING && post_left == 0) {
+        freeze_locked();
+    }
+    k_spin_unlock(&capture_lock, key);
+}
+
+bool capture_draining(void) {
+    k_spinlock_key_t key = k_spin_lock(&capture_lock);
+    bool draining = state == CAPTURE_DRAINING;
+    k_spin_unlock(&capture_lock, key);
+    return draining;
+}
+
+/* Builds the next packet of the frozen capture. Returns its length and
+   points packet at it, or returns 0 when there is nothing to drain. The
+   last packet re-arms the ring, or leaves it idle when disarmed; the
+   packet stays valid until the next call. */
+size_t capture_next(const uint8_t **packet) {
+    if (!capture_draining()) {
+        return 0;
+    }
+
+    uint32_t count = MIN(capture.total_frames - drain_next, CAPTURE_PACKET_FRAMES);
+    capture_header_t *header = (capture_header_t *)capture_packet;
+    *header = capture;
+    header->start_bytes[0] = PACKET_START_BYTE1;
+    header->start_bytes[1] = PACKET_START_BYTE2;
+    header->packet_type = PACKET_TYPE_CAPTURE | PACKET_CHAIN_BITS(ADS1299_CHAIN_LENGTH);
+    header->frame_count = (uint8_t)count;
+    header->frame_index = drain_next;
+
+    // The capture may wrap round the end of the ring
+    uint8_t *data = capture_packet + sizeof(capture_header_t);
+    uint32_t slot = (capture_start + drain_next) % CAPTURE_FRAMES;
+    uint32_t before_end = MIN(count, CAPTURE_FRAMES - slot);
+    memcpy(data, capture_buffer[slot], before_end * CAPTURE_FRAME_BYTES);
+    memcpy(data + before_end * CAPTURE_FRAME_BYTES, capture_buffer[0], (count - before_end) * CAPTURE_FRAME_BYTES);
+
+    size_t crc_size = sizeof(capture_header_t) + count * CAPTURE_FRAME_BYTES;
+    uint16_t crc = calculate_crc16(capture_packet, crc_size);
+    memcpy(&capture_packet[crc_size], &crc, sizeof(crc));
+    capture_packet[crc_size + PACKET_CRC_SIZE] = PACKET_END_BYTE1;
+    capture_packet[crc_size + PACKET_CRC_SIZE + 1] = PACKET_END_BYTE2;
+
+    drain_next += count;
+    stat_packets++;
+    if (drain_next == capture.total_frames) {
+        k_spinlock_key_t key = k_spin_lock(&capture_lock);
+        if (armed) {
+            begin_locked();
+        } else {
+            state = CAPTURE_IDLE;
+        }
+        k_spin_unlock(&capture_lock, key);
+    }
+
+    *packet = capture_packet;
+    return crc_size + PACKET_CRC_SIZE + PACKET_TRAILER_SIZE;
+}
+
+void capture_get_stats(capture_stats_t *stats) {
+    k_spinlock_key_t key = k_spin_lock(&capture_lock);
+    stats->captures = stat_captures;
+    stats->frames = stat_captures ? capture.total_frames : 0;
+    stats->trigger_frame = capture.trigger_frame;
+    stats->trigger_source = capture.trigger_source;
+    stats->data_rate = capture.data_rate;
+    stats->ignored = stat_ignored;
+    k_spin_unlock(&capture_lock, key);
+    stats->packets = stat_packets;
+}
\ No newline at end of file
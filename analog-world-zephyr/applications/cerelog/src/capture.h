@@ -0,0 +1,58 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "packet_format.h"
+
+/* Burst capture (CONFIG_CERELOG_CAPTURE). While armed, every frame read
+   is also kept raw, ADS1299_TOTAL_DATA_BYTES each with the DRDY edge
+   count it was read at, in a RAM ring of
+   CONFIG_CERELOG_CAPTURE_BUFFER_SIZE, so the chip can run at rates the
+   link cannot carry live. A trigger - the host's CMD_CAPTURE, an edge on
+   the trigger pin, or a channel reaching the threshold - keeps up to
+   pre_frames from before it and records up to post_frames after; a stop
+   (the pin going low, or CAPTURE_STOP) ends it sooner. The capture is
+   then frozen and drained as PACKET_TYPE_CAPTURE packets between live
+   ones, using only link capacity the live stream leaves, and the ring
+   re-arms once it is sent. Triggers that come while a capture is under
+   way are ignored and counted.
+
+   capture_store() is the only writer of the ring and runs wherever frames
+   are published, the SPI completion interrupt included. The transmission
+   thread drains a frozen capture without a lock, since nothing writes
+   the ring until it re-arms. */
+
+typedef struct {
+    uint32_t pre_frames;        // Kept from before the trigger, at most
+    uint32_t post_frames;       // Recorded after the trigger frame, at most
+    uint8_t sources;            // CAPTURE_TRIGGER_* that may start a capture; the host always can
+    int32_t threshold;          // Codes; a channel at or beyond +-threshold triggers
+    uint32_t channels;          // Channels the threshold looks at, bit 0 for CH1 of the first chip
+} capture_settings_t;
+
+typedef struct {
+    uint32_t captures;          // Captures completed
+    uint32_t frames;            // Frames in the last one
+    uint32_t trigger_frame;     // Its trigger frame
+    uint8_t trigger_source;
+    uint8_t data_rate;
+    uint32_t packets;           // Capture packets sent, all captures
+    uint32_t ignored;           // Triggers that came while a capture was under way
+} capture_stats_t;
+
+// Function declarations
+void capture_init(void);
+void capture_report(void);
+int capture_arm(const capture_settings_t *settings);
+void capture_disarm(void);
+void capture_trigger(uint8_t source);
+void capture_stop(uint8_t source);
+void capture_set_data_rate(uint8_t data_rate);
+void capture_store(const uint8_t *frame, const ads1299_sample_t *sample, uint32_t drdy_edges);
+bool capture_draining(void);
+size_t capture_next(const uint8_t **packet);
+void capture_get_stats(capture_stats_t *stats);
+
+#endif // CAPTURE_H
\ No newline at end of file
@@ -0,0 +1,73 @@
+#include "command.h"
+#include "data_handler.h"
+#include <string.h>
+
+void command_parser_init(command_parser_t *parser) {
+    parser->pos = 0;
+    parser->crc_errors = 0;
+}
+
+/* Feeds one received byte. Returns true and fills cmd when it completes a
+   valid frame. */
+bool command_parser_feed(command_parser_t *parser, uint8_t byte, command_t *cmd) {
+    uint8_t *frame = parser->frame;
+
+    // Header bytes either match or send the parser back to hunting for 0xAA
+    if ((parser->pos == 0 && byte != PACKET_START_BYTE1) ||
+        (parser->pos == 1 && byte != PACKET_START_BYTE2) ||
+        (parser->pos == 2 && byte != PACKET_TYPE_COMMAND) ||
+        (parser->pos == 3 && (byte == 0 || byte > COMMAND_MAX_PAYLOAD))) {
+        parser->pos = (byte == PACKET_START_BYTE1) ? 1 : 0;
+        frame[0] = byte;
+        return false;
+    }
+
+    frame[parser->pos++] = byte;
+    if (parser->pos < 4 || parser->pos < (size_t)frame[3] + COMMAND_OVERHEAD) {
+        return false;
+    }
+
+    // Whole frame received
+    size_t length = frame[3];
+    size_t crc_data_size = 4 + length;
+    uint16_t frame_crc = frame[crc_data_size] | (frame[crc_data_size + 1] << 8);
+    parser->pos = 0;
+
+    if (frame[crc_data_size + 2] != PACKET_END_BYTE1 || frame[crc_data_size + 3] != PACKET_END_BYTE2) {
+        return false;
+    }
+
+    if (calculate_crc16(frame, crc_data_size) != frame_crc) {
+        parser->crc_errors++;
+        return false;
+    }
+
+    cmd->id = frame[4];
+    cmd->length = length - 1;
+    memcpy(cmd->args, &frame[5], cmd->length);
+    return true;
+}
+
+/* Builds a command frame, as the host does. Returns its length or 0. */
+size_t command_encode(const command_t *cmd, uint8_t *buffer, size_t buffer_size) {
+    size_t length = 1 + cmd->length;
+
+    if (cmd->length >= COMMAND_MAX_PAYLOAD || buffer_size < length + COMMAND_OVERHEAD) {
+        return 0;
+    }
+
+    buffer[0] = PACKET_START_BYTE1;
+    buffer[1] = PACKET_START_BYTE2;
+    buffer[2] = PACKET_TYPE_COMMAND;
+    buffer[3] = (uint8_t)length;
+    buffer[4] = cmd->id;
+    memcpy(&buffer[5], cmd->args, cmd->length);
+
+    uint16_t crc = calculate_crc16(buffer, 4 + length);
+    buffer[4 + length] = crc & 0xFF;
+    buffer[5 + length] = crc >> 8;
+    buffer[6 + length] = PACKET_END_BYTE1;
+    buffer[7 + length] = PACKET_END_BYTE2;
+
+    return length + COMMAND_OVERHEAD;
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Host to device commands, framed like the data packets:
+   0xAA 0x55 | 0x20 | length | command id, arguments | crc16 | 0x55 0xAA
+   length counts the command id and its arguments, the CRC covers
+   everything before it. */
+#define PACKET_TYPE_COMMAND     0x20
+#define COMMAND_MAX_PAYLOAD     32
+#define COMMAND_OVERHEAD        8   // Start, type, length, CRC, end
+
+// Command ids
+#define CMD_SET_PROFILE         0x01    // Arguments: profile name, not NUL-terminated
+#define CMD_SET_BATCH_SIZE      0x02    // Arguments: samples per packet (uint8)
+#define CMD_SET_COMPRESSION     0x03    // Arguments: 0 off, 1 on
+#define CMD_RESEND              0x04    // Arguments: up to RESEND_MAX_RANGES sample ranges
+
+/* A resend range: first sample number (uint32) and sample count (uint16),
+   little-endian. The device sends again the batch packets it still holds
+   that carry any of those samples. */
+#define RESEND_RANGE_SIZE       6
+#define RESEND_MAX_RANGES       ((COMMAND_MAX_PAYLOAD - 1) / RESEND_RANGE_SIZE)
+
+#define CMD_CAPTURE             0x05    // Arguments: a CAPTURE_* action, then its arguments
+
+/* Burst capture actions, the first argument byte. CAPTURE_ARM may carry
+   new settings, all little-endian: pre-trigger frames (uint32),
+   post-trigger frames (uint32), trigger sources (uint8, CAPTURE_TRIGGER_*
+   bits), threshold (int32, codes) and threshold channel mask (uint32).
+   With no settings it arms with the ones in use. */
+#define CAPTURE_ARM             0x01    // Record continuously and wait for a trigger
+#define CAPTURE_TRIGGER         0x02    // Trigger now; from disarmed, starts with no pre-trigger frames
+#define CAPTURE_STOP            0x03    // End a capture being recorded before its post-trigger length
+#define CAPTURE_DISARM          0x04    // Stop waiting for triggers; a capture underway still finishes
+#define CAPTURE_ARM_SETTINGS_SIZE   17
+
+typedef struct {
+    uint8_t id;
+    uint8_t length;             // Argument bytes
+    uint8_t args[COMMAND_MAX_PAYLOAD];
+} command_t;
+
+// Byte-at-a-time frame parser, resynchronises on the start bytes after any error
+typedef struct {
+    uint8_t frame[COMMAND_MAX_PAYLOAD + COMMAND_OVERHEAD];
+    size_t pos;
+    uint32_t crc_errors;
+} command_parser_t;
+
+// Function declarations
+void command_parser_init(command_parser_t *parser);
+bool command_parser_feed(command_parser_t *parser, uint8_t byte, command_t *cmd);
+size_t command_encode(const command_t *cmd, uint8_t *buffer, size_t buffer_size);
+
+#endif // COMMAND_H
\ No newline at end of file
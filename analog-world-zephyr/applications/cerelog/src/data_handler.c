@@ -1,188 +1,556 @@
-#include "data_handler.h"
-#include <zephyr/sys/printk.h>
-#include <zephyr/timing/timing.h>
-#include <string.h>
-
-// Static variables
-static uint32_t sample_counter = 0;
-static timing_t start_time;
-
-// CRC-16 lookup table (CRC-16-CCITT)
-static const uint16_t crc16_table[256] = {
-    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
-    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
-    0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
-    0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
-    0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
-    0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
-    0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
-    0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
-    0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
-    0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
-    0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
-    0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
-    0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
-    0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
-    0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
-    0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
-    0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
-    0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
-    0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
-    0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
-    0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
-    0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
-    0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
-    0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
-    0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
-    0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
-    0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
-    0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
-    0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
-    0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
-    0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
-    0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0
-};
-
-void init_data_handler(void) {
-    timing_init();
-    start_time = timing_counter_get();
-    sample_counter = 0;
-    printk("Data handler initialized\n");
-}
-
-uint64_t get_timestamp_us(void) {
-    timing_t current_time = timing_counter_get();
-    uint64_t cycles = timing_cycles_get(&start_time, &current_time);
-    return timing_cycles_to_ns(cycles) / 1000; // Convert to microseconds
-}
-
-uint16_t calculate_crc16(const uint8_t *data, size_t length) {
-    uint16_t crc = 0xFFFF;
-    
-    for (size_t i = 0; i < length; i++) {
-        crc = (crc << 8) ^ crc16_table[((crc >> 8) ^ data[i]) & 0xFF];
-    }
-    
-    return crc;
-}
-
-int32_t convert_24bit_to_32bit(const uint8_t *data) {
-    // Convert 24-bit two's complement to 32-bit signed integer
-    int32_t result = (data[0] << 24) | (data[1] << 16) | (data[2] << 8);
-    return result >> 8; // Sign extend by shifting right
-}
-
-void process_ads1299_data(const uint8_t *raw_data, ads1299_sample_t *sample) {
-    if (!raw_data || !sample) {
-        printk("Invalid parameters in process_ads1299_data\n");
-        return;
-    }
-    
-    // Get timestamp first
-    sample->timestamp_us = (uint32_t)get_timestamp_us();
-    sample->sample_number = ++sample_counter;
-    
-    // Extract 24-bit status (first 3 bytes)
-    sample->status = (raw_data[0] << 16) | (raw_data[1] << 8) | raw_data[2];
-    
-    // Parse status bits according to ADS1299 datasheet
-    // Status format: 1100 + LOFF_STATP + LOFF_STATN + GPIO[4:7]
-    sample->lead_off_status_p = (raw_data[1] >> 4) & 0x0F; // LOFF_STATP
-    sample->lead_off_status_n = raw_data[1] & 0x0F;        // LOFF_STATN
-    sample->gpio_status = raw_data[2] & 0x0F;              // GPIO[4:7]
-    
-    // Extract channel data (24-bit each, starting from byte 3)
-    for (int ch = 0; ch < ADS1299_NUM_CHANNELS; ch++) {
-        int offset = ADS1299_STATUS_BYTES + (ch * ADS1299_BYTES_PER_CHANNEL);
-        sample->channels[ch] = convert_24bit_to_32bit(&raw_data[offset]);
-    }
-}
-
-size_t format_sample_for_transmission(const ads1299_sample_t *sample, uint8_t *buffer, size_t buffer_size) {
-    if (!sample || !buffer) {
-        return 0;
-    }
-    
-    // Calculate required buffer size
-    size_t required_size = sizeof(ads1299_packet_t);
-    if (buffer_size < required_size) {
-        printk("Buffer too small: need %zu, have %zu\n", required_size, buffer_size);
-        return 0;
-    }
-    
-    ads1299_packet_t *packet = (ads1299_packet_t *)buffer;
-    
-    // Fill packet header
-    packet->start_bytes[0] = PACKET_START_BYTE1;
-    packet->start_bytes[1] = PACKET_START_BYTE2;
-    packet->packet_type = PACKET_TYPE_ADS1299;
-    packet->payload_length = sizeof(ads1299_sample_t) + sizeof(uint64_t); // sample + timestamp
-    
-    // Add timestamp
-    packet->timestamp_us = get_timestamp_us();
-    
-    // Copy sample data
-    memcpy(&packet->sample, sample, sizeof(ads1299_sample_t));
-    
-    // Calculate CRC over header + timestamp + sample data
-    size_t crc_data_size = PACKET_HEADER_SIZE + PACKET_TIMESTAMP_SIZE + sizeof(ads1299_sample_t);
-    packet->crc16 = calculate_crc16((uint8_t *)packet, crc_data_size);
-    
-    // Fill packet trailer
-    packet->end_bytes[0] = PACKET_END_BYTE1;
-    packet->end_bytes[1] = PACKET_END_BYTE2;
-    
-    return required_size;
-}
-
-bool validate_packet(const ads1299_packet_t *packet) {
-    if (!packet) {
-        return false;
-    }
-    
-    // Check start bytes
-    if (packet->start_bytes[0] != PACKET_START_BYTE1 || 
-        packet->start_bytes[1] != PACKET_START_BYTE2) {
-        return false;
-    }
-    
-    // Check end bytes
-    if (packet->end_bytes[0] != PACKET_END_BYTE1 || 
-        packet->end_bytes[1] != PACKET_END_BYTE2) {
-        return false;
-    }
-    
-    // Check packet type
-    if (packet->packet_type != PACKET_TYPE_ADS1299) {
-        return false;
-    }
-    
-    // Verify CRC
-    size_t crc_data_size = PACKET_HEADER_SIZE + PACKET_TIMESTAMP_SIZE + sizeof(ads1299_sample_t);
-    uint16_t calculated_crc = calculate_crc16((uint8_t *)packet, crc_data_size);
-    
-    if (calculated_crc != packet->crc16) {
-        printk("CRC mismatch: calculated 0x%04x, packet 0x%04x\n", 
-               calculated_crc, packet->crc16);
-        return false;
-    }
-    
-    return true;
-}
-
-// Debug function to print sample data
-void print_sample_debug(const ads1299_sample_t *sample) {
-    if (!sample) {
-        return;
-    }
-    
-    printk("Sample #%u @ %u us:\n", sample->sample_number, sample->timestamp_us);
-    printk("  Status: 0x%06x, LOFF_P: 0x%02x, LOFF_N: 0x%02x, GPIO: 0x%02x\n", 
-           sample->status, sample->lead_off_status_p, 
-           sample->lead_off_status_n, sample->gpio_status);
-    
-    for (int ch = 0; ch < ADS1299_NUM_CHANNELS; ch++) {
-        printk("  CH%d: %d (0x%08x)\n", ch + 1, sample->channels[ch], 
-               (uint32_t)sample->channels[ch]);
-    }
+#include "data_handler.h"
+#include <zephyr/sys/printk.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+
+// Static variables
+static uint32_t sample_counter = 0;
+static uint8_t batch_size = CONFIG_CERELOG_BATCH_SAMPLES;
+static bool batch_compression = IS_ENABLED(CONFIG_CERELOG_CODEC);
+
+BUILD_ASSERT(CONFIG_CERELOG_BATCH_SAMPLES <= BATCH_MAX_SAMPLES,
+             "CONFIG_CERELOG_BATCH_SAMPLES exceeds CONFIG_CERELOG_BATCH_MAX_SAMPLES");
+
+// Batch channel data starts after the header and the other chips' status words
+#define BATCH_DATA_OFFSET       (sizeof(ads1299_batch_header_t) + BATCH_STATUS_BYTES)
+
+void init_data_handler(void) {
+    sample_counter = 0;
+    printk("Data handler initialized\n");
+}
+
+/* 64-bit hardware cycle count since boot, safe to call from interrupts.
+   Without a 64-bit timer the 32-bit counter is extended here, which holds
+   as long as it is read at least once per wrap; DRDY and the once a second
+   stats loop in main() see to that. */
+uint64_t get_cycles64(void) {
+#ifdef CONFIG_TIMER_HAS_64BIT_CYCLE_COUNTER
+    return k_cycle_get_64();
+#else
+    static uint32_t last_low;
+    static uint64_t high;
+
+    unsigned int key = irq_lock();
+    uint32_t low = k_cycle_get_32();
+    if (low < last_low) {
+        high += 1ULL << 32;
+    }
+    last_low = low;
+    uint64_t cycles = high | low;
+    irq_unlock(key);
+
+    return cycles;
+#endif
+}
+
+/* cycles * 1e9 overflows 64 bits within minutes at CPU clock rates, so
+   whole seconds and the remainder are converted separately */
+uint64_t cycles_to_ns(uint64_t cycles) {
+    uint64_t hz = sys_clock_hw_cycles_per_sec();
+    return cycles / hz * NSEC_PER_SEC + cycles % hz * NSEC_PER_SEC / hz;
+}
+
+// Microseconds since boot, on the same clock as the DRDY timestamps
+uint64_t get_timestamp_us(void) {
+    return cycles_to_ns(get_cycles64()) / 1000;
+}
+
+uint16_t calculate_crc16(const uint8_t *data, size_t length) {
+    return packet_crc_compute(data, length);
+}
+
+int32_t convert_24bit_to_32bit(const uint8_t *data) {
+    // Convert 24-bit two's complement to 32-bit signed integer
+    int32_t result = (data[0] << 24) | (data[1] << 16) | (data[2] << 8);
+    return result >> 8; // Sign extend by shifting right
+}
+
+static inline uint32_t status_word(const uint8_t *data) {
+    return (data[0] << 16) | (data[1] << 8) | data[2];
+}
+
+/* Parses one RDATAC frame: ADS1299_CHIP_DATA_BYTES per chip, in chain
+   order. Returns -EIO, with the sample still filled in, when a status word
+   lacks its 1100 sync bits; in a chain that means fewer chips answered
+   than the build expects, or the frame slipped. */
+int process_ads1299_data(const uint8_t *raw_data, ads1299_sample_t *sample) {
+    int ret = 0;
+
+    if (!raw_data || !sample) {
+        printk("Invalid parameters in process_ads1299_data\n");
+        return -EINVAL;
+    }
+    
+    // drdy_cycles is filled in by the caller from the DRDY interrupt
+    sample->sample_number = ++sample_counter;
+    
+    // Extract 24-bit status (first 3 bytes)
+    sample->status = status_word(raw_data);
+    
+    // Parse status bits according to ADS1299 datasheet
+    // Status format: 1100 + LOFF_STATP + LOFF_STATN + GPIO[4:7]
+    sample->lead_off_status_p = (raw_data[1] >> 4) & 0x0F; // LOFF_STATP
+    sample->lead_off_status_n = raw_data[1] & 0x0F;        // LOFF_STATN
+    sample->gpio_status = raw_data[2] & 0x0F;              // GPIO[4:7]
+    
+    for (int chip = 0; chip < ADS1299_CHAIN_LENGTH; chip++) {
+        const uint8_t *chip_data = &raw_data[chip * ADS1299_CHIP_DATA_BYTES];
+        uint32_t status = status_word(chip_data);
+        int32_t *channels = &sample->channels[chip * ADS1299_CHIP_CHANNELS];
+
+#if ADS1299_CHAIN_LENGTH > 1
+        if (chip > 0) {
+            sample->chain_status[chip - 1] = status;
+        }
+#endif
+        if ((status & ADS1299_STATUS_SYNC_MASK) != ADS1299_STATUS_SYNC) {
+            ret = -EIO;
+        }
+
+        // Extract channel data (24-bit each, after the chip's status)
+        for (int ch = 0; ch < ADS1299_CHIP_CHANNELS; ch++) {
+            int offset = ADS1299_STATUS_BYTES + (ch * ADS1299_BYTES_PER_CHANNEL);
+            channels[ch] = convert_24bit_to_32bit(&chip_data[offset]);
+        }
+    }
+
+    return ret;
+}
+
+size_t format_sample_for_transmission(const ads1299_sample_t *sample, uint8_t *buffer, size_t buffer_size) {
+    if (!sample || !buffer) {
+        return 0;
+    }
+    
+    // Calculate required buffer size
+    size_t required_size = sizeof(ads1299_packet_t);
+    if (buffer_size < required_size) {
+        printk("Buffer too small: need %zu, have %zu\n", required_size, buffer_size);
+        return 0;
+    }
+    
+    ads1299_packet_t *packet = (ads1299_packet_t *)buffer;
+    
+    // Fill packet header
+    packet->start_bytes[0] = PACKET_START_BYTE1;
+    packet->start_bytes[1] = PACKET_START_BYTE2;
+    packet->packet_type = PACKET_TYPE_ADS1299;
+    packet->payload_length = sizeof(ads1299_sample_t) + sizeof(uint64_t); // sample + timestamp
+    
+    // Add timestamp
+    packet->timestamp_us = cycles_to_ns(sample->drdy_cycles) / 1000;
+    
+    // Copy sample data
+    memcpy(&packet->sample, sample, sizeof(ads1299_sample_t));
+    
+    // Calculate CRC over header + timestamp + sample data
+    size_t crc_data_size = PACKET_HEADER_SIZE + PACKET_TIMESTAMP_SIZE + sizeof(ads1299_sample_t);
+    packet->crc16 = calculate_crc16((uint8_t *)packet, crc_data_size);
+    
+    // Fill packet trailer
+    packet->end_bytes[0] = PACKET_END_BYTE1;
+    packet->end_bytes[1] = PACKET_END_BYTE2;
+    
+    return required_size;
+}
+
+size_t format_marker_for_transmission(const ads1299_marker_t *marker, uint8_t *buffer, size_t buffer_size) {
+    if (!marker || !buffer) {
+        return 0;
+    }
+
+    if (buffer_size < sizeof(ads1299_marker_packet_t)) {
+        printk("Buffer too small: need %zu, have %zu\n", sizeof(ads1299_marker_packet_t), buffer_size);
+        return 0;
+    }
+
+    ads1299_marker_packet_t *packet = (ads1299_marker_packet_t *)buffer;
+
+    packet->start_bytes[0] = PACKET_START_BYTE1;
+    packet->start_bytes[1] = PACKET_START_BYTE2;
+    packet->packet_type = PACKET_TYPE_MARKER;
+    packet->marker_type = marker->marker_type;
+    packet->result = marker->result;
+    packet->sample_number = marker->sample_number;
+    packet->read_number = marker->read_number;
+    packet->timestamp_ns = marker->timestamp_ns;
+    packet->gap_us = marker->gap_us;
+    memcpy(packet->registers, marker->registers, sizeof(packet->registers));
+
+    packet->crc16 = calculate_crc16(buffer, offsetof(ads1299_marker_packet_t, crc16));
+    packet->end_bytes[0] = PACKET_END_BYTE1;
+    packet->end_bytes[1] = PACKET_END_BYTE2;
+
+    return sizeof(ads1299_marker_packet_t);
+}
+
+// Number of samples parsed so far; the next sample gets this plus one
+uint32_t get_sample_count(void) {
+    return sample_counter;
+}
+
+/* Samples per batched packet. Takes effect from the next batch_frame_begin(),
+   so it can be changed while streaming. */
+int set_batch_size(uint8_t samples) {
+    if (samples == 0 || samples > BATCH_MAX_SAMPLES) {
+        return -EINVAL;
+    }
+
+    batch_size = samples;
+    return 0;
+}
+
+uint8_t get_batch_size(void) {
+    return batch_size;
+}
+
+/* Turns eeg_codec compression of batched packets on or off, again from the
+   next batch_frame_begin() */
+void set_batch_compression(bool enable) {
+    batch_compression = enable;
+}
+
+bool get_batch_compression(void) {
+    return batch_compression;
+}
+
+int batch_frame_begin(batch_frame_t *frame, uint8_t *buffer, size_t buffer_size) {
+    if (!frame || !buffer) {
+        return -EINVAL;
+    }
+
+    uint8_t max_samples = batch_size;
+    if (buffer_size < BATCH_PACKET_MAX_SIZE(max_samples)) {
+        printk("Buffer too small: need %zu, have %zu\n",
+               BATCH_PACKET_MAX_SIZE(max_samples), buffer_size);
+        return -ENOMEM;
+    }
+
+    frame->buffer = buffer;
+    frame->max_samples = max_samples;
+    frame->count = 0;
+    frame->compress = batch_compression;
+    frame->body_crc = 0;
+    return 0;
+}
+
+// Channels were sign-extended from 24 bits, so the low three bytes are the raw word
+static void pack_sample_channels(const int32_t channels[ADS1299_NUM_CHANNELS], uint8_t *out) {
+    for (int ch = 0; ch < ADS1299_NUM_CHANNELS; ch++) {
+        uint32_t value = (uint32_t)channels[ch];
+        *out++ = (uint8_t)(value >> 16);
+        *out++ = (uint8_t)(value >> 8);
+        *out++ = (uint8_t)value;
+    }
+}
+
+static size_t pack_batch_channels(const batch_frame_t *frame, uint8_t *out) {
+    for (int i = 0; i < frame->count; i++) {
+        pack_sample_channels(frame->channels[i], out + (size_t)i * BATCH_CHANNEL_BYTES);
+    }
+
+    return (size_t)frame->count * BATCH_CHANNEL_BYTES;
+}
+
+static bool batch_status_matches(const batch_frame_t *frame, const ads1299_sample_t *sample) {
+#if ADS1299_CHAIN_LENGTH > 1
+    if (memcmp(frame->chain_status, sample->chain_status, sizeof(frame->chain_status)) != 0) {
+        return false;
+    }
+#endif
+    return sample->status == frame->status;
+}
+
+/* Appends one sample. Returns -EAGAIN when the sample cannot share the
+   current packet (full, sample number gap or a status change on any
+   chip); the caller then sends the packet, begins a new one and adds the
+   sample again. */
+int batch_frame_add(batch_frame_t *frame, const ads1299_sample_t *sample) {
+    if (frame->count == 0) {
+        frame->drdy_cycles = sample->drdy_cycles;
+        frame->sample_number = sample->sample_number;
+        frame->status = sample->status;
+#if ADS1299_CHAIN_LENGTH > 1
+        memcpy(frame->chain_status, sample->chain_status, sizeof(frame->chain_status));
+#endif
+    } else if (frame->count >= frame->max_samples ||
+               sample->sample_number != frame->sample_number + frame->count ||
+               !batch_status_matches(frame, sample)) {
+        return -EAGAIN;
+    }
+
+    if (frame->compress) {
+        memcpy(frame->channels[frame->count], sample->channels, sizeof(sample->channels));
+    } else {
+        // Pack straight into the packet and checksum the bytes while they are still in cache
+        uint8_t *out = frame->buffer + BATCH_DATA_OFFSET + (size_t)frame->count * BATCH_CHANNEL_BYTES;
+        pack_sample_channels(sample->channels, out);
+        frame->body_crc = packet_crc_update(frame->body_crc, out, BATCH_CHANNEL_BYTES);
+    }
+    frame->count++;
+    return 0;
+}
+
+bool batch_frame_full(const batch_frame_t *frame) {
+    return frame->count >= frame->max_samples;
+}
+
+
+/* Fills in the header, channel data, CRC and trailer. Returns the packet
+   length, or 0 if no samples were added. A compressed batch that would not
+   come out smaller is sent packed instead. */
+size_t batch_frame_finish(batch_frame_t *frame) {
+    if (frame->count == 0) {
+        return 0;
+    }
+
+    ads1299_batch_header_t *header = (ads1299_batch_header_t *)frame->buffer;
+    header->start_bytes[0] = PACKET_START_BYTE1;
+    header->start_bytes[1] = PACKET_START_BYTE2;
+    header->packet_type = PACKET_TYPE_ADS1299_BATCH | PACKET_CHAIN_BITS(ADS1299_CHAIN_LENGTH);
+    header->sample_count = frame->count;
+    header->timestamp_ns = cycles_to_ns(frame->drdy_cycles);
+    header->sample_number = frame->sample_number;
+    header->status[0] = (uint8_t)(frame->status >> 16);
+    header->status[1] = (uint8_t)(frame->status >> 8);
+    header->status[2] = (uint8_t)frame->status;
+
+#if ADS1299_CHAIN_LENGTH > 1
+    uint8_t *chain_status = frame->buffer + sizeof(ads1299_batch_header_t);
+    for (int chip = 0; chip < ADS1299_CHAIN_LENGTH - 1; chip++) {
+        *chain_status++ = (uint8_t)(frame->chain_status[chip] >> 16);
+        *chain_status++ = (uint8_t)(frame->chain_status[chip] >> 8);
+        *chain_status++ = (uint8_t)frame->chain_status[chip];
+    }
+#endif
+
+    uint8_t *data = frame->buffer + BATCH_DATA_OFFSET;
+    size_t crc_data_size = 0;
+    uint16_t crc = 0;
+
+    if (!frame->compress) {
+        // Channel data was packed and checksummed as it was added; put the header in front
+        size_t data_size = (size_t)frame->count * BATCH_CHANNEL_BYTES;
+        crc = packet_crc_update(packet_crc_init(), frame->buffer, BATCH_DATA_OFFSET);
+        crc = packet_crc_final(packet_crc_combine(crc, frame->body_crc, data_size));
+        crc_data_size = BATCH_DATA_OFFSET + data_size;
+    } else {
+        uint8_t *coded = data + BATCH_LENGTH_SIZE;
+        int coded_len = eeg_codec_encode(&frame->channels[0][0], frame->count, ADS1299_NUM_CHANNELS,
+                                         coded, EEG_CODEC_MAX_BYTES(frame->count, ADS1299_NUM_CHANNELS));
+
+        if (coded_len > 0 &&
+            BATCH_COMPRESSED_PACKET_SIZE(coded_len) < BATCH_PACKET_SIZE(frame->count)) {
+            uint16_t data_length = (uint16_t)coded_len;
+            memcpy(data, &data_length, sizeof(data_length));
+            header->packet_type |= PACKET_FLAG_COMPRESSED;
+            crc_data_size = BATCH_DATA_OFFSET + BATCH_LENGTH_SIZE + coded_len;
+        }
+
+        if (crc_data_size == 0) {
+            crc_data_size = BATCH_DATA_OFFSET + pack_batch_channels(frame, data);
+        }
+        crc = calculate_crc16(frame->buffer, crc_data_size);
+    }
+
+    uint8_t *trailer = frame->buffer + crc_data_size;
+    memcpy(trailer, &crc, sizeof(crc));
+    trailer[PACKET_CRC_SIZE] = PACKET_END_BYTE1;
+    trailer[PACKET_CRC_SIZE + 1] = PACKET_END_BYTE2;
+
+    size_t length = crc_data_size + PACKET_CRC_SIZE + PACKET_TRAILER_SIZE;
+    frame->count = 0;
+    return length;
+}
+
+bool validate_packet(const ads1299_packet_t *packet) {
+    if (!packet) {
+        return false;
+    }
+    
+    // Check start bytes
+    if (packet->start_bytes[0] != PACKET_START_BYTE1 || 
+        packet->start_bytes[1] != PACKET_START_BYTE2) {
+        return false;
+    }
+    
+    // Check end bytes
+    if (packet->end_bytes[0] != PACKET_END_BYTE1 || 
+        packet->end_bytes[1] != PACKET_END_BYTE2) {
+        return false;
+    }
+    
+    // Check packet type
+    if (packet->packet_type != PACKET_TYPE_ADS1299) {
+        return false;
+    }
+    
+    // Verify CRC
+    size_t crc_data_size = PACKET_HEADER_SIZE + PACKET_TIMESTAMP_SIZE + sizeof(ads1299_sample_t);
+    uint16_t calculated_crc = calculate_crc16((uint8_t *)packet, crc_data_size);
+    
+    if (calculated_crc != packet->crc16) {
+        printk("CRC mismatch: calculated 0x%04x, packet 0x%04x\n", 
+               calculated_crc, packet->crc16);
+        return false;
+    }
+    
+    return true;
+}
+
+bool validate_marker_packet(const ads1299_marker_packet_t *packet) {
+    if (!packet) {
+        return false;
+    }
+
+    if (packet->start_bytes[0] != PACKET_START_BYTE1 ||
+        packet->start_bytes[1] != PACKET_START_BYTE2 ||
+        packet->end_bytes[0] != PACKET_END_BYTE1 ||
+        packet->end_bytes[1] != PACKET_END_BYTE2 ||
+        packet->packet_type != PACKET_TYPE_MARKER) {
+        return false;
+    }
+
+    uint16_t calculated_crc = calculate_crc16((const uint8_t *)packet, offsetof(ads1299_marker_packet_t, crc16));
+    return calculated_crc == packet->crc16;
+}
+
+bool validate_batch_packet(const uint8_t *packet, size_t length) {
+    if (!packet || length < BATCH_PACKET_SIZE(0)) {
+        return false;
+    }
+
+    const ads1299_batch_header_t *header = (const ads1299_batch_header_t *)packet;
+
+    // Check start bytes and packet type, which must be from a chain as long as this build's
+    if (header->start_bytes[0] != PACKET_START_BYTE1 ||
+        header->start_bytes[1] != PACKET_START_BYTE2 ||
+        (header->packet_type & ~PACKET_FLAG_COMPRESSED) !=
+            (PACKET_TYPE_ADS1299_BATCH | PACKET_CHAIN_BITS(ADS1299_CHAIN_LENGTH)) ||
+        header->sample_count == 0) {
+        return false;
+    }
+
+    // The sample count or the coded length must account for the whole packet
+    size_t expected;
+    if (header->packet_type & PACKET_FLAG_COMPRESSED) {
+        uint16_t data_length;
+        if (length < BATCH_COMPRESSED_PACKET_SIZE(0)) {
+            return false;
+        }
+        memcpy(&data_length, packet + BATCH_DATA_OFFSET, sizeof(data_length));
+        expected = BATCH_COMPRESSED_PACKET_SIZE(data_length);
+    } else {
+        expected = BATCH_PACKET_SIZE(header->sample_count);
+    }
+
+    if (length != expected) {
+        return false;
+    }
+
+    // Check end bytes
+    if (packet[length - 2] != PACKET_END_BYTE1 || packet[length - 1] != PACKET_END_BYTE2) {
+        return false;
+    }
+
+    // Verify CRC
+    size_t crc_data_size = length - PACKET_CRC_SIZE - PACKET_TRAILER_SIZE;
+    uint16_t calculated_crc = calculate_crc16(packet, crc_data_size);
+    uint16_t packet_crc;
+    memcpy(&packet_crc, packet + crc_data_size, sizeof(packet_crc));
+
+    if (calculated_crc != packet_crc) {
+        printk("CRC mismatch: calculated 0x%04x, packet 0x%04x\n",
+               calculated_crc, packet_crc);
+        return false;
+    }
+
+    return true;
+}
+
+/* Validates a batched packet, packed or compressed, and expands it back into
+   samples. The header's timestamp_ns is left to the caller; the device's
+   cycle counts are not recoverable from it. Returns the number of samples written or a negative errno. */
+int decode_batch_packet(const uint8_t *packet, size_t length,
+                        ads1299_sample_t *samples, size_t max_samples) {
+    if (!samples || !validate_batch_packet(packet, length)) {
+        return -EINVAL;
+    }
+
+    const ads1299_batch_header_t *header = (const ads1299_batch_header_t *)packet;
+    const uint8_t *data = packet + BATCH_DATA_OFFSET;
+    uint8_t count = header->sample_count;
+
+    if (count > max_samples) {
+        return -EINVAL;
+    }
+
+    if (header->packet_type & PACKET_FLAG_COMPRESSED) {
+        if (count > BATCH_MAX_SAMPLES) {
+            return -EINVAL;
+        }
+
+        // Decoding happens on one thread only; too large for its stack
+        static int32_t channels[BATCH_MAX_SAMPLES][ADS1299_NUM_CHANNELS];
+        size_t data_length = length - BATCH_COMPRESSED_PACKET_SIZE(0);
+
+        int ret = eeg_codec_decode(data + BATCH_LENGTH_SIZE, data_length, count,
+                                   ADS1299_NUM_CHANNELS, &channels[0][0]);
+        if (ret != 0) {
+            return ret;
+        }
+
+        for (int i = 0; i < count; i++) {
+            memcpy(samples[i].channels, channels[i], sizeof(samples[i].channels));
+        }
+    } else {
+        for (int i = 0; i < count; i++) {
+            for (int ch = 0; ch < ADS1299_NUM_CHANNELS; ch++) {
+                samples[i].channels[ch] = convert_24bit_to_32bit(data);
+                data += ADS1299_BYTES_PER_CHANNEL;
+            }
+        }
+    }
+
+    uint32_t status = status_word(header->status);
+#if ADS1299_CHAIN_LENGTH > 1
+    uint32_t chain_status[ADS1299_CHAIN_LENGTH - 1];
+    for (int chip = 0; chip < ADS1299_CHAIN_LENGTH - 1; chip++) {
+        chain_status[chip] = status_word(packet + sizeof(ads1299_batch_header_t) + chip * ADS1299_STATUS_BYTES);
+    }
+#endif
+    for (int i = 0; i < count; i++) {
+        ads1299_sample_t *sample = &samples[i];
+
+#if ADS1299_CHAIN_LENGTH > 1
+        memcpy(sample->chain_status, chain_status, sizeof(chain_status));
+#endif
+        sample->drdy_cycles = 0;
+        sample->sample_number = header->sample_number + i;
+        sample->status = status;
+        sample->lead_off_status_p = (header->status[1] >> 4) & 0x0F;
+        sample->lead_off_status_n = header->status[1] & 0x0F;
+        sample->gpio_status = header->status[2] & 0x0F;
+    }
+
+    return count;
+}
+
+// Debug function to print sample data
+void print_sample_debug(const ads1299_sample_t *sample) {
+    if (!sample) {
+        return;
+    }
+    
+    printk("Sample #%u @ %llu us:\n", sample->sample_number,
+           (unsigned long long)(cycles_to_ns(sample->drdy_cycles) / 1000));
+    printk("  Status: 0x%06x, LOFF_P: 0x%02x, LOFF_N: 0x%02x, GPIO: 0x%02x\n", 
+           sample->status, sample->lead_off_status_p, 
+           sample->lead_off_status_n, sample->gpio_status);
+    
+    for (int ch = 0; ch < ADS1299_NUM_CHANNELS; ch++) {
+        printk("  CH%d: %d (0x%08x)\n", ch + 1, sample->channels[ch], 
+               (uint32_t)sample->channels[ch]);
+    }
 }
\ No newline at end of file
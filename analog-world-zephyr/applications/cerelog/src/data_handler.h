@@ -1,60 +1,78 @@
-#ifndef DATA_HANDLER_H
-#define DATA_HANDLER_H
-
-#include <stdint.h>
-#include <zephyr/kernel.h>
-
-// ADS1299 data constants
-#define ADS1299_NUM_CHANNELS    8
-#define ADS1299_BYTES_PER_CHANNEL   3  // 24-bit data
-#define ADS1299_STATUS_BYTES    3      // 24-bit status
-#define ADS1299_TOTAL_DATA_BYTES    (ADS1299_STATUS_BYTES + (ADS1299_NUM_CHANNELS * ADS1299_BYTES_PER_CHANNEL))
-
-// Packet format constants
-#define PACKET_HEADER_SIZE      4
-#define PACKET_TIMESTAMP_SIZE   8
-#define PACKET_CRC_SIZE         2
-#define PACKET_TRAILER_SIZE     2
-#define PACKET_OVERHEAD         (PACKET_HEADER_SIZE + PACKET_TIMESTAMP_SIZE + PACKET_CRC_SIZE + PACKET_TRAILER_SIZE)
-
-// Packet identifiers
-#define PACKET_START_BYTE1      0xAA
-#define PACKET_START_BYTE2      0x55
-#define PACKET_TYPE_ADS1299     0x01
-#define PACKET_END_BYTE1        0x55
-#define PACKET_END_BYTE2        0xAA
-
-// Data structures
-typedef struct {
-    uint32_t timestamp_us;      // Microsecond timestamp
-    uint32_t sample_number;     // Incremental sample counter
-    uint32_t status;            // 24-bit status register
-    int32_t channels[ADS1299_NUM_CHANNELS]; // Channel data (sign-extended from 24-bit)
-    uint8_t lead_off_status_p;  // Lead-off status positive
-    uint8_t lead_off_status_n;  // Lead-off status negative
-    uint8_t gpio_status;        // GPIO status
-} ads1299_sample_t;
-
-typedef struct {
-    uint8_t start_bytes[2];     // 0xAA, 0x55
-    uint8_t packet_type;        // 0x01 for ADS1299
-    uint8_t payload_length;     // Length of payload
-    uint64_t timestamp_us;      // 8-byte timestamp
-    ads1299_sample_t sample;    // ADS1299 sample data
-    uint16_t crc16;             // CRC-16 checksum
-    uint8_t end_bytes[2];       // 0x55, 0xAA
-} __attribute__((packed)) ads1299_packet_t;
-
-// Function declarations
-void process_ads1299_data(const uint8_t *raw_data, ads1299_sample_t *sample);
-size_t format_sample_for_transmission(const ads1299_sample_t *sample, 
-                                      uint8_t *buffer, size_t buffer_size);
-uint16_t calculate_crc16(const uint8_t *data, size_t length);
-int32_t convert_24bit_to_32bit(const uint8_t *data);
-uint64_t get_timestamp_us(void);
-
-// Data integrity functions
-bool validate_packet(const ads1299_packet_t *packet);
-void init_data_handler(void);
-
+#ifndef DATA_HANDLER_H
+#define DATA_HANDLER_H
+
+#include <stdint.h>
+#include <zephyr/kernel.h>
+#include "eeg_codec.h"
+#include "packet_crc.h"
+#include "packet_format.h"
+
+// Batched packet capacity, sizes the transmission buffer
+#define BATCH_MAX_SAMPLES       CONFIG_CERELOG_BATCH_MAX_SAMPLES
+
+/* Stream event, sent in order with the samples: it precedes the sample
+   numbered sample_number */
+typedef struct {
+    uint8_t marker_type;        // MARKER_*
+    int16_t result;             // Registers written, or a negative errno
+    uint32_t sample_number;     // First sample after the event
+    uint32_t read_number;       // The same point in frames read from the chip; differs from sample_number when decimating
+    uint64_t timestamp_ns;      // When acquisition paused, same clock as the batch timestamps
+    uint32_t gap_us;            // How long it stayed paused
+    uint8_t registers[PACKET_REGISTER_BYTES]; // Register map in effect from sample_number on
+    int8_t decimation;          // New decimation ratio, or PROFILE_KEEP (-1); not sent
+} ads1299_marker_t;
+
+/* Batch being assembled for a caller-owned transmission buffer. Without
+   compression, samples are packed into the buffer and checksummed as they
+   are added, so batch_frame_finish() only adds the header. With it, they
+   are staged here and compressed by batch_frame_finish(). */
+typedef struct {
+    uint8_t *buffer;            // Holds at least BATCH_PACKET_MAX_SIZE(max_samples) bytes
+    uint8_t max_samples;        // Batch size captured when the batch was started
+    uint8_t count;              // Samples added so far
+    bool compress;              // Compression setting captured when the batch was started
+    uint64_t drdy_cycles;       // First sample's DRDY time
+    uint32_t sample_number;     // First sample's number
+    uint32_t status;            // Status shared by all samples
+#if ADS1299_CHAIN_LENGTH > 1
+    uint32_t chain_status[ADS1299_CHAIN_LENGTH - 1];    // The other chips' status, also shared
+#endif
+    uint16_t body_crc;          // Uncompressed: CRC of the packed channel data so far, from 0
+    int32_t channels[BATCH_MAX_SAMPLES][ADS1299_NUM_CHANNELS];  // Compressed: staged for eeg_codec
+} batch_frame_t;
+
+// Function declarations
+int process_ads1299_data(const uint8_t *raw_data, ads1299_sample_t *sample);
+size_t format_sample_for_transmission(const ads1299_sample_t *sample, 
+                                      uint8_t *buffer, size_t buffer_size);
+
+// Batched transmission
+int set_batch_size(uint8_t samples);
+uint8_t get_batch_size(void);
+void set_batch_compression(bool enable);
+bool get_batch_compression(void);
+int batch_frame_begin(batch_frame_t *frame, uint8_t *buffer, size_t buffer_size);
+int batch_frame_add(batch_frame_t *frame, const ads1299_sample_t *sample);
+bool batch_frame_full(const batch_frame_t *frame);
+size_t batch_frame_finish(batch_frame_t *frame);
+
+size_t format_marker_for_transmission(const ads1299_marker_t *marker,
+                                      uint8_t *buffer, size_t buffer_size);
+uint32_t get_sample_count(void);
+
+uint16_t calculate_crc16(const uint8_t *data, size_t length);
+int32_t convert_24bit_to_32bit(const uint8_t *data);
+uint64_t get_timestamp_us(void);
+uint64_t get_cycles64(void);
+uint64_t cycles_to_ns(uint64_t cycles);
+
+// Data integrity functions
+bool validate_packet(const ads1299_packet_t *packet);
+bool validate_marker_packet(const ads1299_marker_packet_t *packet);
+bool validate_batch_packet(const uint8_t *packet, size_t length);
+int decode_batch_packet(const uint8_t *packet, size_t length,
+                        ads1299_sample_t *samples, size_t max_samples);
+void init_data_handler(void);
+
 #endif // DATA_HANDLER_H
\ No newline at end of file
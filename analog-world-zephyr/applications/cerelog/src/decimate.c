@@ -0,0 +1,200 @@
+#include "decimate.h"
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+#define DECIMATE_PI             3.14159265358979f
+
+static inline int32_t saturate_24bit(int64_t value) {
+    if (value > 0x7FFFFF) {
+        return 0x7FFFFF;
+    }
+    if (value < -0x800000) {
+        return -0x800000;
+    }
+    return (int32_t)value;
+}
+
+#ifdef CONFIG_CERELOG_DECIMATE_FIR
+/* Hamming-windowed sinc with its cut-off at the output Nyquist frequency,
+   before normalisation. Evaluated in single precision, which the ESP32
+   FPU has, once per tap when the ratio changes. */
+static float fir_prototype(int i, int taps, int ratio) {
+    float x = (float)i - (float)(taps - 1) * 0.5f;
+    float cutoff = 0.5f / (float)ratio;
+    float sinc = x == 0.0f ? 2.0f * cutoff : sinf(2.0f * DECIMATE_PI * cutoff * x) / (DECIMATE_PI * x);
+    float window = 0.54f - 0.46f * cosf(2.0f * DECIMATE_PI * (float)i / (float)(taps - 1));
+    return sinc * window;
+}
+
+/* Quantises the prototype to Q30 with unity DC gain, then stores each tap
+   where the phase of the input it multiplies finds it */
+static void fir_design(decimator_t *d) {
+    int ratio = d->ratio;
+    int taps = ratio * DECIMATE_PHASE_TAPS;
+    float sum = 0.0f;
+    int64_t total = 0;
+
+    for (int i = 0; i < taps; i++) {
+        sum += fir_prototype(i, taps, ratio);
+    }
+    for (int i = 0; i < taps; i++) {
+        double q = (double)fir_prototype(i, taps, ratio) / sum * (double)(1 << DECIMATE_COEF_BITS);
+        int32_t tap = (int32_t)floor(q + 0.5);
+        d->coef[(ratio - 1 - i % ratio) * DECIMATE_PHASE_TAPS + i / ratio] = tap;
+        total += tap;
+    }
+
+    // Rounding leaves the sum a few LSBs off; the centre tap takes it up
+    int centre = taps / 2;
+    d->coef[(ratio - 1 - centre % ratio) * DECIMATE_PHASE_TAPS + centre / ratio] +=
+        (int32_t)((1LL << DECIMATE_COEF_BITS) - total);
+}
+
+int decimator_taps(const decimator_t *d) {
+    return d->ratio * DECIMATE_PHASE_TAPS;
+}
+
+int32_t decimator_tap(const decimator_t *d, int i) {
+    return d->coef[(d->ratio - 1 - i % d->ratio) * DECIMATE_PHASE_TAPS + i / d->ratio];
+}
+#else
+/* The cascade's DC gain is ratio^order; divide it out rounding to
+   nearest, halves up, as the FIR path's shift does */
+static int32_t cic_scale(int64_t value, int64_t gain) {
+    int64_t biased = value + gain / 2;
+    int64_t q = biased / gain;
+
+    if (biased % gain < 0) {
+        q--;
+    }
+    return saturate_24bit(q);
+}
+#endif
+
+void decimator_init(decimator_t *d) {
+    memset(d, 0, sizeof(*d));
+    d->next_number = 1;
+    decimator_configure(d, CONFIG_CERELOG_DECIMATE_RATIO);
+}
+
+/* Sets a new ratio and restarts the filter. Numbering carries on, so the
+   host sees no gap; the outputs before the filter has filled again are
+   dropped. */
+int decimator_configure(decimator_t *d, int ratio) {
+    if (ratio < 1 || ratio > DECIMATE_MAX_RATIO) {
+        return -EINVAL;
+    }
+
+    d->ratio = (uint8_t)ratio;
+#ifdef CONFIG_CERELOG_DECIMATE_FIR
+    if (ratio > 1) {
+        fir_design(d);
+    }
+    d->delay2 = (uint16_t)(ratio * DECIMATE_PHASE_TAPS - 1);
+#else
+    d->gain = 1;
+    for (int k = 0; k < DECIMATE_CIC_ORDER; k++) {
+        d->gain *= ratio;
+    }
+    d->delay2 = (uint16_t)(DECIMATE_CIC_ORDER * (ratio - 1));
+#endif
+    decimator_reset(d);
+    return 0;
+}
+
+void decimator_reset(decimator_t *d) {
+    d->phase = 0;
+    d->drdy_pos = 0;
+#ifdef CONFIG_CERELOG_DECIMATE_FIR
+    memset(d->acc, 0, sizeof(d->acc));
+    d->warmup = DECIMATE_PHASE_TAPS - 1;
+#else
+    memset(d->integrator, 0, sizeof(d->integrator));
+    memset(d->comb, 0, sizeof(d->comb));
+    d->warmup = DECIMATE_CIC_ORDER - 1;
+#endif
+}
+
+/* Takes one input sample. Returns true when it completes an output, which
+   is then in *out; otherwise *out may have been partly written. */
+bool decimator_push(decimator_t *d, const ads1299_sample_t *in, ads1299_sample_t *out) {
+    if (d->ratio == 1) {
+        *out = *in;
+        out->sample_number = d->next_number++;
+        return true;
+    }
+
+    uint16_t newest = d->drdy_pos;
+    d->drdy[newest] = in->drdy_cycles;
+    d->drdy_pos = newest + 1 < DECIMATE_HISTORY ? newest + 1 : 0;
+
+#ifdef CONFIG_CERELOG_DECIMATE_FIR
+    const int32_t *h = &d->coef[d->phase * DECIMATE_PHASE_TAPS];
+    for (int ch = 0; ch < ADS1299_NUM_CHANNELS; ch++) {
+        int64_t *acc = d->acc[ch];
+        int32_t x = in->channels[ch];
+        // 32 x 32 -> 64-bit multiply-accumulates; 24-bit codes times Q30 taps never overflow
+        for (int j = 0; j < DECIMATE_PHASE_TAPS; j++) {
+            acc[j] += (int64_t)h[j] * x;
+        }
+    }
+#else
+    for (int ch = 0; ch < ADS1299_NUM_CHANNELS; ch++) {
+        uint64_t *integrator = d->integrator[ch];
+        uint64_t v = (uint64_t)(int64_t)in->channels[ch];
+        for (int k = 0; k < DECIMATE_CIC_ORDER; k++) {
+            integrator[k] += v;
+            v = integrator[k];
+        }
+    }
+#endif
+
+    if (++d->phase < d->ratio) {
+        return false;
+    }
+    d->phase = 0;
+
+#ifdef CONFIG_CERELOG_DECIMATE_FIR
+    // The oldest accumulator is complete; the rest move one block closer
+    for (int ch = 0; ch < ADS1299_NUM_CHANNELS; ch++) {
+        int64_t *acc = d->acc[ch];
+        out->channels[ch] = saturate_24bit((acc[0] + (1LL << (DECIMATE_COEF_BITS - 1))) >> DECIMATE_COEF_BITS);
+        for (int j = 0; j < DECIMATE_PHASE_TAPS - 1; j++) {
+            acc[j] = acc[j + 1];
+        }
+        acc[DECIMATE_PHASE_TAPS - 1] = 0;
+    }
+#else
+    for (int ch = 0; ch < ADS1299_NUM_CHANNELS; ch++) {
+        uint64_t *comb = d->comb[ch];
+        uint64_t v = d->integrator[ch][DECIMATE_CIC_ORDER - 1];
+        for (int k = 0; k < DECIMATE_CIC_ORDER; k++) {
+            uint64_t previous = comb[k];
+            comb[k] = v;
+            v -= previous;
+        }
+        out->channels[ch] = cic_scale((int64_t)v, d->gain);
+    }
+#endif
+
+    if (d->warmup) {
+        d->warmup--;
+        return false;
+    }
+
+    // Timestamp of the filter's centre, halfway between two inputs when the delay is a half sample
+    int older = (newest + DECIMATE_HISTORY - (d->delay2 + 1) / 2) % DECIMATE_HISTORY;
+    int newer = (newest + DECIMATE_HISTORY - d->delay2 / 2) % DECIMATE_HISTORY;
+    out->drdy_cycles = d->drdy[older] + (d->drdy[newer] - d->drdy[older]) / 2;
+
+    out->sample_number = d->next_number++;
+    out->status = in->status;
+#if ADS1299_CHAIN_LENGTH > 1
+    memcpy(out->chain_status, in->chain_status, sizeof(out->chain_status));
+#endif
+    out->lead_off_status_p = in->lead_off_status_p;
+    out->lead_off_status_n = in->lead_off_status_n;
+    out->gpio_status = in->gpio_status;
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,84 @@
+#ifndef DECIMATE_H
+#define DECIMATE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "packet_format.h"
+
+/* Fixed-point decimation between parsing and packet formatting
+   (CONFIG_CERELOG_DECIMATE), so the ADS1299 can oversample at 4-16 kSPS
+   and the link carries a lower rate.
+
+   The FIR filter is a windowed-sinc low-pass of ratio * taps-per-phase
+   taps with its cut-off at the output Nyquist frequency, run in polyphase
+   form: each input is multiplied into the taps-per-phase outputs it
+   contributes to, so the cost per input is taps-per-phase multiplies per
+   channel whatever the ratio, and no input history is kept. The CIC
+   filter is a 4th-order integrator/comb cascade, cheaper still but with
+   passband droop. Both accumulate the 24-bit codes in 64 bits and round
+   back to 24 bits, saturating.
+
+   Outputs are numbered consecutively from 1 across ratio changes and
+   carry the DRDY time of the input at the filter's centre, i.e. corrected
+   for its group delay. The status word and lead-off bits are the newest
+   input's. Not thread-safe; the transmission thread owns it. */
+
+#define DECIMATE_MAX_RATIO      CONFIG_CERELOG_DECIMATE_MAX_RATIO
+#define DECIMATE_COEF_BITS      30      // FIR taps are Q30, summing to exactly 1
+#define DECIMATE_CIC_ORDER      4
+
+#ifdef CONFIG_CERELOG_DECIMATE_FIR
+#define DECIMATE_PHASE_TAPS     CONFIG_CERELOG_DECIMATE_TAPS_PER_PHASE
+#define DECIMATE_MAX_TAPS       (DECIMATE_MAX_RATIO * DECIMATE_PHASE_TAPS)
+// DRDY times are kept long enough to look back half the filter
+#define DECIMATE_HISTORY        DECIMATE_MAX_TAPS
+#else
+#define DECIMATE_HISTORY        (DECIMATE_MAX_RATIO * DECIMATE_CIC_ORDER)
+#endif
+
+typedef struct {
+    uint8_t ratio;
+    uint8_t phase;              // Inputs taken into the current output so far
+    uint8_t warmup;             // Outputs still to drop after a restart, until the filter is full
+    uint16_t drdy_pos;          // Next slot in drdy
+    uint16_t delay2;            // Group delay in half input samples
+    uint32_t next_number;       // sample_number of the next output
+    uint64_t drdy[DECIMATE_HISTORY];
+#ifdef CONFIG_CERELOG_DECIMATE_FIR
+    /* Tap i of the filter, i = 0 for the newest input, is coef[r][j] with
+       i = j * ratio + ratio - 1 - r: the tap an input of phase r applies
+       to the output j blocks ahead */
+    int32_t coef[DECIMATE_MAX_TAPS];
+    int64_t acc[ADS1299_NUM_CHANNELS][DECIMATE_PHASE_TAPS];    // [j]: the output j blocks ahead
+#else
+    uint64_t integrator[ADS1299_NUM_CHANNELS][DECIMATE_CIC_ORDER];     // Wrap around by design
+    uint64_t comb[ADS1299_NUM_CHANNELS][DECIMATE_CIC_ORDER];
+    int64_t gain;               // ratio^DECIMATE_CIC_ORDER
+#endif
+} decimator_t;
+
+// Function declarations
+void decimator_init(decimator_t *d);
+int decimator_configure(decimator_t *d, int ratio);
+void decimator_reset(decimator_t *d);
+bool decimator_push(decimator_t *d, const ads1299_sample_t *in, ads1299_sample_t *out);
+
+static inline int decimator_ratio(const decimator_t *d) {
+    return d->ratio;
+}
+
+static inline uint32_t decimator_next_number(const decimator_t *d) {
+    return d->next_number;
+}
+
+#ifdef CONFIG_CERELOG_DECIMATE_FIR
+// Filter length and Q30 tap i (newest input first), for checking against a reference
+int decimator_taps(const decimator_t *d);
+int32_t decimator_tap(const decimator_t *d, int i);
+#endif
+
+#ifdef CONFIG_CERELOG_DECIMATE_CHECK
+int decimate_check(void);
+#endif
+
+#endif // DECIMATE_H
\ No newline at end of file
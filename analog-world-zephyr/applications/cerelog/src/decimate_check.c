@@ -0,0 +1,249 @@
+#include "decimate.h"
+#include "bench.h"
+#include <math.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+
+/* Boot-time check of the decimator (CONFIG_CERELOG_DECIMATE_CHECK).
+   Every ratio runs a synthetic stream through the decimator and through a
+   direct-form reference built independently here: the FIR taps read back
+   in natural order, or the CIC's boxcar^order impulse response, convolved
+   with the input history in 64 bits. Outputs must match to the bit,
+   timestamps must sit at the filter centre and numbering must not skip.
+   It also reports the filter's passband ripple and the rejection of
+   frequencies that alias into the passband, and the time per input
+   sample: kernel cycles, which are CPU cycles on the ESP32, or host time
+   under the native_sim benchmark. */
+
+#define CHECK_INPUTS            16384
+#define CHECK_PASSBAND          0.2     // Of the output rate: 50 Hz at 250 SPS out
+
+static decimator_t check_decimator;
+static int64_t check_taps[DECIMATE_HISTORY];
+
+static uint32_t check_hash(uint32_t n) {
+    n ^= n >> 16;
+    n *= 0x7FEB352DU;
+    n ^= n >> 15;
+    n *= 0x846CA68BU;
+    n ^= n >> 16;
+    return n;
+}
+
+/* Input n of channel ch: a triangle wave of a different period per
+   channel with noise and an offset, and on the last channel a full-scale
+   square wave whose edges make the FIR overshoot and saturate */
+static int32_t check_input(uint32_t n, int ch) {
+    if (ch == ADS1299_NUM_CHANNELS - 1) {
+        return (n / 37) & 1 ? 0x7FFFFF : -0x800000;
+    }
+
+    int32_t half = 20 + 15 * ch;
+    int32_t phase = (int32_t)(n % (uint32_t)(2 * half));
+    int32_t triangle = (phase < half ? phase : 2 * half - phase) * (0x300000 / half) - 0x180000;
+    int32_t noise = (int32_t)(check_hash(n * ADS1299_NUM_CHANNELS + ch) & 0x3FFFF) - 0x20000;
+    return triangle + noise + ch * 0x10000;
+}
+
+static uint64_t check_drdy(uint32_t n) {
+    return (uint64_t)n * 1000 + check_hash(n) % 64;
+}
+
+/* Fills check_taps with the filter in natural order and returns its
+   length; *scale is its DC gain */
+static int check_reference_taps(const decimator_t *d, int64_t *scale) {
+#ifdef CONFIG_CERELOG_DECIMATE_FIR
+    int taps = decimator_taps(d);
+    for (int i = 0; i < taps; i++) {
+        check_taps[i] = decimator_tap(d, i);
+    }
+    *scale = 1LL << DECIMATE_COEF_BITS;
+    return taps;
+#else
+    // Convolve a unit impulse with a length-ratio boxcar, once per stage
+    int ratio = decimator_ratio(d);
+    int taps = 1;
+    check_taps[0] = 1;
+    *scale = 1;
+    for (int k = 0; k < DECIMATE_CIC_ORDER; k++) {
+        int longer = taps + ratio - 1;
+        for (int i = longer - 1; i >= 0; i--) {
+            int64_t sum = 0;
+            for (int j = 0; j < ratio; j++) {
+                if (i - j >= 0 && i - j < taps) {
+                    sum += check_taps[i - j];
+                }
+            }
+            check_taps[i] = sum;
+        }
+        taps = longer;
+        *scale *= ratio;
+    }
+    return taps;
+#endif
+}
+
+static int32_t check_round(int64_t value, int64_t scale) {
+    // Floor of value / scale + 1/2, saturated to 24 bits
+    int64_t biased = value + scale / 2;
+    int64_t q = biased >= 0 ? biased / scale : -((-biased + scale - 1) / scale);
+    return q > 0x7FFFFF ? 0x7FFFFF : q < -0x800000 ? -0x800000 : (int32_t)q;
+}
+
+/* |H(f)| in dB from the reference taps, f in cycles per input sample,
+   with a rotating phasor rather than a sin and cos per tap */
+static double check_gain_db(int taps, int64_t scale, double f) {
+    double wr = cos(2.0 * 3.14159265358979 * f), wi = -sin(2.0 * 3.14159265358979 * f);
+    double zr = 1.0, zi = 0.0, hr = 0.0, hi = 0.0;
+
+    for (int i = 0; i < taps; i++) {
+        hr += (double)check_taps[i] * zr;
+        hi += (double)check_taps[i] * zi;
+        double t = zr * wr - zi * wi;
+        zi = zr * wi + zi * wr;
+        zr = t;
+    }
+    return 20.0 * log10(sqrt(hr * hr + hi * hi) / (double)scale + 1e-12);
+}
+
+static inline uint64_t check_now(void) {
+#ifdef CONFIG_CERELOG_BENCH
+    return bench_host_now_ns();
+#else
+    return k_cycle_get_32();
+#endif
+}
+
+static int check_ratio(int ratio) {
+    decimator_t *d = &check_decimator;
+    int64_t scale = 1;
+    int taps = 1;
+    int failures = 0;
+    uint32_t first_number = decimator_next_number(d);
+    uint32_t outputs = 0;
+    uint64_t elapsed = 0;
+
+    if (decimator_configure(d, ratio) != 0) {
+        printk("Decimate check: ratio %d rejected\n", ratio);
+        return 1;
+    }
+    if (ratio > 1) {
+        taps = check_reference_taps(d, &scale);
+    } else {
+        check_taps[0] = 1;
+    }
+    int delay2 = taps - 1;
+#ifndef CONFIG_CERELOG_DECIMATE_FIR
+    delay2 = DECIMATE_CIC_ORDER * (ratio - 1);
+#endif
+    // Outputs before the filter is full are dropped; the first kept one ends this block
+    uint32_t block = ratio > 1 ? d->warmup : 0;
+
+    for (uint32_t n = 0; n < CHECK_INPUTS; n++) {
+        ads1299_sample_t in = {
+            .drdy_cycles = check_drdy(n),
+            .sample_number = n + 1,
+            .status = 0xC00000 | (n & 0xFF),
+        };
+        ads1299_sample_t out;
+        for (int ch = 0; ch < ADS1299_NUM_CHANNELS; ch++) {
+            in.channels[ch] = check_input(n, ch);
+        }
+
+        uint64_t start = check_now();
+        bool ready = decimator_push(d, &in, &out);
+        elapsed += (uint32_t)(check_now() - start);
+        if (!ready) {
+            continue;
+        }
+
+        uint32_t last = block * ratio + ratio - 1;
+        if (last != n) {
+            printk("Decimate check: ratio %d output after input %u, expected %u\n", ratio, n, last);
+            failures++;
+            break;
+        }
+        for (int ch = 0; ch < ADS1299_NUM_CHANNELS; ch++) {
+            int64_t sum = 0;
+            for (int i = 0; i < taps && (uint32_t)i <= last; i++) {
+                sum += check_taps[i] * check_input(last - i, ch);
+            }
+            int32_t expected = check_round(sum, scale);
+            if (out.channels[ch] != expected && failures++ < 4) {
+                printk("Decimate check: ratio %d output %u ch %d is %d, reference %d\n",
+                       ratio, outputs, ch + 1, out.channels[ch], expected);
+            }
+        }
+
+        uint64_t older = check_drdy(last - (delay2 + 1) / 2);
+        uint64_t newer = check_drdy(last - delay2 / 2);
+        if (out.drdy_cycles != older + (newer - older) / 2 && failures++ < 4) {
+            printk("Decimate check: ratio %d output %u timestamp off centre\n", ratio, outputs);
+        }
+        if (out.sample_number != first_number + outputs || out.status != in.status) {
+            if (failures++ < 4) {
+                printk("Decimate check: ratio %d output %u numbered %u\n", ratio, outputs, out.sample_number);
+            }
+        }
+        outputs++;
+        block++;
+    }
+
+    uint32_t per_input_x100 = (uint32_t)(elapsed * 100 / CHECK_INPUTS);
+#ifdef CONFIG_CERELOG_BENCH
+    const char *unit = "host ns";
+#else
+    const char *unit = "cycles";
+#endif
+    printk("Decimate by %2d: %3d taps, %5u outputs, %s, %u.%02u %s per input sample",
+           ratio, taps, outputs, failures ? "MISMATCH" : "exact", per_input_x100 / 100,
+           per_input_x100 % 100, unit);
+
+    if (ratio > 1) {
+        // Passband flatness, and the worst band that folds onto it
+        double ripple = 0.0, rejection = 1e9;
+        double passband = CHECK_PASSBAND / ratio;
+        for (int i = 0; i <= 8; i++) {
+            double g = fabs(check_gain_db(taps, scale, passband * i / 8));
+            ripple = g > ripple ? g : ripple;
+        }
+        for (int k = 1; 2 * k <= ratio; k++) {
+            for (int i = -4; i <= 4; i++) {
+                double f = ((double)k + CHECK_PASSBAND * i / 4) / ratio;
+                double g = -check_gain_db(taps, scale, f > 0.5 ? 0.5 : f);
+                rejection = g < rejection ? g : rejection;
+            }
+        }
+        printk(", passband %u.%02u dB, aliases -%u dB", (uint32_t)ripple, (uint32_t)(ripple * 100) % 100,
+               (uint32_t)rejection);
+    }
+    printk("\n");
+
+    return failures;
+}
+
+/* Runs every ratio up to DECIMATE_MAX_RATIO, the powers of two between the
+   ADS1299 data rates and a few others, and returns the number of failures */
+int decimate_check(void) {
+    static const int ratios[] = {1, 2, 3, 4, 5, 8, 16, 32, 64};
+    int failures = 0;
+
+#ifdef CONFIG_CERELOG_DECIMATE_FIR
+    printk("Decimate check: polyphase FIR, %d taps per phase\n", DECIMATE_PHASE_TAPS);
+#else
+    printk("Decimate check: order %d CIC\n", DECIMATE_CIC_ORDER);
+#endif
+    if (!IS_ENABLED(CONFIG_CERELOG_BENCH)) {
+        printk("Cycle counter at %u Hz\n", sys_clock_hw_cycles_per_sec());
+    }
+
+    decimator_init(&check_decimator);
+    for (int i = 0; i < ARRAY_SIZE(ratios); i++) {
+        if (ratios[i] <= DECIMATE_MAX_RATIO) {
+            failures += check_ratio(ratios[i]);
+        }
+    }
+
+    printk("Decimate check %s\n", failures ? "FAILED" : "passed");
+    return failures;
+}
\ No newline at end of file
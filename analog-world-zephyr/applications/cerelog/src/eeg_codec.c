@@ -0,0 +1,223 @@
+#include "eeg_codec.h"
+#include <stdbool.h>
+#include <errno.h>
+
+/* Every step below is a fixed number of passes over the block with no
+   data-dependent loops beyond the capped unary prefix, so the encode cost
+   per sample is bounded regardless of the signal. */
+
+typedef struct {
+    uint8_t *out;
+    size_t pos;
+    uint32_t acc;               // Pending bits, right-aligned
+    int bits;                   // Number of pending bits, always < 8 between calls
+} bit_writer_t;
+
+typedef struct {
+    const uint8_t *in;
+    size_t size;
+    size_t pos;
+    uint32_t acc;
+    int bits;
+    bool overrun;
+} bit_reader_t;
+
+// Writes the low n bits of value, n <= 24
+static inline void put_bits(bit_writer_t *w, uint32_t value, int n) {
+    w->acc = (w->acc << n) | (value & ((1u << n) - 1));
+    w->bits += n;
+    while (w->bits >= 8) {
+        w->bits -= 8;
+        w->out[w->pos++] = (uint8_t)(w->acc >> w->bits);
+    }
+}
+
+static inline void flush_bits(bit_writer_t *w) {
+    if (w->bits > 0) {
+        w->out[w->pos++] = (uint8_t)(w->acc << (8 - w->bits));
+        w->bits = 0;
+    }
+}
+
+// Reads n bits, n <= 24. Past the end of the input it returns zeros and flags the overrun.
+static inline uint32_t get_bits(bit_reader_t *r, int n) {
+    while (r->bits < n) {
+        uint8_t byte = 0;
+        if (r->pos < r->size) {
+            byte = r->in[r->pos++];
+        } else {
+            r->overrun = true;
+        }
+        r->acc = (r->acc << 8) | byte;
+        r->bits += 8;
+    }
+    r->bits -= n;
+    return (r->acc >> r->bits) & ((1u << n) - 1);
+}
+
+static inline uint32_t zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t z) {
+    return (int32_t)(z >> 1) ^ -(int32_t)(z & 1);
+}
+
+static inline int32_t sign_extend_24(uint32_t v) {
+    return (int32_t)(v << 8) >> 8;
+}
+
+/* Residual of sample i for the given mode. Second-order prediction needs two
+   previous samples, so sample 1 always uses the first-order delta. */
+static inline int32_t residual(const int32_t *x, size_t stride, size_t i, int mode) {
+    int32_t r = x[i * stride] - x[(i - 1) * stride];
+    if (mode == EEG_CODEC_MODE_DELTA2 && i >= 2) {
+        r -= x[(i - 1) * stride] - x[(i - 2) * stride];
+    }
+    return r;
+}
+
+static inline uint32_t rice_bits(uint32_t z, int k) {
+    uint32_t q = z >> k;
+    return q < EEG_CODEC_ESCAPE ? q + 1 + k : EEG_CODEC_ESCAPE + EEG_CODEC_ESCAPE_BITS;
+}
+
+static void encode_channel(bit_writer_t *w, const int32_t *x, size_t stride, size_t n) {
+    const uint32_t raw_bits = (uint32_t)n * 24;
+    uint64_t sum1 = 0, sum2 = 0;
+
+    // Pass 1: pick the predictor with the smaller residual magnitude
+    for (size_t i = 1; i < n; i++) {
+        sum1 += zigzag(residual(x, stride, i, EEG_CODEC_MODE_DELTA1));
+        sum2 += zigzag(residual(x, stride, i, EEG_CODEC_MODE_DELTA2));
+    }
+    int mode = sum2 < sum1 ? EEG_CODEC_MODE_DELTA2 : EEG_CODEC_MODE_DELTA1;
+    uint64_t sum = mode == EEG_CODEC_MODE_DELTA2 ? sum2 : sum1;
+
+    // Rice parameter from the mean residual, as in LOCO-I
+    int k = 0;
+    while (k < EEG_CODEC_MAX_K && ((uint64_t)(n - 1) << k) < sum) {
+        k++;
+    }
+
+    // Pass 2: exact coded size, so raw mode can be chosen when it is smaller
+    uint32_t coded_bits = 24 + EEG_CODEC_K_BITS;
+    for (size_t i = 1; i < n && coded_bits < raw_bits; i++) {
+        coded_bits += rice_bits(zigzag(residual(x, stride, i, mode)), k);
+    }
+
+    if (n < 2 || coded_bits >= raw_bits) {
+        put_bits(w, EEG_CODEC_MODE_RAW, EEG_CODEC_MODE_BITS);
+        for (size_t i = 0; i < n; i++) {
+            put_bits(w, (uint32_t)x[i * stride], 24);
+        }
+        return;
+    }
+
+    // Pass 3: emit
+    put_bits(w, (uint32_t)mode, EEG_CODEC_MODE_BITS);
+    put_bits(w, (uint32_t)x[0], 24);
+    put_bits(w, (uint32_t)k, EEG_CODEC_K_BITS);
+    for (size_t i = 1; i < n; i++) {
+        uint32_t z = zigzag(residual(x, stride, i, mode));
+        uint32_t q = z >> k;
+
+        if (q < EEG_CODEC_ESCAPE) {
+            // q ones and a terminating zero
+            put_bits(w, ((1u << q) - 1) << 1, (int)q + 1);
+            if (k > 0) {
+                put_bits(w, z, k);
+            }
+        } else {
+            put_bits(w, (1u << EEG_CODEC_ESCAPE) - 1, EEG_CODEC_ESCAPE);
+            put_bits(w, z >> 24, EEG_CODEC_ESCAPE_BITS - 24);
+            put_bits(w, z, 24);
+        }
+    }
+}
+
+int eeg_codec_encode(const int32_t *samples, size_t num_samples, size_t num_channels,
+                     uint8_t *out, size_t out_size) {
+    if (!samples || !out || num_samples == 0 || num_channels == 0) {
+        return -EINVAL;
+    }
+
+    // Checking the bound once up front keeps the bit writer free of range checks
+    if (out_size < EEG_CODEC_MAX_BYTES(num_samples, num_channels)) {
+        return -ENOMEM;
+    }
+
+    bit_writer_t w = { .out = out };
+    for (size_t ch = 0; ch < num_channels; ch++) {
+        encode_channel(&w, &samples[ch], num_channels, num_samples);
+    }
+    flush_bits(&w);
+
+    return (int)w.pos;
+}
+
+static int decode_channel(bit_reader_t *r, int32_t *x, size_t stride, size_t n) {
+    int mode = (int)get_bits(r, EEG_CODEC_MODE_BITS);
+
+    if (mode == EEG_CODEC_MODE_RAW) {
+        for (size_t i = 0; i < n; i++) {
+            x[i * stride] = sign_extend_24(get_bits(r, 24));
+        }
+        return 0;
+    }
+
+    if (mode != EEG_CODEC_MODE_DELTA1 && mode != EEG_CODEC_MODE_DELTA2) {
+        return -EBADMSG;
+    }
+
+    x[0] = sign_extend_24(get_bits(r, 24));
+    int k = (int)get_bits(r, EEG_CODEC_K_BITS);
+    if (k > EEG_CODEC_MAX_K) {
+        return -EBADMSG;
+    }
+
+    for (size_t i = 1; i < n; i++) {
+        uint32_t q = 0;
+        while (q < EEG_CODEC_ESCAPE && get_bits(r, 1)) {
+            q++;
+        }
+
+        uint32_t z;
+        if (q < EEG_CODEC_ESCAPE) {
+            z = (q << k) | (k > 0 ? get_bits(r, k) : 0);
+        } else {
+            z = get_bits(r, EEG_CODEC_ESCAPE_BITS - 24) << 24;
+            z |= get_bits(r, 24);
+        }
+
+        // Prediction uses already reconstructed samples, exactly as the encoder did
+        int32_t pred = x[(i - 1) * stride];
+        if (mode == EEG_CODEC_MODE_DELTA2 && i >= 2) {
+            pred += x[(i - 1) * stride] - x[(i - 2) * stride];
+        }
+        x[i * stride] = sign_extend_24((uint32_t)(pred + unzigzag(z)));
+
+        if (r->overrun) {
+            return -EBADMSG;
+        }
+    }
+
+    return 0;
+}
+
+int eeg_codec_decode(const uint8_t *in, size_t in_size, size_t num_samples, size_t num_channels,
+                     int32_t *samples) {
+    if (!in || !samples || num_samples == 0 || num_channels == 0) {
+        return -EINVAL;
+    }
+
+    bit_reader_t r = { .in = in, .size = in_size };
+    for (size_t ch = 0; ch < num_channels; ch++) {
+        int ret = decode_channel(&r, &samples[ch], num_channels, num_samples);
+        if (ret != 0) {
+            return ret;
+        }
+    }
+
+    return r.overrun ? -EBADMSG : 0;
+}
\ No newline at end of file
@@ -0,0 +1,53 @@
+#ifndef EEG_CODEC_H
+#define EEG_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Lossless codec for blocks of 24-bit ADS1299 channel samples.
+   Plain C with no Zephyr dependencies so the host tools build the same file.
+
+   Each channel of a block is coded on its own, channel after channel, as
+   an MSB-first bitstream:
+     2 bits  mode: raw, first-order delta or second-order delta
+     raw:    num_samples x 24-bit two's complement values
+     delta:  24-bit first value, 5-bit Rice parameter k, then one
+             Rice code per remaining residual (zigzag mapped)
+   A residual whose quotient reaches EEG_CODEC_ESCAPE is sent as the escape
+   prefix followed by its 26-bit zigzag value. The encoder falls back to raw
+   mode whenever coding would not save bits, which bounds the output. */
+
+#define EEG_CODEC_MODE_BITS     2
+#define EEG_CODEC_MODE_RAW      0
+#define EEG_CODEC_MODE_DELTA1   1
+#define EEG_CODEC_MODE_DELTA2   2
+
+#define EEG_CODEC_K_BITS        5
+#define EEG_CODEC_MAX_K         23
+#define EEG_CODEC_ESCAPE        20  // Unary quotient length that signals an escaped residual
+#define EEG_CODEC_ESCAPE_BITS   26  // Second-order residuals of 24-bit data fit in 26 bits zigzagged
+
+// Worst-case encoded size: every channel in raw mode, plus the mode bits
+#define EEG_CODEC_MAX_BYTES(samples, channels) \
+    ((size_t)(samples) * (channels) * 3 + ((size_t)(channels) * EEG_CODEC_MODE_BITS + 7) / 8)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* samples is interleaved [num_samples][num_channels] and holds sign-extended
+   24-bit values. Returns the encoded length in bytes, or a negative errno. */
+int eeg_codec_encode(const int32_t *samples, size_t num_samples, size_t num_channels,
+                     uint8_t *out, size_t out_size);
+
+/* Inverse of eeg_codec_encode. The caller supplies the block dimensions,
+   which the packet header carries. Returns 0, or a negative errno if the
+   stream is truncated or malformed. */
+int eeg_codec_decode(const uint8_t *in, size_t in_size, size_t num_samples, size_t num_channels,
+                     int32_t *samples);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EEG_CODEC_H
\ No newline at end of file
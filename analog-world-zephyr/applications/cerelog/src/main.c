@@ -1,311 +1,1072 @@
-#include <zephyr/kernel.h>
-#include <zephyr/device.h>
-#include <zephyr/drivers/spi.h>
-#include <zephyr/drivers/gpio.h>
-#include <zephyr/sys/printk.h>
-#include "ads1299.h"
-//#include "data_handler.h"
-
-// GPIO Pin definitions
-#define ADS1299_PWDN_PIN    13
-#define ADS1299_RST_PIN     12
-#define ADS1299_START_PIN   14
-#define ADS1299_DRDY_PIN    27
-
-// Data buffer for ADS1299 samples
-static uint8_t ads_raw_data[27]; // 24 bits status + 24*8 bits data = 216 bits = 27 bytes
-//static ads1299_sample_t current_sample;
-
-// USB/UART transmission buffer
-static uint8_t tx_buffer[64];
-
-// Forward declarations
-static void drdy_interrupt_handler(const struct device *dev, struct gpio_callback *cb, uint32_t pins);
-static int ads1299_init_device(const struct device *gpio_dev, const struct ads1299_config *ads1299_cfg);
-static int ads1299_read_data(const struct ads1299_config *ads1299_cfg);
-//static void data_acquisition_thread(const struct ads1299_config *ads1299_cfg);
-//static void usb_transmission_thread(void);
-
-/* // Thread definitions
-K_THREAD_DEFINE(acq_thread, 2048, data_acquisition_thread, NULL, NULL, NULL, 
-                K_PRIO_COOP(5), 0, 0);
- K_THREAD_DEFINE(usb_thread, 2048, usb_transmission_thread, NULL, NULL, NULL, 
-                K_PRIO_COOP(7), 0, 0);
-
-// Semaphores for thread synchronization
-K_SEM_DEFINE(data_ready_sem, 0, 1); // this is DRDY pin part
-K_SEM_DEFINE(usb_ready_sem, 0, 10);
-
-static void drdy_interrupt_handler(const struct device *dev, struct gpio_callback *cb, uint32_t pins) {
-    ARG_UNUSED(dev);
-    ARG_UNUSED(cb);
-    ARG_UNUSED(pins);
-    
-    data_ready = true;
-    k_sem_give(&data_ready_sem);
-} */
-
-static int ads1299_init_device(const struct device *gpio_dev, const struct ads1299_config *ads1299_cfg) {
-    int ret;
-
-    printk("Initializing ADS1299...\n");
-
-    // Power down sequence
-    gpio_pin_set(gpio_dev, ADS1299_PWDN_PIN, 0);
-    k_msleep(1);
-    gpio_pin_set(gpio_dev, ADS1299_RST_PIN, 0);
-    k_msleep(1);
-
-    // Power up sequence
-    gpio_pin_set(gpio_dev, ADS1299_PWDN_PIN, 1);
-    k_msleep(10);
-    gpio_pin_set(gpio_dev, ADS1299_RST_PIN, 1);
-    k_msleep(100); // Wait for power-on reset
-
-    printk("No issue with gpio manipulation\n");
-
-    // Test: Check if SPI config is valid
-    printk("SPI device: %p\n", ads1299_cfg->zephyr_spi_dev);
-    printk("SPI config: %p\n", ads1299_cfg->spi_cfg);
-    printk("CS GPIO port: %p\n", ads1299_cfg->spi_cfg->cs.gpio.port);
-    printk("CS GPIO pin: %d\n", ads1299_cfg->spi_cfg->cs.gpio.pin);
-
-    // COMMENT OUT THE CRASHING CALLS FOR NOW
-    ADS1299_SDATAC(ads1299_cfg);
-    printk("Skipped ADS1299_SDATAC for now\n");
-
-    // ret = ADS1299_SETUP(ads1299_cfg);
-    printk("Skipped ADS1299_SETUP for now\n");
-
-    // ADS1299_RDATAC(ads1299_cfg);
-    printk("Skipped ADS1299_RDATAC for now\n");
-
-    printk("ADS1299 initialization complete\n");
-    return 0;
-}
-
-
-/* static int ads1299_read_data(const struct ads1299_config *ads1299_cfg) {
-    struct spi_buf rx_buf = {
-        .buf = ads_raw_data,
-        .len = sizeof(ads_raw_data)
-    };
-    struct spi_buf_set rx_bufs = {
-        .buffers = &rx_buf,
-        .count = 1
-    };
-    
-    // Read data from ADS1299
-    int ret = spi_read(ads1299_cfg->zephyr_spi_dev, ads1299_cfg->spi_cfg, &rx_bufs);
-    if (ret != 0) {
-        printk("SPI read failed: %d\n", ret);
-        return ret;
-    }
-    
-    return 0;
-}
-
-static void data_acquisition_thread(const struct ads1299_config *ads1299_cfg) {
-    int ret;
-
-    printk("Data acquisition thread started\n");
-
-    while (1) {
-        // Wait for DRDY interrupt
-        k_sem_take(&data_ready_sem, K_FOREVER);
-
-        if (!acquisition_active) {
-            continue;
-        }
-
-        // Read data from ADS1299
-        ret = ads1299_read_data(ads1299_cfg);
-        if (ret == 0) {
-            // Process raw data into structured format
-            process_ads1299_data(ads_raw_data, &current_sample);
-
-            // Signal USB thread that new data is ready
-            k_sem_give(&usb_ready_sem);
-        }
-
-        data_ready = false;
-        printk("I wuz here");
-    }
-} */
-
-/*static void usb_transmission_thread(void) {
-    int ret;
-    size_t tx_len;
-    
-    printk("USB transmission thread started\n");
-    
-    while (1) {
-        // Wait for new sample data
-        k_sem_take(&usb_ready_sem, K_FOREVER);
-        
-        // Format data for transmission
-        tx_len = format_sample_for_transmission(&current_sample, tx_buffer, sizeof(tx_buffer));
-        
-        if (tx_len > 0) {
-            // Send data via UART (USB CDC)
-            for (size_t i = 0; i < tx_len; i++) {
-                uart_poll_out(uart_dev, tx_buffer[i]);
-                printk("%d\n", tx_buffer[i]);
-            }
-        }
-    }
-} */
-
-int main(void) {
-    int ret;
-    k_msleep(2000);
-    printk("Basic Test Starting...\n");
-    
-    // Get device handles
-    const struct device *uart_dev = DEVICE_DT_GET(DT_NODELABEL(uart0));
-    if (!device_is_ready(uart_dev)) {
-        printk("UART device not ready\n");
-        return -1;
-    }
-    
-    const struct device *gpio_dev = DEVICE_DT_GET(DT_NODELABEL(gpio0));
-    if (!device_is_ready(gpio_dev)) {
-        printk("GPIO device not ready\n");
-        return -1;
-    }
-
-    // Configure all GPIO pins
-    ret = gpio_pin_configure(gpio_dev, ADS1299_PWDN_PIN, GPIO_OUTPUT_INACTIVE);
-    if (ret != 0) {
-        printk("Failed to configure PWDN pin: %d\n", ret);
-        return ret;
-    }
-    
-    ret = gpio_pin_configure(gpio_dev, ADS1299_RST_PIN, GPIO_OUTPUT_INACTIVE);
-    if (ret != 0) {
-        printk("Failed to configure RST pin: %d\n", ret);
-        return ret;
-    }
-    
-    ret = gpio_pin_configure(gpio_dev, ADS1299_START_PIN, GPIO_OUTPUT_INACTIVE);
-    if (ret != 0) {
-        printk("Failed to configure START pin: %d\n", ret);
-        return ret;
-    }
-    
-    ret = gpio_pin_configure(gpio_dev, ADS1299_DRDY_PIN, GPIO_INPUT | GPIO_INT_EDGE_FALLING);
-    if (ret != 0) {
-        printk("Failed to configure DRDY pin: %d\n", ret);
-        return ret;
-    }
-    
-    printk("All GPIO pins configured successfully\n");
-
-    //const struct gpio_dt_spec cs_gpio = GPIO_DT_SPEC_GET_BY_IDX(DT_NODELABEL(spi3), cs_gpios, 0);
-    
-    const struct gpio_dt_spec cs_gpio = {
-    .port = DEVICE_DT_GET(DT_NODELABEL(gpio0)),
-    .pin = 5,
-    .dt_flags = GPIO_ACTIVE_LOW
-};
-    printk("Got CS_GPIO no prob\n");
-    struct spi_config ads1299_spi_cfg = {
-        .frequency = 4000000,
-        .operation = SPI_WORD_SET(8) | SPI_TRANSFER_MSB | SPI_MODE_CPHA | SPI_OP_MODE_MASTER,
-        //.slave = 0,
-        .cs = {
-            .gpio = &cs_gpio,
-            .delay = 1
-        }
-    };
-    const struct device *spi_zephyr_dev = DEVICE_DT_GET(DT_NODELABEL(spi3));
-    printk("Got the SPI ZEPHYR DEVICE no prob");
-    if (!device_is_ready(spi_zephyr_dev)) {
-        printk("SPI device not ready\n");
-        return -1;
-    }
-
-/*     // With this:
-    struct ads1299_config ads1299_config = {
-        .zephyr_spi_dev = spi_zephyr_dev,  // Note: no & needed since spi_zephyr_dev is already a pointer
-        .spi_cfg = &ads1299_spi_cfg
-    }; */
-
-    struct ads1299_config ads1299_cfg = {
-        .zephyr_spi_dev = spi_zephyr_dev,
-        .spi_cfg = &ads1299_spi_cfg
-    };
-
-    printk("SPI device ready\n");
-    ret = ADS1299_INIT(&ads1299_cfg);
-    printk("ADS1299 Driver Init done");
-
-    // Initialize ADS1299
-    ret = ads1299_init_device(gpio_dev, &ads1299_cfg);
-    if (ret != 0) {
-        printk("Failed to initialize ADS1299: %d\n", ret);
-        return ret;
-    }
-    
-/*     // Setup DRDY interrupt
-    gpio_init_callback(&drdy_cb_data, drdy_interrupt_handler, BIT(ADS1299_DRDY_PIN));
-    ret = gpio_add_callback(gpio_dev, &drdy_cb_data);
-    if (ret != 0) {
-        printk("Failed to add GPIO callback: %d\n", ret);
-        return ret;
-    }
-    
-    ret = gpio_pin_interrupt_configure(gpio_dev, ADS1299_DRDY_PIN, GPIO_INT_EDGE_FALLING);
-    if (ret != 0) {
-        printk("Failed to configure GPIO interrupt: %d\n", ret);
-        return ret;
-    }
-
-    printk("Interrupt configured\n"); */
-
-    // Main loop
-    while (1) {
-        k_msleep(1000);
-        printk("System running...\n");
-        printk(ADS1299_SEND_CMD(0x00, &ads1299_cfg));
-    }
-    
-    return 0;    
-    /*
-    // Setup DRDY interrupt
-    gpio_init_callback(&drdy_cb_data, drdy_interrupt_handler, BIT(ADS1299_DRDY_PIN));
-    ret = gpio_add_callback(gpio_dev, &drdy_cb_data);
-    if (ret != 0) {
-        printk("Failed to add GPIO callback: %d\n", ret);
-        return ret;
-    }
-    
-    ret = gpio_pin_interrupt_configure(gpio_dev, ADS1299_DRDY_PIN, GPIO_INT_EDGE_FALLING);
-    if (ret != 0) {
-        printk("Failed to configure GPIO interrupt: %d\n", ret);
-        return ret;
-    }
-
-    struct ads1299_config ads_config = {
-        .spi_zephyr_dev = spi_zephyr_dev,
-        .spi_cfg = &ads1299_spi_cfg
-    };
-    
-    ret = ads1299_init(&ads_config);
-    if (ret != 0) {
-        printk("Failed to initialize ADS1299 driver: %d\n", ret);
-        return ret;
-    }
-    
-
-    
-    printk("System initialized successfully. Starting data acquisition...\n");
-    
-    // Main loop - can be used for status monitoring or commands
-    while (1) {
-        k_msleep(1000);
-        printk("Cool world\n");
-        // Could add status printing, command processing, etc.
-    }
-    */
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/spi.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/uart.h>
+#include <zephyr/sys/printk.h>
+#include <string.h>
+#include "ads1299.h"
+#include "data_handler.h"
+#include "sample_ring.h"
+#include "ads1299_profile.h"
+#include "command.h"
+#include "telemetry.h"
+#include "bench.h"
+#include "transport.h"
+#ifdef CONFIG_CERELOG_DECIMATE
+#include "decimate.h"
+#endif
+#ifdef CONFIG_CERELOG_RETRANSMIT
+#include "retransmit.h"
+#endif
+#ifdef CONFIG_CERELOG_CAPTURE
+#include "capture.h"
+#endif
+
+// GPIO Pin definitions
+#define ADS1299_PWDN_PIN    13
+#define ADS1299_RST_PIN     12
+#define ADS1299_START_PIN   14
+#define ADS1299_DRDY_PIN    27
+#if defined(CONFIG_CERELOG_CAPTURE) && CONFIG_CERELOG_CAPTURE_TRIGGER_PIN >= 0
+#define CAPTURE_TRIGGER_PIN CONFIG_CERELOG_CAPTURE_TRIGGER_PIN
+#endif
+
+// Parsed samples waiting for transmission; frames are read straight into their ring slot
+static sample_ring_t sample_ring;
+
+// Batch being assembled, sized for the largest; finished packets are copied to the transport
+static uint8_t tx_buffer[BATCH_PACKET_MAX_SIZE(BATCH_MAX_SAMPLES)];
+
+// Batch being filled by the transmission thread, too large for its stack
+static batch_frame_t tx_frame;
+static uint8_t marker_buffer[sizeof(ads1299_marker_packet_t)];
+#ifdef CONFIG_CERELOG_DECIMATE
+// Owned by the transmission thread: the filter state and the output sample it builds
+static decimator_t decimator;
+static ads1299_sample_t tx_decimated;
+// Set when the decimator restarts, until a MARKER_NUMBERING goes out with its first output
+static bool numbering_pending = true;
+#endif
+#ifdef CONFIG_CERELOG_TELEMETRY
+static uint8_t telemetry_buffer[sizeof(telemetry_packet_t)];
+#endif
+#ifdef CONFIG_CERELOG_RETRANSMIT
+// Resent packets that may go out before the next live one
+#define RESEND_CREDIT_MAX   4
+static int resend_credit;
+#endif
+
+// Devices and driver config shared with the threads, filled in by main()
+static const struct device *uart_dev;
+static struct spi_config ads1299_spi_cfg;
+static struct ads1299_config ads1299_cfg;
+static struct gpio_callback drdy_cb_data;
+#ifdef CAPTURE_TRIGGER_PIN
+static struct gpio_callback capture_cb_data;
+#endif
+static volatile bool acquisition_active = false;
+
+// Uptime when the ADS1299 left power-down and when its first frame was published, for the bring-up time report
+static int64_t power_up_ticks;
+static int64_t first_sample_ticks;  // Written once, before frames_read first moves
+
+// Pipeline counters
+static atomic_t drdy_edges;         // Falling edges seen by the ISR
+static uint64_t drdy_cycles;        // Cycle count at the latest edge, written by the ISR only
+static atomic_t frames_read;        // Frames read and parsed into the ring
+static atomic_t read_cycles;        // Cycles the acquisition thread spent on frame reads
+static atomic_t spi_errors;         // Frame reads that failed, or came back with a status word out of sync
+static atomic_t command_errors;     // Host commands that failed
+static atomic_t marker_drops;       // Reconfiguration markers lost to a full marker queue
+
+// Host command parser, kept here so telemetry can report its CRC errors
+static command_parser_t command_parser;
+
+#ifdef CONFIG_CERELOG_TELEMETRY
+static timing_t drdy_timing;        // Timing counter at the latest DRDY edge
+#ifdef CONFIG_CERELOG_SPI_ASYNC
+static timing_t spi_start_timing;   // When the read in flight was started
+#endif
+#endif
+
+// Forward declarations
+static void drdy_interrupt_handler(const struct device *dev, struct gpio_callback *cb, uint32_t pins);
+static int ads1299_init_device(const struct device *gpio_dev, const struct ads1299_config *ads1299_cfg);
+static int ads1299_read_data(const struct ads1299_config *ads1299_cfg, uint8_t *frame);
+static void publish_frame(ads1299_sample_t *slot);
+static void data_acquisition_thread(void *p1, void *p2, void *p3);
+static void usb_transmission_thread(void *p1, void *p2, void *p3);
+static void send_batch(batch_frame_t *frame);
+static void send_marker(const ads1299_marker_t *marker);
+static void send_reconfig(ads1299_marker_t *marker);
+static void apply_profile(const ads1299_profile_t *profile);
+static void command_thread(void *p1, void *p2, void *p3);
+
+/* Thread definitions. Acquisition is cooperative so a frame read is never
+   preempted halfway; transmission is preemptible so formatting, or a wait
+   for a free transmit buffer, cannot hold off the next DRDY. */
+K_THREAD_DEFINE(acq_thread, 2048, data_acquisition_thread, NULL, NULL, NULL,
+                K_PRIO_COOP(5), 0, 0);
+K_THREAD_DEFINE(usb_thread, 2048, usb_transmission_thread, NULL, NULL, NULL,
+                K_PRIO_PREEMPT(7), 0, 0);
+// Started by main() once the UART is up
+K_THREAD_DEFINE(cmd_thread, 1024, command_thread, NULL, NULL, NULL,
+                K_PRIO_PREEMPT(8), 0, SYS_FOREVER_MS);
+
+// Semaphores for thread synchronization
+K_SEM_DEFINE(data_ready_sem, 0, 1); // this is DRDY pin part
+K_SEM_DEFINE(usb_ready_sem, 0, SAMPLE_RING_SIZE);
+
+#ifdef CONFIG_CERELOG_SPI_ASYNC
+// Available while no asynchronous frame read is in flight
+K_SEM_DEFINE(spi_idle_sem, 1, 1);
+#endif
+
+// Stream markers from the acquisition thread, sent in sample order by the transmission thread
+K_MSGQ_DEFINE(marker_msgq, sizeof(ads1299_marker_t), 4, 4);
+
+static void drdy_interrupt_handler(const struct device *dev, struct gpio_callback *cb, uint32_t pins) {
+    ARG_UNUSED(dev);
+    ARG_UNUSED(cb);
+    ARG_UNUSED(pins);
+
+    // Latch the time here; anything later adds scheduling jitter
+    drdy_cycles = get_cycles64();
+#ifdef CONFIG_CERELOG_TELEMETRY
+    drdy_timing = timing_counter_get();
+#endif
+    atomic_inc(&drdy_edges);
+    k_sem_give(&data_ready_sem);
+}
+
+#ifdef CAPTURE_TRIGGER_PIN
+// The trigger pin going high starts a capture, going low ends it
+static void capture_pin_handler(const struct device *dev, struct gpio_callback *cb, uint32_t pins) {
+    ARG_UNUSED(cb);
+    ARG_UNUSED(pins);
+
+    if (gpio_pin_get(dev, CAPTURE_TRIGGER_PIN) > 0) {
+        capture_trigger(CAPTURE_TRIGGER_GPIO);
+    } else {
+        capture_stop(CAPTURE_TRIGGER_GPIO);
+    }
+}
+#endif
+
+static int ads1299_init_device(const struct device *gpio_dev, const struct ads1299_config *ads1299_cfg) {
+    printk("Initializing ADS1299...\n");
+
+    // Power down sequence
+    gpio_pin_set(gpio_dev, ADS1299_PWDN_PIN, 0);
+    gpio_pin_set(gpio_dev, ADS1299_RST_PIN, 0);
+    ADS1299_WAIT_TCLK(ADS1299_RST_PULSE_TCLK);
+
+    // Power up sequence: wait out the power-on reset, then pulse RESET
+    gpio_pin_set(gpio_dev, ADS1299_PWDN_PIN, 1);
+    gpio_pin_set(gpio_dev, ADS1299_RST_PIN, 1);
+    power_up_ticks = k_uptime_ticks();
+    ADS1299_WAIT_TCLK(ADS1299_TPOR_TCLK);
+
+    gpio_pin_set(gpio_dev, ADS1299_RST_PIN, 0);
+    ADS1299_WAIT_TCLK(ADS1299_RST_PULSE_TCLK);
+    gpio_pin_set(gpio_dev, ADS1299_RST_PIN, 1);
+    ADS1299_WAIT_TCLK(ADS1299_RST_WAIT_TCLK);
+
+    printk("No issue with gpio manipulation\n");
+
+    // Test: Check if SPI config is valid
+    printk("SPI device: %p\n", ads1299_cfg->zephyr_spi_dev);
+    printk("SPI config: %p\n", ads1299_cfg->spi_cfg);
+    printk("CS GPIO port: %p\n", ads1299_cfg->spi_cfg->cs.gpio.port);
+    printk("CS GPIO pin: %d\n", ads1299_cfg->spi_cfg->cs.gpio.pin);
+
+    ADS1299_SDATAC(ads1299_cfg);
+
+    int ret = ADS1299_SETUP(ads1299_cfg);
+    if (ret != 0) {
+        return ret;
+    }
+
+#ifdef CONFIG_CERELOG_BENCH
+    // Benchmark runs at its own data rate rather than the register list's
+    uint8_t config1;
+    ADS1299_RREG(0x01, &config1, 1, ads1299_cfg);
+    config1 = (config1 & ~0x07) | bench_config1_dr();
+    ADS1299_WREG(0x01, &config1, 1, ads1299_cfg);
+#endif
+
+#ifdef CONFIG_CERELOG_CAPTURE
+    uint8_t image[ADS1299_NUM_REGS];
+    ADS1299_SHADOW_READ(image);
+    capture_set_data_rate(image[0x01]);
+#endif
+
+    // Start conversions, then stream them continuously on every DRDY
+    ADS1299_START(ads1299_cfg);
+    ADS1299_RDATAC(ads1299_cfg);
+
+    printk("ADS1299 initialization complete\n");
+    return 0;
+}
+
+static int ads1299_read_data(const struct ads1299_config *ads1299_cfg, uint8_t *frame) {
+    struct spi_buf rx_buf = {
+        .buf = frame,
+        .len = ADS1299_TOTAL_DATA_BYTES
+    };
+    struct spi_buf_set rx_bufs = {
+        .buffers = &rx_buf,
+        .count = 1
+    };
+
+    // Read data from ADS1299; a failure can repeat every frame, so the caller only counts it
+    return spi_read(ads1299_cfg->zephyr_spi_dev, ads1299_cfg->spi_cfg, &rx_bufs);
+}
+
+/* Parses a frame that has landed in its ring slot and hands it to the
+   transmission thread. Runs in the SPI completion interrupt when reads are
+   asynchronous, otherwise in the acquisition thread. */
+static void publish_frame(ads1299_sample_t *slot) {
+    const uint8_t *frame = sample_ring_frame(&sample_ring, slot);
+
+    BENCH_START(t_parse);
+    TELEMETRY_START(t_telemetry);
+    // A chip out of sync still gives a sample, so the stream keeps its numbering
+    if (process_ads1299_data(frame, slot) != 0) {
+        atomic_inc(&spi_errors);
+    }
+#ifdef CONFIG_CERELOG_CAPTURE
+    capture_store(frame, slot, (uint32_t)atomic_get(&drdy_edges));
+#endif
+    sample_ring_commit(&sample_ring);
+    TELEMETRY_END(TELEMETRY_STAGE_PARSE, t_telemetry);
+    BENCH_END(BENCH_STAGE_PARSE, t_parse);
+
+    // Signal USB thread that new data is ready
+    k_sem_give(&usb_ready_sem);
+
+    // This may be the SPI interrupt, where printk would busy-wait; the main loop reports it
+    if (atomic_get(&frames_read) == 0) {
+        first_sample_ticks = k_uptime_ticks();
+    }
+    atomic_inc(&frames_read);
+}
+
+#ifdef CONFIG_CERELOG_SPI_ASYNC
+static void frame_read_done(const struct device *dev, int result, void *userdata) {
+    ARG_UNUSED(dev);
+
+#ifdef CONFIG_CERELOG_TELEMETRY
+    telemetry_record(TELEMETRY_STAGE_SPI, spi_start_timing);
+#endif
+    if (result == 0) {
+        publish_frame(userdata);
+    } else {
+        // Counted only; telemetry or the stats line reports it from thread context
+        atomic_inc(&spi_errors);
+    }
+    k_sem_give(&spi_idle_sem);
+}
+#endif
+
+static void data_acquisition_thread(void *p1, void *p2, void *p3) {
+    ARG_UNUSED(p1);
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    int ret;
+
+    printk("Data acquisition thread started\n");
+
+    while (1) {
+        // Wait for DRDY interrupt
+        k_sem_take(&data_ready_sem, K_FOREVER);
+
+        if (!acquisition_active) {
+            continue;
+        }
+
+#ifdef CONFIG_CERELOG_SPI_ASYNC
+        // A read still in flight means DRDY outran the bus; this frame is missed
+        if (k_sem_take(&spi_idle_sem, K_NO_WAIT) != 0) {
+            continue;
+        }
+#endif
+
+        // Read into the next ring slot; a full ring drops the sample and counts an overrun
+        ads1299_sample_t *slot = sample_ring_reserve(&sample_ring);
+        if (!slot) {
+#ifdef CONFIG_CERELOG_SPI_ASYNC
+            k_sem_give(&spi_idle_sem);
+#endif
+            continue;
+        }
+        uint8_t *frame = sample_ring_frame(&sample_ring, slot);
+
+        unsigned int key = irq_lock();
+        slot->drdy_cycles = drdy_cycles;
+#ifdef CONFIG_CERELOG_TELEMETRY
+        timing_t drdy_time = drdy_timing;
+#endif
+        irq_unlock(key);
+        TELEMETRY_END(TELEMETRY_STAGE_DRDY_TO_SPI, drdy_time);
+
+        // Read data from ADS1299 before the next conversion overwrites it
+        BENCH_START(t_read);
+        uint32_t read_start = k_cycle_get_32();
+#ifdef CONFIG_CERELOG_SPI_ASYNC
+#ifdef CONFIG_CERELOG_TELEMETRY
+        spi_start_timing = timing_counter_get();
+#endif
+        ret = ADS1299_READ_DATA_ASYNC(frame, ADS1299_TOTAL_DATA_BYTES, frame_read_done, slot,
+                                      &ads1299_cfg);
+        if (ret != 0) {
+            atomic_inc(&spi_errors);
+            k_sem_give(&spi_idle_sem);
+            continue;
+        }
+#else
+        TELEMETRY_START(t_spi);
+        ret = ads1299_read_data(&ads1299_cfg, frame);
+        TELEMETRY_END(TELEMETRY_STAGE_SPI, t_spi);
+        if (ret != 0) {
+            atomic_inc(&spi_errors);
+            continue;
+        }
+#endif
+        atomic_add(&read_cycles, (atomic_val_t)(k_cycle_get_32() - read_start));
+        BENCH_END(BENCH_STAGE_READ, t_read);
+
+#ifndef CONFIG_CERELOG_SPI_ASYNC
+        publish_frame(slot);
+#endif
+
+        // Reconfigure between samples, right after a frame was read
+        const ads1299_profile_t *profile = ads1299_profile_take_request();
+        if (profile) {
+#ifdef CONFIG_CERELOG_SPI_ASYNC
+            // Let the frame in flight take its sample number before the marker is numbered
+            k_sem_take(&spi_idle_sem, K_FOREVER);
+            apply_profile(profile);
+            k_sem_give(&spi_idle_sem);
+#else
+            apply_profile(profile);
+#endif
+        }
+    }
+}
+
+/* Switches the chip to a profile while streaming and queues a marker
+   describing the gap. gap_us covers the SPI work; a data rate change also
+   restarts conversions, and the filter settling time before the next DRDY
+   shows up in the next sample's timestamp. */
+static void apply_profile(const ads1299_profile_t *profile) {
+    ads1299_marker_t marker = { .marker_type = MARKER_RECONFIG, .decimation = profile->decimation };
+    uint8_t image[ADS1299_NUM_REGS];
+
+    ADS1299_SHADOW_READ(image);
+    ads1299_profile_apply_to(profile, image);
+
+    marker.sample_number = get_sample_count() + 1;
+    marker.read_number = marker.sample_number;
+    uint64_t start = get_cycles64();
+    marker.result = ADS1299_RECONFIGURE(image, &ads1299_cfg);
+    marker.timestamp_ns = cycles_to_ns(start);
+    marker.gap_us = (uint32_t)((cycles_to_ns(get_cycles64()) - marker.timestamp_ns) / 1000);
+    ADS1299_SHADOW_READ(marker.registers);
+#ifdef CONFIG_CERELOG_CAPTURE
+    capture_set_data_rate(marker.registers[0x01]);
+#endif
+
+    if (k_msgq_put(&marker_msgq, &marker, K_NO_WAIT) != 0) {
+        atomic_inc(&marker_drops);
+    }
+}
+
+/* Queues one whole packet on the transport; only the transmission thread
+   writes packets, so they never interleave. A dropped packet shows up on
+   the host as a sample number gap and in the telemetry. */
+static void send_packet(const uint8_t *data, size_t length) {
+    TELEMETRY_START(t_uart);
+    int ret = transport_write(data, length);
+    TELEMETRY_END(TELEMETRY_STAGE_UART_TX, t_uart);
+#ifdef CONFIG_CERELOG_BENCH
+    bench_count_queued(data, length, ret);
+#else
+    ARG_UNUSED(ret);
+#endif
+}
+
+/* Finishes the batch, sends it and starts the next one */
+static void send_batch(batch_frame_t *frame) {
+    BENCH_START(t_packet);
+    TELEMETRY_START(t_format);
+    size_t tx_len = batch_frame_finish(frame);
+    BENCH_END(BENCH_STAGE_PACKET, t_packet);
+
+    if (tx_len > 0) {
+        TELEMETRY_END(TELEMETRY_STAGE_FORMAT, t_format);
+#ifdef CONFIG_CERELOG_BENCH
+        // The benchmark decodes every packet, then sends it over the modelled link
+        bench_count_packet(tx_buffer, tx_len);
+#endif
+#ifdef CONFIG_CERELOG_RETRANSMIT
+        // Kept before sending, so a packet the transport drops can be asked for too
+        retransmit_store(tx_buffer, tx_len);
+        resend_credit = MIN(resend_credit + 1, RESEND_CREDIT_MAX);
+#endif
+        send_packet(tx_buffer, tx_len);
+    }
+
+    batch_frame_begin(frame, tx_buffer, sizeof(tx_buffer));
+}
+
+#ifdef CONFIG_CERELOG_RETRANSMIT
+/* Sends one packet the host asked for again. Live data comes first: each
+   live packet, or a pause in the stream, earns one resend, and none go out
+   while the ring is backing up. */
+static void send_resend(void) {
+    const uint8_t *packet;
+
+    if (resend_credit == 0 || sample_ring_depth(&sample_ring) >= SAMPLE_RING_SIZE / 4) {
+        return;
+    }
+    size_t length = retransmit_next(&packet);
+    if (length > 0) {
+        resend_credit--;
+        send_packet(packet, length);
+    }
+}
+#endif
+
+#ifdef CONFIG_CERELOG_CAPTURE
+/* Sends the next packet of a finished capture when the transport could
+   take it and the largest live batch without waiting, so the capture
+   drains at the link capacity the live stream leaves and never holds it
+   up. Nothing goes out while the ring is backing up. */
+static void send_capture(void) {
+    const uint8_t *packet;
+
+    if (!capture_draining() || sample_ring_depth(&sample_ring) >= SAMPLE_RING_SIZE / 4 ||
+        transport_room() < CAPTURE_PACKET_SIZE(CAPTURE_PACKET_FRAMES) + BATCH_PACKET_MAX_SIZE(get_batch_size())) {
+        return;
+    }
+    size_t length = capture_next(&packet);
+    if (length > 0) {
+        send_packet(packet, length);
+    }
+}
+#endif
+
+static void send_marker(const ads1299_marker_t *marker) {
+    size_t tx_len = format_marker_for_transmission(marker, marker_buffer, sizeof(marker_buffer));
+
+#ifdef CONFIG_CERELOG_BENCH
+    bench_count_marker(marker);
+#endif
+    send_packet(marker_buffer, tx_len);
+}
+
+/* Sends a marker queued by apply_profile(). With decimation the filter
+   restarts here, so no output mixes samples from either side of the
+   change, and the marker is renumbered to the first output after it; a
+   ratio change follows as its own marker. */
+static void send_reconfig(ads1299_marker_t *marker) {
+#ifdef CONFIG_CERELOG_DECIMATE
+    int ratio = marker->decimation != PROFILE_KEEP ? marker->decimation : decimator_ratio(&decimator);
+    int ret = 0;
+
+    if (ratio == decimator_ratio(&decimator)) {
+        decimator_reset(&decimator);
+    } else {
+        // A ratio the decimator refuses is reported in the decimation marker's result
+        ret = decimator_configure(&decimator, ratio);
+        if (ret != 0) {
+            decimator_reset(&decimator);
+        }
+    }
+
+    marker->sample_number = decimator_next_number(&decimator);
+    numbering_pending = true;
+    send_marker(marker);
+
+    if (marker->decimation != PROFILE_KEEP) {
+        marker->marker_type = MARKER_DECIMATION;
+        marker->result = ret != 0 ? ret : ratio;
+        marker->gap_us = 0;
+        send_marker(marker);
+    }
+#else
+    send_marker(marker);
+#endif
+}
+
+#ifdef CONFIG_CERELOG_DECIMATE
+/* Ties the first output after a restart to the frame read that completed
+   it, so the host can place capture frames, which are counted as read, in
+   the decimated stream */
+static void send_numbering(const ads1299_sample_t *output, uint32_t read_number) {
+    ads1299_marker_t marker = {
+        .marker_type = MARKER_NUMBERING,
+        .result = (int16_t)decimator_ratio(&decimator),
+        .sample_number = output->sample_number,
+        .read_number = read_number,
+        .timestamp_ns = cycles_to_ns(output->drdy_cycles),
+    };
+
+    send_marker(&marker);
+    numbering_pending = false;
+}
+#endif
+
+#ifdef CONFIG_CERELOG_TELEMETRY
+static inline uint16_t clamp_u16(uint32_t value) {
+    return value > UINT16_MAX ? UINT16_MAX : (uint16_t)value;
+}
+
+/* Sends the stage statistics and pipeline counters for the interval since
+   the previous call */
+static void send_telemetry(void) {
+    static uint64_t last_ns;
+    static uint32_t last_edges, last_frames, last_overruns, last_spi_errors, last_crc_errors;
+    static uint32_t last_command_errors, last_marker_drops;
+    static transport_stats_t last_tx;
+#ifdef CONFIG_CERELOG_RETRANSMIT
+    static retransmit_stats_t last_resend;
+    retransmit_stats_t resend;
+    retransmit_get_stats(&resend);
+#endif
+#ifdef CONFIG_CERELOG_CAPTURE
+    static uint32_t last_capture_ignored;
+    capture_stats_t captured;
+    capture_get_stats(&captured);
+#endif
+
+    uint64_t now_ns = cycles_to_ns(get_cycles64());
+    uint32_t edges = (uint32_t)atomic_get(&drdy_edges);
+    uint32_t frames = (uint32_t)atomic_get(&frames_read);
+    uint32_t overruns = sample_ring_overruns(&sample_ring);
+    uint32_t errors = (uint32_t)atomic_get(&spi_errors);
+    uint32_t crc_errors = command_parser.crc_errors;
+    uint32_t failed_commands = (uint32_t)atomic_get(&command_errors);
+    uint32_t lost_markers = (uint32_t)atomic_get(&marker_drops);
+    transport_stats_t tx;
+    transport_get_stats(&tx);
+
+    telemetry_counters_t counters = {
+        .interval_us = (uint32_t)((now_ns - last_ns) / 1000),
+        .drdy_edges = edges - last_edges,
+        .samples = frames - last_frames,
+        .ring_overruns = overruns - last_overruns,
+        .tx_bytes = tx.bytes - last_tx.bytes,
+        .ring_high_water = clamp_u16(sample_ring_take_high_water(&sample_ring)),
+        .ring_size = clamp_u16(SAMPLE_RING_SIZE),
+        .spi_errors = clamp_u16(errors - last_spi_errors),
+        .command_crc_errors = clamp_u16(crc_errors - last_crc_errors),
+        .link_bytes_per_s = transport_link_bytes_per_s(),
+        .tx_busy_us = tx.busy_us - last_tx.busy_us,
+        .tx_stalls = clamp_u16(tx.stalls - last_tx.stalls),
+        .tx_drops = clamp_u16(tx.drops - last_tx.drops + tx.errors - last_tx.errors),
+#ifdef CONFIG_CERELOG_RETRANSMIT
+        .resend_requests = clamp_u16(resend.requests - last_resend.requests),
+        .resent_packets = clamp_u16(resend.resent - last_resend.resent),
+        .resend_missed = clamp_u16(resend.missed - last_resend.missed),
+        .resend_dropped = clamp_u16(resend.dropped - last_resend.dropped),
+#endif
+        .command_errors = clamp_u16(failed_commands - last_command_errors),
+        .marker_drops = clamp_u16(lost_markers - last_marker_drops),
+#ifdef CONFIG_CERELOG_CAPTURE
+        .capture_ignored = clamp_u16(captured.ignored - last_capture_ignored),
+#endif
+        // first_sample_ticks is written before frames_read first moves
+        .first_sample_us = frames ? (uint32_t)k_ticks_to_us_floor64(first_sample_ticks - power_up_ticks) : 0,
+    };
+    // A read in flight at either end can make frames outnumber edges by one
+    counters.missed_drdy = counters.drdy_edges > counters.samples ? counters.drdy_edges - counters.samples : 0;
+
+    last_ns = now_ns;
+    last_edges = edges;
+    last_frames = frames;
+    last_overruns = overruns;
+    last_spi_errors = errors;
+    last_crc_errors = crc_errors;
+    last_command_errors = failed_commands;
+    last_marker_drops = lost_markers;
+    last_tx = tx;
+#ifdef CONFIG_CERELOG_RETRANSMIT
+    last_resend = resend;
+#endif
+#ifdef CONFIG_CERELOG_CAPTURE
+    last_capture_ignored = captured.ignored;
+#endif
+
+    size_t tx_len = telemetry_format_packet(&counters, telemetry_buffer, sizeof(telemetry_buffer));
+#ifdef CONFIG_CERELOG_BENCH
+    bench_count_telemetry(telemetry_buffer, tx_len);
+#endif
+    send_packet(telemetry_buffer, tx_len);
+}
+#endif
+
+static void usb_transmission_thread(void *p1, void *p2, void *p3) {
+    ARG_UNUSED(p1);
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    const ads1299_sample_t *sample;
+    batch_frame_t *frame = &tx_frame;
+
+    printk("USB transmission thread started\n");
+
+    batch_frame_begin(frame, tx_buffer, sizeof(tx_buffer));
+#ifdef CONFIG_CERELOG_DECIMATE
+    decimator_init(&decimator);
+#endif
+#ifdef CONFIG_CERELOG_TELEMETRY
+    int64_t next_telemetry = k_uptime_get() + CONFIG_CERELOG_TELEMETRY_INTERVAL_MS;
+#endif
+
+    while (1) {
+        // Wait for new sample data; a partial batch goes out if the stream pauses
+        k_timeout_t wait = frame->count ? K_MSEC(CONFIG_CERELOG_BATCH_FLUSH_MS) : K_FOREVER;
+
+#ifdef CONFIG_CERELOG_TELEMETRY
+        // Telemetry goes out between packets, and keeps going while the stream is stopped
+        int64_t now = k_uptime_get();
+        if (now >= next_telemetry) {
+            send_telemetry();
+            next_telemetry += CONFIG_CERELOG_TELEMETRY_INTERVAL_MS;
+            if (next_telemetry <= now) {
+                next_telemetry = now + CONFIG_CERELOG_TELEMETRY_INTERVAL_MS;
+            }
+        }
+        if (!frame->count) {
+            wait = K_MSEC(next_telemetry - now);
+        }
+#endif
+
+#ifdef CONFIG_CERELOG_RETRANSMIT
+        // Resends left over keep the loop turning while the stream is stopped
+        send_resend();
+        if (!frame->count && retransmit_pending()) {
+            wait = K_MSEC(CONFIG_CERELOG_BATCH_FLUSH_MS);
+        }
+#endif
+
+#ifdef CONFIG_CERELOG_CAPTURE
+        // A capture drains between live packets, and on its own while the stream is stopped
+        send_capture();
+        if (!frame->count && capture_draining()) {
+            wait = K_MSEC(1);
+        }
+#endif
+
+        if (k_sem_take(&usb_ready_sem, wait) != 0) {
+            send_batch(frame);
+#ifdef CONFIG_CERELOG_RETRANSMIT
+            resend_credit = MAX(resend_credit, 1);
+#endif
+            continue;
+        }
+
+        // No sample: the command thread woke the loop for a resend
+        sample = sample_ring_peek(&sample_ring);
+        if (!sample) {
+#ifdef CONFIG_CERELOG_RETRANSMIT
+            resend_credit = MAX(resend_credit, 1);
+#endif
+            continue;
+        }
+
+        // A marker goes out between the samples before and after its event
+        ads1299_marker_t marker;
+        if (k_msgq_peek(&marker_msgq, &marker) == 0 &&
+            (int32_t)(sample->sample_number - marker.sample_number) >= 0) {
+            send_batch(frame);
+            k_msgq_get(&marker_msgq, &marker, K_NO_WAIT);
+            send_reconfig(&marker);
+        }
+
+#ifdef CONFIG_CERELOG_DECIMATE
+        // The input is taken in and its slot freed; only a completed output goes on to the batch
+        BENCH_START(t_decimate);
+        TELEMETRY_START(t_filter);
+        bool ready = decimator_push(&decimator, sample, &tx_decimated);
+        TELEMETRY_END(TELEMETRY_STAGE_DECIMATE, t_filter);
+        BENCH_END(BENCH_STAGE_DECIMATE, t_decimate);
+        uint32_t read_number = sample->sample_number;
+        sample_ring_release(&sample_ring);
+#ifdef CONFIG_CERELOG_BENCH
+        bench_count_sample();
+#endif
+        if (!ready) {
+            continue;
+        }
+        sample = &tx_decimated;
+        if (numbering_pending) {
+            // The marker goes out ahead of the output it names
+            send_batch(frame);
+            send_numbering(sample, read_number);
+        }
+#endif
+
+        // Stage into the current batch, starting a new one if the sample does not fit
+        BENCH_START(t_batch);
+        int ret = batch_frame_add(frame, sample);
+        BENCH_END(BENCH_STAGE_BATCH, t_batch);
+        if (ret != 0) {
+            send_batch(frame);
+            batch_frame_add(frame, sample);
+        }
+#ifndef CONFIG_CERELOG_DECIMATE
+        sample_ring_release(&sample_ring);
+
+#ifdef CONFIG_CERELOG_BENCH
+        bench_count_sample();
+#endif
+#endif
+
+        if (batch_frame_full(frame)) {
+            send_batch(frame);
+        }
+    }
+}
+
+#ifdef CONFIG_CERELOG_CAPTURE
+static inline uint32_t get_le32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int handle_capture(const command_t *cmd) {
+    if (cmd->length == 0) {
+        return -EINVAL;
+    }
+
+    switch (cmd->args[0]) {
+    case CAPTURE_ARM: {
+        if (cmd->length == 1) {
+            return capture_arm(NULL);
+        }
+        if (cmd->length != 1 + CAPTURE_ARM_SETTINGS_SIZE) {
+            return -EINVAL;
+        }
+        const uint8_t *arg = &cmd->args[1];
+        capture_settings_t settings = {
+            .pre_frames = get_le32(&arg[0]),
+            .post_frames = get_le32(&arg[4]),
+            .sources = arg[8],
+            .threshold = (int32_t)get_le32(&arg[9]),
+            .channels = get_le32(&arg[13]),
+        };
+        return capture_arm(&settings);
+    }
+    case CAPTURE_TRIGGER:
+        capture_trigger(CAPTURE_TRIGGER_COMMAND);
+        return 0;
+    case CAPTURE_STOP:
+        capture_stop(CAPTURE_TRIGGER_COMMAND);
+        return 0;
+    case CAPTURE_DISARM:
+        capture_disarm();
+        return 0;
+    default:
+        return -ENOTSUP;
+    }
+}
+#endif
+
+static void handle_command(const command_t *cmd) {
+    char name[COMMAND_MAX_PAYLOAD + 1];
+    int ret = -ENOTSUP;
+
+    switch (cmd->id) {
+    case CMD_SET_PROFILE:
+        memcpy(name, cmd->args, cmd->length);
+        name[cmd->length] = '\0';
+        ret = ads1299_profile_request(name);
+        break;
+    case CMD_SET_BATCH_SIZE:
+        ret = cmd->length == 1 ? set_batch_size(cmd->args[0]) : -EINVAL;
+        break;
+    case CMD_SET_COMPRESSION:
+        if (cmd->length == 1) {
+            set_batch_compression(cmd->args[0] != 0);
+            ret = 0;
+        }
+        break;
+#ifdef CONFIG_CERELOG_RETRANSMIT
+    case CMD_RESEND:
+        if (cmd->length == 0 || cmd->length % RESEND_RANGE_SIZE != 0) {
+            ret = -EINVAL;
+            break;
+        }
+        // A full queue drops ranges, and the host asks again
+        ret = 0;
+        for (size_t i = 0; i < cmd->length; i += RESEND_RANGE_SIZE) {
+            const uint8_t *range = &cmd->args[i];
+            uint32_t first = range[0] | (range[1] << 8) | (range[2] << 16) | ((uint32_t)range[3] << 24);
+            uint16_t count = range[4] | (range[5] << 8);
+            if (retransmit_request(first, count) != 0) {
+                ret = -ENOBUFS;
+            }
+        }
+        k_sem_give(&usb_ready_sem);
+        break;
+#endif
+#ifdef CONFIG_CERELOG_CAPTURE
+    case CMD_CAPTURE:
+        ret = handle_capture(cmd);
+        break;
+#endif
+    default:
+        break;
+    }
+
+    // Counted rather than printed: the console shares the UART with the data link
+    if (ret != 0) {
+        atomic_inc(&command_errors);
+    }
+}
+
+/* Polls the UART for host commands. Commands are rare, so a few ms of
+   latency is fine and the console keeps its polled driver. */
+static void command_thread(void *p1, void *p2, void *p3) {
+    ARG_UNUSED(p1);
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    command_t cmd;
+    unsigned char byte;
+
+    while (1) {
+        while (uart_poll_in(uart_dev, &byte) == 0) {
+            if (command_parser_feed(&command_parser, byte, &cmd)) {
+                handle_command(&cmd);
+            }
+        }
+        k_msleep(CONFIG_CERELOG_COMMAND_POLL_MS);
+    }
+}
+
+int main(void) {
+    int ret;
+#if CONFIG_CERELOG_BOOT_DELAY_MS > 0
+    k_msleep(CONFIG_CERELOG_BOOT_DELAY_MS);
+#endif
+    printk("Basic Test Starting...\n");
+
+    // Get device handles
+    uart_dev = DEVICE_DT_GET(DT_NODELABEL(uart0));
+    if (!device_is_ready(uart_dev)) {
+        printk("UART device not ready\n");
+        return -1;
+    }
+    ret = transport_init();
+    if (ret != 0) {
+        printk("Transport not ready: %d\n", ret);
+        return ret;
+    }
+
+    const struct device *gpio_dev = DEVICE_DT_GET(DT_NODELABEL(gpio0));
+    if (!device_is_ready(gpio_dev)) {
+        printk("GPIO device not ready\n");
+        return -1;
+    }
+
+    // Configure all GPIO pins
+    ret = gpio_pin_configure(gpio_dev, ADS1299_PWDN_PIN, GPIO_OUTPUT_INACTIVE);
+    if (ret != 0) {
+        printk("Failed to configure PWDN pin: %d\n", ret);
+        return ret;
+    }
+
+    ret = gpio_pin_configure(gpio_dev, ADS1299_RST_PIN, GPIO_OUTPUT_INACTIVE);
+    if (ret != 0) {
+        printk("Failed to configure RST pin: %d\n", ret);
+        return ret;
+    }
+
+    ret = gpio_pin_configure(gpio_dev, ADS1299_START_PIN, GPIO_OUTPUT_INACTIVE);
+    if (ret != 0) {
+        printk("Failed to configure START pin: %d\n", ret);
+        return ret;
+    }
+
+    ret = gpio_pin_configure(gpio_dev, ADS1299_DRDY_PIN, GPIO_INPUT);
+    if (ret != 0) {
+        printk("Failed to configure DRDY pin: %d\n", ret);
+        return ret;
+    }
+
+    printk("All GPIO pins configured successfully\n");
+
+    //const struct gpio_dt_spec cs_gpio = GPIO_DT_SPEC_GET_BY_IDX(DT_NODELABEL(spi3), cs_gpios, 0);
+
+    const struct gpio_dt_spec cs_gpio = {
+    .port = DEVICE_DT_GET(DT_NODELABEL(gpio0)),
+    .pin = 5,
+    .dt_flags = GPIO_ACTIVE_LOW
+};
+    printk("Got CS_GPIO no prob\n");
+    ads1299_spi_cfg = (struct spi_config) {
+        .frequency = 4000000,
+        .operation = SPI_WORD_SET(8) | SPI_TRANSFER_MSB | SPI_MODE_CPHA | SPI_OP_MODE_MASTER,
+        //.slave = 0,
+        .cs = {
+            .gpio = cs_gpio,
+            .delay = 1
+        }
+    };
+    const struct device *spi_zephyr_dev = DEVICE_DT_GET(DT_NODELABEL(spi3));
+    printk("Got the SPI ZEPHYR DEVICE no prob");
+    if (!device_is_ready(spi_zephyr_dev)) {
+        printk("SPI device not ready\n");
+        return -1;
+    }
+
+/*     // With this:
+    struct ads1299_config ads1299_config = {
+        .zephyr_spi_dev = spi_zephyr_dev,  // Note: no & needed since spi_zephyr_dev is already a pointer
+        .spi_cfg = &ads1299_spi_cfg
+    }; */
+
+    ads1299_cfg = (struct ads1299_config) {
+        .zephyr_spi_dev = spi_zephyr_dev,
+        .spi_cfg = &ads1299_spi_cfg
+    };
+
+    printk("SPI device ready\n");
+    ret = ADS1299_INIT(&ads1299_cfg);
+    printk("ADS1299 Driver Init done");
+
+    init_data_handler();
+    sample_ring_init(&sample_ring);
+    command_parser_init(&command_parser);
+#ifdef CONFIG_CERELOG_TELEMETRY
+    telemetry_init();
+#endif
+#ifdef CONFIG_CERELOG_CAPTURE
+    capture_init();
+    capture_report();
+#endif
+#ifdef CONFIG_CERELOG_DECIMATE_CHECK
+    // Before acquisition starts, so the timings are not disturbed
+    decimate_check();
+#endif
+
+    // Initialize ADS1299
+    ret = ads1299_init_device(gpio_dev, &ads1299_cfg);
+    if (ret != 0) {
+        printk("Failed to initialize ADS1299: %d\n", ret);
+        return ret;
+    }
+
+    // Setup DRDY interrupt
+    gpio_init_callback(&drdy_cb_data, drdy_interrupt_handler, BIT(ADS1299_DRDY_PIN));
+    ret = gpio_add_callback(gpio_dev, &drdy_cb_data);
+    if (ret != 0) {
+        printk("Failed to add GPIO callback: %d\n", ret);
+        return ret;
+    }
+
+    ret = gpio_pin_interrupt_configure(gpio_dev, ADS1299_DRDY_PIN, GPIO_INT_EDGE_FALLING);
+    if (ret != 0) {
+        printk("Failed to configure GPIO interrupt: %d\n", ret);
+        return ret;
+    }
+
+#ifdef CAPTURE_TRIGGER_PIN
+    ret = gpio_pin_configure(gpio_dev, CAPTURE_TRIGGER_PIN, GPIO_INPUT);
+    if (ret == 0) {
+        gpio_init_callback(&capture_cb_data, capture_pin_handler, BIT(CAPTURE_TRIGGER_PIN));
+        ret = gpio_add_callback(gpio_dev, &capture_cb_data);
+    }
+    if (ret == 0) {
+        ret = gpio_pin_interrupt_configure(gpio_dev, CAPTURE_TRIGGER_PIN, GPIO_INT_EDGE_BOTH);
+    }
+    if (ret != 0) {
+        // Captures can still be triggered by the host and the threshold
+        printk("Capture trigger pin not available: %d\n", ret);
+    }
+#endif
+
+    printk("Interrupt configured\n");
+
+    acquisition_active = true;
+    k_thread_start(cmd_thread);
+
+    printk("System initialized successfully. Starting data acquisition...\n");
+
+#ifdef CONFIG_CERELOG_BENCH
+    bench_run(&sample_ring);
+#endif
+
+    /* Main loop - report pipeline health once a second, unless telemetry
+       packets do. The console shares uart0 with the data link, and a line
+       printed while a packet is going out lands inside it, so resends,
+       failed commands and capture triggers are counted rather than
+       printed: with telemetry the counters travel in its packets, without
+       it they ride on the fixed stats line. */
+#ifndef CONFIG_CERELOG_TELEMETRY
+    uint32_t last_frames = 0;
+    uint32_t last_cycles = 0;
+    transport_stats_t last_tx = {0};
+    bool first_sample_reported = false;
+#endif
+    while (1) {
+        k_msleep(1000);
+
+        // Keeps a software-extended cycle counter from missing a wrap while DRDY is quiet
+        (void)get_cycles64();
+
+#ifndef CONFIG_CERELOG_TELEMETRY
+        if (!first_sample_reported && atomic_get(&frames_read) != 0) {
+            printk("First sample %u us after boot, %u us after ADS1299 power-up\n",
+                   (uint32_t)k_ticks_to_us_floor64(first_sample_ticks),
+                   (uint32_t)k_ticks_to_us_floor64(first_sample_ticks - power_up_ticks));
+            first_sample_reported = true;
+        }
+
+        uint32_t edges = (uint32_t)atomic_get(&drdy_edges);
+        uint32_t frames = (uint32_t)atomic_get(&frames_read);
+        uint32_t cycles = (uint32_t)atomic_get(&read_cycles);
+        uint32_t sps = frames - last_frames;
+        transport_stats_t tx;
+        transport_get_stats(&tx);
+        uint32_t link = transport_link_bytes_per_s();
+
+        /* Thread time per read: the whole transfer when blocking, only the
+           submission when asynchronous. The difference is the CPU saved.
+           Link use is bytes sent against what the baud rate allows. */
+        printk("Stats: %u SPS x %u ch, ring depth %u (max %u), overruns %u, missed DRDY %u, "
+               "SPI errors %u, read %u ns/sample, link %u B/s (%u%%), %u TX stalls, %u TX drops",
+               sps, ADS1299_NUM_CHANNELS, sample_ring_depth(&sample_ring),
+               sample_ring_take_high_water(&sample_ring), sample_ring_overruns(&sample_ring),
+               edges - frames, (uint32_t)atomic_get(&spi_errors),
+               sps ? (uint32_t)(k_cyc_to_ns_floor64(cycles - last_cycles) / sps) : 0,
+               tx.bytes - last_tx.bytes, link ? (uint32_t)((uint64_t)(tx.bytes - last_tx.bytes) * 100 / link) : 0,
+               tx.stalls - last_tx.stalls, tx.drops - last_tx.drops);
+#ifdef CONFIG_CERELOG_RETRANSMIT
+        retransmit_stats_t resend;
+        retransmit_get_stats(&resend);
+        printk(", resend %u asked/%u sent/%u gone/%u dropped",
+               resend.requests, resend.resent, resend.missed, resend.dropped);
+#endif
+#ifdef CONFIG_CERELOG_CAPTURE
+        capture_stats_t captured;
+        capture_get_stats(&captured);
+        printk(", %u captures, %u capture packets, %u triggers ignored",
+               captured.captures, captured.packets, captured.ignored);
+#endif
+        printk(", %u command errors, %u markers dropped\n",
+               (uint32_t)atomic_get(&command_errors), (uint32_t)atomic_get(&marker_drops));
+        last_frames = frames;
+        last_cycles = cycles;
+        last_tx = tx;
+#endif
+
+    }
+
+    return 0;
 }
\ No newline at end of file
@@ -0,0 +1,60 @@
+#ifndef PACKET_CRC_H
+#define PACKET_CRC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* CRC-16-CCITT as used on the wire: polynomial 0x1021, MSB first,
+   initial value 0xFFFF, no final XOR. Plain C with no Zephyr dependencies
+   so the host tools build the same file.
+
+   packet_crc_update() runs the implementation picked at build time:
+   slice-by-8 (default), slice-by-4, the byte-at-a-time table, or the ESP32
+   ROM routine. All of them give identical results; the explicit variants
+   below are always built so they can be checked against each other.
+
+   A CRC can be built up in pieces:
+       uint16_t crc = packet_crc_init();
+       crc = packet_crc_update(crc, header, header_len);
+       crc = packet_crc_update(crc, body, body_len);
+       crc = packet_crc_final(crc);
+   and two pieces computed separately can be joined with
+   packet_crc_combine(). */
+
+#define PACKET_CRC_INIT     0xFFFF
+#define PACKET_CRC_POLY     0x1021
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline uint16_t packet_crc_init(void) {
+    return PACKET_CRC_INIT;
+}
+
+// No final XOR for this variant; kept so callers read the same for any CRC
+static inline uint16_t packet_crc_final(uint16_t crc) {
+    return crc;
+}
+
+uint16_t packet_crc_update(uint16_t crc, const uint8_t *data, size_t length);
+
+// packet_crc_final(packet_crc_update(packet_crc_init(), data, length))
+uint16_t packet_crc_compute(const uint8_t *data, size_t length);
+
+/* Joins two pieces: crc_a is the running CRC after the first piece, crc_b
+   the CRC of the second piece started from 0 instead of PACKET_CRC_INIT, and
+   length_b its length. Returns the running CRC after both. Takes
+   O(log length_b) steps, so a header can be prepended to a body that was
+   checksummed earlier without reading the body again. */
+uint16_t packet_crc_combine(uint16_t crc_a, uint16_t crc_b, size_t length_b);
+
+uint16_t packet_crc_update_bytewise(uint16_t crc, const uint8_t *data, size_t length);
+uint16_t packet_crc_update_slice4(uint16_t crc, const uint8_t *data, size_t length);
+uint16_t packet_crc_update_slice8(uint16_t crc, const uint8_t *data, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PACKET_CRC_H
\ No newline at end of file
@@ -0,0 +1,209 @@
+#ifndef PACKET_FORMAT_H
+#define PACKET_FORMAT_H
+
+#include <stdint.h>
+#include "eeg_codec.h"
+#include "telemetry_format.h"
+
+/* Wire format of the packets the firmware sends. Plain C with no Zephyr
+   dependencies so the host decoder builds against the same definitions.
+   Multi-byte header fields are little-endian; channel data keeps the
+   ADS1299's big-endian 24-bit words. */
+
+/* Daisy-chained ADS1299s share CS, SCLK and DRDY. One RDATAC read clocks
+   every chip's frame out back to back, the chip on MISO first, so a
+   sample holds 8 channels per chip. The firmware is built for
+   CONFIG_CERELOG_ADS1299_CHAIN chips; the host reads the chain length
+   from each packet and builds for one. */
+#ifdef CONFIG_CERELOG_ADS1299_CHAIN
+#define ADS1299_CHAIN_LENGTH    CONFIG_CERELOG_ADS1299_CHAIN
+#else
+#define ADS1299_CHAIN_LENGTH    1
+#endif
+#define ADS1299_MAX_CHAIN       4
+
+// ADS1299 data constants
+#define ADS1299_CHIP_CHANNELS   8
+#define ADS1299_NUM_CHANNELS    (ADS1299_CHIP_CHANNELS * ADS1299_CHAIN_LENGTH)
+#define ADS1299_BYTES_PER_CHANNEL   3  // 24-bit data
+#define ADS1299_STATUS_BYTES    3      // 24-bit status
+#define ADS1299_STATUS_SYNC_MASK    0xF00000    // Top nibble of every status word reads 1100
+#define ADS1299_STATUS_SYNC     0xC00000
+#define ADS1299_CHIP_DATA_BYTES (ADS1299_STATUS_BYTES + (ADS1299_CHIP_CHANNELS * ADS1299_BYTES_PER_CHANNEL))
+#define ADS1299_TOTAL_DATA_BYTES    (ADS1299_CHIP_DATA_BYTES * ADS1299_CHAIN_LENGTH)
+
+// Packet format constants
+#define PACKET_HEADER_SIZE      4
+#define PACKET_TIMESTAMP_SIZE   8
+#define PACKET_CRC_SIZE         2
+#define PACKET_TRAILER_SIZE     2
+#define PACKET_OVERHEAD         (PACKET_HEADER_SIZE + PACKET_TIMESTAMP_SIZE + PACKET_CRC_SIZE + PACKET_TRAILER_SIZE)
+
+// Packet identifiers
+#define PACKET_START_BYTE1      0xAA
+#define PACKET_START_BYTE2      0x55
+#define PACKET_TYPE_ADS1299     0x01
+#define PACKET_TYPE_ADS1299_BATCH   0x02
+#define PACKET_TYPE_MARKER      0x03
+#define PACKET_TYPE_TELEMETRY   TELEMETRY_PACKET_TYPE   // 0x04, see telemetry_format.h
+#define PACKET_FLAG_COMPRESSED  0x80    // Or'd into the type: channel data is eeg_codec coded
+#define PACKET_CHAIN_MASK       0x30    // Batch type bits 4-5: chips in the chain minus one
+#define PACKET_CHAIN_SHIFT      4
+#define PACKET_CHAIN_BITS(chips)    ((uint8_t)(((chips) - 1) << PACKET_CHAIN_SHIFT))
+#define PACKET_CHAIN_CHIPS(type)    ((((type) & PACKET_CHAIN_MASK) >> PACKET_CHAIN_SHIFT) + 1)
+#define PACKET_END_BYTE1        0x55
+#define PACKET_END_BYTE2        0xAA
+
+// Batched packet: N samples share one header, status words and CRC, channels stay packed 24-bit
+#define BATCH_CHAIN_STATUS_BYTES(chips)     (((chips) - 1) * ADS1299_STATUS_BYTES)
+#define BATCH_CHAIN_CHANNEL_BYTES(chips)    ((chips) * ADS1299_CHIP_CHANNELS * ADS1299_BYTES_PER_CHANNEL)
+#define BATCH_CHAIN_PACKET_SIZE(n, chips)   (sizeof(ads1299_batch_header_t) + BATCH_CHAIN_STATUS_BYTES(chips) + \
+                                             (n) * BATCH_CHAIN_CHANNEL_BYTES(chips) + \
+                                             PACKET_CRC_SIZE + PACKET_TRAILER_SIZE)
+
+// Compressed batch: a 16-bit data length follows the header and chain status words
+#define BATCH_LENGTH_SIZE       2
+#define BATCH_CHAIN_COMPRESSED_PACKET_SIZE(data_len, chips) \
+    (sizeof(ads1299_batch_header_t) + BATCH_CHAIN_STATUS_BYTES(chips) + BATCH_LENGTH_SIZE + \
+     (data_len) + PACKET_CRC_SIZE + PACKET_TRAILER_SIZE)
+
+// The same for this build's chain
+#define BATCH_STATUS_BYTES      BATCH_CHAIN_STATUS_BYTES(ADS1299_CHAIN_LENGTH)
+#define BATCH_CHANNEL_BYTES     BATCH_CHAIN_CHANNEL_BYTES(ADS1299_CHAIN_LENGTH)
+#define BATCH_PACKET_SIZE(n)    BATCH_CHAIN_PACKET_SIZE(n, ADS1299_CHAIN_LENGTH)
+#define BATCH_COMPRESSED_PACKET_SIZE(data_len)  BATCH_CHAIN_COMPRESSED_PACKET_SIZE(data_len, ADS1299_CHAIN_LENGTH)
+// Largest packet of either kind, for sizing transmission buffers
+#define BATCH_PACKET_MAX_SIZE(n) \
+    BATCH_COMPRESSED_PACKET_SIZE(EEG_CODEC_MAX_BYTES(n, ADS1299_NUM_CHANNELS))
+
+// Marker types
+#define MARKER_RECONFIG         0x01    // Registers changed, acquisition paused for gap_us
+#define MARKER_DECIMATION       0x02    // On-device decimation changed; result is the new ratio or a negative errno
+/* The decimator restarted and sample_number is its first output. That
+   output was completed by the frame read_number, and each later output by
+   result (the ratio) frames more, until the next one of these. Precedes a
+   decimated build's first output and follows every restart. */
+#define MARKER_NUMBERING        0x03
+
+#define PACKET_REGISTER_BYTES   24      // ADS1299 register map, ID through CONFIG4
+
+// Data structures
+typedef struct {
+    uint64_t drdy_cycles;       // Hardware cycle count latched in the DRDY interrupt
+    uint32_t sample_number;     // Incremental sample counter
+    uint32_t status;            // 24-bit status register, of the first chip in a chain
+    int32_t channels[ADS1299_NUM_CHANNELS]; // Channel data (sign-extended from 24-bit), chip by chip
+#if ADS1299_CHAIN_LENGTH > 1
+    uint32_t chain_status[ADS1299_CHAIN_LENGTH - 1]; // Status registers of the second chip on
+#endif
+    uint8_t lead_off_status_p;  // Lead-off status positive
+    uint8_t lead_off_status_n;  // Lead-off status negative
+    uint8_t gpio_status;        // GPIO status
+} ads1299_sample_t;
+
+typedef struct {
+    uint8_t start_bytes[2];     // 0xAA, 0x55
+    uint8_t packet_type;        // 0x01 for ADS1299
+    uint8_t payload_length;     // Length of payload
+    uint64_t timestamp_us;      // 8-byte timestamp
+    ads1299_sample_t sample;    // ADS1299 sample data
+    uint16_t crc16;             // CRC-16 checksum
+    uint8_t end_bytes[2];       // 0x55, 0xAA
+} __attribute__((packed)) ads1299_packet_t;
+
+/* Batched packet layout:
+   header | sample_count * BATCH_CHANNEL_BYTES channel data | crc16 | 0x55 0xAA
+   Channel data is the chip's own big-endian 24-bit words, CH1 first.
+   Samples in one packet have consecutive sample numbers and the same status;
+   the CRC covers everything before it.
+   With PACKET_FLAG_COMPRESSED set in the type, the channel data is replaced by
+   a little-endian uint16 length and that many bytes of eeg_codec output.
+   A daisy chain sets PACKET_CHAIN_BITS(chips) in the type. The header
+   status is the first chip's, the other chips' status words follow it
+   (BATCH_CHAIN_STATUS_BYTES), and each sample carries 8 channels per chip
+   in chain order. Single-chip packets are unchanged. */
+typedef struct {
+    uint8_t start_bytes[2];     // 0xAA, 0x55
+    uint8_t packet_type;        // 0x02 for batched ADS1299 samples
+    uint8_t sample_count;       // Samples in this packet
+    uint64_t timestamp_ns;      // DRDY edge of the first sample, ns since boot
+    uint32_t sample_number;     // Sample number of the first sample
+    uint8_t status[ADS1299_STATUS_BYTES]; // Status word shared by every sample
+} __attribute__((packed)) ads1299_batch_header_t;
+
+// Marker packet: an ads1299_marker_t event between CRC-checked framing
+typedef struct {
+    uint8_t start_bytes[2];     // 0xAA, 0x55
+    uint8_t packet_type;        // 0x03 for markers
+    uint8_t marker_type;
+    int16_t result;
+    uint32_t sample_number;
+    uint32_t read_number;       // The same point counted in frames read from the chip, as capture packets count
+    uint64_t timestamp_ns;
+    uint32_t gap_us;
+    uint8_t registers[PACKET_REGISTER_BYTES];
+    uint16_t crc16;             // CRC-16 over everything before it
+    uint8_t end_bytes[2];       // 0x55, 0xAA
+} __attribute__((packed)) ads1299_marker_packet_t;
+
+/* Burst capture packet (capture.c): raw RDATAC frames recorded on the
+   device around a trigger, drained after the capture ends.
+   header | frame_count * ADS1299_CHIP_DATA_BYTES * chips frames | crc16 | 0x55 0xAA
+   Frames are as read from the chip, status word and big-endian channels,
+   chip by chip along a chain, which sets PACKET_CHAIN_BITS(chips) in the
+   type. Every packet repeats the capture's description, so any one of
+   them places its frames: frame i of the capture is frame first_read + i
+   read from the chip, and lies (i - trigger_frame) sample periods from
+   trigger_ns unless missed_drdy says DRDY edges went unread.
+   Frames are counted as read, before any on-device decimation, so this is
+   the live stream's sample numbering only when the build does not
+   decimate. When it does, MARKER_NUMBERING markers tie the two together. */
+#define PACKET_TYPE_CAPTURE     0x05
+// Frames per capture packet, about 0.9 KB whatever the chain, so one and a batch fit a transmit buffer
+#define CAPTURE_PACKET_FRAMES   (32 / ADS1299_CHAIN_LENGTH)
+#define CAPTURE_CHAIN_PACKET_SIZE(n, chips) \
+    (sizeof(capture_header_t) + (n) * (chips) * ADS1299_CHIP_DATA_BYTES + PACKET_CRC_SIZE + PACKET_TRAILER_SIZE)
+#define CAPTURE_PACKET_SIZE(n)  CAPTURE_CHAIN_PACKET_SIZE(n, ADS1299_CHAIN_LENGTH)
+
+// What started a capture
+#define CAPTURE_TRIGGER_COMMAND     0x01    // CMD_CAPTURE from the host
+#define CAPTURE_TRIGGER_GPIO        0x02    // Rising edge on the trigger pin
+#define CAPTURE_TRIGGER_THRESHOLD   0x04    // A channel's code reached the threshold
+
+// Samples per second for the CONFIG1 data rate bits, 16 kSPS at 0 down to 250 SPS at 6
+#define CAPTURE_SAMPLE_RATE(dr)     (16000u >> (dr))
+
+typedef struct {
+    uint8_t start_bytes[2];     // 0xAA, 0x55
+    uint8_t packet_type;        // 0x05 for capture frames
+    uint8_t frame_count;        // Frames in this packet
+    uint16_t capture_id;        // Counts captures since boot, from 1
+    uint8_t trigger_source;     // CAPTURE_TRIGGER_* that started it
+    uint8_t data_rate;          // CONFIG1 data rate bits at the trigger
+    uint32_t frame_index;       // Position in the capture of this packet's first frame
+    uint32_t total_frames;      // Frames in the whole capture
+    uint32_t trigger_frame;     // Position of the frame the trigger landed on
+    uint32_t first_read;        // Read number of frame 0: frames read from the chip since boot, from 1
+    uint32_t missed_drdy;       // DRDY edges from its first frame to its last with no frame read
+    uint64_t trigger_ns;        // DRDY edge of the trigger frame, ns since boot
+} __attribute__((packed)) capture_header_t;
+
+/* UDP transport: each datagram is this header followed by whole packets,
+   byte for byte as they would go over the UART. Packets never straddle
+   datagrams, so a lost datagram costs whole packets and the rest still
+   decode. Sequence numbers count datagrams from 0 at boot; a gap is a
+   datagram lost in the network, while packets the device could not
+   queue show up as sample number gaps only. */
+#define DATAGRAM_MAGIC1         0xCE
+#define DATAGRAM_MAGIC2         0x10
+#define DATAGRAM_VERSION        1
+
+typedef struct {
+    uint8_t magic[2];           // 0xCE, 0x10
+    uint8_t version;            // DATAGRAM_VERSION
+    uint8_t packet_count;       // Whole packets in the payload
+    uint32_t sequence;
+    uint64_t sent_ns;           // When it was handed to the stack, same clock as the batch timestamps
+} __attribute__((packed)) datagram_header_t;
+
+#endif // PACKET_FORMAT_H
\ No newline at end of file
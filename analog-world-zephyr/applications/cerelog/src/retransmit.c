@@ -0,0 +1,151 @@
+#include "retransmit.h"
+#include "packet_format.h"
+#include <zephyr/kernel.h>
+#include <string.h>
+
+#define RETRANSMIT_BUFFER_SIZE  CONFIG_CERELOG_RETRANSMIT_BUFFER_SIZE
+#define RETRANSMIT_PACKETS      CONFIG_CERELOG_RETRANSMIT_PACKETS
+
+// One stored packet and the samples it carries
+typedef struct {
+    uint32_t first;             // Sample number of its first sample
+    uint16_t count;
+    uint16_t length;            // Packet bytes
+    uint32_t offset;            // Where in retransmit_buffer
+} retransmit_entry_t;
+
+// A range asked for by the host
+typedef struct {
+    uint32_t first;
+    uint32_t count;
+} retransmit_range_t;
+
+/* Packets are stored whole and contiguous: one that does not fit before
+   the end of the buffer starts again at 0. The index is a FIFO of entries
+   in the order sent, which is also sample number order. */
+static uint8_t retransmit_buffer[RETRANSMIT_BUFFER_SIZE];
+static retransmit_entry_t entries[RETRANSMIT_PACKETS];
+static uint32_t entry_head;         // Oldest entry
+static uint32_t entry_count;
+static uint32_t write_offset;       // Where the next packet goes if it fits
+
+// Range being resent, owned by the transmission thread
+static retransmit_range_t current;
+
+static atomic_t stat_requests;
+static atomic_t stat_dropped;
+static uint32_t stat_resent;
+static uint32_t stat_missed;
+
+K_MSGQ_DEFINE(retransmit_msgq, sizeof(retransmit_range_t), CONFIG_CERELOG_RETRANSMIT_REQUESTS, 4);
+
+static inline retransmit_entry_t *entry_at(uint32_t i) {
+    return &entries[(entry_head + i) % RETRANSMIT_PACKETS];
+}
+
+static void evict_oldest(void) {
+    entry_head = (entry_head + 1) % RETRANSMIT_PACKETS;
+    entry_count--;
+}
+
+/* Keeps a copy of a batch packet just sent. Anything else, or a packet
+   larger than the window, is not kept. */
+void retransmit_store(const uint8_t *packet, size_t length) {
+    ads1299_batch_header_t header;
+
+    if (length < sizeof(header) || length > RETRANSMIT_BUFFER_SIZE) {
+        return;
+    }
+    memcpy(&header, packet, sizeof(header));
+    if ((header.packet_type & ~(PACKET_FLAG_COMPRESSED | PACKET_CHAIN_MASK)) != PACKET_TYPE_ADS1299_BATCH ||
+        header.sample_count == 0) {
+        return;
+    }
+
+    uint32_t offset = write_offset;
+    if (offset + length > RETRANSMIT_BUFFER_SIZE) {
+        // Wrapping: what lies past the write offset is the oldest, and goes first
+        while (entry_count && entry_at(0)->offset >= write_offset) {
+            evict_oldest();
+        }
+        offset = 0;
+    }
+    while (entry_count &&
+           (entry_count == RETRANSMIT_PACKETS ||
+            (entry_at(0)->offset < offset + length &&
+             entry_at(0)->offset + entry_at(0)->length > offset))) {
+        evict_oldest();
+    }
+
+    memcpy(&retransmit_buffer[offset], packet, length);
+    retransmit_entry_t *entry = entry_at(entry_count++);
+    entry->first = header.sample_number;
+    entry->count = header.sample_count;
+    entry->length = (uint16_t)length;
+    entry->offset = offset;
+    write_offset = offset + length;
+}
+
+/* Queues a range for resending; called from the command thread. */
+int retransmit_request(uint32_t first, uint16_t count) {
+    retransmit_range_t range = {.first = first, .count = count};
+
+    if (count == 0) {
+        return -EINVAL;
+    }
+    if (k_msgq_put(&retransmit_msgq, &range, K_NO_WAIT) != 0) {
+        atomic_inc(&stat_dropped);
+        return -ENOBUFS;
+    }
+    atomic_inc(&stat_requests);
+    return 0;
+}
+
+bool retransmit_pending(void) {
+    return current.count != 0 || k_msgq_num_used_get(&retransmit_msgq) != 0;
+}
+
+/* Finds the next stored packet for the ranges asked for. Returns its
+   length and points packet at it, or returns 0 when nothing is left to
+   resend. The pointer stays valid until the next retransmit_store(). */
+size_t retransmit_next(const uint8_t **packet) {
+    while (1) {
+        if (current.count == 0 && k_msgq_get(&retransmit_msgq, &current, K_NO_WAIT) != 0) {
+            return 0;
+        }
+
+        // Oldest packet reaching past the start of the range
+        uint32_t i = 0;
+        while (i < entry_count && (int32_t)(entry_at(i)->first + entry_at(i)->count - current.first) <= 0) {
+            i++;
+        }
+
+        int32_t before = i < entry_count ? (int32_t)(entry_at(i)->first - current.first) : INT32_MAX;
+        if (before >= (int32_t)current.count) {
+            // Gone, or never sent: ring overruns leave gaps no resend can fill
+            stat_missed += current.count;
+            current.count = 0;
+            continue;
+        }
+
+        retransmit_entry_t *entry = entry_at(i);
+        uint32_t end = entry->first + entry->count;
+        if (before > 0) {
+            stat_missed += (uint32_t)before;
+        }
+        uint32_t covered = end - current.first;
+        current.count = covered >= current.count ? 0 : current.count - covered;
+        current.first = end;
+
+        stat_resent++;
+        *packet = &retransmit_buffer[entry->offset];
+        return entry->length;
+    }
+}
+
+void retransmit_get_stats(retransmit_stats_t *stats) {
+    stats->requests = (uint32_t)atomic_get(&stat_requests);
+    stats->dropped = (uint32_t)atomic_get(&stat_dropped);
+    stats->resent = stat_resent;
+    stats->missed = stat_missed;
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#ifndef RETRANSMIT_H
+#define RETRANSMIT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Retransmit window (CONFIG_CERELOG_RETRANSMIT). Every batch packet sent
+   is kept, as sent, in a byte ring of CONFIG_CERELOG_RETRANSMIT_BUFFER_SIZE;
+   the oldest are overwritten as new ones come in. When the host finds a
+   sample number gap it sends CMD_RESEND with the missing ranges, and the
+   transmission thread sends the packets still held that cover them again,
+   between live packets.
+   The transmission thread stores and resends, the command thread only
+   queues requests, so the ring itself takes no lock. */
+
+typedef struct {
+    uint32_t requests;          // Ranges asked for
+    uint32_t resent;            // Packets sent again
+    uint32_t missed;            // Samples asked for that had already left the window
+    uint32_t dropped;           // Ranges dropped because the request queue was full
+} retransmit_stats_t;
+
+// Function declarations
+void retransmit_store(const uint8_t *packet, size_t length);
+int retransmit_request(uint32_t first, uint16_t count);
+bool retransmit_pending(void);
+size_t retransmit_next(const uint8_t **packet);
+void retransmit_get_stats(retransmit_stats_t *stats);
+
+#endif // RETRANSMIT_H
\ No newline at end of file
@@ -0,0 +1,74 @@
+#include "sample_ring.h"
+
+void sample_ring_init(sample_ring_t *ring) {
+    atomic_set(&ring->head, 0);
+    atomic_set(&ring->tail, 0);
+    atomic_set(&ring->overruns, 0);
+    atomic_set(&ring->high_water, 0);
+}
+
+/* Returns the next free slot, or NULL when the consumer has fallen a full
+   ring behind. The slot only becomes visible after sample_ring_commit(). */
+ads1299_sample_t *sample_ring_reserve(sample_ring_t *ring) {
+    uint32_t head = (uint32_t)atomic_get(&ring->head);
+    uint32_t tail = (uint32_t)atomic_get(&ring->tail);
+
+    if (head - tail >= SAMPLE_RING_SIZE) {
+        atomic_inc(&ring->overruns);
+        return NULL;
+    }
+
+    return &ring->slots[head & SAMPLE_RING_MASK];
+}
+
+/* Raw frame buffer belonging to a reserved slot */
+uint8_t *sample_ring_frame(sample_ring_t *ring, const ads1299_sample_t *slot) {
+    return ring->frames[slot - ring->slots].bytes;
+}
+
+void sample_ring_commit(sample_ring_t *ring) {
+    // atomic_set is a full barrier, so the slot contents land before the index moves
+    uint32_t head = (uint32_t)atomic_get(&ring->head) + 1;
+    atomic_set(&ring->head, (atomic_val_t)head);
+
+    /* The reader resets high_water from another thread, so raise it with a
+       compare-and-swap: a reset landing between the read and the store makes
+       the swap fail and the depth is compared again against the new value */
+    uint32_t depth = head - (uint32_t)atomic_get(&ring->tail);
+    atomic_val_t seen = atomic_get(&ring->high_water);
+    while (depth > (uint32_t)seen) {
+        if (atomic_cas(&ring->high_water, seen, (atomic_val_t)depth)) {
+            break;
+        }
+        seen = atomic_get(&ring->high_water);
+    }
+}
+
+/* Returns the oldest committed sample without removing it, or NULL if empty */
+const ads1299_sample_t *sample_ring_peek(sample_ring_t *ring) {
+    uint32_t tail = (uint32_t)atomic_get(&ring->tail);
+    uint32_t head = (uint32_t)atomic_get(&ring->head);
+
+    if (head == tail) {
+        return NULL;
+    }
+
+    return &ring->slots[tail & SAMPLE_RING_MASK];
+}
+
+void sample_ring_release(sample_ring_t *ring) {
+    atomic_inc(&ring->tail);
+}
+
+uint32_t sample_ring_depth(const sample_ring_t *ring) {
+    return (uint32_t)atomic_get(&ring->head) - (uint32_t)atomic_get(&ring->tail);
+}
+
+uint32_t sample_ring_overruns(const sample_ring_t *ring) {
+    return (uint32_t)atomic_get(&ring->overruns);
+}
+
+/* Reads and resets the high-water mark so each report covers one interval */
+uint32_t sample_ring_take_high_water(sample_ring_t *ring) {
+    return (uint32_t)atomic_set(&ring->high_water, (atomic_val_t)sample_ring_depth(ring));
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+#include <stdint.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include "data_handler.h"
+
+// Ring capacity, must be a power of two
+#define SAMPLE_RING_SIZE    CONFIG_CERELOG_RING_SIZE
+#define SAMPLE_RING_MASK    (SAMPLE_RING_SIZE - 1)
+
+BUILD_ASSERT((SAMPLE_RING_SIZE & SAMPLE_RING_MASK) == 0,
+             "CONFIG_CERELOG_RING_SIZE must be a power of two");
+
+/* Raw RDATAC frame as clocked out of the chip. Word aligned so the SPI
+   DMA engine can write it in place. */
+typedef struct {
+    uint8_t bytes[ADS1299_TOTAL_DATA_BYTES];
+} __aligned(4) sample_ring_frame_t;
+
+/* Single-producer/single-consumer ring of parsed samples.
+   The acquisition thread is the only writer of head, the transmission
+   thread is the only writer of tail. Both indices run freely and are
+   masked on access, so head - tail is always the queue depth.
+   Each slot has a raw frame next to it, so a reserved slot can be read
+   into and parsed without an intermediate copy. */
+typedef struct {
+    ads1299_sample_t slots[SAMPLE_RING_SIZE];
+    sample_ring_frame_t frames[SAMPLE_RING_SIZE];
+    atomic_t head;              // Next slot the producer fills
+    atomic_t tail;              // Next slot the consumer drains
+    atomic_t overruns;          // Samples dropped because the ring was full
+    atomic_t high_water;        // Deepest queue seen since the last reset, raised by the producer, reset by the reader
+} sample_ring_t;
+
+// Function declarations
+void sample_ring_init(sample_ring_t *ring);
+
+// Producer side
+ads1299_sample_t *sample_ring_reserve(sample_ring_t *ring);
+uint8_t *sample_ring_frame(sample_ring_t *ring, const ads1299_sample_t *slot);
+void sample_ring_commit(sample_ring_t *ring);
+
+// Consumer side
+const ads1299_sample_t *sample_ring_peek(sample_ring_t *ring);
+void sample_ring_release(sample_ring_t *ring);
+
+// Statistics
+uint32_t sample_ring_depth(const sample_ring_t *ring);
+uint32_t sample_ring_overruns(const sample_ring_t *ring);
+uint32_t sample_ring_take_high_water(sample_ring_t *ring);
+
+#endif // SAMPLE_RING_H
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <zephyr/timing/timing.h>
+#include "telemetry_format.h"
+
+/* Hot-path instrumentation (CONFIG_CERELOG_TELEMETRY). Each stage is
+   recorded from one context only, so recording takes no lock; the
+   transmission thread takes a snapshot once per interval with interrupts
+   locked and sends it as a telemetry packet. The packet also carries the
+   counters that would otherwise need a console line while streaming, as
+   the console shares the UART with the data link. */
+
+// Interval counters the caller collects for the packet
+typedef struct {
+    uint32_t interval_us;
+    uint32_t drdy_edges;
+    uint32_t samples;
+    uint32_t missed_drdy;
+    uint32_t ring_overruns;
+    uint32_t tx_bytes;
+    uint16_t ring_high_water;
+    uint16_t ring_size;
+    uint16_t spi_errors;
+    uint16_t command_crc_errors;
+    uint32_t link_bytes_per_s;
+    uint32_t tx_busy_us;
+    uint16_t tx_stalls;
+    uint16_t tx_drops;
+    uint16_t resend_requests;
+    uint16_t resent_packets;
+    uint16_t resend_missed;
+    uint16_t resend_dropped;
+    uint16_t command_errors;
+    uint16_t marker_drops;
+    uint16_t capture_ignored;
+    uint32_t first_sample_us;
+} telemetry_counters_t;
+
+#ifdef CONFIG_CERELOG_TELEMETRY
+void telemetry_init(void);
+void telemetry_record(enum telemetry_stage stage, timing_t start);
+size_t telemetry_format_packet(const telemetry_counters_t *counters, uint8_t *buffer, size_t buffer_size);
+
+#define TELEMETRY_START(t)          timing_t t = timing_counter_get()
+#define TELEMETRY_END(stage, t)     telemetry_record(stage, t)
+#else
+#define TELEMETRY_START(t)
+#define TELEMETRY_END(stage, t)
+#endif
+
+#endif // TELEMETRY_H
\ No newline at end of file
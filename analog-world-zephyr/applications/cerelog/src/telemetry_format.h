@@ -0,0 +1,69 @@
+#ifndef TELEMETRY_FORMAT_H
+#define TELEMETRY_FORMAT_H
+
+#include <stdint.h>
+
+/* Wire format of the telemetry packet the firmware sends once per
+   interval. Plain C with no Zephyr dependencies so the host tools decode
+   it with the same definitions. Multi-byte fields are little-endian.
+
+   Stage times are in timing counter cycles; timing_hz converts them. Each
+   stage keeps a log2 histogram: bucket b counts durations in
+   [2^(b + TELEMETRY_HIST_MIN_LOG2), 2^(b + TELEMETRY_HIST_MIN_LOG2 + 1))
+   cycles, with the first and last buckets also taking everything below
+   and above. */
+#define TELEMETRY_PACKET_TYPE       0x04
+#define TELEMETRY_HIST_BUCKETS      16
+#define TELEMETRY_HIST_MIN_LOG2     4
+
+enum telemetry_stage {
+    TELEMETRY_STAGE_DRDY_TO_SPI,    // DRDY edge to the frame read starting
+    TELEMETRY_STAGE_SPI,            // Frame read, start to data in the ring slot
+    TELEMETRY_STAGE_PARSE,          // process_ads1299_data and ring commit
+    TELEMETRY_STAGE_FORMAT,         // batch_frame_finish: pack or compress, CRC
+    TELEMETRY_STAGE_UART_TX,        // Queuing one packet on the transport, with any wait for a free buffer
+    TELEMETRY_STAGE_DECIMATE,       // One input sample through the decimator
+    TELEMETRY_STAGE_COUNT
+};
+
+typedef struct {
+    uint32_t count;
+    uint32_t total_cycles;          // Saturates; an interval holds at most timing_hz cycles per stage
+    uint32_t max_cycles;
+    uint16_t histogram[TELEMETRY_HIST_BUCKETS];     // Saturating counts
+} __attribute__((packed)) telemetry_stage_stats_t;
+
+typedef struct {
+    uint8_t start_bytes[2];         // 0xAA, 0x55
+    uint8_t packet_type;            // TELEMETRY_PACKET_TYPE
+    uint8_t stage_count;            // TELEMETRY_STAGE_COUNT
+    uint64_t timestamp_ns;          // End of the interval, same clock as the batch timestamps
+    uint32_t interval_us;
+    uint32_t timing_hz;             // Timing counter frequency
+    uint32_t drdy_edges;            // Counters below cover this interval only
+    uint32_t samples;               // Frames read into the ring
+    uint32_t missed_drdy;           // Edges with no frame read
+    uint32_t ring_overruns;         // Frames dropped because the ring was full
+    uint32_t tx_bytes;              // Bytes the transport finished sending
+    uint16_t ring_high_water;
+    uint16_t ring_size;
+    uint16_t spi_errors;
+    uint16_t command_crc_errors;    // Host command frames with a bad CRC
+    uint32_t link_bytes_per_s;      // What the link carries at its baud rate, 0 if unknown
+    uint32_t tx_busy_us;            // Time the transport spent sending
+    uint16_t tx_stalls;             // Packets that waited for a free transmit buffer
+    uint16_t tx_drops;              // Packets dropped with no buffer free in time, or refused by the driver
+    uint16_t resend_requests;       // Ranges the host asked for again, 0 without retransmission
+    uint16_t resent_packets;        // Packets sent again
+    uint16_t resend_missed;         // Samples asked for that had already left the window
+    uint16_t resend_dropped;        // Ranges dropped because the request queue was full
+    uint16_t command_errors;        // Host commands that failed
+    uint16_t marker_drops;          // Reconfiguration markers lost to a full queue
+    uint16_t capture_ignored;       // Capture triggers that came while a capture was under way
+    uint32_t first_sample_us;       // ADS1299 power-up to the first frame read, 0 before it
+    telemetry_stage_stats_t stages[TELEMETRY_STAGE_COUNT];
+    uint16_t crc16;                 // CRC-16 over everything before it
+    uint8_t end_bytes[2];           // 0x55, 0xAA
+} __attribute__((packed)) telemetry_packet_t;
+
+#endif // TELEMETRY_FORMAT_H
\ No newline at end of file
@@ -0,0 +1,41 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <zephyr/kernel.h>
+
+/* Where finished packets go. The formatter hands each whole packet to
+   transport_write() and does not care what carries it; one backend is
+   built, chosen with CONFIG_CERELOG_TRANSPORT_*:
+
+     uart_tx.c   the serial link, double-buffered (see there)
+     udp_tx.c    UDP datagrams of whole packets, sized to the MTU, each
+                 with a sequence number
+
+   Both copy the packet and return. They only make the caller wait when
+   their buffers are all taken; after CONFIG_CERELOG_TRANSPORT_TIMEOUT_MS
+   the packet is dropped and counted, so a wedged link cannot stop
+   telemetry and marker handling for good. The sample ring absorbs the
+   wait, and acquisition never waits on the transport.
+
+   transport_room() tells how many bytes of packets could be written
+   right now without that wait, so bulk data can take only the capacity
+   the live stream leaves. */
+
+// Interval counters, free-running; callers take differences
+typedef struct {
+    uint32_t bytes;             // Sent, counted when their transfer completes
+    uint32_t busy_us;           // Time a transfer was on the wire, or in the network stack
+    uint32_t stalls;            // Writes that waited for a buffer to come free
+    uint32_t drops;             // Packets dropped with no buffer free in time
+    uint32_t errors;            // Transfers the driver or stack refused or aborted
+} transport_stats_t;
+
+int transport_init(void);
+int transport_write(const uint8_t *data, size_t length);
+size_t transport_room(void);
+void transport_get_stats(transport_stats_t *stats);
+uint32_t transport_link_bytes_per_s(void);
+
+#endif // TRANSPORT_H
\ No newline at end of file
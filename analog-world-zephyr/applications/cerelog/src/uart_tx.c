@@ -0,0 +1,303 @@
+/* Serial transport: two buffers, one filling while the other is on the
+   wire. When a transfer completes, the completion context sends the
+   filled buffer straight away, so the link stays busy for as long as
+   there is data and the writer only pays for the copy.
+
+   How a buffer goes out depends on CONFIG_CERELOG_UART_TX_*: DMA through
+   the async UART API, FIFO refills from the TX interrupt, or the polled
+   byte loop as a fallback. Under CONFIG_CERELOG_BENCH no UART is used;
+   a timer holds each buffer for as long as the link would need to send
+   it, so the benchmark sees the same backpressure as hardware. */
+
+#include "transport.h"
+#include "data_handler.h"
+#include "bench.h"
+#include <zephyr/device.h>
+#include <zephyr/drivers/uart.h>
+#include <zephyr/sys/printk.h>
+#include <string.h>
+
+#if defined(CONFIG_CERELOG_BENCH) || defined(CONFIG_CERELOG_UART_TX_ASYNC) || \
+    defined(CONFIG_CERELOG_UART_TX_INTERRUPT)
+#define UART_TX_BUFFERED 1
+#endif
+
+static uint64_t tx_busy_cycles;
+static transport_stats_t tx_stats;
+static uint32_t tx_bytes_per_s;
+static struct k_spinlock tx_lock;
+static const struct device *tx_dev;
+
+#ifdef UART_TX_BUFFERED
+
+// Each buffer holds at least one largest batch, so any packet fits an empty buffer
+#ifdef CONFIG_CERELOG_CAPTURE
+// and a capture packet with one, since captures only drain into room left for a batch
+#define UART_TX_BUFFER_SIZE MAX(CONFIG_CERELOG_UART_TX_BUFFER_SIZE, \
+                                CAPTURE_PACKET_SIZE(CAPTURE_PACKET_FRAMES) + BATCH_PACKET_MAX_SIZE(BATCH_MAX_SAMPLES))
+#else
+#define UART_TX_BUFFER_SIZE MAX(CONFIG_CERELOG_UART_TX_BUFFER_SIZE, BATCH_PACKET_MAX_SIZE(BATCH_MAX_SAMPLES))
+#endif
+
+/* Word aligned for DMA. One buffer is on the wire while the other fills;
+   tx_fill_len bytes of the filling one are taken. */
+static uint8_t tx_buffers[2][UART_TX_BUFFER_SIZE] __aligned(4);
+static int tx_fill;
+static size_t tx_fill_len;
+static bool tx_busy;            // A transfer is on the wire
+static bool tx_copying;         // The writer is copying into the filling buffer outside the lock
+static uint32_t tx_start_cycles;
+
+// Given on every completion, so a stalled writer can look again
+K_SEM_DEFINE(tx_done_sem, 0, 1);
+
+static int tx_backend_start(const uint8_t *data, size_t length);
+
+/* Puts the filling buffer on the wire and starts filling the other one.
+   Called with tx_lock held, from the writer or the completion context. */
+static void tx_start_locked(void) {
+    const uint8_t *data = tx_buffers[tx_fill];
+    size_t length = tx_fill_len;
+
+    tx_fill ^= 1;
+    tx_fill_len = 0;
+    tx_busy = true;
+    tx_start_cycles = k_cycle_get_32();
+    if (tx_backend_start(data, length) != 0) {
+        // The data is lost; the stream shows it as a sample number gap
+        tx_busy = false;
+        tx_stats.errors++;
+    }
+}
+
+/* A transfer finished, or was aborted, with sent bytes on the wire. Runs
+   in interrupt context, and chains the next buffer if the writer has
+   filled one. */
+static void tx_complete(size_t sent, bool aborted) {
+    k_spinlock_key_t key = k_spin_lock(&tx_lock);
+
+    tx_busy = false;
+    if (aborted) {
+        tx_stats.errors++;
+    }
+    tx_stats.bytes += sent;
+    tx_busy_cycles += k_cycle_get_32() - tx_start_cycles;
+    if (tx_fill_len > 0 && !tx_copying) {
+        tx_start_locked();
+    }
+    k_spin_unlock(&tx_lock, key);
+
+    k_sem_give(&tx_done_sem);
+}
+
+#if defined(CONFIG_CERELOG_BENCH)
+
+// Holds each buffer for its time on a link of the benchmark's baud rate
+static const uint8_t *tx_model_data;
+static size_t tx_model_length;
+
+// The buffer has reached the host; the benchmark times its samples before it is refilled
+static void tx_model_done(struct k_timer *timer) {
+    ARG_UNUSED(timer);
+    bench_count_delivered(tx_model_data, tx_model_length);
+    tx_complete(tx_model_length, false);
+}
+
+K_TIMER_DEFINE(tx_model_timer, tx_model_done, NULL);
+
+static int tx_backend_init(void) {
+    tx_bytes_per_s = bench_link_baud() / 10;
+    return 0;
+}
+
+static int tx_backend_start(const uint8_t *data, size_t length) {
+    tx_model_data = data;
+    tx_model_length = length;
+    k_timer_start(&tx_model_timer, K_USEC((uint64_t)length * USEC_PER_SEC / tx_bytes_per_s), K_NO_WAIT);
+    return 0;
+}
+
+#elif defined(CONFIG_CERELOG_UART_TX_ASYNC)
+
+static void tx_uart_callback(const struct device *dev, struct uart_event *evt, void *user_data) {
+    ARG_UNUSED(dev);
+    ARG_UNUSED(user_data);
+
+    switch (evt->type) {
+    case UART_TX_DONE:
+        tx_complete(evt->data.tx.len, false);
+        break;
+    case UART_TX_ABORTED:
+        tx_complete(evt->data.tx.len, true);
+        break;
+    default:
+        break;
+    }
+}
+
+static int tx_backend_init(void) {
+    return uart_callback_set(tx_dev, tx_uart_callback, NULL);
+}
+
+// The driver's DMA reads the buffer; nothing touches it until UART_TX_DONE
+static int tx_backend_start(const uint8_t *data, size_t length) {
+    return uart_tx(tx_dev, data, length, SYS_FOREVER_US);
+}
+
+#elif defined(CONFIG_CERELOG_UART_TX_INTERRUPT)
+
+// Buffer on the wire, refilled into the TX FIFO from the interrupt
+static const uint8_t *tx_wire;
+static size_t tx_wire_length;
+static size_t tx_wire_pos;
+
+static void tx_uart_isr(const struct device *dev, void *user_data) {
+    ARG_UNUSED(user_data);
+
+    if (!uart_irq_update(dev) || !uart_irq_tx_ready(dev)) {
+        return;
+    }
+    if (tx_wire_pos < tx_wire_length) {
+        int filled = uart_fifo_fill(dev, tx_wire + tx_wire_pos, (int)(tx_wire_length - tx_wire_pos));
+        if (filled > 0) {
+            tx_wire_pos += (size_t)filled;
+        }
+        return;
+    }
+    // Everything is in the FIFO; disable first, the completion may start the next buffer
+    uart_irq_tx_disable(dev);
+    tx_complete(tx_wire_length, false);
+}
+
+static int tx_backend_init(void) {
+    return uart_irq_callback_user_data_set(tx_dev, tx_uart_isr, NULL);
+}
+
+static int tx_backend_start(const uint8_t *data, size_t length) {
+    tx_wire = data;
+    tx_wire_length = length;
+    tx_wire_pos = 0;
+    uart_irq_tx_enable(tx_dev);
+    return 0;
+}
+
+#endif
+
+// The data link shares uart0 with the console and the host command receiver
+int transport_init(void) {
+    tx_dev = DEVICE_DT_GET(DT_NODELABEL(uart0));
+    if (!device_is_ready(tx_dev)) {
+        return -ENODEV;
+    }
+
+#ifndef CONFIG_CERELOG_BENCH
+    struct uart_config config;
+    if (uart_config_get(tx_dev, &config) == 0 && config.baudrate > 0) {
+        // 8N1: ten bits on the wire per byte
+        tx_bytes_per_s = config.baudrate / 10;
+    }
+#endif
+
+    int ret = tx_backend_init();
+    if (ret != 0) {
+        printk("UART transmit setup failed: %d\n", ret);
+    }
+    return ret;
+}
+
+/* Copies one whole packet into the filling buffer. Only the transmission
+   thread writes, so packets never interleave. Waits for a buffer to come
+   free when both are taken, and drops the packet if none does within
+   CONFIG_CERELOG_TRANSPORT_TIMEOUT_MS. */
+int transport_write(const uint8_t *data, size_t length) {
+    if (length > UART_TX_BUFFER_SIZE) {
+        return -EMSGSIZE;
+    }
+
+    k_timepoint_t deadline = sys_timepoint_calc(K_MSEC(CONFIG_CERELOG_TRANSPORT_TIMEOUT_MS));
+    bool stalled = false;
+    k_spinlock_key_t key = k_spin_lock(&tx_lock);
+
+    // With the filling buffer too full for the packet, the other one is on the wire
+    while (UART_TX_BUFFER_SIZE - tx_fill_len < length) {
+        if (!stalled) {
+            stalled = true;
+            tx_stats.stalls++;
+        }
+        k_spin_unlock(&tx_lock, key);
+        if (k_sem_take(&tx_done_sem, sys_timepoint_timeout(deadline)) != 0) {
+            key = k_spin_lock(&tx_lock);
+            tx_stats.drops++;
+            k_spin_unlock(&tx_lock, key);
+            return -EAGAIN;
+        }
+        key = k_spin_lock(&tx_lock);
+    }
+
+    // Reserve the space, then copy with interrupts enabled; completions meanwhile leave this buffer alone
+    BENCH_START(t_transmit);
+    uint8_t *dst = tx_buffers[tx_fill] + tx_fill_len;
+    tx_fill_len += length;
+    tx_copying = true;
+    k_spin_unlock(&tx_lock, key);
+
+    memcpy(dst, data, length);
+
+    key = k_spin_lock(&tx_lock);
+    tx_copying = false;
+    if (!tx_busy) {
+        tx_start_locked();
+    }
+    k_spin_unlock(&tx_lock, key);
+    // The CPU cost of sending: the copy and a transfer start, not the wait for a buffer
+    BENCH_END(BENCH_STAGE_TRANSMIT, t_transmit);
+    return 0;
+}
+
+// Free bytes in the filling buffer; the one on the wire frees up as it completes
+size_t transport_room(void) {
+    k_spinlock_key_t key = k_spin_lock(&tx_lock);
+    size_t room = UART_TX_BUFFER_SIZE - tx_fill_len;
+    k_spin_unlock(&tx_lock, key);
+    return room;
+}
+
+#else
+
+static int tx_backend_init(void) {
+    return 0;
+}
+
+// Polled: the writer sends every byte itself, and the link is only as busy as it is
+int transport_write(const uint8_t *data, size_t length) {
+    uint32_t start = k_cycle_get_32();
+    for (size_t i = 0; i < length; i++) {
+        uart_poll_out(tx_dev, data[i]);
+    }
+    k_spinlock_key_t key = k_spin_lock(&tx_lock);
+    tx_stats.bytes += length;
+    tx_busy_cycles += k_cycle_get_32() - start;
+    k_spin_unlock(&tx_lock, key);
+    return 0;
+}
+
+// Polled writes never wait for a buffer, but every byte is the writer's time
+size_t transport_room(void) {
+    return SIZE_MAX;
+}
+
+#endif // UART_TX_BUFFERED
+
+void transport_get_stats(transport_stats_t *stats) {
+    k_spinlock_key_t key = k_spin_lock(&tx_lock);
+    *stats = tx_stats;
+    uint64_t busy_cycles = tx_busy_cycles;
+    k_spin_unlock(&tx_lock, key);
+
+    stats->busy_us = (uint32_t)k_cyc_to_us_floor64(busy_cycles);
+}
+
+// Bytes per second the link can carry, 0 if the driver does not report its baud rate
+uint32_t transport_link_bytes_per_s(void) {
+    return tx_bytes_per_s;
+}
\ No newline at end of file
@@ -0,0 +1,234 @@
+/* UDP transport: packets are gathered into datagrams of whole packets, up
+   to CONFIG_CERELOG_UDP_PAYLOAD_SIZE, and a sender thread hands them to
+   the network stack, so the transmission thread never waits on a socket.
+   A datagram goes out when the next packet would not fit, or once its
+   first packet has waited CONFIG_CERELOG_UDP_FLUSH_MS, which bounds the
+   latency at low data rates. A packet larger than the payload size goes
+   alone in a datagram of its own. */
+
+#include "transport.h"
+#include "data_handler.h"
+#include "bench.h"
+#include <zephyr/kernel.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/sys/printk.h>
+#include <string.h>
+
+#define UDP_TX_BUFFERS          CONFIG_CERELOG_UDP_BUFFERS
+#define UDP_TX_PAYLOAD_SIZE     CONFIG_CERELOG_UDP_PAYLOAD_SIZE
+// Room for the header and the largest packet, however small the payload size
+#define UDP_TX_BUFFER_SIZE      MAX(UDP_TX_PAYLOAD_SIZE, \
+                                    sizeof(datagram_header_t) + BATCH_PACKET_MAX_SIZE(BATCH_MAX_SAMPLES))
+// Queued by the flush timer: look at the open datagram's deadline
+#define UDP_TX_DEADLINE         0xFF
+
+BUILD_ASSERT(UDP_TX_BUFFERS < UDP_TX_DEADLINE, "CONFIG_CERELOG_UDP_BUFFERS too large");
+
+static uint8_t udp_buffers[UDP_TX_BUFFERS][UDP_TX_BUFFER_SIZE] __aligned(4);
+static size_t udp_lengths[UDP_TX_BUFFERS];
+static uint8_t udp_packets[UDP_TX_BUFFERS];
+
+// Datagram being filled, -1 for none, and when its first packet went in; under udp_lock
+static int udp_open = -1;
+static int64_t udp_open_ticks;
+
+static int udp_socket = -1;
+static struct sockaddr_in udp_peer;
+static uint32_t udp_sequence;       // Sender thread only
+static transport_stats_t udp_stats;
+static uint64_t udp_busy_cycles;
+
+K_MUTEX_DEFINE(udp_lock);
+// Buffers free for the writer, and datagrams ready for the sender; one more slot for the deadline token
+K_MSGQ_DEFINE(udp_free_msgq, sizeof(uint8_t), UDP_TX_BUFFERS, 1);
+K_MSGQ_DEFINE(udp_ready_msgq, sizeof(uint8_t), UDP_TX_BUFFERS + 1, 1);
+
+static void udp_deadline_expired(struct k_timer *timer) {
+    ARG_UNUSED(timer);
+    uint8_t token = UDP_TX_DEADLINE;
+    // A full queue means the sender is busy and looks at the deadline after each datagram anyway
+    (void)k_msgq_put(&udp_ready_msgq, &token, K_NO_WAIT);
+}
+
+K_TIMER_DEFINE(udp_flush_timer, udp_deadline_expired, NULL);
+
+static void udp_sender_thread(void *p1, void *p2, void *p3);
+
+// Started by transport_init() once the socket is open
+K_THREAD_DEFINE(udp_thread, 2048, udp_sender_thread, NULL, NULL, NULL,
+                K_PRIO_PREEMPT(7), 0, SYS_FOREVER_MS);
+
+// Hands the open datagram to the sender. Called with udp_lock held.
+static void udp_close_locked(void) {
+    uint8_t index = (uint8_t)udp_open;
+
+    udp_open = -1;
+    k_timer_stop(&udp_flush_timer);
+    // Never full: a buffer is in at most one of the queues
+    (void)k_msgq_put(&udp_ready_msgq, &index, K_NO_WAIT);
+}
+
+// Takes the open datagram if its first packet has waited out the flush deadline
+static int udp_take_due(void) {
+    int index = -1;
+
+    k_mutex_lock(&udp_lock, K_FOREVER);
+    if (udp_open >= 0 && udp_packets[udp_open] > 0 &&
+        k_uptime_ticks() - udp_open_ticks >= k_ms_to_ticks_ceil64(CONFIG_CERELOG_UDP_FLUSH_MS)) {
+        index = udp_open;
+        udp_open = -1;
+    }
+    k_mutex_unlock(&udp_lock);
+    return index;
+}
+
+static void udp_send(uint8_t index) {
+    datagram_header_t *header = (datagram_header_t *)udp_buffers[index];
+
+    header->magic[0] = DATAGRAM_MAGIC1;
+    header->magic[1] = DATAGRAM_MAGIC2;
+    header->version = DATAGRAM_VERSION;
+    header->packet_count = udp_packets[index];
+    header->sequence = udp_sequence++;
+    header->sent_ns = cycles_to_ns(get_cycles64());
+
+    uint32_t start = k_cycle_get_32();
+    ssize_t sent = zsock_sendto(udp_socket, udp_buffers[index], udp_lengths[index], 0,
+                                (struct sockaddr *)&udp_peer, sizeof(udp_peer));
+    uint32_t cycles = k_cycle_get_32() - start;
+
+    k_mutex_lock(&udp_lock, K_FOREVER);
+    if (sent == (ssize_t)udp_lengths[index]) {
+        udp_stats.bytes += (uint32_t)sent;
+#ifdef CONFIG_CERELOG_BENCH
+        bench_count_delivered(udp_buffers[index] + sizeof(datagram_header_t),
+                              udp_lengths[index] - sizeof(datagram_header_t));
+#endif
+    } else {
+        // The sequence number is spent, so the host counts the datagram as lost
+        udp_stats.errors++;
+    }
+    udp_busy_cycles += cycles;
+    k_mutex_unlock(&udp_lock);
+
+    (void)k_msgq_put(&udp_free_msgq, &index, K_NO_WAIT);
+}
+
+static void udp_sender_thread(void *p1, void *p2, void *p3) {
+    ARG_UNUSED(p1);
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    uint8_t index;
+
+    while (1) {
+        k_msgq_get(&udp_ready_msgq, &index, K_FOREVER);
+        if (index != UDP_TX_DEADLINE) {
+            udp_send(index);
+        }
+        // After every datagram too, in case the deadline token found the queue full
+        int due = udp_take_due();
+        if (due >= 0) {
+            udp_send((uint8_t)due);
+        }
+    }
+}
+
+int transport_init(void) {
+    udp_socket = zsock_socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (udp_socket < 0) {
+        printk("UDP socket failed: %d\n", errno);
+        return -errno;
+    }
+
+    udp_peer.sin_family = AF_INET;
+    udp_peer.sin_port = htons(CONFIG_CERELOG_UDP_PEER_PORT);
+    if (zsock_inet_pton(AF_INET, CONFIG_CERELOG_UDP_PEER_ADDR, &udp_peer.sin_addr) != 1) {
+        printk("Bad UDP peer address '%s'\n", CONFIG_CERELOG_UDP_PEER_ADDR);
+        zsock_close(udp_socket);
+        udp_socket = -1;
+        return -EINVAL;
+    }
+
+    for (uint8_t i = 0; i < UDP_TX_BUFFERS; i++) {
+        k_msgq_put(&udp_free_msgq, &i, K_NO_WAIT);
+    }
+    k_thread_start(udp_thread);
+
+    printk("Streaming UDP to %s:%d, %d-byte datagrams\n", CONFIG_CERELOG_UDP_PEER_ADDR,
+           CONFIG_CERELOG_UDP_PEER_PORT, UDP_TX_PAYLOAD_SIZE);
+    return 0;
+}
+
+/* Appends one whole packet to the open datagram, opening one if needed.
+   Waits for a free buffer only when every datagram is queued or being
+   sent, and drops the packet after CONFIG_CERELOG_TRANSPORT_TIMEOUT_MS. */
+int transport_write(const uint8_t *data, size_t length) {
+    if (sizeof(datagram_header_t) + length > UDP_TX_BUFFER_SIZE) {
+        return -EMSGSIZE;
+    }
+
+    k_mutex_lock(&udp_lock, K_FOREVER);
+    if (udp_open >= 0 && udp_lengths[udp_open] + length > UDP_TX_PAYLOAD_SIZE) {
+        udp_close_locked();
+    }
+
+    if (udp_open < 0) {
+        uint8_t index;
+        int ret = k_msgq_get(&udp_free_msgq, &index, K_NO_WAIT);
+        if (ret != 0) {
+            udp_stats.stalls++;
+            // The sender frees buffers without the lock
+            k_mutex_unlock(&udp_lock);
+            ret = k_msgq_get(&udp_free_msgq, &index, K_MSEC(CONFIG_CERELOG_TRANSPORT_TIMEOUT_MS));
+            k_mutex_lock(&udp_lock, K_FOREVER);
+        }
+        if (ret != 0) {
+            udp_stats.drops++;
+            k_mutex_unlock(&udp_lock);
+            return -EAGAIN;
+        }
+        udp_open = index;
+        udp_lengths[index] = sizeof(datagram_header_t);
+        udp_packets[index] = 0;
+        udp_open_ticks = k_uptime_ticks();
+        k_timer_start(&udp_flush_timer, K_MSEC(CONFIG_CERELOG_UDP_FLUSH_MS), K_NO_WAIT);
+    }
+
+    BENCH_START(t_transmit);
+    memcpy(udp_buffers[udp_open] + udp_lengths[udp_open], data, length);
+    udp_lengths[udp_open] += length;
+    udp_packets[udp_open]++;
+    // Full, or a lone oversized packet, or at the packet count the header can hold
+    if (udp_lengths[udp_open] >= UDP_TX_PAYLOAD_SIZE || udp_packets[udp_open] == UINT8_MAX) {
+        udp_close_locked();
+    }
+    k_mutex_unlock(&udp_lock);
+    BENCH_END(BENCH_STAGE_TRANSMIT, t_transmit);
+    return 0;
+}
+
+// What is left of the open datagram, and the payload of every free buffer
+size_t transport_room(void) {
+    k_mutex_lock(&udp_lock, K_FOREVER);
+    size_t room = k_msgq_num_used_get(&udp_free_msgq) * (UDP_TX_PAYLOAD_SIZE - sizeof(datagram_header_t));
+    if (udp_open >= 0 && udp_lengths[udp_open] < UDP_TX_PAYLOAD_SIZE) {
+        room += UDP_TX_PAYLOAD_SIZE - udp_lengths[udp_open];
+    }
+    k_mutex_unlock(&udp_lock);
+    return room;
+}
+
+void transport_get_stats(transport_stats_t *stats) {
+    k_mutex_lock(&udp_lock, K_FOREVER);
+    *stats = udp_stats;
+    uint64_t busy_cycles = udp_busy_cycles;
+    k_mutex_unlock(&udp_lock);
+
+    stats->busy_us = (uint32_t)k_cyc_to_us_floor64(busy_cycles);
+}
+
+// A network has no fixed rate to report
+uint32_t transport_link_bytes_per_s(void) {
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,466 @@
+// C ABI over the host library for cerelog_stream.py (ctypes). Output goes
+// straight into arrays the caller allocated, so NumPy gets the samples
+// without an intermediate copy. Exceptions do not cross this boundary.
+
+#include "aggregator.h"
+#include "filter_bank.h"
+#include "frame_unpack.h"
+#include "gap_recovery.h"
+#include "minmax_pyramid.h"
+#include "recording.h"
+#include "spectral.h"
+#include "stream_decoder.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#define CERELOG_EXPORT extern "C" __declspec(dllexport)
+#else
+#define CERELOG_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+CERELOG_EXPORT size_t cerelog_channels(void) {
+    return cerelog::kChannels;
+}
+
+CERELOG_EXPORT size_t cerelog_max_packet_samples(void) {
+    return cerelog::kMaxPacketSamples;
+}
+
+CERELOG_EXPORT void *cerelog_decoder_new(void) {
+    return new (std::nothrow) cerelog::stream_decoder();
+}
+
+CERELOG_EXPORT void cerelog_decoder_free(void *decoder) {
+    delete static_cast<cerelog::stream_decoder *>(decoder);
+}
+
+/* Returns samples written, or -1 if the arrays are unusable. See
+   stream_decoder::decode for consumed. */
+CERELOG_EXPORT long long cerelog_decoder_decode(void *decoder, const uint8_t *data, size_t length,
+                                                int32_t *channels, uint32_t *sample_number,
+                                                uint64_t *timestamp_ns, uint32_t *status, size_t capacity,
+                                                size_t *consumed) {
+    cerelog::sample_block out;
+    out.channels = channels;
+    out.sample_number = sample_number;
+    out.timestamp_ns = timestamp_ns;
+    out.status = status;
+    out.capacity = capacity;
+
+    try {
+        return (long long)static_cast<cerelog::stream_decoder *>(decoder)->decode(data, length, out, consumed);
+    } catch (...) {
+        *consumed = 0;
+        return -1;
+    }
+}
+
+// Which chip of a daisy chain the decoder hands over; returns 0, or -1 past the longest chain
+CERELOG_EXPORT int cerelog_decoder_select_chip(void *decoder, size_t chip) {
+    try {
+        static_cast<cerelog::stream_decoder *>(decoder)->select_chip(chip);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+// Fills counters in the order of the decoder_stats fields, chained_packets, resent_samples and capture_packets last; returns how many
+CERELOG_EXPORT size_t cerelog_decoder_stats(void *decoder, uint64_t *counters, size_t max_counters) {
+    const cerelog::decoder_stats &s = static_cast<cerelog::stream_decoder *>(decoder)->stats();
+    const uint64_t values[] = {
+        s.bytes, s.samples, s.single_packets, s.batch_packets, s.marker_packets,
+        s.telemetry_packets, s.arduino_frames, s.bad_packets, s.skipped_bytes, s.missing_samples,
+        s.chained_packets, s.resent_samples, s.capture_packets,
+    };
+    size_t n = sizeof(values) / sizeof(values[0]);
+    n = n < max_counters ? n : max_counters;
+    for (size_t i = 0; i < n; i++) {
+        counters[i] = values[i];
+    }
+    return n;
+}
+
+// gap_recovery with the CMD_RESEND frames it has built, until the caller takes them
+struct recovery_handle {
+    cerelog::gap_recovery recovery;
+    std::vector<uint8_t> requests;
+
+    recovery_handle(int hold_ms, int retry_ms, size_t max_held)
+        : recovery(std::chrono::milliseconds(hold_ms), std::chrono::milliseconds(retry_ms), max_held) {}
+};
+
+// Returns null if hold_ms or retry_ms is not positive, or max_held is 0
+CERELOG_EXPORT void *cerelog_recovery_new(int hold_ms, int retry_ms, size_t max_held) {
+    try {
+        return new recovery_handle(hold_ms, retry_ms, max_held);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+CERELOG_EXPORT void cerelog_recovery_free(void *recovery) {
+    delete static_cast<recovery_handle *>(recovery);
+}
+
+// Arrays as cerelog_decoder_decode writes them; sample_number is required. Returns 0, or -1 without it.
+CERELOG_EXPORT int cerelog_recovery_push(void *recovery, const int32_t *channels, const uint32_t *sample_number,
+                                         const uint64_t *timestamp_ns, const uint32_t *status, size_t count) {
+    cerelog::sample_block block;
+    block.channels = const_cast<int32_t *>(channels);
+    block.sample_number = const_cast<uint32_t *>(sample_number);
+    block.timestamp_ns = const_cast<uint64_t *>(timestamp_ns);
+    block.status = const_cast<uint32_t *>(status);
+    block.capacity = count;
+    try {
+        static_cast<recovery_handle *>(recovery)->recovery.push(block, count);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+// Up to capacity samples now in order; the arrays other than channels may be null
+CERELOG_EXPORT size_t cerelog_recovery_pop(void *recovery, int32_t *channels, uint32_t *sample_number,
+                                           uint64_t *timestamp_ns, uint32_t *status, size_t capacity) {
+    recovery_handle *h = static_cast<recovery_handle *>(recovery);
+    cerelog::sample_block out;
+    out.channels = channels;
+    out.sample_number = sample_number;
+    out.timestamp_ns = timestamp_ns;
+    out.status = status;
+    out.capacity = capacity;
+    return h->recovery.pop(out, h->requests);
+}
+
+// Moves up to max_bytes of pending request frames to out, for the serial port; returns how many
+CERELOG_EXPORT size_t cerelog_recovery_requests(void *recovery, uint8_t *out, size_t max_bytes) {
+    std::vector<uint8_t> &requests = static_cast<recovery_handle *>(recovery)->requests;
+    size_t n = std::min(max_bytes, requests.size());
+    std::copy(requests.begin(), requests.begin() + n, out);
+    requests.erase(requests.begin(), requests.begin() + n);
+    return n;
+}
+
+CERELOG_EXPORT void cerelog_recovery_flush(void *recovery) {
+    static_cast<recovery_handle *>(recovery)->recovery.flush();
+}
+
+// Fills counters in the order of the recovery_stats fields, then the samples held; returns how many
+CERELOG_EXPORT size_t cerelog_recovery_stats(void *recovery, uint64_t *counters, size_t max_counters) {
+    const cerelog::gap_recovery &r = static_cast<recovery_handle *>(recovery)->recovery;
+    const cerelog::recovery_stats &s = r.stats();
+    const uint64_t values[] = {
+        s.samples, s.gaps, s.requested, s.requests, s.recovered, s.lost, s.duplicates, s.restarts, r.held(),
+    };
+    size_t n = sizeof(values) / sizeof(values[0]);
+    n = n < max_counters ? n : max_counters;
+    for (size_t i = 0; i < n; i++) {
+        counters[i] = values[i];
+    }
+    return n;
+}
+
+// Returns null if channels or capacity is 0, or fanout is below 2
+CERELOG_EXPORT void *cerelog_pyramid_new(size_t channels, size_t capacity, size_t fanout) {
+    try {
+        return new cerelog::minmax_pyramid(channels, capacity, fanout);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+CERELOG_EXPORT void cerelog_pyramid_free(void *pyramid) {
+    delete static_cast<cerelog::minmax_pyramid *>(pyramid);
+}
+
+// values [count][channels], x [count]
+CERELOG_EXPORT void cerelog_pyramid_append(void *pyramid, const float *values, const double *x, size_t count) {
+    static_cast<cerelog::minmax_pyramid *>(pyramid)->append(values, x, count);
+}
+
+// x has room for 2 * pixels values, values for [2 * pixels][channels]; returns the points written
+CERELOG_EXPORT size_t cerelog_pyramid_query(void *pyramid, uint64_t first, uint64_t count, size_t pixels, double *x,
+                                            float *values) {
+    return static_cast<cerelog::minmax_pyramid *>(pyramid)->query(first, count, pixels, x, values);
+}
+
+// The samples held are [*begin, *end), numbered from 0 in the order appended
+CERELOG_EXPORT void cerelog_pyramid_span(void *pyramid, uint64_t *begin, uint64_t *end) {
+    const cerelog::minmax_pyramid *p = static_cast<cerelog::minmax_pyramid *>(pyramid);
+    *begin = p->begin();
+    *end = p->end();
+}
+
+/* Unpacks count raw frames of a 4, 6 or 8-channel part into channel-major
+   microvolts: out holds channels rows of count floats. status may be null.
+   Returns 0, or -1 for another channel count. */
+CERELOG_EXPORT int cerelog_unpack_frames_uv(const uint8_t *frames, size_t count, size_t channels,
+                                            const float *uv_per_code, float *out, uint32_t *status) {
+    float *rows[8];
+    for (size_t c = 0; c < channels && c < 8; c++) {
+        rows[c] = out + c * count;
+    }
+    switch (channels) {
+    case 4:
+        cerelog::unpack_frames_uv<4>(frames, count, uv_per_code, rows, status);
+        return 0;
+    case 6:
+        cerelog::unpack_frames_uv<6>(frames, count, uv_per_code, rows, status);
+        return 0;
+    case 8:
+        cerelog::unpack_frames_uv<8>(frames, count, uv_per_code, rows, status);
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+CERELOG_EXPORT void cerelog_scale_from_registers(const uint8_t *registers, size_t channels, double vref,
+                                                 float *uv_per_code) {
+    cerelog::scale_from_registers(registers, channels, vref, uv_per_code);
+}
+
+CERELOG_EXPORT size_t cerelog_band_count(void) {
+    return cerelog::kBandCount;
+}
+
+CERELOG_EXPORT const char *cerelog_band_name(size_t band) {
+    return band < cerelog::kBandCount ? cerelog::kBandEdges[band].name : nullptr;
+}
+
+// Returns null if a corner is not below Nyquist or the order is odd
+CERELOG_EXPORT void *cerelog_filter_new(double sample_rate_hz, double mains_hz, double notch_q,
+                                        double dc_cutoff_hz, size_t band_order) {
+    cerelog::filter_bank_config config;
+    config.sample_rate_hz = sample_rate_hz;
+    config.mains_hz = mains_hz;
+    config.notch_q = notch_q;
+    config.dc_cutoff_hz = dc_cutoff_hz;
+    config.band_order = band_order;
+    try {
+        return new cerelog::filter_bank(config);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+CERELOG_EXPORT void cerelog_filter_free(void *filter) {
+    delete static_cast<cerelog::filter_bank *>(filter);
+}
+
+/* in, clean and each band are [count][8]; bands holds cerelog_band_count()
+   of them back to back. clean and bands may be null. */
+CERELOG_EXPORT void cerelog_filter_process(void *filter, const float *in, size_t count, float *clean,
+                                           float *bands) {
+    float *band_out[cerelog::kBandCount];
+    for (size_t b = 0; b < cerelog::kBandCount; b++) {
+        band_out[b] = bands ? bands + b * count * cerelog::filter_bank::kChannels : nullptr;
+    }
+    static_cast<cerelog::filter_bank *>(filter)->process(in, count, clean, band_out);
+}
+
+// Returns null unless fft_size is a power of two >= 16 and 0 < hop <= fft_size
+CERELOG_EXPORT void *cerelog_spectral_new(double sample_rate_hz, size_t channels, size_t fft_size, size_t hop,
+                                          size_t average) {
+    cerelog::spectral_config config;
+    config.sample_rate_hz = sample_rate_hz;
+    config.channels = channels;
+    config.fft_size = fft_size;
+    config.hop = hop;
+    config.average = average;
+    try {
+        return new cerelog::spectral_engine(config);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+CERELOG_EXPORT void cerelog_spectral_free(void *engine) {
+    delete static_cast<cerelog::spectral_engine *>(engine);
+}
+
+CERELOG_EXPORT size_t cerelog_spectral_bins(void *engine) {
+    return static_cast<cerelog::spectral_engine *>(engine)->bins();
+}
+
+/* Pushes count interleaved samples. For each of the first max_frames
+   frames, band_power gets [channels][bands] and columns [channels][bins],
+   back to back; either may be null. count / hop + 1 frames is always
+   enough. Returns the number of frames. */
+CERELOG_EXPORT size_t cerelog_spectral_push(void *engine, const float *in, size_t count, float *band_power,
+                                            float *columns, size_t max_frames) {
+    size_t frames = 0;
+    static_cast<cerelog::spectral_engine *>(engine)->push(in, count, [&](const cerelog::spectral_frame &f) {
+        if (frames < max_frames) {
+            size_t powers = f.channels * cerelog::kBandCount;
+            size_t bins = f.channels * f.bins;
+            if (band_power) {
+                std::copy(f.band_power, f.band_power + powers, band_power + frames * powers);
+            }
+            if (columns) {
+                std::copy(f.column, f.column + bins, columns + frames * bins);
+            }
+        }
+        frames++;
+    });
+    return frames < max_frames ? frames : max_frames;
+}
+
+// Returns null if path cannot be created or chunk_samples is 0; registers may be null
+CERELOG_EXPORT void *cerelog_recorder_new(const char *path, double sample_rate_hz, const uint8_t *registers,
+                                          size_t chunk_samples, size_t flush_samples) {
+    cerelog::recording_config config;
+    config.sample_rate_hz = sample_rate_hz;
+    config.registers = registers;
+    config.chunk_samples = chunk_samples;
+    config.flush_samples = flush_samples;
+    try {
+        return new cerelog::recording_writer(path, config);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+// Closes the file if cerelog_recorder_close was not called
+CERELOG_EXPORT void cerelog_recorder_free(void *recorder) {
+    delete static_cast<cerelog::recording_writer *>(recorder);
+}
+
+// Arrays as cerelog_decoder_decode writes them; all but channels may be null. Returns 0, or -1 on a write error.
+CERELOG_EXPORT int cerelog_recorder_append(void *recorder, const int32_t *channels, const uint32_t *sample_number,
+                                           const uint64_t *timestamp_ns, const uint32_t *status, size_t count) {
+    cerelog::sample_block block;
+    block.channels = const_cast<int32_t *>(channels);
+    block.sample_number = const_cast<uint32_t *>(sample_number);
+    block.timestamp_ns = const_cast<uint64_t *>(timestamp_ns);
+    block.status = const_cast<uint32_t *>(status);
+    block.capacity = count;
+    try {
+        static_cast<cerelog::recording_writer *>(recorder)->append(block, count);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+// Writes the footer; returns 0, or -1 on a write error
+CERELOG_EXPORT int cerelog_recorder_close(void *recorder) {
+    try {
+        static_cast<cerelog::recording_writer *>(recorder)->close();
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+// Returns null if path cannot be mapped or is not a recording
+CERELOG_EXPORT void *cerelog_recording_open(const char *path) {
+    try {
+        return new cerelog::recording_reader(path);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+CERELOG_EXPORT void cerelog_recording_free(void *recording) {
+    delete static_cast<cerelog::recording_reader *>(recording);
+}
+
+/* Samples, whether the index was rebuilt (1) or read from the footer (0),
+   the configured rate and, if registers is not null, the register map */
+CERELOG_EXPORT uint64_t cerelog_recording_info(void *recording, int *recovered, double *sample_rate_hz,
+                                               uint8_t *registers) {
+    const cerelog::recording_reader *r = static_cast<cerelog::recording_reader *>(recording);
+    *recovered = r->recovered();
+    *sample_rate_hz = r->header().sample_rate_hz;
+    if (registers) {
+        std::copy(r->header().registers, r->header().registers + PACKET_REGISTER_BYTES, registers);
+    }
+    return r->size();
+}
+
+// Samples [position, position + count) clipped to the end; sequence gets the 64-bit sample numbers
+CERELOG_EXPORT size_t cerelog_recording_read(void *recording, uint64_t position, size_t count, int32_t *channels,
+                                             uint64_t *sequence, uint64_t *timestamp_ns, uint32_t *status) {
+    cerelog::sample_block out;
+    out.channels = channels;
+    out.timestamp_ns = timestamp_ns;
+    out.status = status;
+    out.capacity = count;
+    return static_cast<cerelog::recording_reader *>(recording)->read(position, count, out, sequence);
+}
+
+// Position of the first sample at or after the sequence (by_time 0) or timestamp (by_time 1)
+CERELOG_EXPORT uint64_t cerelog_recording_find(void *recording, uint64_t value, int by_time) {
+    const cerelog::recording_reader *r = static_cast<cerelog::recording_reader *>(recording);
+    return by_time ? r->find_time(value) : r->find_sequence(value);
+}
+
+/* Opens count ports and starts their readers; device_clocks 1 takes the
+   boards' MCU clocks as one time base. Returns null if a port cannot be
+   opened or the configuration is bad. */
+CERELOG_EXPORT void *cerelog_aggregator_new(const char *const *ports, size_t count, double sample_rate_hz, int baud,
+                                            int device_clocks) {
+    cerelog::aggregator_config config;
+    config.sample_rate_hz = sample_rate_hz;
+    config.baud = baud;
+    config.clocks = device_clocks ? cerelog::time_base::device : cerelog::time_base::host_arrival;
+    try {
+        return new cerelog::aggregator(std::vector<std::string>(ports, ports + count), config);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+// Stops the readers and closes the ports
+CERELOG_EXPORT void cerelog_aggregator_free(void *aggregator) {
+    delete static_cast<cerelog::aggregator *>(aggregator);
+}
+
+CERELOG_EXPORT size_t cerelog_aggregator_boards(void *aggregator) {
+    return static_cast<cerelog::aggregator *>(aggregator)->boards();
+}
+
+// Rows of boards * cerelog_channels() codes; all arrays but channels may be null. Returns the rows written.
+CERELOG_EXPORT size_t cerelog_aggregator_merge(void *aggregator, int32_t *channels, uint32_t *sample_number,
+                                               double *time_ns, uint32_t *held, size_t capacity) {
+    cerelog::merged_block out;
+    out.channels = channels;
+    out.sample_number = sample_number;
+    out.time_ns = time_ns;
+    out.held = held;
+    out.capacity = capacity;
+    return static_cast<cerelog::aggregator *>(aggregator)->merge(out);
+}
+
+// 1 once board 0's port is gone and every row is out
+CERELOG_EXPORT int cerelog_aggregator_finished(void *aggregator) {
+    return static_cast<cerelog::aggregator *>(aggregator)->finished();
+}
+
+/* Per board, in the order of the board_stats fields: counters bytes
+   through held, then stalled and closed as 0 or 1; clocks drift_ppm,
+   jitter_ns and offset_ns. Returns 0, or -1 past the last board. */
+CERELOG_EXPORT int cerelog_aggregator_stats(void *aggregator, size_t board, uint64_t *counters, double *clocks) {
+    std::vector<cerelog::board_stats> stats = static_cast<cerelog::aggregator *>(aggregator)->stats();
+    if (board >= stats.size()) {
+        return -1;
+    }
+    const cerelog::board_stats &s = stats[board];
+    const uint64_t values[] = {
+        s.bytes, s.samples, s.bad_packets, s.missing_samples, s.queue_drops, s.merged, s.skipped, s.held,
+        s.stalled, s.closed,
+    };
+    std::copy(values, values + sizeof(values) / sizeof(values[0]), counters);
+    clocks[0] = s.drift_ppm;
+    clocks[1] = s.jitter_ns;
+    clocks[2] = s.offset_ns;
+    return 0;
+}
\ No newline at end of file
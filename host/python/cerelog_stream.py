@@ -0,0 +1,681 @@
+import ctypes
+import os
+import sys
+
+import numpy as np
+
+# Python binding for the native stream decoder (host/src/stream_decoder.h).
+#
+#   decoder = StreamDecoder()
+#   samples = decoder.feed(ser.read(ser.in_waiting or 1))
+#   samples.channels      -> (n, 8) int32 raw ADS1299 codes
+#   samples.sample_number -> (n,) uint32
+#   samples.timestamp_ns  -> (n,) uint64, DRDY time of each sample's packet (0 for Arduino frames)
+#   samples.status        -> (n,) uint32
+#
+# A board with daisy-chained ADS1299s sends 8 channels per chip;
+# StreamDecoder(chip=k) hands over the k-th chip's, 0 being the first.
+#
+# The arrays are views into buffers the decoder owns and writes in place:
+# no copy is made, and they are overwritten by the next feed(). Copy them
+# (np.copy) to keep them longer.
+#
+# unpack_frames() converts raw 27-byte ADS1299 frames (or 15/21 bytes for the
+# 4/6-channel parts) to microvolts in one call:
+#
+#   uv = unpack_frames(raw, channels=8, registers=marker_registers)  -> (8, n) float32
+#
+# FilterBank filters each new sample once, keeping state between calls, so a
+# live view pays for new samples only:
+#
+#   bank = FilterBank(sample_rate=250, mains_hz=60)
+#   clean, bands = bank.process(uv)   # uv (n, 8) -> clean (n, 8), bands (5, n, 8)
+#   bands[BANDS.index('alpha')]
+#
+# SpectralEngine keeps a sliding Welch estimate and reports band power and a
+# spectrogram column per channel every hop samples:
+#
+#   spectra = SpectralEngine(sample_rate=250, fft_size=256, hop=64)
+#   power, columns = spectra.push(uv)   # (k, 8, 5) uV^2, (k, 8, bins) uV^2/Hz
+#
+# Recorder writes decoded samples to a chunked binary recording
+# (host/src/recording.h) that stays readable if the program dies, and
+# Recording maps one for random access by position, sample number or time:
+#
+#   recorder = Recorder('session.crec', sample_rate=250)
+#   recorder.append(decoder.feed(data))
+#   recorder.close()
+#   rec = Recording('session.crec')
+#   rec.read(rec.find_time(t_ns), 250 * 10)   -> Samples, sample_number as uint64
+#
+# Aggregator reads several boards at once, one native thread per port, and
+# merges them into rows aligned in time by each board's clock model:
+#
+#   agg = Aggregator(['/dev/ttyUSB0', '/dev/ttyUSB1'], sample_rate=250)
+#   rows = agg.merge()                 # rows.channels (n, 16), board 0's 8 first
+#   agg.stats()[1]['drift_ppm'], agg.stats()[1]['held']
+#
+# GapRecovery puts decoded samples back in sample number order and has the
+# board resend what the link lost (firmware CONFIG_CERELOG_RETRANSMIT); its
+# requests go out through write:
+#
+#   recovery = GapRecovery(ser.write)
+#   samples = recovery.push(decoder.feed(ser.read(ser.in_waiting or 1)))
+#   recovery.stats()['recovered'], recovery.stats()['lost']
+#
+# PlotPyramid keeps per-channel min/max levels over a long history, so a
+# plot of any window, seconds or the whole session, gets about 2 points per
+# pixel at a cost set by the plot's width:
+#
+#   pyramid = PlotPyramid(channels=8, capacity=250 * 3600)
+#   pyramid.append(volts, time_ms)               # (n, 8), (n,)
+#   x, y = pyramid.latest(250 * 60, pixels=1000)  # y (m, 8), m <= 2000
+#
+# Build the library with: cmake -S host -B build/host && cmake --build build/host
+# or point CERELOG_NATIVE_LIB at it.
+
+STATS_FIELDS = (
+    'bytes', 'samples', 'single_packets', 'batch_packets', 'marker_packets',
+    'telemetry_packets', 'arduino_frames', 'bad_packets', 'skipped_bytes', 'missing_samples',
+    'chained_packets', 'resent_samples', 'capture_packets',
+)
+
+RECOVERY_STATS_FIELDS = ('samples', 'gaps', 'requested', 'requests', 'recovered', 'lost', 'duplicates', 'restarts',
+                         'held')
+
+_LIB_NAMES = {
+    'win32': 'cerelog_native.dll',
+    'darwin': 'libcerelog_native.dylib',
+}
+
+
+def _find_library():
+    env = os.environ.get('CERELOG_NATIVE_LIB')
+    if env:
+        return env
+    name = _LIB_NAMES.get(sys.platform, 'libcerelog_native.so')
+    here = os.path.dirname(os.path.abspath(__file__))
+    repo = os.path.dirname(os.path.dirname(here))
+    for folder in (here, os.path.join(repo, 'build', 'host'), os.path.join(repo, 'build', 'host', 'Release'),
+                   os.path.join(repo, 'host', 'build')):
+        path = os.path.join(folder, name)
+        if os.path.exists(path):
+            return path
+    raise OSError(f'{name} not found; build host/ with CMake or set CERELOG_NATIVE_LIB')
+
+
+def _load():
+    lib = ctypes.CDLL(_find_library())
+    size_t_p = ctypes.POINTER(ctypes.c_size_t)
+    lib.cerelog_channels.restype = ctypes.c_size_t
+    lib.cerelog_max_packet_samples.restype = ctypes.c_size_t
+    lib.cerelog_decoder_new.restype = ctypes.c_void_p
+    lib.cerelog_decoder_free.argtypes = [ctypes.c_void_p]
+    lib.cerelog_decoder_decode.restype = ctypes.c_longlong
+    lib.cerelog_decoder_decode.argtypes = [
+        ctypes.c_void_p, ctypes.c_void_p, ctypes.c_size_t,
+        ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_size_t,
+        size_t_p,
+    ]
+    lib.cerelog_decoder_select_chip.restype = ctypes.c_int
+    lib.cerelog_decoder_select_chip.argtypes = [ctypes.c_void_p, ctypes.c_size_t]
+    lib.cerelog_decoder_stats.restype = ctypes.c_size_t
+    lib.cerelog_decoder_stats.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_uint64), ctypes.c_size_t]
+    lib.cerelog_recovery_new.restype = ctypes.c_void_p
+    lib.cerelog_recovery_new.argtypes = [ctypes.c_int, ctypes.c_int, ctypes.c_size_t]
+    lib.cerelog_recovery_free.argtypes = [ctypes.c_void_p]
+    lib.cerelog_recovery_push.restype = ctypes.c_int
+    lib.cerelog_recovery_push.argtypes = [
+        ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_size_t,
+    ]
+    lib.cerelog_recovery_pop.restype = ctypes.c_size_t
+    lib.cerelog_recovery_pop.argtypes = [
+        ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_size_t,
+    ]
+    lib.cerelog_recovery_requests.restype = ctypes.c_size_t
+    lib.cerelog_recovery_requests.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_size_t]
+    lib.cerelog_recovery_flush.argtypes = [ctypes.c_void_p]
+    lib.cerelog_recovery_stats.restype = ctypes.c_size_t
+    lib.cerelog_recovery_stats.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_uint64), ctypes.c_size_t]
+    lib.cerelog_pyramid_new.restype = ctypes.c_void_p
+    lib.cerelog_pyramid_new.argtypes = [ctypes.c_size_t, ctypes.c_size_t, ctypes.c_size_t]
+    lib.cerelog_pyramid_free.argtypes = [ctypes.c_void_p]
+    lib.cerelog_pyramid_append.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_size_t]
+    lib.cerelog_pyramid_query.restype = ctypes.c_size_t
+    lib.cerelog_pyramid_query.argtypes = [
+        ctypes.c_void_p, ctypes.c_uint64, ctypes.c_uint64, ctypes.c_size_t, ctypes.c_void_p, ctypes.c_void_p,
+    ]
+    lib.cerelog_pyramid_span.argtypes = [
+        ctypes.c_void_p, ctypes.POINTER(ctypes.c_uint64), ctypes.POINTER(ctypes.c_uint64),
+    ]
+    lib.cerelog_unpack_frames_uv.restype = ctypes.c_int
+    lib.cerelog_unpack_frames_uv.argtypes = [
+        ctypes.c_void_p, ctypes.c_size_t, ctypes.c_size_t, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p,
+    ]
+    lib.cerelog_scale_from_registers.argtypes = [ctypes.c_void_p, ctypes.c_size_t, ctypes.c_double, ctypes.c_void_p]
+    lib.cerelog_band_count.restype = ctypes.c_size_t
+    lib.cerelog_band_name.restype = ctypes.c_char_p
+    lib.cerelog_band_name.argtypes = [ctypes.c_size_t]
+    lib.cerelog_filter_new.restype = ctypes.c_void_p
+    lib.cerelog_filter_new.argtypes = [
+        ctypes.c_double, ctypes.c_double, ctypes.c_double, ctypes.c_double, ctypes.c_size_t,
+    ]
+    lib.cerelog_filter_free.argtypes = [ctypes.c_void_p]
+    lib.cerelog_filter_process.argtypes = [
+        ctypes.c_void_p, ctypes.c_void_p, ctypes.c_size_t, ctypes.c_void_p, ctypes.c_void_p,
+    ]
+    lib.cerelog_spectral_new.restype = ctypes.c_void_p
+    lib.cerelog_spectral_new.argtypes = [
+        ctypes.c_double, ctypes.c_size_t, ctypes.c_size_t, ctypes.c_size_t, ctypes.c_size_t,
+    ]
+    lib.cerelog_spectral_free.argtypes = [ctypes.c_void_p]
+    lib.cerelog_spectral_bins.restype = ctypes.c_size_t
+    lib.cerelog_spectral_bins.argtypes = [ctypes.c_void_p]
+    lib.cerelog_spectral_push.restype = ctypes.c_size_t
+    lib.cerelog_spectral_push.argtypes = [
+        ctypes.c_void_p, ctypes.c_void_p, ctypes.c_size_t, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_size_t,
+    ]
+    lib.cerelog_recorder_new.restype = ctypes.c_void_p
+    lib.cerelog_recorder_new.argtypes = [
+        ctypes.c_char_p, ctypes.c_double, ctypes.c_void_p, ctypes.c_size_t, ctypes.c_size_t,
+    ]
+    lib.cerelog_recorder_free.argtypes = [ctypes.c_void_p]
+    lib.cerelog_recorder_append.restype = ctypes.c_int
+    lib.cerelog_recorder_append.argtypes = [
+        ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_size_t,
+    ]
+    lib.cerelog_recorder_close.restype = ctypes.c_int
+    lib.cerelog_recorder_close.argtypes = [ctypes.c_void_p]
+    lib.cerelog_recording_open.restype = ctypes.c_void_p
+    lib.cerelog_recording_open.argtypes = [ctypes.c_char_p]
+    lib.cerelog_recording_free.argtypes = [ctypes.c_void_p]
+    lib.cerelog_recording_info.restype = ctypes.c_uint64
+    lib.cerelog_recording_info.argtypes = [
+        ctypes.c_void_p, ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_double), ctypes.c_void_p,
+    ]
+    lib.cerelog_recording_read.restype = ctypes.c_size_t
+    lib.cerelog_recording_read.argtypes = [
+        ctypes.c_void_p, ctypes.c_uint64, ctypes.c_size_t,
+        ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p,
+    ]
+    lib.cerelog_recording_find.restype = ctypes.c_uint64
+    lib.cerelog_recording_find.argtypes = [ctypes.c_void_p, ctypes.c_uint64, ctypes.c_int]
+    lib.cerelog_aggregator_new.restype = ctypes.c_void_p
+    lib.cerelog_aggregator_new.argtypes = [
+        ctypes.POINTER(ctypes.c_char_p), ctypes.c_size_t, ctypes.c_double, ctypes.c_int, ctypes.c_int,
+    ]
+    lib.cerelog_aggregator_free.argtypes = [ctypes.c_void_p]
+    lib.cerelog_aggregator_boards.restype = ctypes.c_size_t
+    lib.cerelog_aggregator_boards.argtypes = [ctypes.c_void_p]
+    lib.cerelog_aggregator_merge.restype = ctypes.c_size_t
+    lib.cerelog_aggregator_merge.argtypes = [
+        ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_size_t,
+    ]
+    lib.cerelog_aggregator_finished.restype = ctypes.c_int
+    lib.cerelog_aggregator_finished.argtypes = [ctypes.c_void_p]
+    lib.cerelog_aggregator_stats.restype = ctypes.c_int
+    lib.cerelog_aggregator_stats.argtypes = [
+        ctypes.c_void_p, ctypes.c_size_t, ctypes.POINTER(ctypes.c_uint64), ctypes.POINTER(ctypes.c_double),
+    ]
+    return lib
+
+
+_lib = None
+
+
+def _shared_lib():
+    global _lib
+    if _lib is None:
+        _lib = _load()
+    return _lib
+
+
+def scale_from_registers(registers, channels=8, vref=4.5):
+    # Microvolts per code of each channel from the register map (ID first, as in marker packets)
+    regs = np.ascontiguousarray(np.frombuffer(bytes(registers), dtype=np.uint8))
+    scale = np.empty(channels, dtype=np.float32)
+    _shared_lib().cerelog_scale_from_registers(regs.ctypes.data, channels, vref, scale.ctypes.data)
+    return scale
+
+
+def unpack_frames(data, channels=8, registers=None, vref=4.5, gain=24, status=False):
+    # Raw back-to-back frames -> (channels, n) float32 microvolts, and the status words if asked.
+    # Without registers every channel uses gain.
+    frame_bytes = 3 + 3 * channels
+    raw = np.frombuffer(data, dtype=np.uint8)
+    count = len(raw) // frame_bytes
+    if registers is not None:
+        scale = scale_from_registers(registers, channels, vref)
+    else:
+        scale = np.full(channels, 2 * vref / gain / 2 ** 24 * 1e6, dtype=np.float32)
+
+    out = np.empty((channels, count), dtype=np.float32)
+    status_out = np.empty(count, dtype=np.uint32) if status else None
+    ret = _shared_lib().cerelog_unpack_frames_uv(
+        raw.ctypes.data, count, channels, scale.ctypes.data, out.ctypes.data,
+        status_out.ctypes.data if status else None)
+    if ret < 0:
+        raise ValueError(f'{channels} channels: the ADS1299 family has 4, 6 or 8')
+    return (out, status_out) if status else out
+
+
+class Samples:
+    def __init__(self, channels, sample_number, timestamp_ns, status):
+        self.channels = channels
+        self.sample_number = sample_number
+        self.timestamp_ns = timestamp_ns
+        self.status = status
+
+    def __len__(self):
+        return len(self.sample_number)
+
+
+class StreamDecoder:
+    # chip picks which ADS1299 of a daisy-chained board the eight channels come from
+    def __init__(self, capacity=8192, chip=0):
+        self._lib = _shared_lib()
+        self._handle = self._lib.cerelog_decoder_new()
+        if not self._handle:
+            raise MemoryError('cerelog_decoder_new failed')
+        self.select_chip(chip)
+        self._channels = self._lib.cerelog_channels()
+        self._max_packet_samples = self._lib.cerelog_max_packet_samples()
+        self._allocate(max(capacity, self._max_packet_samples))
+
+    def __del__(self):
+        if getattr(self, '_handle', None):
+            self._lib.cerelog_decoder_free(self._handle)
+            self._handle = None
+
+    def _allocate(self, capacity):
+        self._capacity = capacity
+        self._channel_buf = np.empty((capacity, self._channels), dtype=np.int32)
+        self._number_buf = np.empty(capacity, dtype=np.uint32)
+        self._time_buf = np.empty(capacity, dtype=np.uint64)
+        self._status_buf = np.empty(capacity, dtype=np.uint32)
+
+    def feed(self, data):
+        # Accepts bytes, bytearray or any contiguous buffer; it is read in place
+        view = memoryview(data).cast('B')
+        if view.readonly and not isinstance(data, bytes):
+            data = view = bytes(view)
+        length = len(view)
+        if not length:
+            address = 0
+        elif isinstance(data, bytes):
+            address = ctypes.cast(ctypes.c_char_p(data), ctypes.c_void_p).value
+        else:
+            address = ctypes.addressof(ctypes.c_char.from_buffer(view))
+
+        written = 0
+        offset = 0
+        consumed = ctypes.c_size_t(0)
+        while True:
+            # The decoder needs room for a whole packet before it will start one
+            if self._capacity - written < self._max_packet_samples:
+                self._grow(written)
+            n = self._lib.cerelog_decoder_decode(
+                self._handle, address + offset, length - offset,
+                self._channel_buf[written:].ctypes.data, self._number_buf[written:].ctypes.data,
+                self._time_buf[written:].ctypes.data, self._status_buf[written:].ctypes.data,
+                self._capacity - written, ctypes.byref(consumed))
+            if n < 0:
+                raise RuntimeError('cerelog_decoder_decode rejected the output buffers')
+            written += n
+            offset += consumed.value
+            if offset >= length:
+                break
+
+        return Samples(self._channel_buf[:written], self._number_buf[:written],
+                       self._time_buf[:written], self._status_buf[:written])
+
+    def _grow(self, keep):
+        old = (self._channel_buf, self._number_buf, self._time_buf, self._status_buf)
+        self._allocate(self._capacity * 2)
+        for new, previous in zip((self._channel_buf, self._number_buf, self._time_buf, self._status_buf), old):
+            new[:keep] = previous[:keep]
+
+    def select_chip(self, chip):
+        if self._lib.cerelog_decoder_select_chip(self._handle, chip) != 0:
+            raise ValueError(f'chip {chip} is past the longest daisy chain')
+
+    def stats(self):
+        counters = (ctypes.c_uint64 * len(STATS_FIELDS))()
+        n = self._lib.cerelog_decoder_stats(self._handle, counters, len(STATS_FIELDS))
+        return dict(zip(STATS_FIELDS[:n], counters[:n]))
+
+
+class GapRecovery:
+    # Holds samples behind a sample number gap until the board resends the missing ones, for up to
+    # hold_ms. write takes the CMD_RESEND request bytes, e.g. ser.write; with None, as for a replayed
+    # capture, gaps are only waited out. The arrays returned are overwritten by the next call.
+    def __init__(self, write=None, hold_ms=500, retry_ms=150, max_held=65536, capacity=8192):
+        self._lib = _shared_lib()
+        self._handle = self._lib.cerelog_recovery_new(hold_ms, retry_ms, max_held)
+        if not self._handle:
+            raise ValueError('hold_ms and retry_ms must be positive, max_held at least 1')
+        self._write = write
+        self._channels = self._lib.cerelog_channels()
+        self._requests = ctypes.create_string_buffer(4096)
+        self._allocate(capacity)
+
+    def __del__(self):
+        if getattr(self, '_handle', None):
+            self._lib.cerelog_recovery_free(self._handle)
+            self._handle = None
+
+    def _allocate(self, capacity):
+        self._capacity = capacity
+        self._channel_buf = np.empty((capacity, self._channels), dtype=np.int32)
+        self._number_buf = np.empty(capacity, dtype=np.uint32)
+        self._time_buf = np.empty(capacity, dtype=np.uint64)
+        self._status_buf = np.empty(capacity, dtype=np.uint32)
+
+    def push(self, samples):
+        # samples: a Samples from StreamDecoder.feed(), possibly empty; returns the Samples now in order
+        n = len(samples)
+        if n:
+            arrays = (np.ascontiguousarray(samples.channels, dtype=np.int32),
+                      np.ascontiguousarray(samples.sample_number, dtype=np.uint32),
+                      np.ascontiguousarray(samples.timestamp_ns, dtype=np.uint64),
+                      np.ascontiguousarray(samples.status, dtype=np.uint32))
+            self._lib.cerelog_recovery_push(self._handle, *(a.ctypes.data for a in arrays), n)
+        return self._pop()
+
+    def flush(self):
+        # Gives up on every gap and returns all that was held, at the end of a stream
+        self._lib.cerelog_recovery_flush(self._handle)
+        return self._pop()
+
+    def _pop(self):
+        written = 0
+        while True:
+            n = self._lib.cerelog_recovery_pop(
+                self._handle, self._channel_buf[written:].ctypes.data, self._number_buf[written:].ctypes.data,
+                self._time_buf[written:].ctypes.data, self._status_buf[written:].ctypes.data,
+                self._capacity - written)
+            written += n
+            if written < self._capacity:
+                break
+            old = (self._channel_buf, self._number_buf, self._time_buf, self._status_buf)
+            self._allocate(self._capacity * 2)
+            for new, previous in zip((self._channel_buf, self._number_buf, self._time_buf, self._status_buf), old):
+                new[:written] = previous[:written]
+
+        while True:
+            length = self._lib.cerelog_recovery_requests(self._handle, self._requests, len(self._requests))
+            if not length:
+                break
+            if self._write is not None:
+                self._write(self._requests.raw[:length])
+
+        return Samples(self._channel_buf[:written], self._number_buf[:written],
+                       self._time_buf[:written], self._status_buf[:written])
+
+    def stats(self):
+        counters = (ctypes.c_uint64 * len(RECOVERY_STATS_FIELDS))()
+        n = self._lib.cerelog_recovery_stats(self._handle, counters, len(RECOVERY_STATS_FIELDS))
+        return dict(zip(RECOVERY_STATS_FIELDS[:n], counters[:n]))
+
+
+class PlotPyramid:
+    # Min/max level-of-detail store over the last capacity samples (host/src/minmax_pyramid.h). Each
+    # query pixel gets its samples' min and max, exactly, whatever the window.
+    def __init__(self, channels=8, capacity=250 * 600, fanout=4):
+        self._lib = _shared_lib()
+        self._handle = self._lib.cerelog_pyramid_new(channels, capacity, fanout)
+        if not self._handle:
+            raise ValueError('channels and capacity must be at least 1, fanout at least 2')
+        self.channels = channels
+
+    def __del__(self):
+        if getattr(self, '_handle', None):
+            self._lib.cerelog_pyramid_free(self._handle)
+            self._handle = None
+
+    def append(self, values, x):
+        # values (n, channels), x (n,) non-decreasing, e.g. time in ms
+        values = np.ascontiguousarray(values, dtype=np.float32).reshape(-1, self.channels)
+        x = np.ascontiguousarray(x, dtype=np.float64)
+        if len(x) != len(values):
+            raise ValueError('values and x differ in length')
+        if len(x):
+            self._lib.cerelog_pyramid_append(self._handle, values.ctypes.data, x.ctypes.data, len(x))
+
+    def span(self):
+        # (begin, end): sample numbers of the oldest held and one past the newest
+        begin = ctypes.c_uint64()
+        end = ctypes.c_uint64()
+        self._lib.cerelog_pyramid_span(self._handle, ctypes.byref(begin), ctypes.byref(end))
+        return begin.value, end.value
+
+    def query(self, first, count, pixels):
+        # Samples [first, first + count) for a plot pixels wide -> x (m,), values (m, channels), m <= 2 * pixels
+        x = np.empty(2 * pixels, dtype=np.float64)
+        values = np.empty((2 * pixels, self.channels), dtype=np.float32)
+        n = self._lib.cerelog_pyramid_query(self._handle, first, count, pixels, x.ctypes.data, values.ctypes.data)
+        return x[:n], values[:n]
+
+    def latest(self, count, pixels):
+        # The newest count samples; count None for everything held
+        begin, end = self.span()
+        first = begin if count is None else max(begin, end - count)
+        return self.query(first, end - first, pixels)
+
+
+def band_names():
+    lib = _shared_lib()
+    return tuple(lib.cerelog_band_name(i).decode() for i in range(lib.cerelog_band_count()))
+
+
+class FilterBank:
+    # DC high-pass, mains notch and the EEG bands (host/src/filter_bank.h), 8 channels at once
+    def __init__(self, sample_rate, mains_hz=60.0, notch_q=30.0, dc_cutoff_hz=0.1, order=4):
+        self._lib = _shared_lib()
+        self.bands = band_names()
+        self._handle = self._lib.cerelog_filter_new(sample_rate, mains_hz, notch_q, dc_cutoff_hz, order)
+        if not self._handle:
+            raise ValueError(f'filter corners must lie below {sample_rate / 2} Hz and order must be even')
+        self._channels = self._lib.cerelog_channels()
+        self._allocate(1024)
+
+    def __del__(self):
+        if getattr(self, '_handle', None):
+            self._lib.cerelog_filter_free(self._handle)
+            self._handle = None
+
+    def _allocate(self, capacity):
+        self._capacity = capacity
+        self._clean = np.empty((capacity, self._channels), dtype=np.float32)
+        self._band_buf = np.empty(len(self.bands) * capacity * self._channels, dtype=np.float32)
+
+    def process(self, samples):
+        # samples: (n, 8), any real dtype. Returns views valid until the next call.
+        data = np.ascontiguousarray(samples, dtype=np.float32)
+        n = len(data)
+        if n > self._capacity:
+            self._allocate(max(n, 2 * self._capacity))
+        bands = self._band_buf[:len(self.bands) * n * self._channels].reshape(len(self.bands), n, self._channels)
+        self._lib.cerelog_filter_process(self._handle, data.ctypes.data, n, self._clean.ctypes.data,
+                                         bands.ctypes.data)
+        return self._clean[:n], bands
+
+
+class SpectralEngine:
+    # Sliding Welch band power and spectrogram (host/src/spectral.h)
+    def __init__(self, sample_rate, channels=8, fft_size=256, hop=64, average=8):
+        self._lib = _shared_lib()
+        self._handle = self._lib.cerelog_spectral_new(sample_rate, channels, fft_size, hop, average)
+        if not self._handle:
+            raise ValueError('fft_size must be a power of two >= 16 and hop between 1 and fft_size')
+        self.bands = band_names()
+        self.channels = channels
+        self.hop = hop
+        self.bins = self._lib.cerelog_spectral_bins(self._handle)
+        self.bin_hz = sample_rate / fft_size
+
+    def __del__(self):
+        if getattr(self, '_handle', None):
+            self._lib.cerelog_spectral_free(self._handle)
+            self._handle = None
+
+    def push(self, samples):
+        # samples: (n, channels). Returns band power (k, channels, bands) and columns (k, channels, bins)
+        # for the k segments that closed, oldest first.
+        data = np.ascontiguousarray(samples, dtype=np.float32)
+        most = len(data) // self.hop + 1
+        power = np.empty((most, self.channels, len(self.bands)), dtype=np.float32)
+        columns = np.empty((most, self.channels, self.bins), dtype=np.float32)
+        k = self._lib.cerelog_spectral_push(self._handle, data.ctypes.data, len(data), power.ctypes.data,
+                                            columns.ctypes.data, most)
+        return power[:k], columns[:k]
+
+
+class Recorder:
+    # Chunked binary recording (host/src/recording.h). The part-filled chunk reaches the file every
+    # flush_samples, so a crash loses at most that many samples; close() adds the index.
+    def __init__(self, path, sample_rate=250.0, registers=None, chunk_samples=4096, flush_samples=250):
+        self._lib = _shared_lib()
+        regs = bytes(registers) if registers is not None else None
+        if regs is not None and len(regs) != 24:
+            raise ValueError('registers must be the 24-byte map, ID first')
+        self._handle = self._lib.cerelog_recorder_new(os.fsencode(path), sample_rate, regs, chunk_samples,
+                                                      flush_samples)
+        if not self._handle:
+            raise OSError(f'cannot create recording {path}')
+
+    def __del__(self):
+        if getattr(self, '_handle', None):
+            self._lib.cerelog_recorder_free(self._handle)
+            self._handle = None
+
+    def append(self, samples):
+        # samples: a Samples from StreamDecoder.feed()
+        n = len(samples)
+        if not n:
+            return
+        arrays = (np.ascontiguousarray(samples.channels, dtype=np.int32),
+                  np.ascontiguousarray(samples.sample_number, dtype=np.uint32),
+                  np.ascontiguousarray(samples.timestamp_ns, dtype=np.uint64),
+                  np.ascontiguousarray(samples.status, dtype=np.uint32))
+        if self._lib.cerelog_recorder_append(self._handle, *(a.ctypes.data for a in arrays), n) < 0:
+            raise OSError('recording write failed')
+
+    def close(self):
+        if self._handle:
+            failed = self._lib.cerelog_recorder_close(self._handle)
+            self._lib.cerelog_recorder_free(self._handle)
+            self._handle = None
+            if failed:
+                raise OSError('recording close failed')
+
+
+class Recording:
+    # Read-only, memory-mapped view of a recording; reads cost the same anywhere in the file
+    def __init__(self, path):
+        self._lib = _shared_lib()
+        self._handle = self._lib.cerelog_recording_open(os.fsencode(path))
+        if not self._handle:
+            raise OSError(f'{path} is not a readable recording')
+        recovered = ctypes.c_int(0)
+        rate = ctypes.c_double(0)
+        self.registers = (ctypes.c_uint8 * 24)()
+        self._size = self._lib.cerelog_recording_info(self._handle, ctypes.byref(recovered), ctypes.byref(rate),
+                                                      self.registers)
+        self.registers = bytes(self.registers)
+        self.recovered = bool(recovered.value)    # No index footer: the writer did not finish
+        self.sample_rate = rate.value
+        self._channels = self._lib.cerelog_channels()
+
+    def __del__(self):
+        if getattr(self, '_handle', None):
+            self._lib.cerelog_recording_free(self._handle)
+            self._handle = None
+
+    def __len__(self):
+        return self._size
+
+    def read(self, position, count):
+        # Samples [position, position + count), clipped to the end; copies the caller owns
+        count = max(0, min(count, self._size - position))
+        channels = np.empty((count, self._channels), dtype=np.int32)
+        sequence = np.empty(count, dtype=np.uint64)
+        timestamps = np.empty(count, dtype=np.uint64)
+        status = np.empty(count, dtype=np.uint32)
+        if count:
+            self._lib.cerelog_recording_read(self._handle, position, count, channels.ctypes.data,
+                                             sequence.ctypes.data, timestamps.ctypes.data, status.ctypes.data)
+        return Samples(channels, sequence, timestamps, status)
+
+    def find_sample(self, sample_number):
+        # Position of the first sample numbered at or after sample_number (64-bit, unwrapped)
+        return self._lib.cerelog_recording_find(self._handle, sample_number, 0)
+
+    def find_time(self, timestamp_ns):
+        # Position of the first sample stamped at or after timestamp_ns
+        return self._lib.cerelog_recording_find(self._handle, timestamp_ns, 1)
+
+
+BOARD_STATS_FIELDS = ('bytes', 'samples', 'bad_packets', 'missing_samples', 'queue_drops', 'merged', 'skipped',
+                      'held', 'stalled', 'closed')
+BOARD_CLOCK_FIELDS = ('drift_ppm', 'jitter_ns', 'offset_ns')
+
+
+class MergedRows:
+    def __init__(self, channels, sample_number, time_ns, held):
+        self.channels = channels            # (n, boards * 8) int32 raw codes, board 0's channels first
+        self.sample_number = sample_number  # (n,) uint32, board 0's
+        self.time_ns = time_ns              # (n,) float64 on the common time base
+        self.held = held                    # (n,) uint32, bit b set where board b repeats its last sample
+
+    def __len__(self):
+        return len(self.sample_number)
+
+
+class Aggregator:
+    # Several boards, one reader thread each in native code, merged into rows aligned in time
+    # (host/src/aggregator.h). Takes the place of one Python reader process and lock per board.
+    def __init__(self, ports, sample_rate=250.0, baud=921600, device_clocks=False, capacity=8192):
+        self._lib = _shared_lib()
+        names = (ctypes.c_char_p * len(ports))(*(os.fsencode(p) for p in ports))
+        self._handle = self._lib.cerelog_aggregator_new(names, len(ports), sample_rate, baud, int(device_clocks))
+        if not self._handle:
+            raise OSError(f'cannot open {", ".join(ports)}')
+        self.ports = list(ports)
+        self.channels = self._lib.cerelog_aggregator_boards(self._handle) * self._lib.cerelog_channels()
+        self._capacity = capacity
+
+    def __del__(self):
+        if getattr(self, '_handle', None):
+            self._lib.cerelog_aggregator_free(self._handle)
+            self._handle = None
+
+    def close(self):
+        self.__del__()
+
+    def merge(self):
+        # The rows complete so far; empty when no board has anything new. Never blocks.
+        channels = np.empty((self._capacity, self.channels), dtype=np.int32)
+        numbers = np.empty(self._capacity, dtype=np.uint32)
+        times = np.empty(self._capacity, dtype=np.float64)
+        held = np.empty(self._capacity, dtype=np.uint32)
+        n = self._lib.cerelog_aggregator_merge(self._handle, channels.ctypes.data, numbers.ctypes.data,
+                                               times.ctypes.data, held.ctypes.data, self._capacity)
+        return MergedRows(channels[:n], numbers[:n], times[:n], held[:n])
+
+    @property
+    def finished(self):
+        return bool(self._lib.cerelog_aggregator_finished(self._handle))
+
+    def stats(self):
+        # One dict per board: counters, drift and jitter of its clock, offset from board 0 in ns
+        out = []
+        counters = (ctypes.c_uint64 * len(BOARD_STATS_FIELDS))()
+        clocks = (ctypes.c_double * len(BOARD_CLOCK_FIELDS))()
+        for board, port in enumerate(self.ports):
+            self._lib.cerelog_aggregator_stats(self._handle, board, counters, clocks)
+            s = dict(zip(BOARD_STATS_FIELDS, counters))
+            s.update(zip(BOARD_CLOCK_FIELDS, clocks))
+            s['port'] = port
+            out.append(s)
+        return out
\ No newline at end of file
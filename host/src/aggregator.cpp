@@ -0,0 +1,290 @@
+#include "aggregator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+namespace cerelog {
+
+namespace {
+
+// How far an MCU clock may run from the host's, for the arrival offset to creep up by
+constexpr double kClockSkew = 200e-6;
+constexpr int kReadTimeoutMs = 50;
+/* A board's sample joins a row within this many periods of it. A little
+   over a half, so a board whose phase sits on the boundary is not pushed
+   back and forth across it by arrival jitter, a skip and a hold each time. */
+constexpr double kAlignWindow = 0.6;
+
+int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+aggregator::aggregator(const std::vector<std::string> &ports, const aggregator_config &config)
+    : config_(config) {
+    if (ports.empty() || ports.size() > kMaxBoards) {
+        throw std::invalid_argument("aggregator: between 1 and 32 ports are needed");
+    }
+    if (!(config.sample_rate_hz > 0.0) || !(config.stall_seconds > 0.0) || config.queue_samples < kMaxPacketSamples ||
+        config.read_bytes == 0) {
+        throw std::invalid_argument("aggregator: bad configuration");
+    }
+    size_t ring = 1;
+    while (ring < config.queue_samples) {
+        ring <<= 1;
+    }
+
+    // Every port opens before any reader starts; a failure closes those already open
+    int64_t start = now_ns();
+    for (const std::string &path : ports) {
+        std::unique_ptr<board> b(new board);
+        b->port.reset(new serial_port(path, config.baud));
+        b->clock.reset(new clock_model(config.sample_rate_hz, config.clock_time_constant_s));
+        b->ring.resize(ring);
+        b->mask = ring - 1;
+        b->last_arrival_ns.store(start, std::memory_order_relaxed);
+        boards_.push_back(std::move(b));
+    }
+    for (auto &b : boards_) {
+        board *p = b.get();
+        p->reader = std::thread([this, p] { read_loop(*p); });
+    }
+}
+
+aggregator::~aggregator() {
+    stop_.store(true, std::memory_order_relaxed);
+    for (auto &b : boards_) {
+        if (b->reader.joinable()) {
+            b->reader.join();
+        }
+    }
+}
+
+void aggregator::read_loop(board &b) {
+    std::vector<uint8_t> data(config_.read_bytes);
+    size_t capacity = std::max<size_t>(kMaxPacketSamples, config_.read_bytes / 8);
+    std::vector<int32_t> channels(capacity * kChannels);
+    std::vector<uint32_t> sample_number(capacity);
+    std::vector<uint64_t> timestamp(capacity);
+    std::vector<uint32_t> status(capacity);
+    sample_block block;
+    block.channels = channels.data();
+    block.sample_number = sample_number.data();
+    block.timestamp_ns = timestamp.data();
+    block.status = status.data();
+    block.capacity = capacity;
+
+    while (!stop_.load(std::memory_order_relaxed)) {
+        long got = b.port->read(data.data(), data.size(), kReadTimeoutMs);
+        if (got < 0) {
+            break;
+        }
+        if (got == 0) {
+            continue;
+        }
+        int64_t arrival = now_ns();
+        size_t pos = 0;
+        while (pos < size_t(got)) {
+            size_t consumed = 0;
+            size_t n = b.decoder.decode(data.data() + pos, size_t(got) - pos, block, &consumed);
+            pos += consumed;
+            if (n) {
+                publish(b, block, n, arrival);
+            }
+        }
+        // Markers and telemetry are not merged; drained so they do not pile up
+        b.decoder.take_markers();
+        b.decoder.take_telemetry();
+
+        const decoder_stats &d = b.decoder.stats();
+        b.bytes.store(d.bytes, std::memory_order_relaxed);
+        b.samples.store(d.samples, std::memory_order_relaxed);
+        b.bad_packets.store(d.bad_packets, std::memory_order_relaxed);
+        b.missing_samples.store(d.missing_samples, std::memory_order_relaxed);
+        b.drift_ppm.store(b.clock->drift_ppm(), std::memory_order_relaxed);
+        b.jitter_ns.store(b.clock->jitter_ns(), std::memory_order_relaxed);
+        b.published_offset_ns.store(b.offset_ns, std::memory_order_relaxed);
+        b.last_arrival_ns.store(arrival, std::memory_order_relaxed);
+    }
+    b.closed.store(true, std::memory_order_release);
+}
+
+/* Feeds each packet's timestamp to the clock model, then queues the
+   samples with their model times. A packet is a run of samples sharing one
+   timestamp with consecutive numbers; Arduino frames carry none, and their
+   times follow the sample numbers at the nominal rate. */
+void aggregator::publish(board &b, const sample_block &block, size_t count, int64_t arrival_ns) {
+    for (size_t i = 0; i < count;) {
+        size_t j = i + 1;
+        while (j < count && block.timestamp_ns[j] == block.timestamp_ns[i] &&
+               block.sample_number[j] == block.sample_number[j - 1] + 1) {
+            j++;
+        }
+        if (block.timestamp_ns[i]) {
+            b.clock->observe(block.sample_number[i], uint32_t(j - i), block.timestamp_ns[i]);
+        }
+        i = j;
+    }
+
+    if (config_.clocks == time_base::host_arrival) {
+        // The last sample was converted before these bytes arrived
+        double bound = double(arrival_ns) - b.clock->sample_time_ns(block.sample_number[count - 1]);
+        if (!b.have_offset) {
+            b.offset_ns = bound;
+            b.have_offset = true;
+        } else {
+            double creep = double(arrival_ns - b.last_read_ns) * kClockSkew;
+            b.offset_ns = std::min(b.offset_ns + creep, bound);
+        }
+        b.last_read_ns = arrival_ns;
+    }
+
+    size_t head = b.head.load(std::memory_order_relaxed);
+    size_t tail = b.tail.load(std::memory_order_acquire);
+    while (config_.wait_when_full && b.ring.size() - (head - tail) < count && !stop_.load(std::memory_order_relaxed)) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        tail = b.tail.load(std::memory_order_acquire);
+    }
+    size_t room = b.ring.size() - (head - tail);
+    size_t n = std::min(count, room);
+    for (size_t i = 0; i < n; i++) {
+        queued_sample &q = b.ring[(head + i) & b.mask];
+        std::memcpy(q.channels, block.channels + i * kChannels, sizeof(q.channels));
+        q.sample_number = block.sample_number[i];
+        q.status = block.status[i];
+        q.time_ns = b.clock->sample_time_ns(block.sample_number[i]) + b.offset_ns;
+    }
+    b.head.store(head + n, std::memory_order_release);
+    if (n < count) {
+        b.queue_drops.fetch_add(count - n, std::memory_order_relaxed);
+    }
+}
+
+bool aggregator::stalled(const board &b, int64_t now) const {
+    return b.closed.load(std::memory_order_acquire) ||
+           double(now - b.last_arrival_ns.load(std::memory_order_relaxed)) > config_.stall_seconds * 1e9;
+}
+
+/* A row is only written once every board can decide on it: a sample near
+   the row's time, one past it (the board has none there), or a stall. So
+   rows never change after the fact, and merge waits at most stall_seconds
+   for a slow board. */
+size_t aggregator::merge(const merged_block &out) {
+    enum class pick { take, hold };
+    const size_t width = channels();
+    const double window = kAlignWindow * 1e9 / config_.sample_rate_hz;
+    board &ref = *boards_[0];
+    pick picks[kMaxBoards];
+    int64_t now = 0;
+    size_t written = 0;
+
+    while (written < out.capacity) {
+        size_t ref_tail = ref.tail.load(std::memory_order_relaxed);
+        if (ref_tail == ref.head.load(std::memory_order_acquire)) {
+            break;
+        }
+        const queued_sample &r = ref.ring[ref_tail & ref.mask];
+
+        bool ready = true;
+        for (size_t k = 1; k < boards_.size() && ready; k++) {
+            board &b = *boards_[k];
+            size_t tail = b.tail.load(std::memory_order_relaxed);
+            while (true) {
+                if (tail == b.head.load(std::memory_order_acquire)) {
+                    // Nothing queued: hold a board that has stalled, wait for one that has not
+                    if (!now) {
+                        now = now_ns();
+                    }
+                    // Samples queued just before the stall was seen still count
+                    if (stalled(b, now) && tail == b.head.load(std::memory_order_acquire)) {
+                        picks[k] = pick::hold;
+                    } else {
+                        ready = false;
+                    }
+                    break;
+                }
+                double dt = b.ring[tail & b.mask].time_ns - r.time_ns;
+                if (dt < -window) {
+                    // Earlier than this row and every later one
+                    tail++;
+                    b.skipped++;
+                    continue;
+                }
+                picks[k] = dt > window ? pick::hold : pick::take;
+                break;
+            }
+            b.tail.store(tail, std::memory_order_release);
+        }
+        if (!ready) {
+            break;
+        }
+
+        int32_t *row = out.channels + written * width;
+        uint32_t held = 0;
+        std::memcpy(row, r.channels, sizeof(r.channels));
+        ref.merged++;
+        for (size_t k = 1; k < boards_.size(); k++) {
+            board &b = *boards_[k];
+            if (picks[k] == pick::take) {
+                size_t tail = b.tail.load(std::memory_order_relaxed);
+                std::memcpy(b.last, b.ring[tail & b.mask].channels, sizeof(b.last));
+                b.tail.store(tail + 1, std::memory_order_release);
+                b.merged++;
+            } else {
+                held |= 1u << k;
+                b.held++;
+            }
+            std::memcpy(row + k * kChannels, b.last, sizeof(b.last));
+        }
+        if (out.sample_number) {
+            out.sample_number[written] = r.sample_number;
+        }
+        if (out.time_ns) {
+            out.time_ns[written] = r.time_ns;
+        }
+        if (out.held) {
+            out.held[written] = held;
+        }
+        ref.tail.store(ref_tail + 1, std::memory_order_release);
+        written++;
+    }
+    return written;
+}
+
+bool aggregator::finished() const {
+    const board &ref = *boards_[0];
+    return ref.closed.load(std::memory_order_acquire) &&
+           ref.tail.load(std::memory_order_relaxed) == ref.head.load(std::memory_order_acquire);
+}
+
+std::vector<board_stats> aggregator::stats() const {
+    std::vector<board_stats> out;
+    int64_t now = now_ns();
+    double ref_offset = boards_[0]->published_offset_ns.load(std::memory_order_relaxed);
+    for (const auto &p : boards_) {
+        const board &b = *p;
+        board_stats s;
+        s.port = b.port->path();
+        s.bytes = b.bytes.load(std::memory_order_relaxed);
+        s.samples = b.samples.load(std::memory_order_relaxed);
+        s.bad_packets = b.bad_packets.load(std::memory_order_relaxed);
+        s.missing_samples = b.missing_samples.load(std::memory_order_relaxed);
+        s.queue_drops = b.queue_drops.load(std::memory_order_relaxed);
+        s.merged = b.merged;
+        s.skipped = b.skipped;
+        s.held = b.held;
+        s.drift_ppm = b.drift_ppm.load(std::memory_order_relaxed);
+        s.jitter_ns = b.jitter_ns.load(std::memory_order_relaxed);
+        s.offset_ns = b.published_offset_ns.load(std::memory_order_relaxed) - ref_offset;
+        s.closed = b.closed.load(std::memory_order_acquire);
+        s.stalled = stalled(b, now);
+        out.push_back(s);
+    }
+    return out;
+}
+
+} // namespace cerelog
\ No newline at end of file
@@ -0,0 +1,169 @@
+#ifndef CERELOG_AGGREGATOR_H
+#define CERELOG_AGGREGATOR_H
+
+#include "clock_model.h"
+#include "serial_port.h"
+#include "stream_decoder.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cerelog {
+
+/* Several boards merged into one wide stream, for montages larger than
+   one board.
+
+   Each board is a serial port read by its own thread. The thread decodes
+   with its own stream_decoder, fits its own clock_model to the firmware
+   timestamps and passes every sample with its time to a single-producer,
+   single-consumer ring. Boards share nothing and no lock is taken, so
+   decoding scales with the cores available.
+
+   merge() runs on the caller's thread. Board 0 is the reference: each of
+   its samples makes a row, and every other board adds its sample nearest
+   in time, at most a little over half a period away. Times come from
+   each board's clock model, free of the DRDY interrupt jitter. How two
+   boards' MCU clocks relate is set by time_base:
+
+     host_arrival   offsets estimated from when batches arrive: the
+                    earliest arrival bounds them, so a running minimum
+                    of arrival minus model time, allowed to creep up by
+                    the MCU crystal tolerance, tracks each board
+     device         the MCU clocks already share an epoch; times are used
+                    as they are
+
+   Each ADS1299 converts on its own oscillator, so boards drift apart by
+   their ppm difference. A board running fast has a sample now and then
+   that falls between two rows, which merge skips; one running slow, or
+   one that lost samples in transport, has none near a row, and merge
+   holds its last value there. Both are counted per board. A board silent
+   for stall_seconds, or whose port has gone, is held rather than waited
+   for, so one dead board does not stop the others. */
+
+constexpr size_t kMaxBoards = 32;
+
+enum class time_base { host_arrival, device };
+
+struct aggregator_config {
+    double sample_rate_hz = 250.0;      // Nominal, the same on every board
+    int baud = 921600;
+    time_base clocks = time_base::host_arrival;
+    size_t queue_samples = 32768;       // Ring per board, rounded up to a power of two
+    bool wait_when_full = false;        // Pause the reader rather than drop, for sources that can wait
+    size_t read_bytes = 4096;           // Most bytes taken from a port at once
+    double stall_seconds = 0.5;
+    double clock_time_constant_s = 10.0;
+};
+
+/* Caller-owned output arrays, each with room for capacity rows. Only
+   channels is required; the other arrays may be null. */
+struct merged_block {
+    int32_t *channels = nullptr;        // [capacity][boards * kChannels], board 0's channels first
+    uint32_t *sample_number = nullptr;  // Board 0's sample number
+    double *time_ns = nullptr;          // Board 0's model time, on the common time base
+    uint32_t *held = nullptr;           // Bit b set where board b had no sample and holds its last one
+    size_t capacity = 0;
+};
+
+struct board_stats {
+    std::string port;
+    uint64_t bytes = 0;
+    uint64_t samples = 0;               // Decoded
+    uint64_t bad_packets = 0;
+    uint64_t missing_samples = 0;       // Lost in transport, from jumps in the sample number
+    uint64_t queue_drops = 0;           // Decoded but dropped because merge fell behind
+    uint64_t merged = 0;                // Taken into a row
+    uint64_t skipped = 0;               // Fell between rows
+    uint64_t held = 0;                  // Rows without a sample of this board
+    double drift_ppm = 0.0;             // ADS1299 oscillator against the board's MCU clock
+    double jitter_ns = 0.0;             // DRDY timestamp jitter around the clock model
+    double offset_ns = 0.0;             // Time base offset from board 0
+    bool stalled = false;               // Silent for stall_seconds
+    bool closed = false;                // Port gone
+};
+
+class aggregator {
+public:
+    /* Opens every port and starts its reader. Throws std::invalid_argument
+       for no ports, more than kMaxBoards or a bad configuration, and
+       std::runtime_error if a port cannot be opened. */
+    aggregator(const std::vector<std::string> &ports, const aggregator_config &config);
+    ~aggregator();
+
+    aggregator(const aggregator &) = delete;
+    aggregator &operator=(const aggregator &) = delete;
+
+    /* Writes the rows complete so far into out, starting at out[0], and
+       returns how many; 0 when no board has anything new. Does not block.
+       merge() and stats() are for one consumer thread. */
+    size_t merge(const merged_block &out);
+
+    // True once board 0's port is gone and all its samples are merged: no rows are left to come
+    bool finished() const;
+
+    size_t boards() const { return boards_.size(); }
+    size_t channels() const { return boards_.size() * kChannels; }
+    std::vector<board_stats> stats() const;
+    const aggregator_config &config() const { return config_; }
+
+private:
+    struct queued_sample {
+        int32_t channels[kChannels];
+        uint32_t sample_number;
+        uint32_t status;
+        double time_ns;
+    };
+
+    struct board {
+        std::unique_ptr<serial_port> port;
+        std::thread reader;
+
+        // Written by the reader only
+        stream_decoder decoder;
+        std::unique_ptr<clock_model> clock;
+        double offset_ns = 0.0;
+        int64_t last_read_ns = 0;
+        bool have_offset = false;
+
+        // Ring: the reader advances head, merge advances tail
+        std::vector<queued_sample> ring;
+        size_t mask = 0;
+        alignas(64) std::atomic<size_t> head{0};
+        alignas(64) std::atomic<size_t> tail{0};
+
+        // Published by the reader for stats() and stall detection
+        std::atomic<int64_t> last_arrival_ns{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> samples{0};
+        std::atomic<uint64_t> bad_packets{0};
+        std::atomic<uint64_t> missing_samples{0};
+        std::atomic<uint64_t> queue_drops{0};
+        std::atomic<double> drift_ppm{0.0};
+        std::atomic<double> jitter_ns{0.0};
+        std::atomic<double> published_offset_ns{0.0};
+        std::atomic<bool> closed{false};
+
+        // Merge side
+        int32_t last[kChannels] = {};
+        uint64_t merged = 0;
+        uint64_t skipped = 0;
+        uint64_t held = 0;
+    };
+
+    void read_loop(board &b);
+    void publish(board &b, const sample_block &block, size_t count, int64_t arrival_ns);
+    bool stalled(const board &b, int64_t now_ns) const;
+
+    aggregator_config config_;
+    std::vector<std::unique_ptr<board>> boards_;
+    std::atomic<bool> stop_{false};
+};
+
+} // namespace cerelog
+
+#endif // CERELOG_AGGREGATOR_H
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef CERELOG_ARENA_H
+#define CERELOG_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+
+namespace cerelog {
+
+/* One allocation carved into cache-line aligned arrays. A processing
+   stage works out its total size up front (measure with a null arena,
+   then take the same arrays from a real one), so steady-state work never
+   touches the heap and all its tables and buffers sit together. */
+class arena {
+public:
+    static constexpr size_t kAlign = 64;
+
+    // A measuring arena: take() returns null and only adds up the sizes
+    arena() = default;
+    explicit arena(size_t bytes) : storage_(new uint8_t[bytes + kAlign]), capacity_(bytes) {
+        uintptr_t base = reinterpret_cast<uintptr_t>(storage_.get());
+        base_ = reinterpret_cast<uint8_t *>((base + kAlign - 1) & ~uintptr_t(kAlign - 1));
+    }
+
+    // count zero-initialised Ts, never destroyed, so T must be trivial; throws std::bad_alloc past the capacity
+    template <typename T>
+    T *take(size_t count) {
+        size_t offset = used_;
+        used_ += (count * sizeof(T) + kAlign - 1) & ~(kAlign - 1);
+        if (!base_) {
+            return nullptr;
+        }
+        if (used_ > capacity_) {
+            throw std::bad_alloc();
+        }
+        T *p = reinterpret_cast<T *>(base_ + offset);
+        for (size_t i = 0; i < count; i++) {
+            new (p + i) T();
+        }
+        return p;
+    }
+
+    size_t used() const { return used_; }
+
+private:
+    std::unique_ptr<uint8_t[]> storage_;
+    uint8_t *base_ = nullptr;
+    size_t capacity_ = 0;
+    size_t used_ = 0;
+};
+
+} // namespace cerelog
+
+#endif // CERELOG_ARENA_H
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include "capture_assembler.h"
+#include "frame_unpack.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace cerelog {
+
+capture_assembler::capture_assembler(size_t max_frames) : max_frames_(max_frames) {
+    if (max_frames == 0) {
+        throw std::invalid_argument("capture_assembler: max_frames must be at least 1");
+    }
+}
+
+void capture_assembler::start(const capture_header_t &header, size_t chips) {
+    current_ = burst_capture();
+    current_.id = header.capture_id;
+    current_.trigger_source = header.trigger_source;
+    current_.data_rate = header.data_rate;
+    current_.chips = chips;
+    current_.frames = header.total_frames;
+    current_.trigger_frame = header.trigger_frame;
+    current_.first_read = header.first_read;
+    current_.missed_drdy = header.missed_drdy;
+    current_.trigger_ns = header.trigger_ns;
+    current_.channels.assign(chips * ADS1299_CHIP_CHANNELS, std::vector<int32_t>(current_.frames));
+    current_.status.assign(chips, std::vector<uint32_t>(current_.frames));
+    current_.received.assign(current_.frames, 0);
+    arrived_ = 0;
+    open_ = true;
+}
+
+void capture_assembler::finish() {
+    current_.missing = current_.frames - arrived_;
+    stats_.captures++;
+    stats_.missing_frames += current_.missing;
+    if (current_.missing == 0) {
+        stats_.complete++;
+    }
+    have_last_ = true;
+    last_id_ = current_.id;
+    done_.push_back(std::move(current_));
+    current_ = burst_capture();
+    open_ = false;
+}
+
+void capture_assembler::push(const capture_chunk &chunk) {
+    const capture_header_t &h = chunk.header;
+    size_t chips = PACKET_CHAIN_CHIPS(h.packet_type);
+    size_t frame_bytes = chips * ADS1299_CHIP_DATA_BYTES;
+    stats_.packets++;
+
+    if (h.total_frames == 0 || h.total_frames > max_frames_ || h.trigger_frame >= h.total_frames ||
+        uint64_t(h.frame_index) + h.frame_count > h.total_frames ||
+        chunk.frames.size() != size_t(h.frame_count) * frame_bytes) {
+        stats_.bad++;
+        return;
+    }
+
+    if (open_ && h.capture_id != current_.id) {
+        finish();
+    }
+    if (!open_) {
+        // The rest of a capture already finished; a device that restarted begins again at frame 0
+        if (have_last_ && h.capture_id == last_id_ && h.frame_index != 0) {
+            stats_.duplicates++;
+            return;
+        }
+        start(h, chips);
+    } else if (chips != current_.chips || h.total_frames != current_.frames ||
+               h.first_read != current_.first_read) {
+        stats_.bad++;
+        return;
+    }
+
+    size_t first = h.frame_index;
+    size_t count = h.frame_count;
+    if (std::all_of(current_.received.begin() + first, current_.received.begin() + first + count,
+                    [](uint8_t r) { return r != 0; })) {
+        stats_.duplicates++;
+        return;
+    }
+
+    // Each chip's part of a frame unpacks like a frame of its own
+    const uint8_t *data = chunk.frames.data();
+    int32_t *channels[ADS1299_CHIP_CHANNELS];
+    for (size_t chip = 0; chip < chips; chip++) {
+        for (size_t ch = 0; ch < ADS1299_CHIP_CHANNELS; ch++) {
+            channels[ch] = current_.channels[chip * ADS1299_CHIP_CHANNELS + ch].data() + first;
+        }
+        uint32_t *status = current_.status[chip].data() + first;
+        if (chips == 1) {
+            unpack_frames<ADS1299_CHIP_CHANNELS>(data, count, channels, status);
+            break;
+        }
+        for (size_t i = 0; i < count; i++) {
+            int32_t *one[ADS1299_CHIP_CHANNELS];
+            for (size_t ch = 0; ch < ADS1299_CHIP_CHANNELS; ch++) {
+                one[ch] = channels[ch] + i;
+            }
+            unpack_frames<ADS1299_CHIP_CHANNELS>(data + i * frame_bytes + chip * ADS1299_CHIP_DATA_BYTES, 1, one,
+                                                 status + i);
+        }
+    }
+
+    for (size_t i = first; i < first + count; i++) {
+        arrived_ += current_.received[i] == 0;
+        current_.received[i] = 1;
+    }
+    if (arrived_ == current_.frames) {
+        finish();
+    }
+}
+
+void capture_assembler::push(const std::vector<capture_chunk> &chunks) {
+    for (const capture_chunk &chunk : chunks) {
+        push(chunk);
+    }
+}
+
+std::vector<burst_capture> capture_assembler::take() {
+    std::vector<burst_capture> captures;
+    captures.swap(done_);
+    return captures;
+}
+
+void capture_assembler::flush() {
+    if (open_) {
+        finish();
+    }
+}
+
+void read_numbering::push(const ads1299_marker_packet_t &marker) {
+    if (marker.marker_type == MARKER_RECONFIG) {
+        restart_ = marker.read_number;
+    } else if (marker.marker_type == MARKER_NUMBERING && marker.result > 0) {
+        // The boot numbering marker has no reconfiguration before it, and starts at read 1
+        segments_.push_back({restart_, marker.read_number, marker.sample_number, uint32_t(marker.result)});
+        restart_ = marker.read_number;
+    }
+}
+
+void read_numbering::push(const std::vector<ads1299_marker_packet_t> &markers) {
+    for (const ads1299_marker_packet_t &marker : markers) {
+        push(marker);
+    }
+}
+
+double read_numbering::position(uint32_t read) const {
+    // The last segment that started at or before the read; read numbers wrap after three days at 16 kSPS
+    auto it = std::upper_bound(segments_.begin(), segments_.end(), read,
+                               [](uint32_t r, const segment &s) { return r < s.start; });
+    if (it == segments_.begin()) {
+        return double(read);
+    }
+    const segment &s = *(it - 1);
+    if (read < s.anchor_read) {
+        // Only filled the restarted filter: spread between the output before and the first after
+        return double(s.anchor_sample) - 1.0 + double(read - s.start + 1) / double(s.anchor_read - s.start + 1);
+    }
+    return double(s.anchor_sample) + double(read - s.anchor_read) / s.ratio;
+}
+
+} // namespace cerelog
\ No newline at end of file
@@ -0,0 +1,124 @@
+#ifndef CERELOG_CAPTURE_ASSEMBLER_H
+#define CERELOG_CAPTURE_ASSEMBLER_H
+
+#include "stream_decoder.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cerelog {
+
+/* Host half of the firmware's burst capture (capture.c).
+
+   Capture packets, from stream_decoder::take_captures(), drain between
+   the live packets one capture at a time, in frame order. Each repeats
+   the capture's description, so its frames land in place whatever was
+   lost before it. A capture is finished once every frame is in, when a
+   packet of another capture arrives, or on flush(). Captures are not
+   resent: a damaged packet leaves its frames missing, and the finished
+   capture says which. Not thread-safe. */
+
+struct burst_capture {
+    uint16_t id = 0;
+    uint8_t trigger_source = 0;     // CAPTURE_TRIGGER_*
+    uint8_t data_rate = 0;          // CONFIG1 data rate bits
+    size_t chips = 1;
+    size_t frames = 0;
+    size_t trigger_frame = 0;
+    uint32_t first_read = 0;        // Read number of frame 0, the rest follow on; read_numbering maps it to the stream
+    uint32_t missed_drdy = 0;       // DRDY edges left unread between its first and last frame; 0 means evenly spaced
+    uint64_t trigger_ns = 0;        // DRDY edge of the trigger frame, device clock
+    std::vector<std::vector<int32_t>> channels;     // [chips * 8][frames] sign-extended codes, chip by chip
+    std::vector<std::vector<uint32_t>> status;      // [chips][frames] 24-bit status words
+    std::vector<uint8_t> received;  // [frames] 1 where the frame arrived
+    size_t missing = 0;             // Frames that did not
+
+    double sample_rate() const { return CAPTURE_SAMPLE_RATE(data_rate); }
+    double duration_s() const { return double(frames) / sample_rate(); }
+    // Seconds from the trigger frame, negative before it
+    double time_s(size_t frame) const { return (double(frame) - double(trigger_frame)) / sample_rate(); }
+};
+
+struct capture_stats {
+    uint64_t packets = 0;
+    uint64_t captures = 0;          // Finished
+    uint64_t complete = 0;          // Finished with every frame in
+    uint64_t missing_frames = 0;
+    uint64_t duplicates = 0;        // Packets whose frames were already in
+    uint64_t bad = 0;               // Packets that disagree with themselves or their capture
+};
+
+/* Places frames counted as read from the chip, as capture packets count
+   them, in the live stream's sample numbering. Without on-device
+   decimation the two are the same and no markers are needed. With it,
+   each MARKER_RECONFIG marks where the decimator restarts, in read
+   numbering, and the MARKER_NUMBERING after it says which read completed
+   its first output and the ratio from there on. Feed it every marker, in
+   stream order, from the start of the stream: a host that joins later
+   learns the numbering at the next restart. Not thread-safe. */
+class read_numbering {
+public:
+    void push(const ads1299_marker_packet_t &marker);
+    void push(const std::vector<ads1299_marker_packet_t> &markers);
+
+    /* Stream position of a read: an output's sample number for the read
+       that completed it, and a fraction of the way from the output before
+       for the reads in between, so positions only grow. Reads that only
+       filled the filter after a restart fall between the last output
+       before it and the first after. Reads before the first numbering
+       marker, or every read in a build that does not decimate, map to
+       themselves. */
+    double position(uint32_t read) const;
+
+    bool decimating() const { return !segments_.empty(); }
+
+private:
+    struct segment {
+        uint32_t start;             // First read into the restarted decimator
+        uint32_t anchor_read;       // Read that completed the first output
+        uint32_t anchor_sample;     // That output's sample number
+        uint32_t ratio;
+    };
+
+    std::vector<segment> segments_;     // In stream order, so by start
+    uint32_t restart_ = 1;              // Start of the next segment; the stream's first read is 1
+};
+
+class capture_assembler {
+public:
+    // The firmware's ring is at most 4 MiB of single-chip frames
+    static constexpr size_t kDefaultMaxFrames = (4u << 20) / ADS1299_CHIP_DATA_BYTES;
+
+    // Packets describing a capture of more than max_frames frames are refused as bad
+    explicit capture_assembler(size_t max_frames = kDefaultMaxFrames);
+
+    void push(const capture_chunk &chunk);
+    void push(const std::vector<capture_chunk> &chunks);
+
+    // Captures finished since the last call, oldest first
+    std::vector<burst_capture> take();
+
+    // Finishes the capture under way with what has arrived, at the end of a stream
+    void flush();
+
+    bool assembling() const { return open_; }
+    const capture_stats &stats() const { return stats_; }
+
+private:
+    void start(const capture_header_t &header, size_t chips);
+    void finish();
+
+    size_t max_frames_;
+    bool open_ = false;
+    burst_capture current_;
+    size_t arrived_ = 0;
+    bool have_last_ = false;
+    uint16_t last_id_ = 0;
+    std::vector<burst_capture> done_;
+    capture_stats stats_;
+};
+
+} // namespace cerelog
+
+#endif // CERELOG_CAPTURE_ASSEMBLER_H
\ No newline at end of file
@@ -0,0 +1,170 @@
+#include "clock_model.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cerelog {
+
+clock_model::clock_model(double nominal_rate_hz, double time_constant_s)
+    : nominal_rate_hz_(nominal_rate_hz), time_constant_s_(time_constant_s) {}
+
+double clock_model::period_ns() const {
+    return 1e9 / nominal_rate_hz_ + slope_;
+}
+
+double clock_model::drift_ppm() const {
+    return slope_ * nominal_rate_hz_ / 1e9 * 1e6;
+}
+
+double clock_model::jitter_ns() const {
+    return std::sqrt(residual_var_);
+}
+
+/* Old points are rescaled to the new sample period: x * period, and with
+   it y, stays the same, so the drift estimate carries over. The offset to
+   the first point at the new rate is absorbed by the next observe(). */
+void clock_model::set_nominal_rate(double nominal_rate_hz) {
+    double k = nominal_rate_hz / nominal_rate_hz_;
+    sx_ *= k;
+    sxx_ *= k * k;
+    sxy_ *= k;
+    slope_ /= k;
+    nominal_rate_hz_ = nominal_rate_hz;
+    restart_ = true;
+    has_pending_ = false;
+}
+
+/* The fit works on y = time - (origin_time + x * nominal period), a few
+   microseconds at most, with x counted from the newest point. Keeping both
+   small holds the sums well inside double precision over long recordings. */
+void clock_model::start_segment(uint64_t index, double time_ns) {
+    origin_ = index;
+    origin_time_ns_ = time_ns;
+    sw_ = sx_ = sy_ = sxx_ = sxy_ = 0.0;
+    points_ = 0;
+    slope_ = 0.0;
+    intercept_ = 0.0;
+    has_pending_ = false;
+}
+
+/* A gap is a step in the line's intercept; the slope is unchanged. Moving
+   the old points by the step keeps everything they say about drift, so the
+   fit stays locked across stalls instead of relearning the slope. */
+void clock_model::shift(double offset_ns) {
+    sy_ += offset_ns * sw_;
+    sxy_ += offset_ns * sx_;
+    intercept_ += offset_ns;
+}
+
+double clock_model::offset_from_fit(uint64_t index, double time_ns) const {
+    double x = double(int64_t(index - origin_));
+    double y = time_ns - origin_time_ns_ - x * 1e9 / nominal_rate_hz_;
+    return y - (intercept_ + slope_ * x);
+}
+
+void clock_model::add_point(uint64_t index, double time_ns) {
+    const double nominal = 1e9 / nominal_rate_hz_;
+    double d = double(int64_t(index - origin_));
+
+    // Move the origin to the new point and age the old points
+    double forget = std::exp(-d / (time_constant_s_ * nominal_rate_hz_));
+    sxx_ = (sxx_ - 2 * d * sx_ + d * d * sw_) * forget;
+    sxy_ = (sxy_ - d * sy_) * forget;
+    sx_ = (sx_ - d * sw_) * forget;
+    sy_ *= forget;
+    sw_ *= forget;
+    origin_ = index;
+    origin_time_ns_ += d * nominal;
+
+    double y = time_ns - origin_time_ns_;
+    sw_ += 1;
+    sy_ += y;
+    points_++;
+
+    double det = sw_ * sxx_ - sx_ * sx_;
+    if (points_ >= 2 && det > 1e-9 * sw_ * sxx_) {
+        slope_ = (sw_ * sxy_ - sx_ * sy_) / det;
+    }
+    intercept_ = (sy_ - slope_ * sx_) / sw_;
+}
+
+double clock_model::gap_threshold_ns() const {
+    return std::max(kGapSigmas * jitter_ns(), 0.5e9 / nominal_rate_hz_);
+}
+
+bool clock_model::observe(uint32_t sample_number, uint32_t sample_count, uint64_t timestamp_ns) {
+    double t = double(timestamp_ns);
+
+    if (!started_) {
+        started_ = true;
+        last_number_ = sample_number;
+        last_index_ = sample_number;
+        last_count_ = sample_count;
+        observations_++;
+        start_segment(last_index_, t);
+        add_point(last_index_, t);
+        return false;
+    }
+
+    uint64_t index = last_index_ + int64_t(int32_t(sample_number - last_number_));
+    uint64_t expected = last_index_ + last_count_;
+    if (index > expected) {
+        missing_samples_ += index - expected;
+    }
+    last_number_ = sample_number;
+    last_index_ = index;
+    last_count_ = sample_count;
+    observations_++;
+
+    if (restart_) {
+        restart_ = false;
+        shift(offset_from_fit(index, t));
+        add_point(index, t);
+        return false;
+    }
+
+    if (!locked()) {
+        add_point(index, t);
+        return false;
+    }
+
+    double offset = offset_from_fit(index, t);
+    double threshold = gap_threshold_ns();
+
+    if (has_pending_) {
+        has_pending_ = false;
+        if (std::abs(offset) >= threshold && std::abs(offset - pending_.offset_ns) < threshold) {
+            // Two batches agree on the new offset: the stream really jumped
+            gaps_.push_back({pending_.index, pending_.offset_ns});
+            shift(pending_.offset_ns);
+            add_point(pending_.index, pending_.time_ns);
+            add_point(index, t);
+            return true;
+        }
+        outliers_++;
+    }
+
+    if (std::abs(offset) >= threshold) {
+        pending_ = {index, t, offset};
+        has_pending_ = true;
+        return false;
+    }
+
+    // Innovation variance, averaged evenly at first and then over the time constant
+    double alpha = std::max(1.0 / double(++residual_points_),
+                            1.0 - std::exp(-double(sample_count) / (time_constant_s_ * nominal_rate_hz_)));
+    residual_var_ += alpha * (offset * offset - residual_var_);
+    add_point(index, t);
+    return false;
+}
+
+double clock_model::sample_index_time_ns(uint64_t sample_index) const {
+    double x = double(int64_t(sample_index - origin_));
+    return origin_time_ns_ + x * 1e9 / nominal_rate_hz_ + intercept_ + slope_ * x;
+}
+
+double clock_model::sample_time_ns(uint32_t sample_number) const {
+    return sample_index_time_ns(last_index_ + int64_t(int32_t(sample_number - last_number_)));
+}
+
+} // namespace cerelog
\ No newline at end of file
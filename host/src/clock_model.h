@@ -0,0 +1,115 @@
+#ifndef CERELOG_CLOCK_MODEL_H
+#define CERELOG_CLOCK_MODEL_H
+
+#include <cstdint>
+#include <vector>
+
+namespace cerelog {
+
+/* Maps ADS1299 sample numbers to device time.
+
+   The ADS1299 converts on its own oscillator, so sample n is taken at
+   t0 + n * period, where the period is nominal only to within the
+   oscillator tolerance. The firmware latches the DRDY edge on the MCU
+   clock and sends it as timestamp_ns with the first sample of each
+   batch. Those timestamps carry interrupt latency jitter; the sample
+   numbers carry none.
+
+   The model fits timestamp against sample number with a forgetting
+   least-squares line, so the slope tracks the ADS1299 period as seen by
+   the MCU clock (drift) and the residuals measure the jitter. Smoothed
+   times come from the line. A step in the timestamps that jitter cannot
+   explain is a real gap in acquisition (conversions stopped, e.g. for a
+   data rate change): the line moves by the step and keeps its slope.
+   Samples lost in transport are different; they show up as a jump in the
+   sample number that the line already accounts for. */
+struct clock_gap {
+    uint64_t sample_index;      // Unwrapped number of the first sample after the gap
+    double duration_ns;         // Time lost beyond what the sample numbers explain
+};
+
+class clock_model {
+public:
+    // time_constant_s sets how quickly drift estimates follow temperature changes
+    explicit clock_model(double nominal_rate_hz, double time_constant_s = 10.0);
+
+    /* Feeds the timestamp of one batch: sample_number and timestamp_ns of
+       its first sample, and how many consecutive samples it holds.
+       sample_number is the 32-bit on-wire counter and may wrap.
+       A single timestamp far off the line is dropped as an outlier; a gap
+       is only declared once the next batch confirms the new offset, and
+       the return value is true on that call. */
+    bool observe(uint32_t sample_number, uint32_t sample_count, uint64_t timestamp_ns);
+
+    /* Switches to a new nominal rate, e.g. after a marker packet reports
+       a CONFIG1 change. The drift estimate is kept and the next batch
+       sets the new offset without being reported as a gap. */
+    void set_nominal_rate(double nominal_rate_hz);
+
+    // Jitter-free time of any sample since the last gap
+    double sample_time_ns(uint32_t sample_number) const;
+    // Same, for an already unwrapped sample index
+    double sample_index_time_ns(uint64_t sample_index) const;
+    // Last observed sample number, unwrapped
+    uint64_t last_index() const { return last_index_; }
+
+    double nominal_rate_hz() const { return nominal_rate_hz_; }
+    double period_ns() const;
+    // ADS1299 oscillator against MCU clock, parts per million
+    double drift_ppm() const;
+    // RMS of timestamp residuals against the fitted line
+    double jitter_ns() const;
+
+    bool locked() const { return points_ >= kMinPoints; }
+    // The last batch was off the line and waits for the next one to tell a gap from an outlier
+    bool pending() const { return has_pending_; }
+    uint64_t observations() const { return observations_; }
+    uint64_t missing_samples() const { return missing_samples_; }
+    uint64_t outliers() const { return outliers_; }
+    const std::vector<clock_gap> &gaps() const { return gaps_; }
+
+private:
+    static constexpr uint32_t kMinPoints = 8;       // Fit points before residuals are trusted
+    static constexpr double kGapSigmas = 8.0;       // Residual that counts as a gap, in jitter RMS
+
+    struct pending_gap {
+        uint64_t index;
+        double time_ns;
+        double offset_ns;
+    };
+
+    void start_segment(uint64_t index, double time_ns);
+    void shift(double offset_ns);
+    void add_point(uint64_t index, double time_ns);
+    double offset_from_fit(uint64_t index, double time_ns) const;
+    double gap_threshold_ns() const;
+
+    double nominal_rate_hz_;
+    double time_constant_s_;
+
+    // Weighted sums of the fit y = a + b x, with x counted in samples from origin_
+    uint64_t origin_ = 0;
+    double origin_time_ns_ = 0.0;
+    double sw_ = 0, sx_ = 0, sy_ = 0, sxx_ = 0, sxy_ = 0;
+    double intercept_ = 0.0;
+    double slope_ = 0.0;
+    uint64_t points_ = 0;
+
+    double residual_var_ = 0.0;
+    uint64_t residual_points_ = 0;
+    bool started_ = false;
+    bool restart_ = false;
+    bool has_pending_ = false;
+    pending_gap pending_{};
+    uint32_t last_count_ = 0;
+    uint64_t outliers_ = 0;
+    uint32_t last_number_ = 0;
+    uint64_t last_index_ = 0;
+    uint64_t observations_ = 0;
+    uint64_t missing_samples_ = 0;
+    std::vector<clock_gap> gaps_;
+};
+
+} // namespace cerelog
+
+#endif // CERELOG_CLOCK_MODEL_H
\ No newline at end of file
@@ -0,0 +1,211 @@
+#include "filter_bank.h"
+#include "frame_unpack.h"
+#include "simd_target.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace cerelog {
+
+const band_edges kBandEdges[kBandCount] = {
+    {"delta", 0.5, 4.0},
+    {"theta", 4.0, 8.0},
+    {"alpha", 8.0, 13.0},
+    {"beta", 13.0, 30.0},
+    {"gamma", 30.0, 50.0},
+};
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr size_t kChannels = filter_bank::kChannels;
+// Samples filtered per section pass; the state stays in registers across a block
+constexpr size_t kBlock = 64;
+
+struct corner {
+    double cos_w0;
+    double alpha;
+    // 1 - cos(w0), without the cancellation of computing it that way near DC
+    double one_minus_cos;
+};
+
+corner prewarp(double sample_rate_hz, double frequency_hz, double q) {
+    double w0 = 2.0 * kPi * frequency_hz / sample_rate_hz;
+    double half = std::sin(w0 / 2.0);
+    return {std::cos(w0), std::sin(w0) / (2.0 * q), 2.0 * half * half};
+}
+
+biquad normalise(double b0, double b1, double b2, double a0, double a1, double a2) {
+    return {b0 / a0, b1 / a0, b2 / a0, a1 / a0, a2 / a0};
+}
+
+/* Runs one section over a block of interleaved samples in place. The
+   expression order is the same in both versions so they agree to the bit. */
+void run_section_scalar(const biquad &q, double *state, double *x, size_t count) {
+    double *s1 = state;
+    double *s2 = state + kChannels;
+    for (size_t i = 0; i < count; i++) {
+        double *v = x + i * kChannels;
+        for (size_t c = 0; c < kChannels; c++) {
+            double in = v[c];
+            double y = q.b0 * in + s1[c];
+            s1[c] = q.b1 * in - q.a1 * y + s2[c];
+            s2[c] = q.b2 * in - q.a2 * y;
+            v[c] = y;
+        }
+    }
+}
+
+#ifdef CERELOG_X86
+
+CERELOG_TARGET("avx2")
+void run_section_avx2(const biquad &q, double *state, double *x, size_t count) {
+    const __m256d b0 = _mm256_set1_pd(q.b0);
+    const __m256d b1 = _mm256_set1_pd(q.b1);
+    const __m256d b2 = _mm256_set1_pd(q.b2);
+    const __m256d a1 = _mm256_set1_pd(q.a1);
+    const __m256d a2 = _mm256_set1_pd(q.a2);
+    __m256d s1_lo = _mm256_loadu_pd(state);
+    __m256d s1_hi = _mm256_loadu_pd(state + 4);
+    __m256d s2_lo = _mm256_loadu_pd(state + kChannels);
+    __m256d s2_hi = _mm256_loadu_pd(state + kChannels + 4);
+
+    for (size_t i = 0; i < count; i++) {
+        double *v = x + i * kChannels;
+        __m256d in_lo = _mm256_loadu_pd(v);
+        __m256d in_hi = _mm256_loadu_pd(v + 4);
+        __m256d y_lo = _mm256_add_pd(_mm256_mul_pd(b0, in_lo), s1_lo);
+        __m256d y_hi = _mm256_add_pd(_mm256_mul_pd(b0, in_hi), s1_hi);
+        s1_lo = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(b1, in_lo), _mm256_mul_pd(a1, y_lo)), s2_lo);
+        s1_hi = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(b1, in_hi), _mm256_mul_pd(a1, y_hi)), s2_hi);
+        s2_lo = _mm256_sub_pd(_mm256_mul_pd(b2, in_lo), _mm256_mul_pd(a2, y_lo));
+        s2_hi = _mm256_sub_pd(_mm256_mul_pd(b2, in_hi), _mm256_mul_pd(a2, y_hi));
+        _mm256_storeu_pd(v, y_lo);
+        _mm256_storeu_pd(v + 4, y_hi);
+    }
+
+    _mm256_storeu_pd(state, s1_lo);
+    _mm256_storeu_pd(state + 4, s1_hi);
+    _mm256_storeu_pd(state + kChannels, s2_lo);
+    _mm256_storeu_pd(state + kChannels + 4, s2_hi);
+}
+
+#endif // CERELOG_X86
+
+void run_sections(const biquad *sections, size_t n, double *state, double *x, size_t count) {
+#ifdef CERELOG_X86
+    if (active_simd_level() == simd_level::avx2) {
+        for (size_t i = 0; i < n; i++) {
+            run_section_avx2(sections[i], state + i * 2 * kChannels, x, count);
+        }
+        return;
+    }
+#endif
+    for (size_t i = 0; i < n; i++) {
+        run_section_scalar(sections[i], state + i * 2 * kChannels, x, count);
+    }
+}
+
+void store_block(const double *x, size_t count, float *out) {
+    if (out) {
+        for (size_t i = 0; i < count * kChannels; i++) {
+            out[i] = float(x[i]);
+        }
+    }
+}
+
+void check_corner(double sample_rate_hz, double frequency_hz) {
+    if (!(frequency_hz > 0.0 && frequency_hz < sample_rate_hz / 2.0)) {
+        throw std::invalid_argument("filter corner must lie between 0 and half the sample rate");
+    }
+}
+
+} // namespace
+
+biquad design_lowpass(double sample_rate_hz, double cutoff_hz, double q) {
+    corner k = prewarp(sample_rate_hz, cutoff_hz, q);
+    return normalise(k.one_minus_cos / 2.0, k.one_minus_cos, k.one_minus_cos / 2.0,
+                     1.0 + k.alpha, -2.0 * k.cos_w0, 1.0 - k.alpha);
+}
+
+biquad design_highpass(double sample_rate_hz, double cutoff_hz, double q) {
+    corner k = prewarp(sample_rate_hz, cutoff_hz, q);
+    double one_plus_cos = 2.0 - k.one_minus_cos;
+    return normalise(one_plus_cos / 2.0, -one_plus_cos, one_plus_cos / 2.0,
+                     1.0 + k.alpha, -2.0 * k.cos_w0, 1.0 - k.alpha);
+}
+
+biquad design_notch(double sample_rate_hz, double center_hz, double q) {
+    corner k = prewarp(sample_rate_hz, center_hz, q);
+    return normalise(1.0, -2.0 * k.cos_w0, 1.0, 1.0 + k.alpha, -2.0 * k.cos_w0, 1.0 - k.alpha);
+}
+
+std::vector<double> butterworth_q(size_t order) {
+    std::vector<double> q;
+    for (size_t k = 0; k < order / 2; k++) {
+        q.push_back(1.0 / (2.0 * std::cos(kPi * double(2 * k + 1) / double(2 * order))));
+    }
+    return q;
+}
+
+filter_bank::filter_bank(const filter_bank_config &config) : config_(config) {
+    double fs = config.sample_rate_hz;
+    if (config.band_order == 0 || config.band_order % 2) {
+        throw std::invalid_argument("band_order must be even and non-zero");
+    }
+
+    check_corner(fs, config.dc_cutoff_hz);
+    sections_.push_back(design_highpass(fs, config.dc_cutoff_hz, butterworth_q(2)[0]));
+    if (config.mains_hz > 0.0) {
+        check_corner(fs, config.mains_hz);
+        sections_.push_back(design_notch(fs, config.mains_hz, config.notch_q));
+    }
+    front_sections_ = sections_.size();
+
+    std::vector<double> q = butterworth_q(config.band_order);
+    for (const band_edges &band : kBandEdges) {
+        check_corner(fs, band.low_hz);
+        check_corner(fs, band.high_hz);
+        for (double section_q : q) {
+            sections_.push_back(design_highpass(fs, band.low_hz, section_q));
+        }
+        for (double section_q : q) {
+            sections_.push_back(design_lowpass(fs, band.high_hz, section_q));
+        }
+    }
+    band_sections_ = 2 * q.size();
+
+    state_.assign(sections_.size() * 2 * kChannels, 0.0);
+}
+
+void filter_bank::reset() {
+    state_.assign(state_.size(), 0.0);
+}
+
+void filter_bank::process(const float *in, size_t count, float *clean, float *const *bands) {
+    double front[kBlock * kChannels];
+    double band[kBlock * kChannels];
+    const biquad *band_sections = sections_.data() + front_sections_;
+    double *band_state = state_.data() + front_sections_ * 2 * kChannels;
+
+    for (size_t done = 0; done < count; done += kBlock) {
+        size_t n = count - done < kBlock ? count - done : kBlock;
+        const float *block_in = in + done * kChannels;
+        for (size_t i = 0; i < n * kChannels; i++) {
+            front[i] = double(block_in[i]);
+        }
+
+        run_sections(sections_.data(), front_sections_, state_.data(), front, n);
+        store_block(front, n, clean ? clean + done * kChannels : nullptr);
+
+        for (size_t b = 0; b < kBandCount; b++) {
+            std::copy(front, front + n * kChannels, band);
+            run_sections(band_sections + b * band_sections_, band_sections_,
+                         band_state + b * band_sections_ * 2 * kChannels, band, n);
+            store_block(band, n, bands && bands[b] ? bands[b] + done * kChannels : nullptr);
+        }
+    }
+}
+
+} // namespace cerelog
\ No newline at end of file
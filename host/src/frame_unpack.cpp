@@ -0,0 +1,270 @@
+#include "frame_unpack.h"
+#include "simd_target.h"
+
+namespace cerelog {
+
+namespace {
+
+// One 128-bit lane holds 4 channels, unpacked from 12 of the 16 bytes loaded
+constexpr size_t kLaneChannels = 4;
+constexpr size_t kLaneBytes = kLaneChannels * ADS1299_BYTES_PER_CHANNEL;
+constexpr size_t kLoadBytes = 16;
+
+template <size_t Channels>
+struct frame_layout {
+    static constexpr size_t bytes = frame_bytes(Channels);
+    static constexpr size_t lanes = (Channels + kLaneChannels - 1) / kLaneChannels;
+    // How far the last 16-byte load of a frame reaches past its own end
+    static constexpr size_t overread = ADS1299_STATUS_BYTES + (lanes - 1) * kLaneBytes + kLoadBytes - bytes;
+    // Frames at the end of a buffer whose loads would run off it
+    static constexpr size_t tail = (overread + bytes - 1) / bytes;
+};
+
+inline int32_t be24(const uint8_t *p) {
+    return int32_t(uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8) >> 8;
+}
+
+inline uint32_t status24(const uint8_t *p) {
+    return uint32_t(p[0]) << 16 | uint32_t(p[1]) << 8 | p[2];
+}
+
+inline void store_code(int32_t *out, int32_t code, float) {
+    *out = code;
+}
+
+inline void store_code(float *out, int32_t code, float uv_per_code) {
+    *out = float(code) * uv_per_code;
+}
+
+template <size_t Channels, typename Out>
+void unpack_scalar(const uint8_t *frames, size_t begin, size_t end, const float *uv_per_code, Out *const *channels) {
+    constexpr size_t bytes = frame_layout<Channels>::bytes;
+    for (size_t i = begin; i < end; i++) {
+        const uint8_t *data = frames + i * bytes + ADS1299_STATUS_BYTES;
+        for (size_t c = 0; c < Channels; c++) {
+            store_code(&channels[c][i], be24(data + c * ADS1299_BYTES_PER_CHANNEL),
+                       uv_per_code ? uv_per_code[c] : 0.0f);
+        }
+    }
+}
+
+#ifdef CERELOG_X86
+
+/* Moves each 3-byte big-endian value into the top of a 32-bit lane; an
+   arithmetic shift right by 8 then sign-extends it */
+#define CERELOG_BE24_SHUFFLE -1, 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9
+
+CERELOG_TARGET("sse4.1")
+inline void store4(int32_t *out, __m128i codes, float) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out), codes);
+}
+
+CERELOG_TARGET("sse4.1")
+inline void store4(float *out, __m128i codes, float uv_per_code) {
+    _mm_storeu_ps(out, _mm_mul_ps(_mm_cvtepi32_ps(codes), _mm_set1_ps(uv_per_code)));
+}
+
+/* Four frames at a time: one load per frame and lane, then a 4x4
+   transpose turns frame rows into channel rows */
+template <size_t Channels, typename Out>
+CERELOG_TARGET("sse4.1")
+void unpack_sse41(const uint8_t *frames, size_t end, const float *uv_per_code, Out *const *channels) {
+    using layout = frame_layout<Channels>;
+    const __m128i shuffle = _mm_setr_epi8(CERELOG_BE24_SHUFFLE);
+
+    for (size_t i = 0; i < end; i += 4) {
+        const uint8_t *data = frames + i * layout::bytes + ADS1299_STATUS_BYTES;
+        for (size_t lane = 0; lane < layout::lanes; lane++) {
+            __m128i f[4];
+            for (size_t k = 0; k < 4; k++) {
+                __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + k * layout::bytes +
+                                                                                lane * kLaneBytes));
+                f[k] = _mm_srai_epi32(_mm_shuffle_epi8(raw, shuffle), 8);
+            }
+            __m128i t0 = _mm_unpacklo_epi32(f[0], f[1]);
+            __m128i t1 = _mm_unpacklo_epi32(f[2], f[3]);
+            __m128i t2 = _mm_unpackhi_epi32(f[0], f[1]);
+            __m128i t3 = _mm_unpackhi_epi32(f[2], f[3]);
+            const __m128i rows[4] = {
+                _mm_unpacklo_epi64(t0, t1), _mm_unpackhi_epi64(t0, t1),
+                _mm_unpacklo_epi64(t2, t3), _mm_unpackhi_epi64(t2, t3),
+            };
+            for (size_t k = 0; k < kLaneChannels && lane * kLaneChannels + k < Channels; k++) {
+                size_t c = lane * kLaneChannels + k;
+                store4(channels[c] + i, rows[k], uv_per_code ? uv_per_code[c] : 0.0f);
+            }
+        }
+    }
+}
+
+CERELOG_TARGET("avx2")
+inline void store8(int32_t *out, __m256i codes, float) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), codes);
+}
+
+CERELOG_TARGET("avx2")
+inline void store8(float *out, __m256i codes, float uv_per_code) {
+    _mm256_storeu_ps(out, _mm256_mul_ps(_mm256_cvtepi32_ps(codes), _mm256_set1_ps(uv_per_code)));
+}
+
+/* Eight frames at a time: frames i..i+3 in the low 128-bit halves and
+   i+4..i+7 in the high ones, so the in-lane transpose leaves each channel
+   row in frame order */
+template <size_t Channels, typename Out>
+CERELOG_TARGET("avx2")
+void unpack_avx2(const uint8_t *frames, size_t end, const float *uv_per_code, Out *const *channels) {
+    using layout = frame_layout<Channels>;
+    const __m256i shuffle = _mm256_setr_epi8(CERELOG_BE24_SHUFFLE, CERELOG_BE24_SHUFFLE);
+
+    for (size_t i = 0; i < end; i += 8) {
+        const uint8_t *data = frames + i * layout::bytes + ADS1299_STATUS_BYTES;
+        for (size_t lane = 0; lane < layout::lanes; lane++) {
+            __m256i f[4];
+            for (size_t k = 0; k < 4; k++) {
+                const uint8_t *lo = data + k * layout::bytes + lane * kLaneBytes;
+                const uint8_t *hi = lo + 4 * layout::bytes;
+                __m256i raw = _mm256_inserti128_si256(
+                    _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(lo))),
+                    _mm_loadu_si128(reinterpret_cast<const __m128i *>(hi)), 1);
+                f[k] = _mm256_srai_epi32(_mm256_shuffle_epi8(raw, shuffle), 8);
+            }
+            __m256i t0 = _mm256_unpacklo_epi32(f[0], f[1]);
+            __m256i t1 = _mm256_unpacklo_epi32(f[2], f[3]);
+            __m256i t2 = _mm256_unpackhi_epi32(f[0], f[1]);
+            __m256i t3 = _mm256_unpackhi_epi32(f[2], f[3]);
+            const __m256i rows[4] = {
+                _mm256_unpacklo_epi64(t0, t1), _mm256_unpackhi_epi64(t0, t1),
+                _mm256_unpacklo_epi64(t2, t3), _mm256_unpackhi_epi64(t2, t3),
+            };
+            for (size_t k = 0; k < kLaneChannels && lane * kLaneChannels + k < Channels; k++) {
+                size_t c = lane * kLaneChannels + k;
+                store8(channels[c] + i, rows[k], uv_per_code ? uv_per_code[c] : 0.0f);
+            }
+        }
+    }
+}
+
+simd_level detect_simd_level() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    int max_leaf = info[0];
+    __cpuid(info, 1);
+    bool sse41 = (info[2] & (1 << 19)) != 0;
+    // AVX2 also needs the OS to save the upper register halves
+    bool os_avx = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+    bool avx2 = false;
+    if (max_leaf >= 7 && os_avx) {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+#else
+    __builtin_cpu_init();
+    bool sse41 = __builtin_cpu_supports("sse4.1");
+    bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+    return avx2 ? simd_level::avx2 : sse41 ? simd_level::sse41 : simd_level::scalar;
+}
+
+#else
+
+simd_level detect_simd_level() {
+    return simd_level::scalar;
+}
+
+#endif // CERELOG_X86
+
+simd_level &level_setting() {
+    static simd_level level = supported_simd_level();
+    return level;
+}
+
+template <size_t Channels, typename Out>
+void unpack(const uint8_t *frames, size_t count, const float *uv_per_code, Out *const *channels, uint32_t *status) {
+    using layout = frame_layout<Channels>;
+    size_t safe = count > layout::tail ? count - layout::tail : 0;
+    size_t done = 0;
+
+#ifdef CERELOG_X86
+    switch (level_setting()) {
+    case simd_level::avx2:
+        done = safe / 8 * 8;
+        unpack_avx2<Channels>(frames, done, uv_per_code, channels);
+        break;
+    case simd_level::sse41:
+        done = safe / 4 * 4;
+        unpack_sse41<Channels>(frames, done, uv_per_code, channels);
+        break;
+    case simd_level::scalar:
+        break;
+    }
+#else
+    (void)safe;
+#endif
+    unpack_scalar<Channels>(frames, done, count, uv_per_code, channels);
+
+    if (status) {
+        for (size_t i = 0; i < count; i++) {
+            status[i] = status24(frames + i * layout::bytes);
+        }
+    }
+}
+
+} // namespace
+
+double gain_from_chset(uint8_t chset) {
+    static const double gains[8] = {1, 2, 4, 6, 8, 12, 24, 24};
+    return gains[(chset >> 4) & 0x07];
+}
+
+void scale_from_registers(const uint8_t *registers, size_t channels, double vref, float *uv_per_code) {
+    const size_t ch1set = 0x05;
+    for (size_t c = 0; c < channels; c++) {
+        uv_per_code[c] = float(2.0 * vref / gain_from_chset(registers[ch1set + c]) / double(1 << 24) * 1e6);
+    }
+}
+
+simd_level supported_simd_level() {
+    static const simd_level level = detect_simd_level();
+    return level;
+}
+
+simd_level active_simd_level() {
+    return level_setting();
+}
+
+void set_simd_level(simd_level level) {
+    simd_level supported = supported_simd_level();
+    level_setting() = level < supported ? level : supported;
+}
+
+const char *simd_level_name(simd_level level) {
+    switch (level) {
+    case simd_level::avx2:
+        return "avx2";
+    case simd_level::sse41:
+        return "sse4.1";
+    default:
+        return "scalar";
+    }
+}
+
+template <size_t Channels>
+void unpack_frames(const uint8_t *frames, size_t count, int32_t *const *channels, uint32_t *status) {
+    unpack<Channels>(frames, count, nullptr, channels, status);
+}
+
+template <size_t Channels>
+void unpack_frames_uv(const uint8_t *frames, size_t count, const float *uv_per_code, float *const *channels,
+                      uint32_t *status) {
+    unpack<Channels>(frames, count, uv_per_code, channels, status);
+}
+
+template void unpack_frames<4>(const uint8_t *, size_t, int32_t *const *, uint32_t *);
+template void unpack_frames<6>(const uint8_t *, size_t, int32_t *const *, uint32_t *);
+template void unpack_frames<8>(const uint8_t *, size_t, int32_t *const *, uint32_t *);
+template void unpack_frames_uv<4>(const uint8_t *, size_t, const float *, float *const *, uint32_t *);
+template void unpack_frames_uv<6>(const uint8_t *, size_t, const float *, float *const *, uint32_t *);
+template void unpack_frames_uv<8>(const uint8_t *, size_t, const float *, float *const *, uint32_t *);
+
+} // namespace cerelog
\ No newline at end of file
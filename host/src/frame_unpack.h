@@ -0,0 +1,69 @@
+#ifndef CERELOG_FRAME_UNPACK_H
+#define CERELOG_FRAME_UNPACK_H
+
+#include "packet_format.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cerelog {
+
+/* Batch conversion of raw ADS1299 RDATAC frames: 3 status bytes followed
+   by one 24-bit big-endian two's complement value per channel, 27 bytes
+   for the 8-channel part. Frames are read back to back and written out
+   channel by channel (structure of arrays), either as sign-extended codes
+   or as microvolts.
+
+   The kernels are compiled for the 4, 6 and 8-channel parts of the family
+   and use AVX2 or SSE4.1 shuffles when the CPU has them, falling back to
+   plain C++. All levels give bit-identical results. */
+
+// Bytes of one frame for a part with this many channels
+constexpr size_t frame_bytes(size_t channels) {
+    return ADS1299_STATUS_BYTES + channels * ADS1299_BYTES_PER_CHANNEL;
+}
+
+// NU_CH[1:0] of the ID register: 4, 6 or 8 channels
+constexpr size_t channels_from_id(uint8_t id) {
+    return (id & 0x3) == 0 ? 4 : (id & 0x3) == 1 ? 6 : 8;
+}
+
+// PGA gain selected by CHnSET GAIN[2:0]; the reserved code reads as 24
+double gain_from_chset(uint8_t chset);
+
+/* Microvolts per code of each channel, from the CHnSET registers of the
+   register map (ID at index 0, as sent in marker packets) and the
+   reference voltage. One LSB is 2 * VREF / gain / 2^24. */
+void scale_from_registers(const uint8_t *registers, size_t channels, double vref, float *uv_per_code);
+
+enum class simd_level { scalar, sse41, avx2 };
+
+// Best level this CPU supports
+simd_level supported_simd_level();
+// Level the kernels use: the supported one unless lowered with set_simd_level
+simd_level active_simd_level();
+// Limits the kernels to level (or the supported one, if lower); for benchmarks
+void set_simd_level(simd_level level);
+const char *simd_level_name(simd_level level);
+
+/* Unpacks count frames. channels[c] receives count codes of channel c;
+   status, if not null, receives each frame's 24-bit status word.
+   Instantiated for Channels = 4, 6 and 8. */
+template <size_t Channels>
+void unpack_frames(const uint8_t *frames, size_t count, int32_t *const *channels, uint32_t *status);
+
+// Same, scaled by uv_per_code[c] into microvolts
+template <size_t Channels>
+void unpack_frames_uv(const uint8_t *frames, size_t count, const float *uv_per_code, float *const *channels,
+                      uint32_t *status);
+
+extern template void unpack_frames<4>(const uint8_t *, size_t, int32_t *const *, uint32_t *);
+extern template void unpack_frames<6>(const uint8_t *, size_t, int32_t *const *, uint32_t *);
+extern template void unpack_frames<8>(const uint8_t *, size_t, int32_t *const *, uint32_t *);
+extern template void unpack_frames_uv<4>(const uint8_t *, size_t, const float *, float *const *, uint32_t *);
+extern template void unpack_frames_uv<6>(const uint8_t *, size_t, const float *, float *const *, uint32_t *);
+extern template void unpack_frames_uv<8>(const uint8_t *, size_t, const float *, float *const *, uint32_t *);
+
+} // namespace cerelog
+
+#endif // CERELOG_FRAME_UNPACK_H
\ No newline at end of file
@@ -0,0 +1,204 @@
+#include "gap_recovery.h"
+#include "command.h"
+#include "packet_crc.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace cerelog {
+
+namespace {
+
+// Most samples one resend range can name
+constexpr uint64_t kMaxRangeSamples = UINT16_MAX;
+
+void append_resend_frame(std::vector<uint8_t> &out, const uint8_t *args, size_t args_length) {
+    size_t start = out.size();
+    size_t length = 1 + args_length;
+    out.push_back(PACKET_START_BYTE1);
+    out.push_back(PACKET_START_BYTE2);
+    out.push_back(PACKET_TYPE_COMMAND);
+    out.push_back(uint8_t(length));
+    out.push_back(CMD_RESEND);
+    out.insert(out.end(), args, args + args_length);
+    uint16_t crc = packet_crc_compute(out.data() + start, 4 + length);
+    out.push_back(uint8_t(crc & 0xFF));
+    out.push_back(uint8_t(crc >> 8));
+    out.push_back(PACKET_END_BYTE1);
+    out.push_back(PACKET_END_BYTE2);
+}
+
+} // namespace
+
+gap_recovery::gap_recovery(std::chrono::milliseconds hold, std::chrono::milliseconds retry, size_t max_held)
+    : hold_(hold), retry_(retry), max_held_(max_held) {
+    if (hold.count() <= 0 || retry.count() <= 0 || max_held == 0) {
+        throw std::invalid_argument("gap_recovery: hold and retry must be positive, max_held at least 1");
+    }
+}
+
+void gap_recovery::push(const sample_block &in, size_t count) {
+    if (count && !in.sample_number) {
+        throw std::invalid_argument("gap_recovery: sample numbers are required");
+    }
+    clock::time_point now = clock::now();
+
+    for (size_t i = 0; i < count; i++) {
+        row r;
+        std::copy(in.channels + i * kChannels, in.channels + (i + 1) * kChannels, r.channels.begin());
+        r.sample_number = in.sample_number[i];
+        r.timestamp_ns = in.timestamp_ns ? in.timestamp_ns[i] : 0;
+        r.status = in.status ? in.status[i] : 0;
+
+        uint32_t s = r.sample_number;
+        if (!started_) {
+            started_ = true;
+            next_raw_ = s;
+        }
+        int32_t delta = int32_t(s - next_raw_);
+        if (delta < 0 && s <= 1) {
+            // Whatever the old run still owed is not coming
+            flush();
+            next_raw_ = s;
+            delta = 0;
+            stats_.restarts++;
+        }
+        if (delta < 0 && uint64_t(-int64_t(delta)) > next_) {
+            stats_.duplicates++;
+            continue;
+        }
+        uint64_t u = next_ + int64_t(delta);
+
+        if (delta >= 0) {
+            if (delta > 0) {
+                stats_.gaps++;
+                if (uint64_t(delta) > max_held_) {
+                    // More than could be held while waiting for it
+                    flush();
+                    stats_.lost += uint64_t(delta);
+                } else {
+                    gaps_[next_] = gap{u, now, now, 0};
+                }
+            }
+            next_ = u + 1;
+            next_raw_ = s + 1;
+            if (gaps_.empty()) {
+                ready_.push_back(r);
+                release_ = next_;
+            } else {
+                held_.emplace(u, r);
+            }
+            continue;
+        }
+
+        // Behind the highest seen: fills a gap, or is a repeat
+        auto it = gaps_.upper_bound(u);
+        if (u < release_ || it == gaps_.begin() || u >= std::prev(it)->second.end) {
+            stats_.duplicates++;
+            continue;
+        }
+        --it;
+        uint64_t start = it->first;
+        gap g = it->second;
+        gaps_.erase(it);
+        if (start < u) {
+            gaps_[start] = gap{u, g.found, g.asked, g.tries};
+        }
+        if (u + 1 < g.end) {
+            gaps_[u + 1] = g;
+        }
+        held_.emplace(u, r);
+        stats_.recovered++;
+    }
+    release();
+}
+
+// Moves held samples to ready_ up to the first gap
+void gap_recovery::release() {
+    uint64_t bound = gaps_.empty() ? next_ : gaps_.begin()->first;
+    auto it = held_.begin();
+    while (it != held_.end() && it->first < bound) {
+        ready_.push_back(it->second);
+        it = held_.erase(it);
+    }
+    release_ = bound;
+}
+
+void gap_recovery::give_up_front() {
+    auto it = gaps_.begin();
+    stats_.lost += it->second.end - it->first;
+    gaps_.erase(it);
+    release();
+}
+
+void gap_recovery::flush() {
+    while (!gaps_.empty()) {
+        give_up_front();
+    }
+}
+
+/* One CMD_RESEND frame per RESEND_MAX_RANGES ranges. A range is numbered
+   as the device numbers its samples, counting back from next_raw_. */
+void gap_recovery::append_requests(std::vector<uint8_t> &requests, clock::time_point now) {
+    uint8_t args[RESEND_MAX_RANGES * RESEND_RANGE_SIZE];
+    size_t ranges = 0;
+
+    for (auto &entry : gaps_) {
+        gap &g = entry.second;
+        if (g.tries >= kMaxTries || (g.tries > 0 && now - g.asked < retry_)) {
+            continue;
+        }
+        g.tries++;
+        g.asked = now;
+        for (uint64_t first = entry.first; first < g.end;) {
+            uint64_t count = std::min(g.end - first, kMaxRangeSamples);
+            uint32_t number = next_raw_ - uint32_t(next_ - first);
+            uint8_t *range = args + ranges * RESEND_RANGE_SIZE;
+            range[0] = uint8_t(number);
+            range[1] = uint8_t(number >> 8);
+            range[2] = uint8_t(number >> 16);
+            range[3] = uint8_t(number >> 24);
+            range[4] = uint8_t(count);
+            range[5] = uint8_t(count >> 8);
+            stats_.requested += count;
+            first += count;
+            if (++ranges == RESEND_MAX_RANGES) {
+                append_resend_frame(requests, args, ranges * RESEND_RANGE_SIZE);
+                stats_.requests++;
+                ranges = 0;
+            }
+        }
+    }
+    if (ranges) {
+        append_resend_frame(requests, args, ranges * RESEND_RANGE_SIZE);
+        stats_.requests++;
+    }
+}
+
+size_t gap_recovery::pop(const sample_block &out, std::vector<uint8_t> &requests) {
+    clock::time_point now = clock::now();
+    while (!gaps_.empty() && (now - gaps_.begin()->second.found > hold_ || held_.size() > max_held_)) {
+        give_up_front();
+    }
+    append_requests(requests, now);
+
+    size_t n = std::min(out.capacity, ready_.size());
+    for (size_t i = 0; i < n; i++) {
+        const row &r = ready_.front();
+        std::copy(r.channels.begin(), r.channels.end(), out.channels + i * kChannels);
+        if (out.sample_number) {
+            out.sample_number[i] = r.sample_number;
+        }
+        if (out.timestamp_ns) {
+            out.timestamp_ns[i] = r.timestamp_ns;
+        }
+        if (out.status) {
+            out.status[i] = r.status;
+        }
+        ready_.pop_front();
+    }
+    stats_.samples += n;
+    return n;
+}
+
+} // namespace cerelog
\ No newline at end of file
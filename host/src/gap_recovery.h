@@ -0,0 +1,107 @@
+#ifndef CERELOG_GAP_RECOVERY_H
+#define CERELOG_GAP_RECOVERY_H
+
+#include "stream_decoder.h"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <vector>
+
+namespace cerelog {
+
+/* Host half of the firmware's retransmit window (retransmit.c).
+
+   Decoded samples go in as they arrive and come out in sample number
+   order. A jump in the sample number is a gap: the samples after it are
+   held, and a CMD_RESEND frame asking for the missing range is handed
+   back for the caller to write to the board. The device sends the batch
+   packets that carried them again, which fill the gap and let the held
+   samples go. A gap is asked for again every retry interval, up to
+   kMaxTries times, and given up on as lost once it is older than hold, or
+   when more than max_held samples wait behind it. So a clean link adds no
+   delay, and a damaged one delays the output by about one round trip.
+
+   Resent packets repeat samples around the gap; those, like any sample
+   already passed on, are dropped as duplicates. A sample number back at 0
+   or 1 is a device that restarted, and what its old run owed is given up
+   on. Not thread-safe. */
+
+struct recovery_stats {
+    uint64_t samples = 0;           // Passed on
+    uint64_t gaps = 0;              // Jumps in the sample number
+    uint64_t requested = 0;         // Samples asked for, retries included
+    uint64_t requests = 0;          // CMD_RESEND frames built
+    uint64_t recovered = 0;         // Samples that came back to fill a gap
+    uint64_t lost = 0;              // Samples given up on
+    uint64_t duplicates = 0;        // Already held or passed on, or given up on
+    uint64_t restarts = 0;
+};
+
+class gap_recovery {
+public:
+    // Requests per gap before waiting out the hold time
+    static constexpr int kMaxTries = 3;
+
+    // Throws std::invalid_argument if hold or retry is not positive, or max_held is 0
+    explicit gap_recovery(std::chrono::milliseconds hold = std::chrono::milliseconds(500),
+                          std::chrono::milliseconds retry = std::chrono::milliseconds(150),
+                          size_t max_held = 1 << 16);
+
+    // Takes count decoded samples from in, in the order they arrived
+    void push(const sample_block &in, size_t count);
+
+    /* Writes into out, from out[0], up to out.capacity samples that are now
+       in order, and appends to requests the CMD_RESEND frames due for new
+       and unanswered gaps. Gives up on gaps held too long. Returns the
+       samples written. */
+    size_t pop(const sample_block &out, std::vector<uint8_t> &requests);
+
+    // Gives up on every gap, so pop() passes on all that is held, at the end of a stream
+    void flush();
+
+    // Samples waiting, in order or behind a gap
+    size_t held() const { return ready_.size() + held_.size(); }
+    const recovery_stats &stats() const { return stats_; }
+
+private:
+    using clock = std::chrono::steady_clock;
+    struct row {
+        std::array<int32_t, kChannels> channels;
+        uint64_t timestamp_ns;
+        uint32_t sample_number;
+        uint32_t status;
+    };
+    struct gap {
+        uint64_t end;               // One past the last missing sample
+        clock::time_point found;
+        clock::time_point asked;
+        int tries;
+    };
+
+    void take(uint64_t number, const row &r);
+    void give_up_front();
+    void release();
+    void append_requests(std::vector<uint8_t> &requests, clock::time_point now);
+
+    std::chrono::milliseconds hold_;
+    std::chrono::milliseconds retry_;
+    size_t max_held_;
+    bool started_ = false;
+    /* Sample numbers are extended to 64 bits, and run on across a restart,
+       so a wrap or a restart never sends them backwards here */
+    uint64_t next_ = 0;             // One past the highest seen
+    uint32_t next_raw_ = 0;         // next_ as the device numbers it
+    uint64_t release_ = 0;          // Everything before this is in ready_ or passed on
+    std::deque<row> ready_;         // In order, before the first gap
+    std::map<uint64_t, row> held_;  // Behind a gap
+    std::map<uint64_t, gap> gaps_;  // By first missing sample
+    recovery_stats stats_;
+};
+
+} // namespace cerelog
+
+#endif // CERELOG_GAP_RECOVERY_H
\ No newline at end of file
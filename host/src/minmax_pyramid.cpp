@@ -0,0 +1,156 @@
+#include "minmax_pyramid.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace cerelog {
+
+namespace {
+
+constexpr float kEmptyMin = std::numeric_limits<float>::infinity();
+constexpr float kEmptyMax = -std::numeric_limits<float>::infinity();
+
+} // namespace
+
+minmax_pyramid::minmax_pyramid(size_t channels, size_t capacity, size_t fanout)
+    : channels_(channels), capacity_(capacity), fanout_(fanout) {
+    if (channels == 0 || capacity == 0 || fanout < 2) {
+        throw std::invalid_argument("minmax_pyramid: channels and capacity must be at least 1, fanout at least 2");
+    }
+    raw_.resize(capacity * channels);
+    x_.resize(capacity);
+    for (uint64_t size = fanout; size <= capacity; size *= fanout) {
+        level l;
+        l.size = size;
+        // Every bucket overlapping the samples held, the one being filled included
+        l.buckets = capacity / size + 2;
+        l.min.resize(l.buckets * channels);
+        l.max.resize(l.buckets * channels);
+        l.partial_min.assign(channels, kEmptyMin);
+        l.partial_max.assign(channels, kEmptyMax);
+        levels_.push_back(std::move(l));
+    }
+}
+
+void minmax_pyramid::append(const float *values, const double *x, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        const float *v = values + i * channels_;
+        size_t slot = size_t(end_ % capacity_);
+        std::copy(v, v + channels_, &raw_[slot * channels_]);
+        x_[slot] = x[i];
+        end_++;
+
+        // Each level takes the sample, or the bucket just closed below it, until one is still open
+        const float *in_min = v;
+        const float *in_max = v;
+        for (level &l : levels_) {
+            for (size_t c = 0; c < channels_; c++) {
+                l.partial_min[c] = std::min(l.partial_min[c], in_min[c]);
+                l.partial_max[c] = std::max(l.partial_max[c], in_max[c]);
+            }
+            if (end_ % l.size != 0) {
+                break;
+            }
+            size_t bucket = size_t((end_ / l.size - 1) % l.buckets);
+            float *min = &l.min[bucket * channels_];
+            float *max = &l.max[bucket * channels_];
+            std::copy(l.partial_min.begin(), l.partial_min.end(), min);
+            std::copy(l.partial_max.begin(), l.partial_max.end(), max);
+            std::fill(l.partial_min.begin(), l.partial_min.end(), kEmptyMin);
+            std::fill(l.partial_max.begin(), l.partial_max.end(), kEmptyMax);
+            in_min = min;
+            in_max = max;
+        }
+    }
+}
+
+/* Folds samples [a, b) into min and max, whole buckets at a time: up
+   through the levels while a is not yet aligned for the next, then down
+   again as what is left gets shorter. Every bucket so chosen has closed,
+   since b is at most end_. */
+void minmax_pyramid::fold(uint64_t a, uint64_t b, float *min, float *max) const {
+    // Level k > 0 is levels_[k - 1]; level 0 the samples themselves
+    auto size = [this](size_t k) { return k ? levels_[k - 1].size : 1; };
+    auto take = [&](size_t k) {
+        const float *lo;
+        const float *hi;
+        if (k == 0) {
+            lo = hi = &raw_[size_t(a % capacity_) * channels_];
+        } else {
+            const level &l = levels_[k - 1];
+            size_t bucket = size_t((a / l.size) % l.buckets);
+            lo = &l.min[bucket * channels_];
+            hi = &l.max[bucket * channels_];
+        }
+        for (size_t c = 0; c < channels_; c++) {
+            min[c] = std::min(min[c], lo[c]);
+            max[c] = std::max(max[c], hi[c]);
+        }
+        a += size(k);
+    };
+
+    size_t k = 0;
+    while (k < levels_.size() && a + size(k + 1) <= b) {
+        while (a % size(k + 1) != 0) {
+            take(k);
+        }
+        k++;
+    }
+    while (a < b) {
+        while (a + size(k) <= b) {
+            take(k);
+        }
+        if (k > 0) {
+            k--;
+        }
+    }
+}
+
+size_t minmax_pyramid::query(uint64_t first, uint64_t count, size_t pixels, double *x, float *values) const {
+    uint64_t lo = std::max(first, begin());
+    uint64_t hi = first < end_ ? first + std::min(count, end_ - first) : first;
+    if (lo >= hi || pixels == 0) {
+        return 0;
+    }
+    uint64_t n = hi - lo;
+
+    if (n <= 2 * uint64_t(pixels)) {
+        for (uint64_t i = 0; i < n; i++) {
+            size_t slot = size_t((lo + i) % capacity_);
+            x[i] = x_[slot];
+            std::copy(&raw_[slot * channels_], &raw_[(slot + 1) * channels_], values + i * channels_);
+        }
+        return size_t(n);
+    }
+
+    for (size_t p = 0; p < pixels; p++) {
+        uint64_t a = lo + n * p / pixels;
+        uint64_t b = lo + n * (p + 1) / pixels;
+        float *min = values + 2 * p * channels_;
+        float *max = min + channels_;
+        std::fill(min, min + channels_, kEmptyMin);
+        std::fill(max, max + channels_, kEmptyMax);
+        fold(a, b, min, max);
+        x[2 * p] = x[2 * p + 1] = x_[size_t(a % capacity_)];
+    }
+    return 2 * pixels;
+}
+
+void minmax_pyramid::clear() {
+    end_ = 0;
+    for (level &l : levels_) {
+        std::fill(l.partial_min.begin(), l.partial_min.end(), kEmptyMin);
+        std::fill(l.partial_max.begin(), l.partial_max.end(), kEmptyMax);
+    }
+}
+
+size_t minmax_pyramid::bytes() const {
+    size_t total = raw_.size() * sizeof(float) + x_.size() * sizeof(double);
+    for (const level &l : levels_) {
+        total += (l.min.size() + l.max.size()) * sizeof(float);
+    }
+    return total;
+}
+
+} // namespace cerelog
\ No newline at end of file
@@ -0,0 +1,77 @@
+#ifndef CERELOG_MINMAX_PYRAMID_H
+#define CERELOG_MINMAX_PYRAMID_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cerelog {
+
+/* Level-of-detail store for plotting long windows of several channels.
+
+   The last capacity samples are kept as they are, and above them levels
+   of buckets, each fanout times longer than the level below, holding
+   every channel's min and max over the bucket. A bucket is written once,
+   when its last sample arrives, so append() costs the same per sample
+   however much is held.
+
+   query() reduces any run of samples to the min and max of each pixel's
+   share of it. A pixel's range is covered by the longest whole buckets
+   that fit, at most 2 * (fanout - 1) per level, so a query costs
+   O(pixels * levels * fanout * channels) for a window of a second or of
+   the whole history alike, and the result is exact: the same min and
+   max a scan of every sample would give.
+
+   Samples are numbered from 0 in the order appended; begin() is the
+   oldest still held. Not thread-safe. */
+class minmax_pyramid {
+public:
+    // Throws std::invalid_argument if channels or capacity is 0, or fanout is below 2
+    minmax_pyramid(size_t channels, size_t capacity, size_t fanout = 4);
+
+    /* Appends interleaved samples [count][channels]; x is each sample's
+       position on the plot's axis, such as its time in ms, and must not
+       decrease */
+    void append(const float *values, const double *x, size_t count);
+
+    /* Reduces samples [first, first + count), clipped to those held, for a
+       plot pixels wide. With more than 2 samples a pixel, each pixel gives
+       two points, its channels' minimums then maximums, both at the x of
+       its first sample; otherwise the samples come out as they are.
+       x has room for 2 * pixels values and values for [2 * pixels][channels].
+       Returns the points written. */
+    size_t query(uint64_t first, uint64_t count, size_t pixels, double *x, float *values) const;
+
+    // Forgets every sample
+    void clear();
+
+    uint64_t begin() const { return end_ > capacity_ ? end_ - capacity_ : 0; }
+    uint64_t end() const { return end_; }
+    size_t channels() const { return channels_; }
+    size_t levels() const { return levels_.size(); }
+    size_t bytes() const;
+
+private:
+    struct level {
+        uint64_t size;              // Samples per bucket
+        size_t buckets;             // Ring length
+        std::vector<float> min;     // [buckets][channels]
+        std::vector<float> max;
+        std::vector<float> partial_min; // Bucket being filled, [channels]
+        std::vector<float> partial_max;
+    };
+
+    void fold(uint64_t a, uint64_t b, float *min, float *max) const;
+
+    size_t channels_;
+    size_t capacity_;
+    size_t fanout_;
+    uint64_t end_ = 0;
+    std::vector<float> raw_;        // [capacity][channels], ring
+    std::vector<double> x_;         // [capacity], ring
+    std::vector<level> levels_;     // Bucketed levels, shortest buckets first
+};
+
+} // namespace cerelog
+
+#endif // CERELOG_MINMAX_PYRAMID_H
\ No newline at end of file
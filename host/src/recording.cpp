@@ -0,0 +1,479 @@
+#include "recording.h"
+#include "packet_crc.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cerelog {
+
+namespace {
+
+constexpr size_t kChunkHeaderBytes = sizeof(recording_chunk_header);
+constexpr size_t kTrailerBytes = sizeof(recording_trailer);
+constexpr size_t kChunkAlign = 4096;
+constexpr size_t kBytesPerSample = 2 * sizeof(uint64_t) + kRecordingFrameBytes;
+
+size_t chunk_stride(size_t chunk_samples) {
+    size_t used = kChunkHeaderBytes + chunk_samples * kBytesPerSample;
+    return (used + kChunkAlign - 1) / kChunkAlign * kChunkAlign;
+}
+
+// Offsets of the three columns within a chunk
+size_t timestamp_offset(size_t chunk_samples) {
+    return kChunkHeaderBytes + chunk_samples * sizeof(uint64_t);
+}
+
+size_t frames_offset(size_t chunk_samples) {
+    return kChunkHeaderBytes + 2 * chunk_samples * sizeof(uint64_t);
+}
+
+// Over the used part of each column, in column order
+uint16_t chunk_data_crc(const uint8_t *chunk, size_t chunk_samples, size_t count) {
+    uint16_t crc = packet_crc_init();
+    crc = packet_crc_update(crc, chunk + kChunkHeaderBytes, count * sizeof(uint64_t));
+    crc = packet_crc_update(crc, chunk + timestamp_offset(chunk_samples), count * sizeof(uint64_t));
+    crc = packet_crc_update(crc, chunk + frames_offset(chunk_samples), count * kRecordingFrameBytes);
+    return packet_crc_final(crc);
+}
+
+// CRC of a struct whose last field is its uint16_t crc, taken as zero
+template <typename T>
+uint16_t struct_crc(const T &value) {
+    T copy = value;
+    copy.crc = 0;
+    return packet_crc_compute(reinterpret_cast<const uint8_t *>(&copy), sizeof(copy));
+}
+
+inline void put_be24(uint8_t *p, uint32_t value) {
+    p[0] = uint8_t(value >> 16);
+    p[1] = uint8_t(value >> 8);
+    p[2] = uint8_t(value);
+}
+
+inline int32_t be24(const uint8_t *p) {
+    return int32_t(uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8) >> 8;
+}
+
+inline uint32_t status24(const uint8_t *p) {
+    return uint32_t(p[0]) << 16 | uint32_t(p[1]) << 8 | p[2];
+}
+
+int seek(std::FILE *file, uint64_t offset) {
+#if defined(_WIN32)
+    return _fseeki64(file, int64_t(offset), SEEK_SET);
+#else
+    return fseeko(file, off_t(offset), SEEK_SET);
+#endif
+}
+
+} // namespace
+
+recording_writer::recording_writer(const std::string &path, const recording_config &config)
+    : path_(path), config_(config) {
+    if (config.chunk_samples == 0 || config.chunk_samples > UINT32_MAX) {
+        throw std::invalid_argument("recording_writer: chunk_samples must be between 1 and 2^32 - 1");
+    }
+    chunk_bytes_ = chunk_stride(config.chunk_samples);
+    chunk_.assign(chunk_bytes_, 0);
+    sequence_ = reinterpret_cast<uint64_t *>(chunk_.data() + kChunkHeaderBytes);
+    timestamp_ = reinterpret_cast<uint64_t *>(chunk_.data() + timestamp_offset(config.chunk_samples));
+    frames_ = chunk_.data() + frames_offset(config.chunk_samples);
+
+    file_ = std::fopen(path.c_str(), "w+b");
+    if (!file_) {
+        throw std::runtime_error("recording_writer: cannot create " + path);
+    }
+
+    recording_header header = {};
+    header.magic = kRecordingMagic;
+    header.version = kRecordingVersion;
+    header.channels = kChannels;
+    header.frame_bytes = kRecordingFrameBytes;
+    header.chunk_samples = uint32_t(config.chunk_samples);
+    header.chunk_bytes = chunk_bytes_;
+    header.created_unix_ns = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    header.sample_rate_hz = config.sample_rate_hz;
+    if (config.registers) {
+        std::memcpy(header.registers, config.registers, sizeof(header.registers));
+    }
+    header.crc = struct_crc(header);
+    write_at(0, &header, sizeof(header));
+    config_.registers = nullptr;        // Not kept past construction
+}
+
+recording_writer::~recording_writer() {
+    try {
+        close();
+    } catch (...) {
+        // The file stays readable up to the last flush
+    }
+    if (file_) {
+        std::fclose(file_);
+    }
+}
+
+void recording_writer::write_at(uint64_t offset, const void *data, size_t length) {
+    if (seek(file_, offset) != 0 || std::fwrite(data, 1, length, file_) != length) {
+        throw std::runtime_error("recording_writer: write to " + path_ + " failed");
+    }
+    bytes_written_ += length;
+}
+
+void recording_writer::append(const sample_block &block, size_t count) {
+    if (!file_) {
+        throw std::runtime_error("recording_writer: append after close");
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        uint32_t number = block.sample_number ? block.sample_number[i] : last_number_ + 1;
+        uint64_t sequence = number;
+        if (have_number_) {
+            // Forwards within half the 32-bit range is the device counting on, wrapped or not
+            uint32_t delta = number - last_number_;
+            sequence = delta != 0 && delta < 0x80000000U ? last_sequence_ + delta : last_sequence_ + 1;
+        }
+        have_number_ = true;
+        last_number_ = number;
+        last_sequence_ = sequence;
+
+        sequence_[count_] = sequence;
+        timestamp_[count_] = block.timestamp_ns ? block.timestamp_ns[i] : 0;
+        uint8_t *frame = frames_ + count_ * kRecordingFrameBytes;
+        put_be24(frame, block.status ? block.status[i] : 0);
+        const int32_t *channels = block.channels + i * kChannels;
+        for (size_t ch = 0; ch < kChannels; ch++) {
+            put_be24(frame + ADS1299_STATUS_BYTES + ch * ADS1299_BYTES_PER_CHANNEL, uint32_t(channels[ch]));
+        }
+
+        count_++;
+        samples_++;
+        unflushed_++;
+        if (count_ == config_.chunk_samples) {
+            write_chunk(true);
+        }
+    }
+
+    if (config_.flush_samples && unflushed_ >= config_.flush_samples) {
+        flush();
+    }
+}
+
+/* Writes the samples of the current chunk not yet in the file, then its
+   header, so a header on disk never counts samples that are not. A chunk
+   filled between flushes goes out in a single write. */
+void recording_writer::write_chunk(bool full) {
+    size_t cap = config_.chunk_samples;
+    recording_chunk_header *header = reinterpret_cast<recording_chunk_header *>(chunk_.data());
+    uint64_t base = kRecordingHeaderBytes + uint64_t(chunks_) * chunk_bytes_;
+
+    *header = {};
+    header->magic = kRecordingChunkMagic;
+    header->index = chunks_;
+    header->count = uint32_t(count_);
+    header->data_crc = chunk_data_crc(chunk_.data(), cap, count_);
+    header->first_sequence = sequence_[0];
+    header->last_sequence = sequence_[count_ - 1];
+    header->first_timestamp_ns = timestamp_[0];
+    header->last_timestamp_ns = timestamp_[count_ - 1];
+    header->crc = struct_crc(*header);
+
+    if (full && flushed_ == 0) {
+        write_at(base, chunk_.data(), chunk_bytes_);
+    } else {
+        size_t from = flushed_, n = count_ - flushed_;
+        write_at(base + kChunkHeaderBytes + from * sizeof(uint64_t), sequence_ + from, n * sizeof(uint64_t));
+        write_at(base + timestamp_offset(cap) + from * sizeof(uint64_t), timestamp_ + from, n * sizeof(uint64_t));
+        write_at(base + frames_offset(cap) + from * kRecordingFrameBytes, frames_ + from * kRecordingFrameBytes,
+                 n * kRecordingFrameBytes);
+        write_at(base, header, kChunkHeaderBytes);
+    }
+
+    if (full) {
+        chunks_++;
+        count_ = 0;
+        flushed_ = 0;
+    } else {
+        flushed_ = count_;
+    }
+}
+
+void recording_writer::flush() {
+    if (!file_) {
+        return;
+    }
+    if (count_ > flushed_) {
+        write_chunk(false);
+    }
+    if (std::fflush(file_) != 0) {
+        throw std::runtime_error("recording_writer: flush of " + path_ + " failed");
+    }
+    unflushed_ = 0;
+}
+
+/* The index is built from the chunk headers read back from the file, one
+   at a time, so it takes no memory while recording */
+void recording_writer::close() {
+    if (!file_) {
+        return;
+    }
+    flush();
+
+    uint32_t chunks = chunks_ + (count_ ? 1 : 0);
+    uint64_t index_offset = kRecordingHeaderBytes + uint64_t(chunks) * chunk_bytes_;
+    uint16_t index_crc = packet_crc_init();
+    for (uint32_t k = 0; k < chunks; k++) {
+        recording_chunk_header header;
+        if (seek(file_, kRecordingHeaderBytes + uint64_t(k) * chunk_bytes_) != 0 ||
+            std::fread(&header, sizeof(header), 1, file_) != 1) {
+            throw std::runtime_error("recording_writer: cannot read back " + path_);
+        }
+        recording_index_entry entry = {header.first_sequence, header.last_sequence, header.first_timestamp_ns,
+                                       header.last_timestamp_ns};
+        index_crc = packet_crc_update(index_crc, reinterpret_cast<const uint8_t *>(&entry), sizeof(entry));
+        write_at(index_offset + uint64_t(k) * sizeof(entry), &entry, sizeof(entry));
+    }
+
+    recording_trailer trailer = {};
+    trailer.magic = kRecordingIndexMagic;
+    trailer.chunks = chunks;
+    trailer.samples = samples_;
+    trailer.index_offset = index_offset;
+    trailer.index_crc = packet_crc_final(index_crc);
+    trailer.crc = struct_crc(trailer);
+    write_at(index_offset + uint64_t(chunks) * sizeof(recording_index_entry), &trailer, sizeof(trailer));
+
+    int failed = std::fclose(file_);
+    file_ = nullptr;
+    if (failed) {
+        throw std::runtime_error("recording_writer: close of " + path_ + " failed");
+    }
+}
+
+recording_reader::recording_reader(const std::string &path) {
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER size;
+    if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size) || size.QuadPart < LONGLONG(kRecordingHeaderBytes)) {
+        if (file != INVALID_HANDLE_VALUE) {
+            CloseHandle(file);
+        }
+        throw std::runtime_error("recording_reader: cannot open " + path);
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void *view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        throw std::runtime_error("recording_reader: cannot map " + path);
+    }
+    file_handle_ = file;
+    mapping_handle_ = mapping;
+    length_ = size_t(size.QuadPart);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || size_t(st.st_size) < kRecordingHeaderBytes) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        throw std::runtime_error("recording_reader: cannot open " + path);
+    }
+    void *view = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        throw std::runtime_error("recording_reader: cannot map " + path);
+    }
+    length_ = size_t(st.st_size);
+#endif
+    data_ = static_cast<const uint8_t *>(view);
+
+    std::memcpy(&header_, data_, sizeof(header_));
+    bool valid = header_.magic == kRecordingMagic && header_.version == kRecordingVersion &&
+                 header_.crc == struct_crc(header_) && header_.channels == kChannels &&
+                 header_.frame_bytes == kRecordingFrameBytes && header_.chunk_samples != 0 &&
+                 header_.chunk_bytes == chunk_stride(header_.chunk_samples);
+    if (!valid) {
+        unmap();
+        throw std::runtime_error("recording_reader: " + path + " is not a recording");
+    }
+
+    if (!load_footer()) {
+        rebuild_index();
+    }
+}
+
+recording_reader::~recording_reader() {
+    unmap();
+}
+
+void recording_reader::unmap() {
+    if (!data_) {
+        return;
+    }
+#if defined(_WIN32)
+    UnmapViewOfFile(data_);
+    CloseHandle(mapping_handle_);
+    CloseHandle(file_handle_);
+#else
+    munmap(const_cast<uint8_t *>(data_), length_);
+#endif
+    data_ = nullptr;
+}
+
+const recording_chunk_header *recording_reader::chunk(size_t k) const {
+    return reinterpret_cast<const recording_chunk_header *>(data_ + kRecordingHeaderBytes + k * header_.chunk_bytes);
+}
+
+const uint64_t *recording_reader::sequence_column(size_t k) const {
+    return reinterpret_cast<const uint64_t *>(reinterpret_cast<const uint8_t *>(chunk(k)) + kChunkHeaderBytes);
+}
+
+const uint64_t *recording_reader::timestamp_column(size_t k) const {
+    return reinterpret_cast<const uint64_t *>(reinterpret_cast<const uint8_t *>(chunk(k)) +
+                                              timestamp_offset(header_.chunk_samples));
+}
+
+// Takes the footer if it is whole and agrees with the file; the chunks are not read
+bool recording_reader::load_footer() {
+    if (length_ < kRecordingHeaderBytes + kTrailerBytes) {
+        return false;
+    }
+    recording_trailer trailer;
+    std::memcpy(&trailer, data_ + length_ - kTrailerBytes, sizeof(trailer));
+    uint64_t cap = header_.chunk_samples;
+    if (trailer.magic != kRecordingIndexMagic || trailer.crc != struct_crc(trailer) ||
+        trailer.index_offset != kRecordingHeaderBytes + uint64_t(trailer.chunks) * header_.chunk_bytes ||
+        trailer.index_offset + uint64_t(trailer.chunks) * sizeof(recording_index_entry) + kTrailerBytes != length_ ||
+        trailer.samples > uint64_t(trailer.chunks) * cap ||
+        (trailer.chunks && trailer.samples <= uint64_t(trailer.chunks - 1) * cap)) {
+        return false;
+    }
+    const uint8_t *entries = data_ + trailer.index_offset;
+    if (packet_crc_compute(entries, trailer.chunks * sizeof(recording_index_entry)) != trailer.index_crc) {
+        return false;
+    }
+
+    index_.resize(trailer.chunks);
+    std::memcpy(index_.data(), entries, trailer.chunks * sizeof(recording_index_entry));
+    samples_ = trailer.samples;
+    return true;
+}
+
+/* Walks the chunks from the start and keeps every one whose header and
+   data check out, stopping at the first that does not or that is not
+   full: a writer only ever leaves its last chunk part-filled. */
+void recording_reader::rebuild_index() {
+    size_t cap = header_.chunk_samples;
+    recovered_ = true;
+    index_.clear();
+    samples_ = 0;
+
+    for (size_t k = 0; kRecordingHeaderBytes + k * header_.chunk_bytes + kChunkHeaderBytes <= length_; k++) {
+        const recording_chunk_header *h = chunk(k);
+        size_t base = kRecordingHeaderBytes + k * header_.chunk_bytes;
+        if (h->magic != kRecordingChunkMagic || h->index != k || h->crc != struct_crc(*h) || h->count == 0 ||
+            h->count > cap || base + frames_offset(cap) + h->count * kRecordingFrameBytes > length_ ||
+            chunk_data_crc(data_ + base, cap, h->count) != h->data_crc) {
+            break;
+        }
+        index_.push_back({h->first_sequence, h->last_sequence, h->first_timestamp_ns, h->last_timestamp_ns});
+        samples_ += h->count;
+        if (h->count < cap) {
+            break;
+        }
+    }
+}
+
+size_t recording_reader::read(uint64_t position, size_t count, const sample_block &out, uint64_t *sequence) const {
+    size_t cap = header_.chunk_samples;
+    if (position >= samples_) {
+        return 0;
+    }
+    count = size_t(std::min<uint64_t>({count, out.capacity, samples_ - position}));
+
+    size_t written = 0;
+    while (written < count) {
+        size_t k = size_t(position / cap), first = size_t(position % cap);
+        size_t n = std::min(count - written, cap - first);
+        const uint64_t *seq = sequence_column(k) + first;
+        const uint64_t *ts = timestamp_column(k) + first;
+        const uint8_t *frame = reinterpret_cast<const uint8_t *>(chunk(k)) + frames_offset(cap) +
+                               first * kRecordingFrameBytes;
+
+        for (size_t i = 0; i < n; i++, frame += kRecordingFrameBytes) {
+            size_t j = written + i;
+            int32_t *channels = out.channels + j * kChannels;
+            for (size_t ch = 0; ch < kChannels; ch++) {
+                channels[ch] = be24(frame + ADS1299_STATUS_BYTES + ch * ADS1299_BYTES_PER_CHANNEL);
+            }
+            if (out.status) {
+                out.status[j] = status24(frame);
+            }
+            if (out.sample_number) {
+                out.sample_number[j] = uint32_t(seq[i]);
+            }
+        }
+        if (out.timestamp_ns) {
+            std::memcpy(out.timestamp_ns + written, ts, n * sizeof(uint64_t));
+        }
+        if (sequence) {
+            std::memcpy(sequence + written, seq, n * sizeof(uint64_t));
+        }
+        written += n;
+        position += n;
+    }
+    return written;
+}
+
+const uint8_t *recording_reader::frames(uint64_t position, size_t *count) const {
+    size_t cap = header_.chunk_samples;
+    if (position >= samples_) {
+        *count = 0;
+        return nullptr;
+    }
+    size_t k = size_t(position / cap), first = size_t(position % cap);
+    *count = size_t(std::min<uint64_t>(cap - first, samples_ - position));
+    return reinterpret_cast<const uint8_t *>(chunk(k)) + frames_offset(cap) + first * kRecordingFrameBytes;
+}
+
+uint64_t recording_reader::find_sequence(uint64_t sequence) const {
+    auto it = std::partition_point(index_.begin(), index_.end(),
+                                   [&](const recording_index_entry &e) { return e.last_sequence < sequence; });
+    if (it == index_.end()) {
+        return samples_;
+    }
+    size_t k = size_t(it - index_.begin());
+    size_t used = size_t(std::min<uint64_t>(header_.chunk_samples, samples_ - uint64_t(k) * header_.chunk_samples));
+    const uint64_t *column = sequence_column(k);
+    return uint64_t(k) * header_.chunk_samples + size_t(std::lower_bound(column, column + used, sequence) - column);
+}
+
+uint64_t recording_reader::find_time(uint64_t timestamp_ns) const {
+    auto it = std::partition_point(index_.begin(), index_.end(),
+                                   [&](const recording_index_entry &e) { return e.last_timestamp_ns < timestamp_ns; });
+    if (it == index_.end()) {
+        return samples_;
+    }
+    size_t k = size_t(it - index_.begin());
+    size_t used = size_t(std::min<uint64_t>(header_.chunk_samples, samples_ - uint64_t(k) * header_.chunk_samples));
+    const uint64_t *column = timestamp_column(k);
+    return uint64_t(k) * header_.chunk_samples + size_t(std::lower_bound(column, column + used, timestamp_ns) - column);
+}
+
+} // namespace cerelog
\ No newline at end of file
@@ -0,0 +1,215 @@
+#ifndef CERELOG_RECORDING_H
+#define CERELOG_RECORDING_H
+
+#include "stream_decoder.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace cerelog {
+
+/* Chunked binary recording of decoded samples (.crec).
+
+   Layout, little-endian:
+     recording_header                   one, at offset 0
+     chunk k                            at kRecordingHeaderBytes + k * chunk_bytes
+       recording_chunk_header
+       uint64_t sequence[chunk_samples]
+       uint64_t timestamp_ns[chunk_samples]
+       uint8_t  frames[chunk_samples][27]   raw ADS1299 frames, as frame_unpack.h reads them
+     recording_index_entry[chunks]      footer, written by close()
+     recording_trailer                  the last 32 bytes
+
+   Every chunk but the last is full, so sample n is at a fixed place in
+   chunk n / chunk_samples and reading any range costs the same wherever it
+   lies. The footer index holds each chunk's first and last sequence and
+   timestamp, for finding a sample number or time with a binary search
+   without touching the chunks.
+
+   sequence is the device sample number widened to 64 bits: 32-bit
+   wrap-around is unwrapped and a restart of the numbering (a reboot)
+   carries on from the last value, so it only increases and keeps the
+   device's gaps.
+
+   Each chunk header and its data carry a CRC-16. A file whose writer
+   never reached close() has no footer; the reader then rebuilds the index
+   from the chunks that check out, up to the last one flushed. */
+
+constexpr uint32_t kRecordingMagic = 0x43455243;        // "CREC"
+constexpr uint32_t kRecordingChunkMagic = 0x4B4E4843;   // "CHNK"
+constexpr uint32_t kRecordingIndexMagic = 0x58444E49;   // "INDX"
+constexpr uint16_t kRecordingVersion = 1;
+constexpr size_t kRecordingFrameBytes = ADS1299_TOTAL_DATA_BYTES;
+
+struct recording_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t channels;
+    uint32_t frame_bytes;
+    uint32_t chunk_samples;
+    uint64_t chunk_bytes;               // Chunk stride, a multiple of 4 KiB
+    uint64_t created_unix_ns;
+    double sample_rate_hz;              // As configured; timestamps are the authority
+    uint8_t registers[PACKET_REGISTER_BYTES];   // Register map at the start, ID first; zeros if unknown
+    uint8_t reserved[62];
+    uint16_t crc;                       // Over everything above
+};
+constexpr size_t kRecordingHeaderBytes = 128;
+static_assert(sizeof(recording_header) == kRecordingHeaderBytes, "recording_header layout");
+
+struct recording_chunk_header {
+    uint32_t magic;
+    uint32_t index;                     // k, checked against the chunk's position
+    uint32_t count;                     // Samples used, chunk_samples in all but the last chunk
+    uint16_t data_crc;                  // Over the used part of the three columns
+    uint16_t crc;                       // Over this header, with crc itself zero
+    uint64_t first_sequence;
+    uint64_t last_sequence;
+    uint64_t first_timestamp_ns;
+    uint64_t last_timestamp_ns;
+    uint8_t reserved[16];
+};
+static_assert(sizeof(recording_chunk_header) == 64, "recording_chunk_header layout");
+
+struct recording_index_entry {
+    uint64_t first_sequence;
+    uint64_t last_sequence;
+    uint64_t first_timestamp_ns;
+    uint64_t last_timestamp_ns;
+};
+
+struct recording_trailer {
+    uint32_t magic;
+    uint32_t chunks;
+    uint64_t samples;
+    uint64_t index_offset;
+    uint16_t index_crc;
+    uint8_t reserved[4];
+    uint16_t crc;                       // Over this trailer, with crc itself zero
+};
+static_assert(sizeof(recording_trailer) == 32, "recording_trailer layout");
+
+struct recording_config {
+    size_t chunk_samples = 4096;        // About 170 KiB a chunk
+    double sample_rate_hz = 250.0;
+    const uint8_t *registers = nullptr; // PACKET_REGISTER_BYTES bytes, may be null
+    /* The part-filled chunk is written out at least this often, in
+       samples, so a crash loses no more than this; 0 only writes whole
+       chunks */
+    size_t flush_samples = 250;
+};
+
+/* Appends decoded samples to a new recording.
+
+   Memory is one chunk whatever the length of the recording. A full chunk
+   goes to the file in one write; the part-filled one is rewritten in its
+   slot every flush_samples, so an interrupted recording stays readable up
+   to the last flush. close() then reads the chunk headers back to write
+   the footer. Throws std::runtime_error when the file cannot be written.
+   Not thread-safe. */
+class recording_writer {
+public:
+    // Creates or truncates path; throws std::invalid_argument for chunk_samples of 0
+    recording_writer(const std::string &path, const recording_config &config);
+    ~recording_writer();
+
+    recording_writer(const recording_writer &) = delete;
+    recording_writer &operator=(const recording_writer &) = delete;
+
+    /* Appends block[0..count). A null sample_number counts on from the
+       previous sample; null timestamp_ns or status record zeros. */
+    void append(const sample_block &block, size_t count);
+
+    // Writes the part-filled chunk and flushes the stream
+    void flush();
+
+    // Flushes, writes the footer and closes the file; later calls do nothing
+    void close();
+
+    uint64_t samples() const { return samples_; }
+    uint64_t bytes_written() const { return bytes_written_; }
+    size_t chunk_bytes() const { return chunk_bytes_; }
+
+private:
+    void write_chunk(bool full);
+    void write_at(uint64_t offset, const void *data, size_t length);
+
+    std::FILE *file_ = nullptr;
+    std::string path_;
+    recording_config config_;
+    size_t chunk_bytes_;
+    std::vector<uint8_t> chunk_;        // The chunk being filled, laid out as on disk
+    uint64_t *sequence_;
+    uint64_t *timestamp_;
+    uint8_t *frames_;
+    size_t count_ = 0;
+    uint32_t chunks_ = 0;               // Whole chunks written
+    uint64_t samples_ = 0;
+    uint64_t bytes_written_ = 0;
+    size_t flushed_ = 0;                // Samples of the current chunk already in the file
+    size_t unflushed_ = 0;              // Samples appended since the last flush
+    bool have_number_ = false;
+    uint32_t last_number_ = 0;
+    uint64_t last_sequence_ = 0;
+};
+
+/* Read-only view of a recording, mapped into memory.
+
+   Opening reads the header and footer only. Reads decode straight from
+   the mapping, so the operating system pages in just the chunks a range
+   touches. Thread-safe for concurrent reads. */
+class recording_reader {
+public:
+    // Throws std::runtime_error if path cannot be mapped or is not a recording
+    explicit recording_reader(const std::string &path);
+    ~recording_reader();
+
+    recording_reader(const recording_reader &) = delete;
+    recording_reader &operator=(const recording_reader &) = delete;
+
+    const recording_header &header() const { return header_; }
+    uint64_t size() const { return samples_; }
+    size_t chunks() const { return index_.size(); }
+    // The footer was missing or damaged and the index was rebuilt from the chunks
+    bool recovered() const { return recovered_; }
+
+    /* Decodes samples [position, position + count) into out, clipped to
+       the end of the recording and to out.capacity. Returns the number
+       written. out.sample_number gets the low 32 bits of the sequence;
+       sequence, if not null, gets all of it. */
+    size_t read(uint64_t position, size_t count, const sample_block &out, uint64_t *sequence = nullptr) const;
+
+    /* The raw frames from position to the end of its chunk, in the file
+       mapping: *count is set to how many there are, 0 past the end */
+    const uint8_t *frames(uint64_t position, size_t *count) const;
+
+    // Position of the first sample with a sequence or timestamp at or after the one given; size() if none
+    uint64_t find_sequence(uint64_t sequence) const;
+    uint64_t find_time(uint64_t timestamp_ns) const;
+
+private:
+    void unmap();
+    bool load_footer();
+    void rebuild_index();
+    const recording_chunk_header *chunk(size_t k) const;
+    const uint64_t *sequence_column(size_t k) const;
+    const uint64_t *timestamp_column(size_t k) const;
+
+    const uint8_t *data_ = nullptr;
+    size_t length_ = 0;
+#if defined(_WIN32)
+    void *file_handle_ = nullptr;
+    void *mapping_handle_ = nullptr;
+#endif
+    recording_header header_;
+    std::vector<recording_index_entry> index_;
+    uint64_t samples_ = 0;
+    bool recovered_ = false;
+};
+
+} // namespace cerelog
+
+#endif // CERELOG_RECORDING_H
\ No newline at end of file
@@ -0,0 +1,273 @@
+#include "replay.h"
+#include "recording.h"
+#include "spectral.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+namespace cerelog {
+
+const char *const kReplayStageNames[kReplayStageCount] = {
+    "input", "scale", "filter", "spectral", "record", "pace",
+};
+
+capture_source::capture_source(const std::string &path, size_t read_bytes)
+    : buffer_(read_bytes ? read_bytes : 1), read_bytes_(read_bytes ? read_bytes : 1) {
+    file_ = std::fopen(path.c_str(), "rb");
+    if (!file_) {
+        throw std::runtime_error("capture_source: cannot open " + path);
+    }
+}
+
+capture_source::capture_source(std::vector<uint8_t> bytes, size_t read_bytes)
+    : memory_(std::move(bytes)), read_bytes_(read_bytes ? read_bytes : 1) {}
+
+capture_source::~capture_source() {
+    if (file_) {
+        std::fclose(file_);
+    }
+}
+
+// Takes the next read_bytes of input; false at the end
+bool capture_source::refill() {
+    if (file_) {
+        chunk_length_ = std::fread(buffer_.data(), 1, buffer_.size(), file_);
+        chunk_ = buffer_.data();
+    } else {
+        chunk_length_ = std::min(read_bytes_, memory_.size() - memory_pos_);
+        chunk_ = memory_.data() + memory_pos_;
+        memory_pos_ += chunk_length_;
+    }
+    chunk_pos_ = 0;
+    taken_ += chunk_length_;
+    return chunk_length_ != 0;
+}
+
+size_t capture_source::next(const sample_block &out) {
+    while (true) {
+        if (chunk_pos_ == chunk_length_ && !refill()) {
+            return 0;
+        }
+        size_t consumed = 0;
+        size_t n = decoder_.decode(chunk_ + chunk_pos_, chunk_length_ - chunk_pos_, out, &consumed);
+        chunk_pos_ += consumed;
+        if (n) {
+            return n;
+        }
+    }
+}
+
+csv_source::csv_source(const std::string &path, double uv_per_code)
+    : codes_per_uv_(1.0 / uv_per_code), line_(4096) {
+    file_ = std::fopen(path.c_str(), "rb");
+    if (!file_) {
+        throw std::runtime_error("csv_source: cannot open " + path);
+    }
+}
+
+csv_source::~csv_source() {
+    if (file_) {
+        std::fclose(file_);
+    }
+}
+
+size_t csv_source::next(const sample_block &out) {
+    size_t written = 0;
+    while (written < out.capacity && std::fgets(line_.data(), int(line_.size()), file_)) {
+        bytes_ += std::strlen(line_.data());
+
+        // Split in place at the commas
+        const char *fields[kChannels + 8];
+        size_t count = 0;
+        for (char *p = line_.data(); count < sizeof(fields) / sizeof(fields[0]);) {
+            fields[count++] = p;
+            p = std::strchr(p, ',');
+            if (!p) {
+                break;
+            }
+            *p++ = '\0';
+        }
+        if (count < kChannels) {
+            if (row_ != 0 && count > 1) {
+                bad_rows_++;
+            }
+            continue;
+        }
+
+        int32_t *channels = out.channels + written * kChannels;
+        bool numeric = true;
+        for (size_t ch = 0; ch < kChannels && numeric; ch++) {
+            const char *f = fields[count - kChannels + ch];
+            char *end;
+            double v = std::strtod(f, &end);
+            numeric = end != f;
+            double code = std::strchr(f, '.') ? std::round(v * codes_per_uv_) : v;
+            channels[ch] = int32_t(std::min(std::max(code, -8388608.0), 8388607.0));
+        }
+        if (!numeric) {
+            // The header row; anywhere else, a stray line
+            if (row_ != 0) {
+                bad_rows_++;
+            }
+            continue;
+        }
+
+        double timestamp_ms = count > kChannels ? std::strtod(fields[0], nullptr) : 0.0;
+        row_++;
+        if (out.sample_number) {
+            out.sample_number[written] = row_;
+        }
+        if (out.timestamp_ns) {
+            out.timestamp_ns[written] = timestamp_ms > 0.0 ? uint64_t(timestamp_ms * 1e6) : 0;
+        }
+        if (out.status) {
+            out.status[written] = 0xC00000;
+        }
+        written++;
+    }
+    return written;
+}
+
+replay_engine::replay_engine(const replay_config &config) : config_(config) {
+    if (config.batch < kMaxPacketSamples) {
+        throw std::invalid_argument("replay_engine: batch must hold a whole packet");
+    }
+    if (config.filter) {
+        filter_bank_config fc;
+        fc.sample_rate_hz = config.sample_rate_hz;
+        fc.mains_hz = config.mains_hz;
+        filter_bank check(fc);
+    }
+    if (config.spectral) {
+        spectral_config sc;
+        sc.sample_rate_hz = config.sample_rate_hz;
+        sc.channels = kChannels;
+        sc.fft_size = config.fft_size;
+        sc.hop = config.hop;
+        spectral_engine check(sc);
+    }
+
+    size_t n = config.batch;
+    codes_.resize(n * kChannels);
+    sample_number_.resize(n);
+    timestamp_.resize(n);
+    status_.resize(n);
+    uv_.resize(n * kChannels);
+    if (config.filter) {
+        clean_.resize(n * kChannels);
+        band_data_.resize(kBandCount * n * kChannels);
+    }
+    for (size_t b = 0; b < kBandCount; b++) {
+        bands_[b] = config.filter ? band_data_.data() + b * n * kChannels : nullptr;
+    }
+}
+
+/* Filters, spectral engine and recorder start fresh on every run, so runs
+   over the same source give the same results */
+replay_report replay_engine::run(replay_source &source, const batch_callback &on_batch) {
+    using clock = std::chrono::steady_clock;
+    auto seconds = [](clock::time_point a, clock::time_point b) { return std::chrono::duration<double>(b - a).count(); };
+
+    std::unique_ptr<filter_bank> bank;
+    if (config_.filter) {
+        filter_bank_config fc;
+        fc.sample_rate_hz = config_.sample_rate_hz;
+        fc.mains_hz = config_.mains_hz;
+        bank.reset(new filter_bank(fc));
+    }
+    std::unique_ptr<spectral_engine> spectra;
+    if (config_.spectral) {
+        spectral_config sc;
+        sc.sample_rate_hz = config_.sample_rate_hz;
+        sc.channels = kChannels;
+        sc.fft_size = config_.fft_size;
+        sc.hop = config_.hop;
+        spectra.reset(new spectral_engine(sc));
+    }
+    std::unique_ptr<recording_writer> recorder;
+    if (!config_.record_path.empty()) {
+        recording_config rc;
+        rc.sample_rate_hz = config_.sample_rate_hz;
+        // Flushing is for crashes during live capture; a replay can be run again
+        rc.flush_samples = 0;
+        recorder.reset(new recording_writer(config_.record_path, rc));
+    }
+
+    sample_block block;
+    block.channels = codes_.data();
+    block.sample_number = sample_number_.data();
+    block.timestamp_ns = timestamp_.data();
+    block.status = status_.data();
+    block.capacity = config_.batch;
+
+    replay_report report;
+    const float scale = float(config_.uv_per_code);
+    clock::time_point start = clock::now();
+
+    while (true) {
+        clock::time_point t0 = clock::now();
+        size_t n = source.next(block);
+        clock::time_point t1 = clock::now();
+        report.stage_seconds[size_t(replay_stage::input)] += seconds(t0, t1);
+        if (!n) {
+            break;
+        }
+
+        for (size_t i = 0; i < n * kChannels; i++) {
+            uv_[i] = float(codes_[i]) * scale;
+        }
+        clock::time_point t2 = clock::now();
+        report.stage_seconds[size_t(replay_stage::scale)] += seconds(t1, t2);
+
+        if (bank) {
+            bank->process(uv_.data(), n, clean_.data(), bands_);
+        }
+        clock::time_point t3 = clock::now();
+        report.stage_seconds[size_t(replay_stage::filter)] += seconds(t2, t3);
+
+        if (spectra) {
+            spectra->push(uv_.data(), n, [&](const spectral_frame &f) {
+                std::memcpy(report.band_power, f.band_power, sizeof(report.band_power));
+                report.spectral_frames++;
+            });
+        }
+        clock::time_point t4 = clock::now();
+        report.stage_seconds[size_t(replay_stage::spectral)] += seconds(t3, t4);
+
+        if (recorder) {
+            recorder->append(block, n);
+        }
+        clock::time_point t5 = clock::now();
+        report.stage_seconds[size_t(replay_stage::record)] += seconds(t4, t5);
+
+        report.samples += n;
+        if (on_batch) {
+            on_batch({n, codes_.data(), sample_number_.data(), timestamp_.data(), uv_.data(),
+                      bank ? clean_.data() : nullptr, bank ? bands_ : nullptr});
+        }
+
+        if (config_.speed > 0.0) {
+            double due = double(report.samples) / (config_.sample_rate_hz * config_.speed);
+            std::this_thread::sleep_until(start + std::chrono::duration_cast<clock::duration>(
+                                                      std::chrono::duration<double>(due)));
+            report.stage_seconds[size_t(replay_stage::pace)] += seconds(t5, clock::now());
+        }
+    }
+
+    if (recorder) {
+        clock::time_point t0 = clock::now();
+        recorder->close();
+        report.stage_seconds[size_t(replay_stage::record)] += seconds(t0, clock::now());
+    }
+    report.input_bytes = source.bytes();
+    report.wall_seconds = seconds(start, clock::now());
+    return report;
+}
+
+} // namespace cerelog
\ No newline at end of file
@@ -0,0 +1,170 @@
+#ifndef CERELOG_REPLAY_H
+#define CERELOG_REPLAY_H
+
+#include "filter_bank.h"
+#include "stream_decoder.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace cerelog {
+
+/* Offline replay of recorded streams through the host pipeline: the same
+   stages python_viz.py runs on a live port, without the board.
+
+     input      read and decode the capture, or parse the CSV
+     scale      codes to microvolts
+     filter     filter_bank: DC high-pass, mains notch and the EEG bands
+     spectral   spectral_engine: sliding Welch band power
+     record     recording_writer, when a path is given
+
+   Each stage is timed on its own, so the same run is a throughput
+   benchmark of the pipeline on real data. */
+
+// Where replayed samples come from; each call fills out from the start
+class replay_source {
+public:
+    virtual ~replay_source() = default;
+
+    // Returns the number of samples written, up to out.capacity; 0 at the end
+    virtual size_t next(const sample_block &out) = 0;
+
+    // Input bytes taken so far
+    virtual uint64_t bytes() const = 0;
+};
+
+/* A raw capture of the serial stream, as telemetry_dump reads it: any mix
+   the stream_decoder understands, fed in read_bytes pieces as the port
+   would hand them over. Reads the file in those pieces, or replays bytes
+   already in memory. */
+class capture_source : public replay_source {
+public:
+    // Throws std::runtime_error if path cannot be opened
+    capture_source(const std::string &path, size_t read_bytes = 4096);
+    capture_source(std::vector<uint8_t> bytes, size_t read_bytes = 4096);
+    ~capture_source() override;
+
+    capture_source(const capture_source &) = delete;
+    capture_source &operator=(const capture_source &) = delete;
+
+    size_t next(const sample_block &out) override;
+    uint64_t bytes() const override { return taken_; }
+    const decoder_stats &stats() const { return decoder_.stats(); }
+
+private:
+    bool refill();
+
+    stream_decoder decoder_;
+    std::FILE *file_ = nullptr;
+    std::vector<uint8_t> memory_;       // Whole input when replaying from memory
+    size_t memory_pos_ = 0;
+    std::vector<uint8_t> buffer_;       // One read's worth from the file
+    const uint8_t *chunk_ = nullptr;    // Current read
+    size_t chunk_length_ = 0;
+    size_t chunk_pos_ = 0;
+    size_t read_bytes_;
+    uint64_t taken_ = 0;
+};
+
+/* The plotters' CSV, read as codec_corpus reads it: one sample per row,
+   the last eight columns the channels. Integers are raw ADS1299 codes;
+   values with a decimal point are microvolts, turned back into codes with
+   uv_per_code so they go down the pipeline like decoded samples. A first
+   column before the channels is the timestamp in milliseconds (Timestamp
+   in the plotters' header row). Samples are numbered by row; rows that do
+   not parse after the first sample are skipped and counted. */
+class csv_source : public replay_source {
+public:
+    // Throws std::runtime_error if path cannot be opened
+    csv_source(const std::string &path, double uv_per_code);
+    ~csv_source() override;
+
+    csv_source(const csv_source &) = delete;
+    csv_source &operator=(const csv_source &) = delete;
+
+    size_t next(const sample_block &out) override;
+    uint64_t bytes() const override { return bytes_; }
+    uint64_t bad_rows() const { return bad_rows_; }
+
+private:
+    std::FILE *file_ = nullptr;
+    double codes_per_uv_;
+    std::vector<char> line_;
+    uint32_t row_ = 0;
+    uint64_t bytes_ = 0;
+    uint64_t bad_rows_ = 0;
+};
+
+enum class replay_stage { input, scale, filter, spectral, record, pace };
+constexpr size_t kReplayStageCount = 6;
+extern const char *const kReplayStageNames[kReplayStageCount];
+
+struct replay_config {
+    double sample_rate_hz = 250.0;
+    double speed = 0.0;                 // Multiple of real time; 0 runs as fast as possible
+    double uv_per_code = 2.0 * 4.5 / 24.0 / 16777216.0 * 1e6;  // VREF 4.5 V at gain 24
+    size_t batch = 4096;                // Most samples taken from the source at once
+    bool filter = true;
+    double mains_hz = 60.0;
+    bool spectral = true;
+    size_t fft_size = 256;
+    size_t hop = 64;
+    std::string record_path;            // Empty to skip recording
+};
+
+struct replay_report {
+    uint64_t samples = 0;
+    uint64_t input_bytes = 0;
+    uint64_t spectral_frames = 0;
+    double stage_seconds[kReplayStageCount] = {};
+    double wall_seconds = 0.0;
+    float band_power[kChannels][kBandCount] = {};   // The last Welch estimate, uV^2
+
+    double stream_seconds(double sample_rate_hz) const { return double(samples) / sample_rate_hz; }
+};
+
+// A batch as it leaves the pipeline; arrays are [count][kChannels] and valid during the callback only
+struct replay_batch {
+    size_t count;
+    const int32_t *codes;
+    const uint32_t *sample_number;
+    const uint64_t *timestamp_ns;
+    const float *uv;
+    const float *clean;                 // Null unless filtering
+    const float *const *bands;          // [kBandCount], null unless filtering
+};
+
+/* Drives a source through the pipeline. With speed > 0 the samples are
+   released no faster than speed times sample_rate_hz, by sleeping between
+   batches, so a capture can stand in for the board at real time or any
+   multiple of it. */
+class replay_engine {
+public:
+    using batch_callback = std::function<void(const replay_batch &)>;
+
+    // Throws std::invalid_argument for a bad filter or spectral configuration, or a batch below kMaxPacketSamples
+    explicit replay_engine(const replay_config &config);
+
+    replay_report run(replay_source &source, const batch_callback &on_batch = nullptr);
+
+    const replay_config &config() const { return config_; }
+
+private:
+    replay_config config_;
+    std::vector<int32_t> codes_;
+    std::vector<uint32_t> sample_number_;
+    std::vector<uint64_t> timestamp_;
+    std::vector<uint32_t> status_;
+    std::vector<float> uv_;
+    std::vector<float> clean_;
+    std::vector<float> band_data_;
+    float *bands_[kBandCount];
+};
+
+} // namespace cerelog
+
+#endif // CERELOG_REPLAY_H
\ No newline at end of file
@@ -0,0 +1,148 @@
+#include "serial_port.h"
+
+#include <stdexcept>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+namespace cerelog {
+
+#if defined(_WIN32)
+
+serial_port::serial_port(const std::string &path, int baud) : path_(path) {
+    if (baud <= 0) {
+        throw std::invalid_argument("serial_port: unsupported baud rate");
+    }
+    // COM10 and up are only reachable through the device namespace
+    std::string device = path.compare(0, 4, "\\\\.\\") == 0 ? path : "\\\\.\\" + path;
+    HANDLE handle = CreateFileA(device.c_str(), GENERIC_READ, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("serial_port: cannot open " + path);
+    }
+    DCB dcb = {};
+    dcb.DCBlength = sizeof(dcb);
+    bool ok = GetCommState(handle, &dcb);
+    if (ok) {
+        dcb.BaudRate = DWORD(baud);
+        dcb.ByteSize = 8;
+        dcb.Parity = NOPARITY;
+        dcb.StopBits = ONESTOPBIT;
+        dcb.fBinary = TRUE;
+        dcb.fParity = FALSE;
+        dcb.fOutxCtsFlow = FALSE;
+        dcb.fOutxDsrFlow = FALSE;
+        dcb.fDtrControl = DTR_CONTROL_ENABLE;
+        dcb.fRtsControl = RTS_CONTROL_ENABLE;
+        dcb.fOutX = FALSE;
+        dcb.fInX = FALSE;
+        ok = SetCommState(handle, &dcb) != 0;
+    }
+    if (!ok) {
+        CloseHandle(handle);
+        throw std::runtime_error("serial_port: cannot configure " + path);
+    }
+    handle_ = handle;
+}
+
+serial_port::~serial_port() {
+    CloseHandle(static_cast<HANDLE>(handle_));
+}
+
+long serial_port::read(void *data, size_t length, int timeout_ms) {
+    HANDLE handle = static_cast<HANDLE>(handle_);
+    // Returns at once with whatever is buffered, or waits up to the constant for the first byte
+    COMMTIMEOUTS timeouts = {};
+    timeouts.ReadIntervalTimeout = MAXDWORD;
+    timeouts.ReadTotalTimeoutMultiplier = MAXDWORD;
+    timeouts.ReadTotalTimeoutConstant = DWORD(timeout_ms > 0 ? timeout_ms : 1);
+    DWORD got = 0;
+    if (!SetCommTimeouts(handle, &timeouts) || !ReadFile(handle, data, DWORD(length), &got, nullptr)) {
+        return -1;
+    }
+    return long(got);
+}
+
+#else
+
+namespace {
+
+speed_t baud_constant(int baud) {
+    switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+#if defined(B460800)
+    case 460800: return B460800;
+    case 921600: return B921600;
+    case 1000000: return B1000000;
+    case 2000000: return B2000000;
+#endif
+    default: throw std::invalid_argument("serial_port: unsupported baud rate");
+    }
+}
+
+} // namespace
+
+serial_port::serial_port(const std::string &path, int baud) : path_(path) {
+    speed_t speed = baud_constant(baud);
+    int fd = ::open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) {
+        throw std::runtime_error("serial_port: cannot open " + path);
+    }
+    struct termios tio;
+    if (tcgetattr(fd, &tio) != 0) {
+        ::close(fd);
+        throw std::runtime_error("serial_port: " + path + " is not a terminal");
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+        ::close(fd);
+        throw std::runtime_error("serial_port: cannot configure " + path);
+    }
+    fd_ = fd;
+}
+
+serial_port::~serial_port() {
+    ::close(fd_);
+}
+
+long serial_port::read(void *data, size_t length, int timeout_ms) {
+    struct pollfd p = {fd_, POLLIN, 0};
+    int ready = ::poll(&p, 1, timeout_ms);
+    if (ready < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+    if (ready == 0) {
+        return 0;
+    }
+    ssize_t got = ::read(fd_, data, length);
+    if (got > 0) {
+        return long(got);
+    }
+    // 0 is end of file; EIO is a pseudo-terminal whose master closed, or a device that went away
+    if (got < 0 && (errno == EAGAIN || errno == EINTR)) {
+        return 0;
+    }
+    return -1;
+}
+
+#endif
+
+} // namespace cerelog
\ No newline at end of file
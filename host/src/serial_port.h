@@ -0,0 +1,41 @@
+#ifndef CERELOG_SERIAL_PORT_H
+#define CERELOG_SERIAL_PORT_H
+
+#include <cstddef>
+#include <string>
+
+namespace cerelog {
+
+/* A serial port opened raw for reading the board's stream: 8N1, no flow
+   control, no line discipline, so every byte arrives as sent. path is a
+   device such as /dev/ttyUSB0 or a pseudo-terminal, or COM4 on Windows.
+   Pseudo-terminals ignore the baud rate. */
+class serial_port {
+public:
+    // Throws std::runtime_error if path cannot be opened or configured, std::invalid_argument for an unsupported baud
+    serial_port(const std::string &path, int baud);
+    ~serial_port();
+
+    serial_port(const serial_port &) = delete;
+    serial_port &operator=(const serial_port &) = delete;
+
+    /* Waits up to timeout_ms for data and reads what is there, up to
+       length bytes. Returns the bytes read, 0 on timeout, or -1 once the
+       port is gone (device unplugged, or the master side of a
+       pseudo-terminal closed and drained). */
+    long read(void *data, size_t length, int timeout_ms);
+
+    const std::string &path() const { return path_; }
+
+private:
+    std::string path_;
+#if defined(_WIN32)
+    void *handle_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+};
+
+} // namespace cerelog
+
+#endif // CERELOG_SERIAL_PORT_H
\ No newline at end of file
@@ -0,0 +1,18 @@
+#ifndef CERELOG_SIMD_TARGET_H
+#define CERELOG_SIMD_TARGET_H
+
+/* Lets a translation unit built for the baseline ISA carry AVX2 and
+   SSE4.1 kernels, picked at run time by supported_simd_level(). */
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define CERELOG_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+// MSVC allows any intrinsic in any function
+#define CERELOG_TARGET(isa)
+#else
+#define CERELOG_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+#endif // CERELOG_SIMD_TARGET_H
\ No newline at end of file
@@ -0,0 +1,230 @@
+#include "spectral.h"
+
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace cerelog {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+bool power_of_two(size_t n) {
+    return n && (n & (n - 1)) == 0;
+}
+
+} // namespace
+
+/* Takes every array from a, in a fixed order: once from a measuring arena
+   to size the real one, then from the real one */
+template <typename Arena>
+void spectral_engine::carve(Arena &a) {
+    size_t n = config_.fft_size;
+    size_t channels = config_.channels;
+    window_ = a.template take<float>(n);
+    bit_reverse_ = a.template take<uint32_t>(half_);
+    twiddle_re_ = a.template take<float>(half_ / 2);
+    twiddle_im_ = a.template take<float>(half_ / 2);
+    split_re_ = a.template take<float>(half_ + 1);
+    split_im_ = a.template take<float>(half_ + 1);
+    ring_ = a.template take<float>(channels * n);
+    history_ = a.template take<float>(config_.average * channels * bins());
+    sum_ = a.template take<double>(channels * bins());
+    segment_ = a.template take<float>(n);
+    fft_re_ = a.template take<float>(half_);
+    fft_im_ = a.template take<float>(half_);
+    column_ = a.template take<float>(channels * bins());
+    band_power_ = a.template take<float>(channels * kBandCount);
+}
+
+spectral_engine::spectral_engine(const spectral_config &config) : config_(config), half_(config.fft_size / 2) {
+    if (!power_of_two(config.fft_size) || config.fft_size < 16 || config.hop == 0 ||
+        config.hop > config.fft_size || config.channels == 0 || config.average == 0) {
+        throw std::invalid_argument("spectral_config needs a power-of-two fft_size >= 16 and 0 < hop <= fft_size");
+    }
+
+    arena measure;
+    carve(measure);
+    arena_ = arena(measure.used());
+    carve(arena_);
+
+    // Hann window; the PSD scale makes a tone of amplitude A integrate to A^2 / 2
+    size_t n = config_.fft_size;
+    double window_power = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        double w = 0.5 - 0.5 * std::cos(2.0 * kPi * double(i) / double(n));
+        window_[i] = float(w);
+        window_power += w * w;
+    }
+    psd_scale_ = 1.0 / (config_.sample_rate_hz * window_power);
+
+    size_t bits = 0;
+    while ((size_t(1) << bits) < half_) {
+        bits++;
+    }
+    for (size_t i = 0; i < half_; i++) {
+        uint32_t r = 0;
+        for (size_t b = 0; b < bits; b++) {
+            r |= uint32_t((i >> b) & 1) << (bits - 1 - b);
+        }
+        bit_reverse_[i] = r;
+    }
+    for (size_t j = 0; j < half_ / 2; j++) {
+        twiddle_re_[j] = float(std::cos(2.0 * kPi * double(j) / double(half_)));
+        twiddle_im_[j] = float(-std::sin(2.0 * kPi * double(j) / double(half_)));
+    }
+    for (size_t k = 0; k <= half_; k++) {
+        split_re_[k] = float(std::cos(2.0 * kPi * double(k) / double(n)));
+        split_im_[k] = float(-std::sin(2.0 * kPi * double(k) / double(n)));
+    }
+
+    // Bins whose centre falls in [low, high) of each band
+    for (size_t b = 0; b < kBandCount; b++) {
+        band_first_[b] = size_t(std::ceil(kBandEdges[b].low_hz / bin_hz()));
+        band_end_[b] = size_t(std::ceil(kBandEdges[b].high_hz / bin_hz()));
+        band_end_[b] = band_end_[b] < bins() ? band_end_[b] : bins();
+        band_first_[b] = band_first_[b] < band_end_[b] ? band_first_[b] : band_end_[b];
+    }
+}
+
+void spectral_engine::reset() {
+    std::memset(ring_, 0, config_.channels * config_.fft_size * sizeof(float));
+    std::memset(sum_, 0, config_.channels * bins() * sizeof(double));
+    ring_pos_ = 0;
+    pushed_ = 0;
+    since_segment_ = 0;
+    history_pos_ = 0;
+    history_filled_ = 0;
+}
+
+/* One-sided PSD of a windowed segment: a complex FFT of half the length
+   over the even and odd samples, then split into the real spectrum */
+void spectral_engine::transform(const float *segment, float *power) {
+    for (size_t i = 0; i < half_; i++) {
+        uint32_t r = bit_reverse_[i];
+        fft_re_[r] = segment[2 * i];
+        fft_im_[r] = segment[2 * i + 1];
+    }
+
+    for (size_t len = 2; len <= half_; len <<= 1) {
+        size_t span = len / 2;
+        size_t stride = half_ / len;
+        for (size_t start = 0; start < half_; start += len) {
+            for (size_t j = 0; j < span; j++) {
+                float wr = twiddle_re_[j * stride];
+                float wi = twiddle_im_[j * stride];
+                size_t a = start + j;
+                size_t b = a + span;
+                float vr = fft_re_[b] * wr - fft_im_[b] * wi;
+                float vi = fft_re_[b] * wi + fft_im_[b] * wr;
+                fft_re_[b] = fft_re_[a] - vr;
+                fft_im_[b] = fft_im_[a] - vi;
+                fft_re_[a] += vr;
+                fft_im_[a] += vi;
+            }
+        }
+    }
+
+    // X[k] = E[k] + W^k O[k], with E and O the spectra of the even and odd samples
+    for (size_t k = 0; k <= half_; k++) {
+        size_t kk = k == half_ ? 0 : k;
+        size_t mk = k == 0 ? 0 : half_ - k;
+        float zr = fft_re_[kk], zi = fft_im_[kk];
+        float cr = fft_re_[mk], ci = -fft_im_[mk];
+        float er = 0.5f * (zr + cr), ei = 0.5f * (zi + ci);
+        float or_ = 0.5f * (zi - ci), oi = -0.5f * (zr - cr);
+        float xr = er + split_re_[k] * or_ - split_im_[k] * oi;
+        float xi = ei + split_re_[k] * oi + split_im_[k] * or_;
+        double p = (double(xr) * xr + double(xi) * xi) * psd_scale_;
+        power[k] = float((k == 0 || k == half_) ? p : 2.0 * p);
+    }
+}
+
+void spectral_engine::close_segment(const frame_callback &on_frame) {
+    size_t n = config_.fft_size;
+    size_t nb = bins();
+    float *slot = history_ + history_pos_ * config_.channels * nb;
+    bool full = history_filled_ == config_.average;
+
+    for (size_t ch = 0; ch < config_.channels; ch++) {
+        // Oldest sample first: the ring position is where the next sample goes
+        const float *ring = ring_ + ch * n;
+        for (size_t i = 0; i < n; i++) {
+            size_t at = ring_pos_ + i < n ? ring_pos_ + i : ring_pos_ + i - n;
+            segment_[i] = ring[at] * window_[i];
+        }
+        float *column = column_ + ch * nb;
+        transform(segment_, column);
+
+        float *old = slot + ch * nb;
+        double *sum = sum_ + ch * nb;
+        for (size_t k = 0; k < nb; k++) {
+            sum[k] += double(column[k]) - (full ? double(old[k]) : 0.0);
+            old[k] = column[k];
+        }
+    }
+
+    history_pos_ = history_pos_ + 1 < config_.average ? history_pos_ + 1 : 0;
+    history_filled_ += full ? 0 : 1;
+    if (history_pos_ == 0) {
+        // Rebuild the sums from the history once per lap, so rounding cannot build up
+        std::memset(sum_, 0, config_.channels * nb * sizeof(double));
+        for (size_t h = 0; h < history_filled_; h++) {
+            const float *columns = history_ + h * config_.channels * nb;
+            for (size_t i = 0; i < config_.channels * nb; i++) {
+                sum_[i] += columns[i];
+            }
+        }
+    }
+
+    double scale = bin_hz() / double(history_filled_);
+    for (size_t ch = 0; ch < config_.channels; ch++) {
+        const double *sum = sum_ + ch * nb;
+        for (size_t b = 0; b < kBandCount; b++) {
+            double power = 0.0;
+            for (size_t k = band_first_[b]; k < band_end_[b]; k++) {
+                power += sum[k];
+            }
+            band_power_[ch * kBandCount + b] = float(power * scale);
+        }
+    }
+
+    if (on_frame) {
+        spectral_frame frame;
+        frame.end_sample = pushed_;
+        frame.channels = config_.channels;
+        frame.bins = nb;
+        frame.band_power = band_power_;
+        frame.column = column_;
+        on_frame(frame);
+    }
+}
+
+void spectral_engine::push(const float *samples, size_t count, const frame_callback &on_frame) {
+    size_t n = config_.fft_size;
+    size_t channels = config_.channels;
+    for (size_t i = 0; i < count; i++) {
+        const float *sample = samples + i * channels;
+        for (size_t ch = 0; ch < channels; ch++) {
+            ring_[ch * n + ring_pos_] = sample[ch];
+        }
+        ring_pos_ = ring_pos_ + 1 < n ? ring_pos_ + 1 : 0;
+        pushed_++;
+        since_segment_++;
+
+        // The first segment closes once the ring is full, then one every hop
+        if (pushed_ >= n && since_segment_ >= config_.hop) {
+            since_segment_ = 0;
+            close_segment(on_frame);
+        }
+    }
+}
+
+void spectral_engine::average_psd(size_t channel, float *psd) const {
+    for (size_t k = 0; k < bins(); k++) {
+        psd[k] = history_filled_ ? float(sum_[channel * bins() + k] / double(history_filled_)) : 0.0f;
+    }
+}
+
+} // namespace cerelog
\ No newline at end of file
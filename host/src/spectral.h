@@ -0,0 +1,101 @@
+#ifndef CERELOG_SPECTRAL_H
+#define CERELOG_SPECTRAL_H
+
+#include "arena.h"
+#include "filter_bank.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace cerelog {
+
+struct spectral_config {
+    double sample_rate_hz = 250.0;
+    size_t channels = 8;
+    size_t fft_size = 256;              // Segment length, a power of two
+    size_t hop = 64;                    // New samples between segments; fft_size / 4 overlaps them by 75%
+    size_t average = 8;                 // Segments in the Welch average
+};
+
+// What push() reports each time a segment closes
+struct spectral_frame {
+    uint64_t end_sample;                // Samples pushed up to the end of this segment
+    size_t channels;
+    size_t bins;                        // fft_size / 2 + 1, from DC to Nyquist
+    const float *band_power;            // [channels][kBandCount]: Welch average, input units squared
+    const float *column;                // [channels][bins]: this segment's PSD, input units squared per Hz
+};
+
+/* Streaming Welch spectral estimate for several channels.
+
+   Samples go into a ring per channel. Every hop samples the last fft_size
+   of them are Hann-windowed and transformed, giving one spectrogram column
+   per channel, and the column joins a sliding average of the last
+   `average` columns. The band powers for kBandEdges come from that
+   average, so each update costs one FFT per channel plus work
+   proportional to the number of bins, however long the session.
+
+   The window, bit reversal and twiddle tables, rings, column history and
+   scratch space all live in one arena sized at construction; push() does
+   not allocate. Not thread-safe. */
+class spectral_engine {
+public:
+    using frame_callback = std::function<void(const spectral_frame &)>;
+
+    // Throws std::invalid_argument unless fft_size is a power of two >= 16 and 0 < hop <= fft_size
+    explicit spectral_engine(const spectral_config &config);
+
+    // Feeds interleaved samples [count][channels]; on_frame runs for every segment that closes
+    void push(const float *samples, size_t count, const frame_callback &on_frame);
+
+    // Forgets all samples, keeping the tables and memory
+    void reset();
+
+    const spectral_config &config() const { return config_; }
+    size_t bins() const { return config_.fft_size / 2 + 1; }
+    double bin_hz() const { return config_.sample_rate_hz / double(config_.fft_size); }
+    size_t arena_bytes() const { return arena_.used(); }
+
+    // Welch-averaged PSD of one channel, [bins], as of the last frame
+    void average_psd(size_t channel, float *psd) const;
+
+private:
+    template <typename Arena>
+    void carve(Arena &a);
+    void transform(const float *segment, float *power);
+    void close_segment(const frame_callback &on_frame);
+
+    spectral_config config_;
+    arena arena_;
+    size_t half_;                       // fft_size / 2, the complex FFT length
+
+    // Tables
+    float *window_;
+    uint32_t *bit_reverse_;
+    float *twiddle_re_, *twiddle_im_;   // e^-2pi i j / half, for the complex FFT
+    float *split_re_, *split_im_;       // e^-2pi i k / fft_size, for splitting the real spectrum
+    double psd_scale_;
+    size_t band_first_[kBandCount];
+    size_t band_end_[kBandCount];
+
+    // Streaming state
+    float *ring_;                       // [channels][fft_size]
+    size_t ring_pos_ = 0;
+    uint64_t pushed_ = 0;
+    size_t since_segment_ = 0;
+    float *history_;                    // [average][channels][bins]
+    double *sum_;                       // [channels][bins], of the filled history
+    size_t history_pos_ = 0;
+    size_t history_filled_ = 0;
+
+    // Scratch
+    float *segment_;
+    float *fft_re_, *fft_im_;
+    float *column_;
+    float *band_power_;
+};
+
+} // namespace cerelog
+
+#endif // CERELOG_SPECTRAL_H
\ No newline at end of file
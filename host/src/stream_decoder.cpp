@@ -0,0 +1,447 @@
+#include "stream_decoder.h"
+#include "packet_crc.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace cerelog {
+
+namespace {
+
+constexpr size_t kNeedMore = SIZE_MAX;
+
+constexpr uint8_t kArduinoStart1 = 0xAB;
+constexpr uint8_t kArduinoStart2 = 0xCD;
+constexpr uint8_t kArduinoEnd1 = 0xDC;
+constexpr uint8_t kArduinoEnd2 = 0xBA;
+constexpr size_t kArduinoCounterOffset = 3;
+constexpr size_t kArduinoDataOffset = 7;
+constexpr size_t kArduinoChecksumOffset = kArduinoDataOffset + ADS1299_TOTAL_DATA_BYTES;
+
+inline int32_t be24(const uint8_t *p) {
+    return int32_t(uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8) >> 8;
+}
+
+inline uint32_t status24(const uint8_t *p) {
+    return uint32_t(p[0]) << 16 | uint32_t(p[1]) << 8 | p[2];
+}
+
+void unpack_channels(const uint8_t *data, size_t samples, int32_t *out) {
+    for (size_t i = 0; i < samples * kChannels; i++) {
+        out[i] = be24(data + i * ADS1299_BYTES_PER_CHANNEL);
+    }
+}
+
+bool has_firmware_trailer(const uint8_t *p, size_t length) {
+    return p[length - 2] == PACKET_END_BYTE1 && p[length - 1] == PACKET_END_BYTE2;
+}
+
+bool firmware_crc_ok(const uint8_t *p, size_t length) {
+    size_t crc_size = length - PACKET_CRC_SIZE - PACKET_TRAILER_SIZE;
+    uint16_t crc;
+    std::memcpy(&crc, p + crc_size, sizeof(crc));
+    return packet_crc_compute(p, crc_size) == crc;
+}
+
+// Batches from a daisy chain differ only in the chain bits of the type
+inline bool is_batch_type(uint8_t type) {
+    return (type & ~(PACKET_FLAG_COMPRESSED | PACKET_CHAIN_MASK)) == PACKET_TYPE_ADS1299_BATCH;
+}
+
+inline bool is_capture_type(uint8_t type) {
+    return (type & ~PACKET_CHAIN_MASK) == PACKET_TYPE_CAPTURE;
+}
+
+// Samples a packet of known length will add to the output
+size_t packet_samples(const uint8_t *p) {
+    if (p[0] == kArduinoStart1) {
+        return 1;
+    }
+    if (is_batch_type(p[2])) {
+        return p[3];
+    }
+    return p[2] == PACKET_TYPE_ADS1299 ? 1 : 0;
+}
+
+} // namespace
+
+stream_decoder::stream_decoder() {
+    carry_.reserve(2 * kMaxPacketBytes);
+    chain_.reserve(kMaxPacketSamples * kMaxChainChannels);
+}
+
+void stream_decoder::select_chip(size_t chip) {
+    if (chip >= ADS1299_MAX_CHAIN) {
+        throw std::invalid_argument("stream_decoder: chip beyond the longest daisy chain");
+    }
+    chip_ = chip;
+}
+
+void stream_decoder::reset() {
+    carry_.clear();
+    markers_.clear();
+    telemetry_.clear();
+    captures_.clear();
+    stats_ = decoder_stats();
+    have_next_number_ = false;
+    trailer_at_end_ = false;
+}
+
+std::vector<ads1299_marker_packet_t> stream_decoder::take_markers() {
+    std::vector<ads1299_marker_packet_t> markers;
+    markers.swap(markers_);
+    return markers;
+}
+
+std::vector<telemetry_packet_t> stream_decoder::take_telemetry() {
+    std::vector<telemetry_packet_t> telemetry;
+    telemetry.swap(telemetry_);
+    return telemetry;
+}
+
+std::vector<capture_chunk> stream_decoder::take_captures() {
+    std::vector<capture_chunk> captures;
+    captures.swap(captures_);
+    return captures;
+}
+
+size_t stream_decoder::packet_length(const uint8_t *p, size_t available) const {
+    if (available < 2) {
+        return kNeedMore;
+    }
+
+    if (p[0] == kArduinoStart1) {
+        if (p[1] != kArduinoStart2) {
+            return 0;
+        }
+        if (available < 3) {
+            return kNeedMore;
+        }
+        return p[2] == kArduinoPayloadLength ? kArduinoFrameBytes : 0;
+    }
+
+    if (p[1] != PACKET_START_BYTE2) {
+        return 0;
+    }
+    if (available < PACKET_HEADER_SIZE) {
+        return kNeedMore;
+    }
+
+    if (is_batch_type(p[2])) {
+        size_t chips = PACKET_CHAIN_CHIPS(p[2]);
+        if (p[3] == 0) {
+            return 0;
+        }
+        if (!(p[2] & PACKET_FLAG_COMPRESSED)) {
+            return BATCH_CHAIN_PACKET_SIZE(p[3], chips);
+        }
+        size_t length_offset = sizeof(ads1299_batch_header_t) + BATCH_CHAIN_STATUS_BYTES(chips);
+        if (available < length_offset + BATCH_LENGTH_SIZE) {
+            return kNeedMore;
+        }
+        uint16_t data_length;
+        std::memcpy(&data_length, p + length_offset, sizeof(data_length));
+        if (data_length > EEG_CODEC_MAX_BYTES(p[3], chips * ADS1299_CHIP_CHANNELS)) {
+            return 0;
+        }
+        return BATCH_CHAIN_COMPRESSED_PACKET_SIZE(data_length, chips);
+    }
+
+    if (is_capture_type(p[2])) {
+        size_t chips = PACKET_CHAIN_CHIPS(p[2]);
+        if (p[3] == 0 || p[3] * chips > kMaxCaptureChipFrames) {
+            return 0;
+        }
+        return CAPTURE_CHAIN_PACKET_SIZE(p[3], chips);
+    }
+
+    switch (p[2]) {
+    case PACKET_TYPE_ADS1299:
+        return p[3] == sizeof(ads1299_sample_t) + PACKET_TIMESTAMP_SIZE ? sizeof(ads1299_packet_t) : 0;
+    case PACKET_TYPE_MARKER:
+        return sizeof(ads1299_marker_packet_t);
+    case PACKET_TYPE_TELEMETRY:
+        return p[3] == TELEMETRY_STAGE_COUNT ? sizeof(telemetry_packet_t) : 0;
+    default:
+        return 0;
+    }
+}
+
+void stream_decoder::count_sample_number(uint32_t first, size_t count) {
+    if (have_next_number_ && first != next_number_) {
+        // Only count forward jumps; a restarted device or counter starts over
+        int32_t jump = int32_t(first - next_number_);
+        if (jump > 0) {
+            stats_.missing_samples += uint32_t(jump);
+        } else if (first > 1 && int32_t(first + uint32_t(count) - next_number_) <= 0) {
+            // A resent packet fills an earlier gap; the stream carries on where it was
+            stats_.resent_samples += count;
+            return;
+        }
+    }
+    next_number_ = first + uint32_t(count);
+    have_next_number_ = true;
+}
+
+bool stream_decoder::decode_packet(const uint8_t *p, size_t length, const sample_block &out, size_t &written) {
+    int32_t *channels = out.channels + written * kChannels;
+
+    if (p[0] == kArduinoStart1) {
+        if (p[length - 2] != kArduinoEnd1 || p[length - 1] != kArduinoEnd2) {
+            return false;
+        }
+        uint8_t sum = 0;
+        for (size_t i = 2; i < kArduinoChecksumOffset; i++) {
+            sum = uint8_t(sum + p[i]);
+        }
+        if (sum != p[kArduinoChecksumOffset]) {
+            stats_.bad_packets++;
+            return false;
+        }
+
+        const uint8_t *c = p + kArduinoCounterOffset;
+        uint32_t counter = uint32_t(c[0]) << 24 | uint32_t(c[1]) << 16 | uint32_t(c[2]) << 8 | c[3];
+        const uint8_t *data = p + kArduinoDataOffset;
+        unpack_channels(data + ADS1299_STATUS_BYTES, 1, channels);
+        if (out.sample_number) {
+            out.sample_number[written] = counter;
+        }
+        if (out.timestamp_ns) {
+            out.timestamp_ns[written] = 0;
+        }
+        if (out.status) {
+            out.status[written] = status24(data);
+        }
+        count_sample_number(counter, 1);
+        written++;
+        stats_.arduino_frames++;
+        stats_.samples++;
+        return true;
+    }
+
+    if (!has_firmware_trailer(p, length)) {
+        return false;
+    }
+    if (!firmware_crc_ok(p, length)) {
+        stats_.bad_packets++;
+        return false;
+    }
+
+    if (is_batch_type(p[2])) {
+        return decode_batch(p, length, out, written);
+    }
+
+    if (is_capture_type(p[2])) {
+        capture_chunk chunk;
+        std::memcpy(&chunk.header, p, sizeof(chunk.header));
+        chunk.frames.assign(p + sizeof(chunk.header), p + length - PACKET_CRC_SIZE - PACKET_TRAILER_SIZE);
+        captures_.push_back(std::move(chunk));
+        stats_.capture_packets++;
+        return true;
+    }
+
+    switch (p[2]) {
+    case PACKET_TYPE_ADS1299: {
+        ads1299_packet_t packet;
+        std::memcpy(&packet, p, sizeof(packet));
+        std::memcpy(channels, packet.sample.channels, sizeof(packet.sample.channels));
+        if (out.sample_number) {
+            out.sample_number[written] = packet.sample.sample_number;
+        }
+        if (out.timestamp_ns) {
+            out.timestamp_ns[written] = packet.timestamp_us * 1000;
+        }
+        if (out.status) {
+            out.status[written] = packet.sample.status;
+        }
+        count_sample_number(packet.sample.sample_number, 1);
+        written++;
+        stats_.single_packets++;
+        stats_.samples++;
+        return true;
+    }
+
+    case PACKET_TYPE_MARKER: {
+        ads1299_marker_packet_t marker;
+        std::memcpy(&marker, p, sizeof(marker));
+        markers_.push_back(marker);
+        stats_.marker_packets++;
+        return true;
+    }
+
+    case PACKET_TYPE_TELEMETRY: {
+        telemetry_packet_t telemetry;
+        std::memcpy(&telemetry, p, sizeof(telemetry));
+        telemetry_.push_back(telemetry);
+        stats_.telemetry_packets++;
+        return true;
+    }
+
+    default:
+        return false;
+    }
+}
+
+/* A batch from one chip decodes straight into the output; a chained one
+   is decoded whole into chain_ and the selected chip's channels copied out */
+bool stream_decoder::decode_batch(const uint8_t *p, size_t length, const sample_block &out, size_t &written) {
+    ads1299_batch_header_t header;
+    std::memcpy(&header, p, sizeof(header));
+    size_t chips = PACKET_CHAIN_CHIPS(header.packet_type);
+    size_t chain_channels = chips * ADS1299_CHIP_CHANNELS;
+    const uint8_t *data = p + sizeof(header) + BATCH_CHAIN_STATUS_BYTES(chips);
+    size_t count = header.sample_count;
+    int32_t *channels = out.channels + written * kChannels;
+    int32_t *decoded = chips == 1 ? channels : nullptr;
+
+    if (chips > 1) {
+        chain_.resize(count * chain_channels);
+        decoded = chain_.data();
+    }
+
+    if (header.packet_type & PACKET_FLAG_COMPRESSED) {
+        size_t data_length = length - BATCH_CHAIN_COMPRESSED_PACKET_SIZE(0, chips);
+        if (eeg_codec_decode(data + BATCH_LENGTH_SIZE, data_length, count, chain_channels, decoded) != 0) {
+            stats_.bad_packets++;
+            return false;
+        }
+    } else {
+        // Each chip's eight channels unpack like one single-chip sample
+        unpack_channels(data, count * chips, decoded);
+    }
+
+    uint32_t status = 0;
+    if (chip_ < chips) {
+        status = chip_ == 0 ? status24(header.status)
+                            : status24(p + sizeof(header) + (chip_ - 1) * ADS1299_STATUS_BYTES);
+        if (chips > 1) {
+            for (size_t i = 0; i < count; i++) {
+                std::memcpy(channels + i * kChannels, decoded + i * chain_channels + chip_ * ADS1299_CHIP_CHANNELS,
+                            kChannels * sizeof(int32_t));
+            }
+        }
+    } else {
+        std::fill(channels, channels + count * kChannels, 0);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (out.sample_number) {
+            out.sample_number[written + i] = header.sample_number + uint32_t(i);
+        }
+        if (out.timestamp_ns) {
+            out.timestamp_ns[written + i] = header.timestamp_ns;
+        }
+        if (out.status) {
+            out.status[written + i] = status;
+        }
+    }
+    count_sample_number(header.sample_number, count);
+    written += count;
+    stats_.batch_packets++;
+    if (chips > 1) {
+        stats_.chained_packets++;
+    }
+    stats_.samples += count;
+    return true;
+}
+
+/* Decodes packets starting before limit. A packet may run past limit up to
+   length, which is how the joined carry buffer hands over to the chunk. */
+stream_decoder::scan_result stream_decoder::scan(const uint8_t *data, size_t length, size_t limit,
+                                                 const sample_block &out, size_t &written, size_t &pos) {
+    while (pos < limit) {
+        const uint8_t *p = data + pos;
+        if (*p != PACKET_START_BYTE1 && *p != kArduinoStart1) {
+            trailer_at_end_ = false;
+            pos++;
+            stats_.skipped_bytes++;
+            continue;
+        }
+
+        size_t packet = packet_length(p, length - pos);
+        if (packet == kNeedMore || (packet != 0 && packet > length - pos)) {
+            return scan_result::need_more;
+        }
+        if (packet != 0) {
+            if (written + packet_samples(p) > out.capacity) {
+                return scan_result::full;
+            }
+            if (decode_packet(p, packet, out, written)) {
+                pos += packet;
+                if (p[0] == PACKET_START_BYTE1) {
+                    /* A packet that lost a byte still ends in 0x55 0xAA when the
+                       next packet's start byte stands in for its own; 0x55 after
+                       the trailer means the 0xAA was shared, so hand it back */
+                    if (pos == length) {
+                        trailer_at_end_ = true;
+                    } else if (data[pos] == PACKET_START_BYTE2) {
+                        pos--;
+                    }
+                }
+                continue;
+            }
+        }
+
+        // Not a packet after all: resync from the next byte
+        trailer_at_end_ = false;
+        pos++;
+        stats_.skipped_bytes++;
+    }
+    return scan_result::done;
+}
+
+size_t stream_decoder::decode(const uint8_t *data, size_t length, const sample_block &out, size_t *consumed) {
+    if (!out.channels || out.capacity < kMaxPacketSamples) {
+        throw std::invalid_argument("sample_block needs channels and room for kMaxPacketSamples");
+    }
+
+    size_t written = 0;
+    size_t used = 0;
+
+    // The last call ended on a packet trailer that may also start this chunk's packet
+    if (trailer_at_end_ && carry_.empty() && length && data[0] == PACKET_START_BYTE2) {
+        carry_.push_back(PACKET_START_BYTE1);
+    }
+    trailer_at_end_ = false;
+
+    if (!carry_.empty()) {
+        /* Join the held bytes with enough of the chunk to finish any packet
+           they start, plus one byte to see past its trailer */
+        size_t held = carry_.size();
+        size_t take = std::min(length, kMaxPacketBytes + 1);
+        carry_.insert(carry_.end(), data, data + take);
+
+        size_t pos = 0;
+        scan_result result = scan(carry_.data(), carry_.size(), held, out, written, pos);
+        if (result == scan_result::full) {
+            carry_.erase(carry_.begin(), carry_.begin() + pos);
+            carry_.resize(held - pos);
+            *consumed = 0;
+            return written;
+        }
+        if (result == scan_result::need_more) {
+            // Still short: the chunk was smaller than the packet, so it is all held now
+            carry_.erase(carry_.begin(), carry_.begin() + pos);
+            stats_.bytes += length;
+            *consumed = length;
+            return written;
+        }
+        used = pos - held;
+        carry_.clear();
+    }
+
+    size_t pos = used;
+    scan_result result = scan(data, length, length, out, written, pos);
+    if (result == scan_result::need_more) {
+        carry_.assign(data + pos, data + length);
+        pos = length;
+    }
+
+    stats_.bytes += pos;
+    *consumed = pos;
+    return written;
+}
+
+} // namespace cerelog
\ No newline at end of file
@@ -0,0 +1,128 @@
+#ifndef CERELOG_STREAM_DECODER_H
+#define CERELOG_STREAM_DECODER_H
+
+#include "packet_format.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cerelog {
+
+constexpr size_t kChannels = ADS1299_NUM_CHANNELS;
+// Most samples one packet can carry; sample_block capacity must be at least this
+constexpr size_t kMaxPacketSamples = 255;
+// Channels of the longest daisy chain of ADS1299s the firmware supports
+constexpr size_t kMaxChainChannels = ADS1299_MAX_CHAIN * ADS1299_CHIP_CHANNELS;
+// Largest packet on either wire format, a compressed batch of 255 samples from the longest chain
+constexpr size_t kMaxPacketBytes = BATCH_CHAIN_COMPRESSED_PACKET_SIZE(
+    EEG_CODEC_MAX_BYTES(kMaxPacketSamples, kMaxChainChannels), ADS1299_MAX_CHAIN);
+// Most raw frames, counting each chip's, one capture packet can carry
+constexpr size_t kMaxCaptureChipFrames = 255;
+static_assert(CAPTURE_CHAIN_PACKET_SIZE(kMaxCaptureChipFrames, 1) <= kMaxPacketBytes,
+              "capture packets must fit the join buffer");
+
+/* Arduino sketch frame (src/test_ads1299_drdy): 0xAB 0xCD | length 31 |
+   counter u32 BE | 27 bytes ADS1299 status and channels | sum of length
+   through data, mod 256 | 0xDC 0xBA */
+constexpr size_t kArduinoFrameBytes = 37;
+constexpr uint8_t kArduinoPayloadLength = 31;
+
+/* Caller-owned output arrays, each with room for capacity samples. Only
+   channels is required; the other arrays may be null. */
+struct sample_block {
+    int32_t *channels = nullptr;        // [capacity][kChannels] raw sign-extended codes
+    uint32_t *sample_number = nullptr;  // Firmware sample number, or the Arduino frame counter
+    uint64_t *timestamp_ns = nullptr;   // DRDY time of the first sample of the packet; 0 for Arduino frames
+    uint32_t *status = nullptr;         // 24-bit ADS1299 status word
+    size_t capacity = 0;
+};
+
+struct decoder_stats {
+    uint64_t bytes = 0;
+    uint64_t samples = 0;
+    uint64_t single_packets = 0;        // PACKET_TYPE_ADS1299
+    uint64_t batch_packets = 0;         // PACKET_TYPE_ADS1299_BATCH, packed or compressed
+    uint64_t chained_packets = 0;       // Batches from a daisy chain of ADS1299s, also in batch_packets
+    uint64_t marker_packets = 0;
+    uint64_t telemetry_packets = 0;
+    uint64_t arduino_frames = 0;
+    uint64_t bad_packets = 0;           // Framing was right but the CRC, checksum or contents were not
+    uint64_t skipped_bytes = 0;         // Bytes dropped while looking for the next packet
+    uint64_t missing_samples = 0;       // Jumps in the sample number
+    uint64_t resent_samples = 0;        // Behind the stream, from packets sent again on request (CMD_RESEND)
+    uint64_t capture_packets = 0;       // PACKET_TYPE_CAPTURE, burst capture frames
+};
+
+// One capture packet: its header and raw frames, ADS1299_CHIP_DATA_BYTES per chip each
+struct capture_chunk {
+    capture_header_t header;
+    std::vector<uint8_t> frames;
+};
+
+/* Finds packets in a serial byte stream and decodes their samples.
+
+   The stream may mix the firmware's 0xAA 0x55 packets (single samples,
+   packed or compressed batches, markers, telemetry and burst capture
+   frames, all CRC-16 checked) with the Arduino sketch's 0xAB 0xCD frames. Chunks can be split
+   anywhere. Packets are decoded in place from the caller's chunk; only a
+   packet split across two chunks is copied, once, to join it. After
+   corruption the decoder moves on one byte and looks for the next start
+   marker, so a bad packet costs only itself.
+
+   A board with daisy-chained ADS1299s sends 8 channels per chip; the
+   decoder hands over one chip's eight, chosen with select_chip(), and
+   that chip's status word. Samples from a chain without that chip come
+   out as zero codes with status 0, which lacks the 1100 sync bits.
+
+   Not thread-safe; use one decoder per stream. */
+class stream_decoder {
+public:
+    stream_decoder();
+
+    /* Decodes samples from data into out, starting at out[0]. Stops early
+       when out cannot hold the next packet. Returns the number of samples
+       written; *consumed is set to the input bytes used, and the caller
+       passes the rest in again. A trailing partial packet is always
+       consumed and completed by the next call. Throws
+       std::invalid_argument if out.capacity is below kMaxPacketSamples. */
+    size_t decode(const uint8_t *data, size_t length, const sample_block &out, size_t *consumed);
+
+    // Markers, telemetry and capture packets seen since the last call, in stream order
+    std::vector<ads1299_marker_packet_t> take_markers();
+    std::vector<telemetry_packet_t> take_telemetry();
+    std::vector<capture_chunk> take_captures();
+
+    // Throws std::invalid_argument past ADS1299_MAX_CHAIN; takes effect from the next packet
+    void select_chip(size_t chip);
+    size_t chip() const { return chip_; }
+
+    const decoder_stats &stats() const { return stats_; }
+    void reset();
+
+private:
+    enum class scan_result { done, need_more, full };
+
+    scan_result scan(const uint8_t *data, size_t length, size_t limit, const sample_block &out,
+                     size_t &written, size_t &pos);
+    // Length of the packet starting at p, 0 if it is not one, or SIZE_MAX if more bytes are needed
+    size_t packet_length(const uint8_t *p, size_t available) const;
+    bool decode_packet(const uint8_t *p, size_t length, const sample_block &out, size_t &written);
+    bool decode_batch(const uint8_t *p, size_t length, const sample_block &out, size_t &written);
+    void count_sample_number(uint32_t first, size_t count);
+
+    std::vector<uint8_t> carry_;        // Start of a packet split across chunks
+    std::vector<int32_t> chain_;        // Every chip's channels of a chained packet, before selection
+    size_t chip_ = 0;
+    std::vector<ads1299_marker_packet_t> markers_;
+    std::vector<telemetry_packet_t> telemetry_;
+    std::vector<capture_chunk> captures_;
+    decoder_stats stats_;
+    bool have_next_number_ = false;
+    uint32_t next_number_ = 0;
+    bool trailer_at_end_ = false;       // The last byte seen closed a firmware packet
+};
+
+} // namespace cerelog
+
+#endif // CERELOG_STREAM_DECODER_H
\ No newline at end of file
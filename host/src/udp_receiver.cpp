@@ -0,0 +1,243 @@
+#include "udp_receiver.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <cerrno>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace cerelog {
+
+namespace {
+
+// Largest UDP payload; the device's datagrams are far smaller
+constexpr size_t kMaxDatagram = 65507;
+// Room for a burst while the reader is busy decoding
+constexpr int kReceiveBuffer = 4 << 20;
+// Recent losses remembered per datagram of window
+constexpr size_t kGivenUpPerWindow = 4;
+
+} // namespace
+
+datagram_reorder::datagram_reorder(size_t window, std::chrono::milliseconds timeout)
+    : window_(window), timeout_(timeout) {
+    if (window == 0) {
+        throw std::invalid_argument("datagram_reorder: window must be at least 1");
+    }
+}
+
+size_t datagram_reorder::push(const uint8_t *data, size_t length, std::vector<uint8_t> &out) {
+    datagram_header_t header;
+    if (length < sizeof(header)) {
+        stats_.bad++;
+        return 0;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic[0] != DATAGRAM_MAGIC1 || header.magic[1] != DATAGRAM_MAGIC2 ||
+        header.version != DATAGRAM_VERSION) {
+        stats_.bad++;
+        return 0;
+    }
+    stats_.datagrams++;
+    const uint8_t *payload = data + sizeof(header);
+    const size_t payload_length = length - sizeof(header);
+    const uint32_t sequence = header.sequence;
+    size_t appended = 0;
+
+    if (!started_) {
+        started_ = true;
+        next_ = sequence;
+    } else if (sequence == 0 && next_ > window_ && !held_.count(0)) {
+        // Whatever the old run still owed is not coming
+        appended += flush(out);
+        given_up_.clear();
+        next_ = 0;
+        stats_.restarts++;
+    }
+
+    int32_t ahead = int32_t(sequence - next_);
+    if (ahead < 0) {
+        if (given_up_.erase(sequence)) {
+            stats_.late++;
+        } else {
+            stats_.duplicates++;
+        }
+        return appended;
+    }
+    if (ahead > 0) {
+        if (held_.count(sequence)) {
+            stats_.duplicates++;
+            return appended;
+        }
+        held_[sequence] = held_datagram{std::vector<uint8_t>(payload, payload + payload_length), clock::now()};
+        if (held_.size() > window_) {
+            appended += skip_to_first_held(out);
+        }
+        return appended;
+    }
+
+    // The one awaited; anything held means it came after a later one
+    if (!held_.empty()) {
+        stats_.reordered++;
+    }
+    out.insert(out.end(), payload, payload + payload_length);
+    stats_.payload_bytes += payload_length;
+    next_++;
+    return appended + payload_length + release(out);
+}
+
+// Passes on held datagrams while they continue the sequence
+size_t datagram_reorder::release(std::vector<uint8_t> &out) {
+    size_t appended = 0;
+    auto it = held_.begin();
+    while (it != held_.end() && it->first == next_) {
+        out.insert(out.end(), it->second.payload.begin(), it->second.payload.end());
+        appended += it->second.payload.size();
+        next_++;
+        it = held_.erase(it);
+    }
+    stats_.payload_bytes += appended;
+    return appended;
+}
+
+size_t datagram_reorder::skip_to_first_held(std::vector<uint8_t> &out) {
+    uint32_t first = held_.begin()->first;
+    for (uint32_t s = next_; s != first; s++) {
+        stats_.lost++;
+        given_up_.insert(s);
+    }
+    while (given_up_.size() > window_ * kGivenUpPerWindow) {
+        given_up_.erase(given_up_.begin());
+    }
+    next_ = first;
+    return release(out);
+}
+
+size_t datagram_reorder::expire(std::vector<uint8_t> &out) {
+    size_t appended = 0;
+    clock::time_point now = clock::now();
+    while (!held_.empty() && now - held_.begin()->second.arrived > timeout_) {
+        appended += skip_to_first_held(out);
+    }
+    return appended;
+}
+
+size_t datagram_reorder::flush(std::vector<uint8_t> &out) {
+    size_t appended = 0;
+    while (!held_.empty()) {
+        appended += skip_to_first_held(out);
+    }
+    return appended;
+}
+
+#if defined(_WIN32)
+
+namespace {
+
+struct winsock {
+    winsock() {
+        WSADATA data;
+        WSAStartup(MAKEWORD(2, 2), &data);
+    }
+    ~winsock() { WSACleanup(); }
+};
+
+} // namespace
+
+udp_receiver::udp_receiver(uint16_t port, size_t window, std::chrono::milliseconds timeout)
+    : datagram_(kMaxDatagram), reorder_(window, timeout) {
+    static winsock startup;
+    SOCKET s = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s == INVALID_SOCKET) {
+        throw std::runtime_error("udp_receiver: cannot create a socket");
+    }
+    setsockopt(s, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char *>(&kReceiveBuffer), sizeof(kReceiveBuffer));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    int addr_length = sizeof(addr);
+    u_long nonblocking = 1;
+    if (::bind(s, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+        getsockname(s, reinterpret_cast<sockaddr *>(&addr), &addr_length) != 0 ||
+        ioctlsocket(s, FIONBIO, &nonblocking) != 0) {
+        closesocket(s);
+        throw std::runtime_error("udp_receiver: cannot bind port " + std::to_string(port));
+    }
+    socket_ = uintptr_t(s);
+    port_ = ntohs(addr.sin_port);
+}
+
+udp_receiver::~udp_receiver() {
+    closesocket(SOCKET(socket_));
+}
+
+size_t udp_receiver::receive(std::vector<uint8_t> &out, int timeout_ms) {
+    SOCKET s = SOCKET(socket_);
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(s, &readable);
+    timeval tv = {timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+    size_t appended = 0;
+    if (select(0, &readable, nullptr, nullptr, &tv) > 0) {
+        int got;
+        while ((got = recv(s, reinterpret_cast<char *>(datagram_.data()), int(datagram_.size()), 0)) >= 0) {
+            appended += reorder_.push(datagram_.data(), size_t(got), out);
+        }
+    }
+    return appended + reorder_.expire(out);
+}
+
+#else
+
+udp_receiver::udp_receiver(uint16_t port, size_t window, std::chrono::milliseconds timeout)
+    : datagram_(kMaxDatagram), reorder_(window, timeout) {
+    int s = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s < 0) {
+        throw std::runtime_error("udp_receiver: cannot create a socket");
+    }
+    // A smaller buffer than asked for is still usable
+    setsockopt(s, SOL_SOCKET, SO_RCVBUF, &kReceiveBuffer, sizeof(kReceiveBuffer));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    socklen_t addr_length = sizeof(addr);
+    if (::bind(s, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+        getsockname(s, reinterpret_cast<sockaddr *>(&addr), &addr_length) != 0) {
+        ::close(s);
+        throw std::runtime_error("udp_receiver: cannot bind port " + std::to_string(port));
+    }
+    socket_ = s;
+    port_ = ntohs(addr.sin_port);
+}
+
+udp_receiver::~udp_receiver() {
+    ::close(socket_);
+}
+
+size_t udp_receiver::receive(std::vector<uint8_t> &out, int timeout_ms) {
+    struct pollfd p = {socket_, POLLIN, 0};
+    size_t appended = 0;
+    if (::poll(&p, 1, timeout_ms) > 0) {
+        ssize_t got;
+        while ((got = ::recv(socket_, datagram_.data(), datagram_.size(), MSG_DONTWAIT)) >= 0) {
+            appended += reorder_.push(datagram_.data(), size_t(got), out);
+        }
+    }
+    return appended + reorder_.expire(out);
+}
+
+#endif
+
+} // namespace cerelog
\ No newline at end of file
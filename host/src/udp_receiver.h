@@ -0,0 +1,108 @@
+#ifndef CERELOG_UDP_RECEIVER_H
+#define CERELOG_UDP_RECEIVER_H
+
+#include "packet_format.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <vector>
+
+namespace cerelog {
+
+/* Receiving end of the firmware's UDP transport (udp_tx.c).
+
+   Every datagram is a datagram_header_t and whole packets. The sequence
+   numbers put the datagrams back in order before their packets reach the
+   stream decoder: a datagram that arrives early is held until the ones
+   before it come in, for up to reorder_window datagrams or
+   reorder_timeout, after which the missing ones are given up on as lost.
+   One that turns up after that is late and dropped, since its samples
+   were already passed over. A sequence number back at 0 is a device that
+   restarted. */
+
+struct datagram_stats {
+    uint64_t datagrams = 0;         // Taken in, early ones included
+    uint64_t payload_bytes = 0;     // Packet bytes passed on
+    uint64_t lost = 0;              // Sequence numbers given up on
+    uint64_t reordered = 0;         // Arrived after a later one, still in time
+    uint64_t late = 0;              // Arrived after being given up on
+    uint64_t duplicates = 0;
+    uint64_t bad = 0;               // Too short, or not this stream's header
+    uint64_t restarts = 0;
+};
+
+// The ordering on its own, fed with datagrams however they arrive
+class datagram_reorder {
+public:
+    explicit datagram_reorder(size_t window = 64,
+                              std::chrono::milliseconds timeout = std::chrono::milliseconds(50));
+
+    /* Takes one datagram and appends to out the payloads of every datagram
+       now in sequence. Returns the bytes appended. */
+    size_t push(const uint8_t *data, size_t length, std::vector<uint8_t> &out);
+
+    // Gives up on gaps whose held datagrams have waited longer than the timeout
+    size_t expire(std::vector<uint8_t> &out);
+
+    // Gives up on every gap and passes on all that is held, at the end of a stream
+    size_t flush(std::vector<uint8_t> &out);
+
+    const datagram_stats &stats() const { return stats_; }
+
+private:
+    using clock = std::chrono::steady_clock;
+    struct held_datagram {
+        std::vector<uint8_t> payload;
+        clock::time_point arrived;
+    };
+
+    size_t release(std::vector<uint8_t> &out);
+    size_t skip_to_first_held(std::vector<uint8_t> &out);
+
+    size_t window_;
+    std::chrono::milliseconds timeout_;
+    bool started_ = false;
+    uint32_t next_ = 0;             // Next sequence number to pass on
+    std::map<uint32_t, held_datagram> held_;
+    std::set<uint32_t> given_up_;   // Recent losses, to tell late datagrams from duplicates
+    datagram_stats stats_;
+};
+
+/* A UDP socket bound to port on every local address, feeding a
+   datagram_reorder. Port 0 picks a free one; port() tells which. */
+class udp_receiver {
+public:
+    // Throws std::runtime_error if the socket cannot be bound
+    explicit udp_receiver(uint16_t port, size_t window = 64,
+                          std::chrono::milliseconds timeout = std::chrono::milliseconds(50));
+    ~udp_receiver();
+
+    udp_receiver(const udp_receiver &) = delete;
+    udp_receiver &operator=(const udp_receiver &) = delete;
+
+    /* Waits up to timeout_ms for a datagram, then takes every one already
+       queued, and appends the payloads now in order to out. Returns the
+       bytes appended; 0 on timeout. */
+    size_t receive(std::vector<uint8_t> &out, int timeout_ms);
+
+    size_t flush(std::vector<uint8_t> &out) { return reorder_.flush(out); }
+    const datagram_stats &stats() const { return reorder_.stats(); }
+    uint16_t port() const { return port_; }
+
+private:
+#if defined(_WIN32)
+    uintptr_t socket_;
+#else
+    int socket_ = -1;
+#endif
+    uint16_t port_ = 0;
+    std::vector<uint8_t> datagram_;
+    datagram_reorder reorder_;
+};
+
+} // namespace cerelog
+
+#endif // CERELOG_UDP_RECEIVER_H
\ No newline at end of file
@@ -0,0 +1,481 @@
+// Merges several boards into one time-aligned stream.
+//
+//   aggregate [options] PORT...        live: merge the ports, print each board once a second
+//   aggregate [--seconds S]            self-check and scaling benchmark over pseudo-terminals
+//
+//   --rate HZ        sample rate of every board (250)
+//   --baud N         serial baud rate (921600)
+//   --device-clocks  the boards' MCU clocks share an epoch; otherwise offsets come from arrival times
+//   --csv PATH       live: also write the merged rows, board 0's sample number and time first
+//
+// Without ports, each simulated board is a pseudo-terminal fed by a
+// generator thread that writes batched packets as the firmware does: its
+// ADS1299 off by a known number of ppm, its MCU clock at its own offset,
+// DRDY timestamps with interrupt jitter and, on one board, batches lost in
+// transport. Channel 0 of every board carries the true sample time, so
+// each merged row shows how far apart its boards' samples really were. The
+// check paces the generators in real time and expects every row aligned
+// to within a period, the lost samples held, and drift and offsets as set.
+// The benchmark then writes S seconds at 16 kSPS per board (60 s, at most
+// 2^20 samples) as fast as the pseudo-terminals take it, for 1, 2, 4 and 8
+// boards, and reports decoded samples per second against one board. The
+// exit status is non-zero if any check fails.
+
+#include "aggregator.h"
+#include "packet_crc.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+using cerelog::aggregator;
+using cerelog::aggregator_config;
+using cerelog::board_stats;
+using cerelog::kChannels;
+using cerelog::merged_block;
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kTimeUnitNs = 10000.0;     // Channel 0 counts true time in 10 us steps
+
+void print_stats(const std::vector<board_stats> &stats) {
+    std::printf("%-5s %-14s %10s %9s %8s %8s %8s %8s %10s %9s %12s\n", "board", "port", "decoded", "missing",
+                "drops", "skipped", "held", "bad", "drift ppm", "jitter", "offset ms");
+    for (size_t k = 0; k < stats.size(); k++) {
+        const board_stats &s = stats[k];
+        std::printf("%-5zu %-14s %10llu %9llu %8llu %8llu %8llu %8llu %10.1f %7.1fus %12.3f%s\n", k, s.port.c_str(),
+                    (unsigned long long)s.samples, (unsigned long long)s.missing_samples,
+                    (unsigned long long)s.queue_drops, (unsigned long long)s.skipped, (unsigned long long)s.held,
+                    (unsigned long long)s.bad_packets, s.drift_ppm, s.jitter_ns / 1e3, s.offset_ns / 1e6,
+                    s.closed ? "  closed" : s.stalled ? "  stalled" : "");
+    }
+}
+
+struct merged_rows {
+    std::vector<int32_t> channels;
+    std::vector<uint32_t> sample_number;
+    std::vector<double> time_ns;
+    std::vector<uint32_t> held;
+    merged_block block;
+
+    merged_rows(size_t width, size_t capacity)
+        : channels(width * capacity), sample_number(capacity), time_ns(capacity), held(capacity) {
+        block.channels = channels.data();
+        block.sample_number = sample_number.data();
+        block.time_ns = time_ns.data();
+        block.held = held.data();
+        block.capacity = capacity;
+    }
+};
+
+int live(const std::vector<std::string> &ports, const aggregator_config &config, const std::string &csv_path) {
+    aggregator agg(ports, config);
+    merged_rows rows(agg.channels(), 4096);
+    std::FILE *csv = nullptr;
+    if (!csv_path.empty()) {
+        csv = std::fopen(csv_path.c_str(), "w");
+        if (!csv) {
+            throw std::runtime_error("cannot create " + csv_path);
+        }
+    }
+
+    auto next_report = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    uint64_t total = 0;
+    while (!agg.finished()) {
+        size_t n = agg.merge(rows.block);
+        total += n;
+        for (size_t i = 0; csv && i < n; i++) {
+            std::fprintf(csv, "%u,%.0f", rows.sample_number[i], rows.time_ns[i]);
+            for (size_t c = 0; c < agg.channels(); c++) {
+                std::fprintf(csv, ",%d", rows.channels[i * agg.channels() + c]);
+            }
+            std::fprintf(csv, "\n");
+        }
+        if (std::chrono::steady_clock::now() >= next_report) {
+            next_report += std::chrono::seconds(1);
+            std::printf("\n%llu rows of %zu channels\n", (unsigned long long)total, agg.channels());
+            print_stats(agg.stats());
+        }
+        if (!n) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    }
+    std::printf("\nAll ports closed after %llu rows\n", (unsigned long long)total);
+    print_stats(agg.stats());
+    if (csv) {
+        std::fclose(csv);
+    }
+    return 0;
+}
+
+#if !defined(_WIN32)
+
+struct board_sim {
+    double drift_ppm;               // ADS1299 oscillator error
+    double start_ns;                // True time of the first conversion
+    double mcu_offset_ns;           // MCU clock minus true time
+    std::vector<size_t> lost_batches;
+};
+
+struct sim_batch {
+    double send_ns;                 // True time the batch leaves the board, after its last sample
+    std::vector<uint8_t> bytes;
+};
+
+void put_be24(std::vector<uint8_t> &out, int32_t value) {
+    out.push_back(uint8_t(uint32_t(value) >> 16));
+    out.push_back(uint8_t(uint32_t(value) >> 8));
+    out.push_back(uint8_t(value));
+}
+
+/* Batches of 16 as the firmware sends them. Channel 0 is the true time of
+   the sample, channel 1 the board, channel 2 the sample index; the rest a
+   sine so the packets look like data. */
+std::vector<sim_batch> simulate(const board_sim &sim, size_t board, double rate, size_t count, unsigned seed) {
+    const size_t batch = 16;
+    const double period = 1e9 / rate * (1.0 - sim.drift_ppm * 1e-6);
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> jitter(0.0, 2000.0);
+    std::vector<sim_batch> out;
+    size_t lost = 0;
+
+    for (size_t first = 0, b = 0; first < count; first += batch, b++) {
+        size_t n = std::min(batch, count - first);
+        double true_first = sim.start_ns + double(first) * period;
+        if (lost < sim.lost_batches.size() && sim.lost_batches[lost] == b) {
+            lost++;
+            continue;
+        }
+        sim_batch sb;
+        sb.send_ns = true_first + double(n) * period;
+        std::vector<uint8_t> &bytes = sb.bytes;
+        ads1299_batch_header_t header = {};
+        header.start_bytes[0] = PACKET_START_BYTE1;
+        header.start_bytes[1] = PACKET_START_BYTE2;
+        header.packet_type = PACKET_TYPE_ADS1299_BATCH;
+        header.sample_count = uint8_t(n);
+        // DRDY latched on the MCU clock a few microseconds late
+        header.timestamp_ns = uint64_t(true_first + sim.mcu_offset_ns + 5000.0 + std::abs(jitter(rng)));
+        header.sample_number = uint32_t(first + 1);
+        header.status[0] = 0xC0;
+        const uint8_t *h = reinterpret_cast<const uint8_t *>(&header);
+        bytes.insert(bytes.end(), h, h + sizeof(header));
+        for (size_t i = first; i < first + n; i++) {
+            double t = sim.start_ns + double(i) * period;
+            put_be24(bytes, int32_t(std::llround(t / kTimeUnitNs)));
+            put_be24(bytes, int32_t(board));
+            put_be24(bytes, int32_t(i & 0x7FFFFF));
+            for (size_t ch = 3; ch < kChannels; ch++) {
+                put_be24(bytes, int32_t(100000.0 * std::sin(2.0 * kPi * 10.0 * t / 1e9 + double(ch))));
+            }
+        }
+        uint16_t crc = packet_crc_compute(bytes.data(), bytes.size());
+        bytes.push_back(uint8_t(crc));
+        bytes.push_back(uint8_t(crc >> 8));
+        bytes.push_back(PACKET_END_BYTE1);
+        bytes.push_back(PACKET_END_BYTE2);
+        out.push_back(std::move(sb));
+    }
+    return out;
+}
+
+// The master side of a pseudo-terminal; the aggregator opens the slave by name
+struct pty {
+    int master = -1;
+    std::string slave;
+
+    pty() {
+        master = posix_openpt(O_RDWR | O_NOCTTY);
+        if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0 || !ptsname(master)) {
+            throw std::runtime_error("cannot create a pseudo-terminal");
+        }
+        slave = ptsname(master);
+    }
+    ~pty() { close(); }
+    pty(const pty &) = delete;
+    pty &operator=(const pty &) = delete;
+
+    void close() {
+        if (master >= 0) {
+            ::close(master);
+            master = -1;
+        }
+    }
+
+    void write_all(const uint8_t *p, size_t n) {
+        while (n) {
+            ssize_t w = ::write(master, p, n);
+            if (w <= 0) {
+                throw std::runtime_error("pseudo-terminal write failed");
+            }
+            p += w;
+            n -= size_t(w);
+        }
+    }
+};
+
+/* Feeds each board's batches to its pseudo-terminal, at their send times
+   when paced, and closes it at the end so the reader sees the port go. The
+   clock starts once every generator runs, so a slow thread start does not
+   arrive as a backlog. */
+std::vector<std::thread> start_generators(std::vector<pty> &ptys, const std::vector<std::vector<sim_batch>> &batches,
+                                          bool paced) {
+    struct gate {
+        std::atomic<size_t> ready{0};
+        std::atomic<bool> go{false};
+        std::chrono::steady_clock::time_point start;
+    };
+    auto g = std::make_shared<gate>();
+    std::vector<std::thread> threads;
+    for (size_t k = 0; k < ptys.size(); k++) {
+        threads.emplace_back([&ptys, &batches, k, g, paced] {
+            g->ready++;
+            while (!g->go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            for (const sim_batch &b : batches[k]) {
+                if (paced) {
+                    std::this_thread::sleep_until(g->start + std::chrono::nanoseconds(int64_t(b.send_ns)));
+                }
+                ptys[k].write_all(b.bytes.data(), b.bytes.size());
+            }
+            // Let the reader drain the slave before the close turns into end of file
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            ptys[k].close();
+        });
+    }
+    while (g->ready.load() < ptys.size()) {
+        std::this_thread::yield();
+    }
+    g->start = std::chrono::steady_clock::now();
+    g->go.store(true, std::memory_order_release);
+    return threads;
+}
+
+// Real-time run of four boards with different oscillators, clocks and losses
+bool check_alignment(double seconds) {
+    const double rate = 2000.0;
+    const double period = 1e9 / rate;
+    const size_t count = size_t(rate * seconds);
+    const std::vector<board_sim> sims = {
+        {0.0, 10e6, 0.0, {}},
+        {400.0, 10.17e6, 3.2e9, {}},
+        {-400.0, 10.31e6, 17e9, {100, 101, 200}},
+        {150.0, 10.42e6, 0.8e9, {}},
+    };
+    const uint64_t lost = 3 * 16;
+
+    std::vector<pty> ptys(sims.size());
+    std::vector<std::string> ports;
+    std::vector<std::vector<sim_batch>> batches;
+    for (size_t k = 0; k < sims.size(); k++) {
+        ports.push_back(ptys[k].slave);
+        batches.push_back(simulate(sims[k], k, rate, count, unsigned(k + 1)));
+    }
+
+    aggregator_config config;
+    config.sample_rate_hz = rate;
+    aggregator agg(ports, config);
+    std::vector<std::thread> generators = start_generators(ptys, batches, true);
+
+    merged_rows rows(agg.channels(), 4096);
+    const size_t width = agg.channels();
+    uint64_t total = 0, compared = 0;
+    double max_error = 0.0, sum_error = 0.0;
+    bool boards_ok = true;
+    while (!agg.finished()) {
+        size_t n = agg.merge(rows.block);
+        for (size_t i = 0; i < n; i++, total++) {
+            const int32_t *row = rows.channels.data() + i * width;
+            // The first second settles the clock models and arrival offsets
+            if (total < size_t(rate)) {
+                continue;
+            }
+            for (size_t k = 1; k < sims.size(); k++) {
+                boards_ok &= row[k * kChannels + 1] == int32_t(k);
+                if (rows.held[i] & (1u << k)) {
+                    continue;
+                }
+                double error = std::abs(double(row[k * kChannels] - row[0])) * kTimeUnitNs;
+                max_error = std::max(max_error, error);
+                sum_error += error;
+                compared++;
+            }
+        }
+        if (!n) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    }
+    for (std::thread &t : generators) {
+        t.join();
+    }
+
+    std::vector<board_stats> stats = agg.stats();
+    std::printf("Four boards at %.0f SPS for %.0f s, paced in real time:\n", rate, seconds);
+    print_stats(stats);
+    std::printf("%llu rows; samples compared after the first second: %llu, off by %.1f us mean, %.1f us most "
+                "(period %.0f us)\n",
+                (unsigned long long)total, (unsigned long long)compared, compared ? sum_error / compared / 1e3 : 0.0,
+                max_error / 1e3, period / 1e3);
+
+    bool ok = boards_ok && compared > 0 && max_error < period && total == stats[0].samples;
+    for (size_t k = 0; k < sims.size(); k++) {
+        const board_stats &s = stats[k];
+        uint64_t expect_missing = sims[k].lost_batches.size() * 16;
+        /* Samples one board gains on another over the run, from the oscillators
+           alone, and a few skip and hold pairs where arrival jitter moves a
+           sample back and forth across the half-period boundary */
+        double slips = std::abs(sims[k].drift_ppm) * 1e-6 * double(count) + 4.0;
+        ok &= s.bad_packets == 0 && s.queue_drops == 0 && s.missing_samples == expect_missing;
+        ok &= std::abs(s.drift_ppm + sims[k].drift_ppm) < 50.0 + std::abs(sims[k].drift_ppm) * 0.05;
+        ok &= std::abs(s.offset_ns - (sims[k].mcu_offset_ns - sims[0].mcu_offset_ns) * -1.0) < period;
+        if (k > 0) {
+            ok &= double(s.skipped) < slips && double(s.held) < slips + double(expect_missing) &&
+                  s.held >= expect_missing;
+        }
+    }
+    if (!ok || stats[2].missing_samples != lost) {
+        std::printf("Alignment FAILED\n");
+        return false;
+    }
+    return true;
+}
+
+// Decoded samples per second with n boards writing as fast as the pseudo-terminals go
+bool benchmark(double seconds) {
+    const double rate = 16000.0;
+    const size_t count = std::min<size_t>(size_t(rate * seconds), size_t(1) << 20);
+    std::printf("\n%zu samples per board at %.0f SPS, as fast as possible, %u hardware threads:\n", count, rate,
+                std::thread::hardware_concurrency());
+    std::printf("%6s %10s %14s %14s %10s %12s\n", "boards", "wall s", "decoded/s", "per board/s", "scaling",
+                "x realtime");
+
+    std::vector<sim_batch> one = simulate({0.0, 0.0, 0.0, {}}, 0, rate, count, 1);
+    double single = 0.0;
+    bool ok = true;
+    for (size_t boards : {1, 2, 4, 8}) {
+        std::vector<pty> ptys(boards);
+        std::vector<std::string> ports;
+        std::vector<std::vector<sim_batch>> batches(boards, one);
+        for (size_t k = 0; k < boards; k++) {
+            ports.push_back(ptys[k].slave);
+        }
+        aggregator_config config;
+        config.sample_rate_hz = rate;
+        config.clocks = cerelog::time_base::device;
+        // The generators can wait; a board would not run this far ahead of the others
+        config.wait_when_full = true;
+        aggregator agg(ports, config);
+        merged_rows rows(agg.channels(), 4096);
+        const size_t width = agg.channels();
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> generators = start_generators(ptys, batches, false);
+        uint64_t total = 0;
+        bool aligned = true;
+        while (!agg.finished()) {
+            size_t n = agg.merge(rows.block);
+            for (size_t i = 0; i < n; i++) {
+                const int32_t *row = rows.channels.data() + i * width;
+                for (size_t k = 1; k < boards; k++) {
+                    aligned &= row[k * kChannels + 2] == row[2];
+                }
+            }
+            total += n;
+            if (!n) {
+                std::this_thread::sleep_for(std::chrono::microseconds(500));
+            }
+        }
+        for (std::thread &t : generators) {
+            t.join();
+        }
+        // The generators' closing pause is not decoding time
+        double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() - 0.1;
+
+        uint64_t decoded = 0;
+        bool run_ok = aligned && total == count;
+        std::vector<board_stats> stats = agg.stats();
+        for (const board_stats &s : stats) {
+            decoded += s.samples;
+            run_ok &= s.samples == count && s.queue_drops == 0 && s.bad_packets == 0 && s.held == 0;
+        }
+        if (!run_ok) {
+            print_stats(stats);
+            ok = false;
+        }
+        double per_s = double(decoded) / wall;
+        if (boards == 1) {
+            single = per_s;
+        }
+        std::printf("%6zu %10.3f %14.4g %14.4g %9.2fx %12.0f\n", boards, wall, per_s, per_s / double(boards),
+                    per_s / single, double(count) / rate / wall);
+    }
+    if (!ok) {
+        std::printf("Benchmark merge FAILED\n");
+    }
+    return ok;
+}
+
+#endif
+
+} // namespace
+
+int main(int argc, char **argv) {
+    aggregator_config config;
+    std::vector<std::string> ports;
+    std::string csv_path;
+    double seconds = 60.0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--rate" && has_value) {
+            config.sample_rate_hz = std::atof(argv[++i]);
+        } else if (arg == "--baud" && has_value) {
+            config.baud = std::atoi(argv[++i]);
+        } else if (arg == "--csv" && has_value) {
+            csv_path = argv[++i];
+        } else if (arg == "--seconds" && has_value) {
+            seconds = std::atof(argv[++i]);
+        } else if (arg == "--device-clocks") {
+            config.clocks = cerelog::time_base::device;
+        } else if (arg[0] != '-') {
+            ports.push_back(arg);
+        } else {
+            std::fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return 2;
+        }
+    }
+
+    try {
+        if (!ports.empty()) {
+            return live(ports, config, csv_path);
+        }
+#if defined(_WIN32)
+        std::fprintf(stderr, "The self-check needs pseudo-terminals; give ports to merge\n");
+        return 2;
+#else
+        bool ok = check_alignment(4.0);
+        ok &= benchmark(seconds);
+        return ok ? 0 : 1;
+#endif
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
\ No newline at end of file
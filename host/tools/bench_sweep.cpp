@@ -0,0 +1,410 @@
+// Sweeps the firmware's native_sim pipeline benchmark over its settings.
+//
+//   bench_sweep [options] ZEPHYR_EXE...     run every combination on each benchmark build
+//   bench_sweep --compare OLD NEW           list what got worse between two sweeps
+//
+//   --rates LIST     CONFIG1 data rate bits, 0 (16 kSPS) to 6 (250 SPS) (0-6)
+//   --batches LIST   samples per batch packet (1,4,16,64)
+//   --bauds LIST     modelled link baud rates (921600)
+//   --seconds S      simulated seconds measured per run (5)
+//   --out PATH       append the results to PATH as JSON lines, as well as printing them
+//   --label TEXT     recorded with every result, e.g. `git describe --dirty`
+//   --tolerance PCT  compare: change allowed before a figure counts as worse (10)
+//
+// Lists are comma separated, with a-b for a range. The channel count is
+// fixed when the firmware is built, so give one zephyr.exe per count, each
+// built with bench.conf:
+//
+//   west build -b native_sim -d build/bench8 applications/cerelog -- -DEXTRA_CONF_FILE=bench.conf
+//   west build -b native_sim -d build/bench32 applications/cerelog -- -DEXTRA_CONF_FILE=bench.conf -DCONFIG_CERELOG_ADS1299_CHAIN=4
+//
+// Each run passes the combination on the simulator's command line, takes
+// its BENCH_JSON line (throughput, dropped samples, DRDY-to-host latency
+// percentiles, CPU per stage) and decodes the bytes that left the
+// modelled link with the host stream decoder, adding the samples it got,
+// the gaps it saw and its decode time. One JSON object per run goes to
+// stdout and to --out; a run that fails is recorded with its error.
+//
+// --compare matches runs by channels, data rate, batch and baud, and
+// lists those that sent fewer samples, dropped more, took longer at the
+// 99th latency percentile or more CPU per sample. The exit status is
+// non-zero if any run failed or, when comparing, anything got worse.
+
+#include "stream_decoder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#define popen _popen
+#define pclose _pclose
+#endif
+
+namespace {
+
+using cerelog::kChannels;
+using cerelog::kMaxPacketSamples;
+
+using clock_type = std::chrono::steady_clock;
+
+// Flat JSON object: key to the value's text, quotes stripped from strings
+using result = std::map<std::string, std::string>;
+
+std::vector<unsigned> parse_list(const std::string &text) {
+    std::vector<unsigned> out;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        size_t dash = item.find('-');
+        unsigned first = unsigned(std::stoul(item.substr(0, dash)));
+        unsigned last = dash == std::string::npos ? first : unsigned(std::stoul(item.substr(dash + 1)));
+        for (unsigned v = first; v <= last; v++) {
+            out.push_back(v);
+        }
+    }
+    if (out.empty()) {
+        throw std::invalid_argument("empty list '" + text + "'");
+    }
+    return out;
+}
+
+// Enough JSON for BENCH_JSON lines and this tool's own output: one flat object
+result parse_object(const std::string &text) {
+    result out;
+    size_t pos = text.find('{');
+    if (pos == std::string::npos) {
+        throw std::runtime_error("not a JSON object: " + text);
+    }
+    pos++;
+    while (pos < text.size()) {
+        size_t key_start = text.find('"', pos);
+        if (key_start == std::string::npos) {
+            break;
+        }
+        size_t key_end = text.find('"', key_start + 1);
+        size_t colon = text.find(':', key_end);
+        if (key_end == std::string::npos || colon == std::string::npos) {
+            throw std::runtime_error("bad JSON object: " + text);
+        }
+        std::string key = text.substr(key_start + 1, key_end - key_start - 1);
+        size_t value_start = colon + 1;
+        std::string value;
+        if (value_start < text.size() && text[value_start] == '"') {
+            size_t value_end = value_start + 1;
+            while (value_end < text.size() && text[value_end] != '"') {
+                if (text[value_end] == '\\') {
+                    value_end++;
+                }
+                value += text[value_end++];
+            }
+            pos = value_end + 1;
+        } else {
+            size_t value_end = text.find_first_of(",}", value_start);
+            value = text.substr(value_start, value_end - value_start);
+            pos = value_end;
+        }
+        out[key] = value;
+        pos = text.find_first_of(",}", pos);
+        if (pos == std::string::npos || text[pos] == '}') {
+            break;
+        }
+        pos++;
+    }
+    return out;
+}
+
+std::string quote(const std::string &text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c == '\n' ? ' ' : c;
+    }
+    return out + "\"";
+}
+
+double number(const result &r, const std::string &key) {
+    auto it = r.find(key);
+    return it == r.end() ? 0.0 : std::atof(it->second.c_str());
+}
+
+struct host_decode {
+    uint64_t samples = 0;
+    uint64_t missing = 0;
+    uint64_t bad_packets = 0;
+    uint64_t skipped_bytes = 0;
+    double ns_per_sample = 0.0;
+};
+
+// The capture as the host reads it from the port, in serial-sized chunks
+host_decode decode_capture(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("no capture written at " + path);
+    }
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    cerelog::stream_decoder decoder;
+    std::vector<int32_t> channels(kMaxPacketSamples * kChannels);
+    cerelog::sample_block out;
+    out.channels = channels.data();
+    out.capacity = kMaxPacketSamples;
+    const size_t chunk = 4096;
+
+    clock_type::time_point start = clock_type::now();
+    for (size_t pos = 0; pos < bytes.size();) {
+        size_t length = std::min(chunk, bytes.size() - pos);
+        size_t consumed = 0;
+        decoder.decode(bytes.data() + pos, length, out, &consumed);
+        pos += consumed;
+    }
+    double ns = std::chrono::duration<double, std::nano>(clock_type::now() - start).count();
+
+    const cerelog::decoder_stats &s = decoder.stats();
+    host_decode d;
+    d.samples = s.samples;
+    d.missing = s.missing_samples;
+    d.bad_packets = s.bad_packets;
+    d.skipped_bytes = s.skipped_bytes;
+    d.ns_per_sample = s.samples ? ns / double(s.samples) : 0.0;
+    return d;
+}
+
+struct run_settings {
+    std::string exe;
+    unsigned rate_bits;
+    unsigned batch;
+    unsigned baud;
+    unsigned seconds;
+};
+
+/* Runs one combination and returns its JSON line. The simulator is told
+   to stop well past the benchmark's own end, in case it never gets there. */
+std::string run_one(const run_settings &s, const std::string &label, bool &ok) {
+    const std::string capture = "bench_sweep_capture.bin";
+    std::remove(capture.c_str());
+    std::string command = quote(s.exe) + " --bench-dr=" + std::to_string(s.rate_bits) +
+                          " --bench-batch=" + std::to_string(s.batch) + " --bench-baud=" + std::to_string(s.baud) +
+                          " --bench-seconds=" + std::to_string(s.seconds) + " --bench-capture=" + capture +
+                          " --stop_at=" + std::to_string(s.seconds + 30) + " 2>&1";
+
+    std::string output, line, json;
+    FILE *pipe = popen(command.c_str(), "r");
+    if (!pipe) {
+        throw std::runtime_error("cannot run " + s.exe);
+    }
+    char buffer[4096];
+    while (std::fgets(buffer, sizeof(buffer), pipe)) {
+        line = buffer;
+        if (line.compare(0, 11, "BENCH_JSON ") == 0) {
+            json = line.substr(11);
+        }
+        output += line;
+    }
+    int status = pclose(pipe);
+
+    std::string extra = ",\"exe\":" + quote(s.exe) + ",\"label\":" + quote(label);
+    if (json.empty() || status != 0) {
+        ok = false;
+        std::string tail = output.size() > 400 ? output.substr(output.size() - 400) : output;
+        return "{\"config1_dr\":" + std::to_string(s.rate_bits) + ",\"batch\":" + std::to_string(s.batch) +
+               ",\"baud\":" + std::to_string(s.baud) + extra + ",\"error\":" +
+               quote("exit status " + std::to_string(status) + ": " + tail) + "}";
+    }
+
+    host_decode d = decode_capture(capture);
+    std::remove(capture.c_str());
+    char host[256];
+    std::snprintf(host, sizeof(host),
+                  ",\"host_samples\":%llu,\"host_missing\":%llu,\"host_bad_packets\":%llu,"
+                  "\"host_skipped_bytes\":%llu,\"host_decode_ns_per_sample\":%.1f",
+                  (unsigned long long)d.samples, (unsigned long long)d.missing,
+                  (unsigned long long)d.bad_packets, (unsigned long long)d.skipped_bytes, d.ns_per_sample);
+    // The capture covers the warm-up as well, so only the host's own errors are judged
+    if (d.bad_packets != 0 || d.skipped_bytes != 0) {
+        ok = false;
+        std::fprintf(stderr, "%s: host decode found %llu bad packets, %llu skipped bytes\n", s.exe.c_str(),
+                     (unsigned long long)d.bad_packets, (unsigned long long)d.skipped_bytes);
+    }
+    json = json.substr(0, json.find_last_of('}'));
+    return json + extra + host + "}";
+}
+
+int sweep(const std::vector<std::string> &exes, const std::vector<unsigned> &rates,
+          const std::vector<unsigned> &batches, const std::vector<unsigned> &bauds, unsigned seconds,
+          const std::string &out_path, const std::string &label) {
+    std::ofstream out;
+    if (!out_path.empty()) {
+        out.open(out_path, std::ios::app);
+        if (!out) {
+            throw std::runtime_error("cannot write " + out_path);
+        }
+    }
+    for (unsigned r : rates) {
+        if (r > 6) {
+            throw std::invalid_argument("data rate bits run from 0 to 6");
+        }
+    }
+
+    bool ok = true;
+    size_t total = exes.size() * rates.size() * batches.size() * bauds.size(), done = 0;
+    for (const std::string &exe : exes) {
+        for (unsigned baud : bauds) {
+            for (unsigned rate : rates) {
+                for (unsigned batch : batches) {
+                    std::fprintf(stderr, "[%zu/%zu] %s: %u SPS, batch %u, %u baud\n", ++done, total, exe.c_str(),
+                                 16000u >> rate, batch, baud);
+                    std::string line = run_one({exe, rate, batch, baud, seconds}, label, ok);
+                    std::printf("%s\n", line.c_str());
+                    std::fflush(stdout);
+                    if (out) {
+                        out << line << "\n";
+                        out.flush();
+                    }
+                }
+            }
+        }
+    }
+    return ok ? 0 : 1;
+}
+
+std::vector<result> read_results(const std::string &path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error("cannot read " + path);
+    }
+    std::vector<result> out;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.find('{') != std::string::npos) {
+            out.push_back(parse_object(line));
+        }
+    }
+    return out;
+}
+
+std::string run_key(const result &r) {
+    return std::to_string(long(number(r, "channels"))) + " ch, " + std::to_string(long(number(r, "rate_sps"))) +
+           " SPS, batch " + std::to_string(long(number(r, "batch"))) + ", " +
+           std::to_string(long(number(r, "baud"))) + " baud";
+}
+
+/* A later run of the same settings is worse if it sent fewer samples per
+   second, dropped samples it did not drop before, or its p99 latency or
+   CPU per sample grew, each by more than tolerance percent. */
+int compare(const std::string &old_path, const std::string &new_path, double tolerance) {
+    std::map<std::string, result> before;
+    for (const result &r : read_results(old_path)) {
+        if (!r.count("error")) {
+            before[run_key(r)] = r;
+        }
+    }
+
+    size_t compared = 0, worse = 0, failed = 0;
+    const double slack = 1.0 + tolerance / 100.0;
+    for (const result &r : read_results(new_path)) {
+        if (r.count("error")) {
+            std::printf("%s: run failed\n", r.count("channels") ? run_key(r).c_str() : r.at("exe").c_str());
+            failed++;
+            continue;
+        }
+        auto it = before.find(run_key(r));
+        if (it == before.end()) {
+            continue;
+        }
+        const result &b = it->second;
+        compared++;
+        std::string why;
+        char text[160];
+        if (number(r, "sent_sps") * slack < number(b, "sent_sps")) {
+            std::snprintf(text, sizeof(text), " sent %.0f SPS, was %.0f;", number(r, "sent_sps"),
+                          number(b, "sent_sps"));
+            why += text;
+        }
+        if (number(r, "dropped") > number(b, "dropped") * slack) {
+            std::snprintf(text, sizeof(text), " dropped %.0f, was %.0f;", number(r, "dropped"), number(b, "dropped"));
+            why += text;
+        }
+        // Latencies under a millisecond move by whole histogram steps; leave them some room
+        if (number(r, "latency_p99_us") > number(b, "latency_p99_us") * slack + 100.0) {
+            std::snprintf(text, sizeof(text), " p99 latency %.0f us, was %.0f;", number(r, "latency_p99_us"),
+                          number(b, "latency_p99_us"));
+            why += text;
+        }
+        if (number(r, "cpu_ns_per_sample") > number(b, "cpu_ns_per_sample") * slack) {
+            std::snprintf(text, sizeof(text), " CPU %.0f ns/sample, was %.0f;", number(r, "cpu_ns_per_sample"),
+                          number(b, "cpu_ns_per_sample"));
+            why += text;
+        }
+        if (!why.empty()) {
+            why.pop_back();
+            std::printf("%s:%s\n", run_key(r).c_str(), why.c_str());
+            worse++;
+        }
+    }
+    std::printf("%zu runs compared, %zu worse by more than %.0f%%, %zu failed\n", compared, worse, tolerance,
+                failed);
+    return worse == 0 && failed == 0 ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::vector<std::string> exes, compare_paths;
+    std::string rates = "0-6", batches = "1,4,16,64", bauds = "921600";
+    std::string out_path, label;
+    unsigned seconds = 5;
+    double tolerance = 10.0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--rates" && has_value) {
+            rates = argv[++i];
+        } else if (arg == "--batches" && has_value) {
+            batches = argv[++i];
+        } else if (arg == "--bauds" && has_value) {
+            bauds = argv[++i];
+        } else if (arg == "--seconds" && has_value) {
+            seconds = unsigned(std::atoi(argv[++i]));
+        } else if (arg == "--out" && has_value) {
+            out_path = argv[++i];
+        } else if (arg == "--label" && has_value) {
+            label = argv[++i];
+        } else if (arg == "--tolerance" && has_value) {
+            tolerance = std::atof(argv[++i]);
+        } else if (arg == "--compare" && i + 2 < argc) {
+            compare_paths = {argv[i + 1], argv[i + 2]};
+            i += 2;
+        } else if (arg[0] != '-') {
+            exes.push_back(arg);
+        } else {
+            std::fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return 2;
+        }
+    }
+
+    try {
+        if (!compare_paths.empty()) {
+            return compare(compare_paths[0], compare_paths[1], tolerance);
+        }
+        if (exes.empty()) {
+            std::fprintf(stderr, "Give the zephyr.exe of one or more bench.conf builds, or --compare OLD NEW\n");
+            return 2;
+        }
+        return sweep(exes, parse_list(rates), parse_list(batches), parse_list(bauds), seconds, out_path, label);
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
\ No newline at end of file
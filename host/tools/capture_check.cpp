@@ -0,0 +1,536 @@
+// Burst capture check for stream_decoder and capture_assembler against a
+// model of the firmware's capture drain (capture.c), and the capture
+// durations the firmware's ring gives.
+//
+//   capture_check
+//
+// A simulated board freezes a capture of raw frames and drains it as
+// PACKET_TYPE_CAPTURE packets between live batches, for a chain of 1 to 4
+// ADS1299s; the stream reaches the decoder in chunks of random size.
+// Every frame must come out of the assembler in place and unchanged, with
+// the live samples still decoding without a gap. With packets damaged on
+// the way, exactly their frames must be reported missing, and the capture
+// must still be finished when the next one starts. Repeated packets must
+// count as duplicates. With a decimating profile, whose ratio changes
+// during the capture, the numbering markers must place every frame read
+// that completed an output on that output's sample number, and the rest
+// in order between them. A model of the ring must count only the DRDY
+// edges missed within a capture, however long it sat armed before it.
+//
+// Then, for ring sizes that fit the ESP32's internal RAM and one for an
+// external PSRAM, it prints how long a capture lasts at each data rate,
+// and how long it takes to drain at 921600 baud next to a 250 SPS live
+// stream. Last, decoding and assembling a capture is timed. The exit
+// status is non-zero if any check fails.
+
+#include "capture_assembler.h"
+#include "packet_crc.h"
+#include "stream_decoder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+using cerelog::burst_capture;
+using cerelog::capture_assembler;
+using cerelog::kChannels;
+using cerelog::read_numbering;
+using cerelog::sample_block;
+using cerelog::stream_decoder;
+
+constexpr size_t kBatch = 16;
+constexpr uint32_t kLinkBytesPerS = 921600 / 10;
+constexpr uint32_t kLiveRate = 250;
+// The ring keeps each frame's DRDY edge count beside it
+constexpr size_t kSlotEdgeBytes = sizeof(uint32_t);
+
+// Channel codes are a function of the frame and channel, so any frame can be checked on its own
+int32_t channel_value(uint32_t frame, size_t ch) {
+    return int32_t((frame * 2654435761u + uint32_t(ch) * 40503u) & 0xFFFFFF) - 0x800000;
+}
+
+void put_be24(std::vector<uint8_t> &out, uint32_t value) {
+    out.push_back(uint8_t(value >> 16));
+    out.push_back(uint8_t(value >> 8));
+    out.push_back(uint8_t(value));
+}
+
+void put_trailer(std::vector<uint8_t> &out, size_t start) {
+    uint16_t crc = packet_crc_compute(out.data() + start, out.size() - start);
+    out.push_back(uint8_t(crc));
+    out.push_back(uint8_t(crc >> 8));
+    out.push_back(PACKET_END_BYTE1);
+    out.push_back(PACKET_END_BYTE2);
+}
+
+// Status words carry the chip in their low bits, to catch chips swapped along a chain
+uint32_t status_value(uint32_t frame, size_t chip) {
+    return ADS1299_STATUS_SYNC | uint32_t(chip) << 8 | (frame & 0xFF);
+}
+
+void append_batch(std::vector<uint8_t> &out, uint32_t first, size_t count = kBatch) {
+    size_t start = out.size();
+    ads1299_batch_header_t header = {};
+    header.start_bytes[0] = PACKET_START_BYTE1;
+    header.start_bytes[1] = PACKET_START_BYTE2;
+    header.packet_type = PACKET_TYPE_ADS1299_BATCH;
+    header.sample_count = uint8_t(count);
+    header.timestamp_ns = uint64_t(first) * 4000000;
+    header.sample_number = first;
+    header.status[0] = 0xC0;
+    const uint8_t *h = reinterpret_cast<const uint8_t *>(&header);
+    out.insert(out.end(), h, h + sizeof(header));
+    for (size_t i = 0; i < count; i++) {
+        for (size_t ch = 0; ch < kChannels; ch++) {
+            put_be24(out, uint32_t(channel_value(first + uint32_t(i), ch)));
+        }
+    }
+    put_trailer(out, start);
+}
+
+void append_marker(std::vector<uint8_t> &out, uint8_t type, int16_t result, uint32_t sample_number,
+                   uint32_t read_number) {
+    size_t start = out.size();
+    ads1299_marker_packet_t marker = {};
+    marker.start_bytes[0] = PACKET_START_BYTE1;
+    marker.start_bytes[1] = PACKET_START_BYTE2;
+    marker.packet_type = PACKET_TYPE_MARKER;
+    marker.marker_type = type;
+    marker.result = result;
+    marker.sample_number = sample_number;
+    marker.read_number = read_number;
+    const uint8_t *m = reinterpret_cast<const uint8_t *>(&marker);
+    out.insert(out.end(), m, m + offsetof(ads1299_marker_packet_t, crc16));
+    put_trailer(out, start);
+}
+
+// What the firmware's ring holds when a capture is frozen
+struct model_capture {
+    uint16_t id;
+    size_t chips;
+    uint32_t frames;
+    uint32_t trigger_frame;
+    uint32_t first_read;
+    uint8_t data_rate;
+    uint32_t missed_drdy = 0;
+};
+
+size_t packet_frames(size_t chips) {
+    return 32 / chips;
+}
+
+size_t ring_frames(size_t bytes, size_t chips) {
+    return bytes / (chips * ADS1299_CHIP_DATA_BYTES + kSlotEdgeBytes);
+}
+
+// Packets as capture_next() builds them, one per element
+std::vector<std::vector<uint8_t>> drain(const model_capture &c) {
+    std::vector<std::vector<uint8_t>> packets;
+    for (uint32_t index = 0; index < c.frames;) {
+        uint32_t count = uint32_t(std::min<size_t>(c.frames - index, packet_frames(c.chips)));
+        std::vector<uint8_t> p;
+        capture_header_t header = {};
+        header.start_bytes[0] = PACKET_START_BYTE1;
+        header.start_bytes[1] = PACKET_START_BYTE2;
+        header.packet_type = PACKET_TYPE_CAPTURE | PACKET_CHAIN_BITS(c.chips);
+        header.frame_count = uint8_t(count);
+        header.capture_id = c.id;
+        header.trigger_source = CAPTURE_TRIGGER_THRESHOLD;
+        header.data_rate = c.data_rate;
+        header.frame_index = index;
+        header.total_frames = c.frames;
+        header.trigger_frame = c.trigger_frame;
+        header.first_read = c.first_read;
+        header.missed_drdy = c.missed_drdy;
+        header.trigger_ns = 123456789;
+        const uint8_t *h = reinterpret_cast<const uint8_t *>(&header);
+        p.insert(p.end(), h, h + sizeof(header));
+        for (uint32_t f = index; f < index + count; f++) {
+            for (size_t chip = 0; chip < c.chips; chip++) {
+                put_be24(p, status_value(f, chip));
+                for (size_t ch = 0; ch < ADS1299_CHIP_CHANNELS; ch++) {
+                    put_be24(p, uint32_t(channel_value(f, chip * ADS1299_CHIP_CHANNELS + ch)) & 0xFFFFFF);
+                }
+            }
+        }
+        put_trailer(p, 0);
+        packets.push_back(std::move(p));
+        index += count;
+    }
+    return packets;
+}
+
+struct receiver {
+    stream_decoder decoder;
+    capture_assembler assembler;
+    read_numbering numbering;
+    std::vector<int32_t> channels = std::vector<int32_t>(8192 * kChannels);
+    std::vector<uint32_t> numbers = std::vector<uint32_t>(8192);
+    uint64_t samples = 0;
+    uint64_t bad_numbers = 0;
+    uint32_t next_number = 1;
+
+    // Feeds the stream in chunks of 1 to max_chunk bytes
+    void feed(const std::vector<uint8_t> &stream, std::mt19937 &rng, size_t max_chunk) {
+        sample_block block;
+        block.channels = channels.data();
+        block.sample_number = numbers.data();
+        block.capacity = numbers.size();
+        std::uniform_int_distribution<size_t> chunk_size(1, max_chunk);
+        size_t pos = 0;
+        while (pos < stream.size()) {
+            size_t length = std::min(chunk_size(rng), stream.size() - pos);
+            size_t used = 0;
+            while (used < length) {
+                size_t consumed = 0;
+                size_t n = decoder.decode(stream.data() + pos + used, length - used, block, &consumed);
+                for (size_t i = 0; i < n; i++) {
+                    bad_numbers += numbers[i] != next_number++;
+                    for (size_t ch = 0; ch < kChannels; ch++) {
+                        bad_numbers += channels[i * kChannels + ch] != channel_value(numbers[i], ch);
+                    }
+                }
+                samples += n;
+                used += consumed;
+            }
+            assembler.push(decoder.take_captures());
+            numbering.push(decoder.take_markers());
+            pos += length;
+        }
+    }
+};
+
+// Frames of c wrong in b; frames not received are skipped when missing_ok
+size_t wrong_frames(const burst_capture &b, const model_capture &c, bool missing_ok) {
+    size_t wrong = 0;
+    if (b.id != c.id || b.chips != c.chips || b.frames != c.frames || b.trigger_frame != c.trigger_frame ||
+        b.first_read != c.first_read || b.data_rate != c.data_rate || b.missed_drdy != c.missed_drdy) {
+        return c.frames;
+    }
+    for (uint32_t f = 0; f < c.frames; f++) {
+        if (!b.received[f]) {
+            wrong += !missing_ok;
+            continue;
+        }
+        bool ok = true;
+        for (size_t chip = 0; chip < c.chips; chip++) {
+            ok &= b.status[chip][f] == status_value(f, chip);
+        }
+        for (size_t ch = 0; ch < c.chips * ADS1299_CHIP_CHANNELS; ch++) {
+            ok &= b.channels[ch][f] == channel_value(f, ch);
+        }
+        wrong += !ok;
+    }
+    return wrong;
+}
+
+/* Drains a capture between live batches, as the firmware does at a 250 SPS
+   live rate, damaging one byte in the chosen capture packets */
+std::vector<uint8_t> mix(const std::vector<std::vector<uint8_t>> &packets, uint32_t &live_number,
+                         const std::vector<size_t> &damage, std::mt19937 &rng) {
+    std::vector<uint8_t> stream;
+    for (size_t i = 0; i < packets.size(); i++) {
+        if (i % 4 == 0) {
+            append_batch(stream, live_number);
+            live_number += kBatch;
+        }
+        size_t start = stream.size();
+        stream.insert(stream.end(), packets[i].begin(), packets[i].end());
+        if (std::find(damage.begin(), damage.end(), i) != damage.end()) {
+            std::uniform_int_distribution<size_t> at(sizeof(capture_header_t), packets[i].size() - 5);
+            stream[start + at(rng)] ^= 0x10;
+        }
+    }
+    append_batch(stream, live_number);
+    live_number += kBatch;
+    return stream;
+}
+
+constexpr uint32_t kDecimatedReads = 6000;
+constexpr uint32_t kRestartRead = 3001;
+
+uint64_t completes_count(const std::vector<uint32_t> &completes) {
+    return uint64_t(std::count_if(completes.begin(), completes.end(), [](uint32_t n) { return n != 0; }));
+}
+
+/* The live stream of a build that decimates (decimate.c, send_reconfig()):
+   by 4 from boot, then by 8 from a profile change at kRestartRead. Each
+   restart drops the outputs of the filter's warm-up, numbering carries
+   on, and a MARKER_NUMBERING goes out ahead of the first output after it.
+   Returns the output each read completed, 0 for none, by read number. */
+std::vector<uint32_t> decimated_stream(std::vector<uint8_t> &stream) {
+    constexpr uint32_t kWarmup = 3;     // FIR with 4 taps per phase
+    std::vector<uint32_t> completes(kDecimatedReads + 1, 0);
+    std::vector<uint32_t> batch;
+    uint32_t ratio = 4, phase = 0, warmup = kWarmup, next = 1;
+    bool numbering = true;
+
+    auto flush = [&]() {
+        if (!batch.empty()) {
+            append_batch(stream, batch.front(), batch.size());
+            batch.clear();
+        }
+    };
+    for (uint32_t read = 1; read <= kDecimatedReads; read++) {
+        if (read == kRestartRead) {
+            flush();
+            append_marker(stream, MARKER_RECONFIG, 5, next, read);
+            append_marker(stream, MARKER_DECIMATION, 8, next, read);
+            ratio = 8;
+            phase = 0;
+            warmup = kWarmup;
+            numbering = true;
+        }
+        if (++phase < ratio) {
+            continue;
+        }
+        phase = 0;
+        if (warmup) {
+            warmup--;
+            continue;
+        }
+        completes[read] = next;
+        if (numbering) {
+            flush();
+            append_marker(stream, MARKER_NUMBERING, int16_t(ratio), next, read);
+            numbering = false;
+        }
+        batch.push_back(next++);
+        if (batch.size() == kBatch) {
+            flush();
+        }
+    }
+    flush();
+    return completes;
+}
+
+/* The ring as capture_store() keeps it, frames reduced to their DRDY edge
+   count: armed, it records round the ring until a trigger, then post
+   more frames, and freezes. Returns the capture's missed_drdy. */
+uint32_t ring_missed_drdy(const std::vector<uint32_t> &read_edges, size_t slots, uint32_t trigger, uint32_t pre,
+                          uint32_t post) {
+    std::vector<uint32_t> edges(slots);
+    size_t head = 0;
+    uint32_t frames = 0;
+    for (uint32_t i = 0; i < read_edges.size(); i++) {
+        edges[head] = read_edges[i];
+        head = (head + 1) % slots;
+        if (i == trigger) {
+            frames = std::min(i, pre) + 1;
+        } else if (i > trigger) {
+            frames++;
+        }
+        if (i == trigger + post) {
+            break;
+        }
+    }
+    uint32_t first = edges[(head + slots - frames) % slots];
+    uint32_t span = edges[(head + slots - 1) % slots] - first + 1;
+    return span > frames ? span - frames : 0;
+}
+
+bool check() {
+    bool ok = true;
+    std::mt19937 rng(25);
+
+    for (size_t chips = 1; chips <= ADS1299_MAX_CHAIN; chips++) {
+        receiver rx;
+        uint32_t live_number = 1;
+        model_capture c = {1, chips, uint32_t(ring_frames(131072, chips)), 1024, 5000001, 0};
+        auto packets = drain(c);
+        rx.feed(mix(packets, live_number, {}, rng), rng, 4096);
+        auto done = rx.assembler.take();
+        size_t wrong = done.size() == 1 ? wrong_frames(done[0], c, false) : c.frames;
+        bool pass = wrong == 0 && rx.bad_numbers == 0 && rx.samples == live_number - 1 &&
+                    rx.decoder.stats().capture_packets == packets.size() && !rx.assembler.assembling();
+        std::printf("  %zu chip%s: %u frames in %zu packets, %zu wrong, %llu live samples%s\n", chips,
+                    chips > 1 ? "s" : " ", c.frames, packets.size(), wrong, (unsigned long long)rx.samples,
+                    pass ? "" : "  FAILED");
+        ok &= pass;
+    }
+
+    // Damaged packets lose just their frames; the next capture finishes the first
+    {
+        receiver rx;
+        uint32_t live_number = 1;
+        model_capture first = {7, 1, 4228, 1024, 100, 0};
+        model_capture second = {8, 1, 777, 0, 90000, 3};
+        auto packets = drain(first);
+        std::vector<size_t> damage = {0, 5, 6, 50, packets.size() - 1};
+        rx.feed(mix(packets, live_number, damage, rng), rng, 512);
+        bool open_after_first = rx.assembler.assembling();
+        rx.feed(mix(drain(second), live_number, {}, rng), rng, 512);
+        auto done = rx.assembler.take();
+        size_t expected_missing = (damage.size() - 1) * packet_frames(1) + first.frames % packet_frames(1);
+        bool pass = done.size() == 2 && open_after_first && done[0].missing == expected_missing &&
+                    wrong_frames(done[0], first, true) == 0 && done[1].missing == 0 &&
+                    wrong_frames(done[1], second, false) == 0 && rx.bad_numbers == 0 &&
+                    rx.samples == live_number - 1;
+        std::printf("  damaged: %zu of %zu packets, %zu frames missing (expected %zu), next capture %s%s\n",
+                    damage.size(), packets.size(), done.empty() ? size_t(0) : done[0].missing, expected_missing,
+                    done.size() == 2 && done[1].missing == 0 ? "complete" : "not complete", pass ? "" : "  FAILED");
+        ok &= pass;
+    }
+
+    // Packets seen twice, in and after the capture
+    {
+        receiver rx;
+        uint32_t live_number = 1;
+        model_capture c = {9, 2, 500, 100, 42, 1};
+        auto packets = drain(c);
+        packets.insert(packets.begin() + 3, packets[2]);
+        packets.push_back(packets[4]);
+        rx.feed(mix(packets, live_number, {}, rng), rng, 1024);
+        auto done = rx.assembler.take();
+        bool pass = done.size() == 1 && done[0].missing == 0 && wrong_frames(done[0], c, false) == 0 &&
+                    rx.assembler.stats().duplicates == 2 && !rx.assembler.assembling();
+        std::printf("  duplicates: %llu counted of 2%s\n", (unsigned long long)rx.assembler.stats().duplicates,
+                    pass ? "" : "  FAILED");
+        ok &= pass;
+    }
+
+    // Live outputs of a decimating profile; the capture, in read numbering, spans a ratio change
+    {
+        receiver rx;
+        std::vector<uint8_t> stream;
+        std::vector<uint32_t> completes = decimated_stream(stream);
+        model_capture c = {10, 1, 2000, 1000, 2001, 0};
+        for (const auto &p : drain(c)) {
+            stream.insert(stream.end(), p.begin(), p.end());
+        }
+        rx.feed(stream, rng, 2048);
+        auto done = rx.assembler.take();
+
+        size_t exact = 0, outputs = 0, out_of_order = 0;
+        double previous = 0.0;
+        for (uint32_t i = 0; i < c.frames; i++) {
+            uint32_t read = c.first_read + i;
+            double position = rx.numbering.position(read);
+            if (completes[read]) {
+                outputs++;
+                exact += position == double(completes[read]);
+            }
+            out_of_order += i > 0 && position <= previous;
+            previous = position;
+        }
+        bool pass = done.size() == 1 && wrong_frames(done[0], c, false) == 0 && rx.numbering.decimating() &&
+                    outputs > 0 && exact == outputs && out_of_order == 0 && rx.bad_numbers == 0 &&
+                    rx.samples == completes_count(completes);
+        std::printf("  decimating: %zu of %zu outputs placed exactly, %zu frames out of order, "
+                    "%llu live samples%s\n", exact, outputs, out_of_order, (unsigned long long)rx.samples,
+                    pass ? "" : "  FAILED");
+        ok &= pass;
+    }
+
+    /* Armed through twenty turns of a 1000-frame ring, with the edge count
+       wrapping on the way, before a trigger keeps 200 frames before it and
+       300 after. An edge missed long before the capture must not count
+       against it; one missed inside it must. */
+    {
+        constexpr size_t kSlots = 1000;
+        constexpr uint32_t kTrigger = 20000, kPre = 200, kPost = 300;
+        auto reads = [&](uint32_t skip_before) {
+            std::vector<uint32_t> edges;
+            uint32_t edge = UINT32_MAX - 10000;
+            for (uint32_t i = 0; i <= kTrigger + kPost; i++) {
+                edge += 1 + (i == skip_before);
+                edges.push_back(edge);
+            }
+            return edges;
+        };
+        uint32_t before = ring_missed_drdy(reads(500), kSlots, kTrigger, kPre, kPost);
+        uint32_t inside = ring_missed_drdy(reads(kTrigger - 50), kSlots, kTrigger, kPre, kPost);
+
+        receiver rx;
+        uint32_t live_number = 1;
+        model_capture c = {11, 1, kPre + 1 + kPost, kPre, kTrigger - kPre + 1, 0, inside};
+        rx.feed(mix(drain(c), live_number, {}, rng), rng, 1024);
+        auto done = rx.assembler.take();
+        bool pass = before == 0 && inside == 1 && done.size() == 1 && wrong_frames(done[0], c, false) == 0;
+        std::printf("  missed DRDY: %u before the capture reported, %u of 1 inside it%s\n", before, inside,
+                    pass ? "" : "  FAILED");
+        ok &= pass;
+    }
+    return ok;
+}
+
+void durations() {
+    struct ring {
+        const char *name;
+        size_t bytes;
+    };
+    const ring rings[] = {
+        {"64 KiB", 64 << 10},
+        {"128 KiB (default)", 128 << 10},
+        {"192 KiB, retransmit off", 192 << 10},
+        {"4 MiB PSRAM", 4 << 20},
+    };
+    // Live batches of 16 at 250 SPS, packed, take their share of the link first
+    double live_bytes_per_s = double(kLiveRate) / kBatch * BATCH_PACKET_SIZE(kBatch);
+
+    for (size_t chips = 1; chips <= ADS1299_MAX_CHAIN; chips *= 2) {
+        std::printf("\n  %zu chip%s, %zu bytes a frame\n  %-24s %7s", chips, chips > 1 ? "s" : "",
+                    chips * ADS1299_CHIP_DATA_BYTES, "ring", "frames");
+        for (int dr = 0; dr <= 6; dr++) {
+            std::printf(" %8u", CAPTURE_SAMPLE_RATE(dr));
+        }
+        std::printf("  drain\n");
+        for (const ring &r : rings) {
+            size_t frames = ring_frames(r.bytes, chips);
+            std::printf("  %-24s %7zu", r.name, frames);
+            for (int dr = 0; dr <= 6; dr++) {
+                std::printf(" %7.2fs", double(frames) / CAPTURE_SAMPLE_RATE(dr));
+            }
+            size_t per_packet = packet_frames(chips);
+            size_t full = frames / per_packet;
+            size_t bytes = full * CAPTURE_CHAIN_PACKET_SIZE(per_packet, chips);
+            if (frames % per_packet) {
+                bytes += CAPTURE_CHAIN_PACKET_SIZE(frames % per_packet, chips);
+            }
+            std::printf(" %6.1fs\n", bytes / (kLinkBytesPerS - live_bytes_per_s));
+        }
+    }
+    std::printf("\n  (sample rates in SPS; drain at %u B/s less %.0f B/s of live stream)\n", kLinkBytesPerS,
+                live_bytes_per_s);
+}
+
+void bench() {
+    std::mt19937 rng(7);
+    model_capture c = {1, 1, 4228, 1024, 1, 0};
+    auto packets = drain(c);
+    std::vector<uint8_t> stream;
+    for (const auto &p : packets) {
+        stream.insert(stream.end(), p.begin(), p.end());
+    }
+    constexpr int kRounds = 200;
+    receiver rx;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < kRounds; i++) {
+        rx.feed(stream, rng, 65536);
+    }
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    auto done = rx.assembler.take();
+    std::printf("\n  decode and assemble: %.1f M frames/s, %.2f ms per 128 KiB capture (%zu captures)\n",
+                kRounds * c.frames / s / 1e6, s / kRounds * 1e3, done.size());
+}
+
+} // namespace
+
+int main() {
+    std::printf("Capture packets through stream_decoder and capture_assembler\n");
+    bool ok = check();
+    std::printf("\nCapture duration at each data rate\n");
+    durations();
+    bench();
+    if (!ok) {
+        std::printf("\ncapture_check FAILED\n");
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
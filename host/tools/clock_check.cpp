@@ -0,0 +1,178 @@
+// Accuracy check for the host clock model.
+//
+//   clock_check
+//
+// Simulates batch timestamps as the firmware sends them: an ADS1299 whose
+// oscillator is off by a known (and in one case wandering) number of ppm,
+// DRDY edges latched with interrupt latency jitter and occasional long
+// latency spikes, lost batches and acquisition stalls. Each scenario is fed
+// through clock_model and checked against the truth: drift, jitter, the
+// error of the smoothed sample times, and exactly the expected gaps and
+// missing samples. The exit status is non-zero if any check fails.
+
+#include "clock_model.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct stall {
+    uint64_t before_sample;         // Sample index the stall precedes
+    double duration_ns;
+};
+
+struct scenario {
+    std::string name;
+    double rate;
+    uint32_t batch;
+    double seconds;
+    double drift_ppm;               // Constant part
+    double wander_ppm;              // Slow sinusoid over an hour, as from temperature
+    double jitter_ns;               // Gaussian interrupt latency spread
+    double spike_rate;              // Fraction of batches with a long latency spike
+    uint32_t first_number;          // On-wire sample number of the first sample
+    std::vector<uint64_t> lost_batches;
+    std::vector<stall> stalls;
+};
+
+struct result {
+    double drift_error_ppm = 0;
+    double jitter_ns = 0;
+    double raw_error_ns = 0;        // RMS of timestamp minus true time
+    double smooth_error_ns = 0;     // RMS of model time minus true time
+    size_t gaps = 0;
+    uint64_t missing = 0;
+    bool ok = true;
+};
+
+result run(const scenario &s) {
+    cerelog::clock_model model(s.rate);
+    std::mt19937_64 rng(42);
+    std::normal_distribution<double> jitter(0.0, s.jitter_ns);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+    const double nominal = 1e9 / s.rate;
+    const double latency = 3000.0;  // Constant part of the interrupt latency, unobservable
+    const uint64_t total = uint64_t(s.rate * s.seconds);
+    const double settle = 60.0 * s.rate;
+
+    double true_time = 1e9;         // Device has been up a second
+    double raw_sum = 0, raw_sq = 0, smooth_sum = 0, smooth_sq = 0;
+    double drift_error = 0;
+    uint64_t measured = 0, expected_missing = 0;
+    size_t stall_next = 0;
+    result r;
+
+    for (uint64_t index = 0, batch = 0; index < total; index += s.batch, batch++) {
+        if (stall_next < s.stalls.size() && index >= s.stalls[stall_next].before_sample) {
+            true_time += s.stalls[stall_next].duration_ns;
+            stall_next++;
+        }
+
+        double t = true_time;
+        double ppm = s.drift_ppm + s.wander_ppm * std::sin(2 * M_PI * double(index) / s.rate / 3600.0);
+        true_time += s.batch * nominal * (1 + ppm * 1e-6);
+
+        bool lost = false;
+        for (uint64_t b : s.lost_batches) {
+            lost = lost || b == batch;
+        }
+        if (lost) {
+            expected_missing += s.batch;
+            continue;
+        }
+
+        double stamp = t + latency + std::abs(jitter(rng));
+        if (unit(rng) < s.spike_rate) {
+            stamp += 20000.0 + 60000.0 * unit(rng);
+        }
+
+        uint32_t number = s.first_number + uint32_t(index);
+        model.observe(number, s.batch, uint64_t(stamp));
+
+        // Score only once the fit has settled, and against a constant latency
+        if (double(index) > settle && !model.pending()) {
+            double raw = stamp - t - latency;
+            double smooth = model.sample_time_ns(number) - t - latency;
+            raw_sum += raw;
+            raw_sq += raw * raw;
+            smooth_sum += smooth;
+            smooth_sq += smooth * smooth;
+            drift_error = std::max(drift_error, std::abs(model.drift_ppm() - ppm));
+            measured++;
+        }
+    }
+
+    auto rms = [&](double sum, double sq) {
+        double mean = sum / double(measured);
+        return std::sqrt(std::max(0.0, sq / double(measured) - mean * mean));
+    };
+
+    r.drift_error_ppm = drift_error;
+    r.jitter_ns = model.jitter_ns();
+    r.raw_error_ns = rms(raw_sum, raw_sq);
+    r.smooth_error_ns = rms(smooth_sum, smooth_sq);
+    r.gaps = model.gaps().size();
+    r.missing = model.missing_samples();
+
+    if (r.gaps != s.stalls.size()) {
+        std::printf("  FAIL %s: %zu gaps found, %zu expected\n", s.name.c_str(), r.gaps, s.stalls.size());
+        r.ok = false;
+    }
+    for (size_t i = 0; i < r.gaps && i < s.stalls.size(); i++) {
+        const cerelog::clock_gap &g = model.gaps()[i];
+        uint64_t at = g.sample_index - s.first_number;
+        if (at < s.stalls[i].before_sample || at >= s.stalls[i].before_sample + s.batch ||
+            std::abs(g.duration_ns - s.stalls[i].duration_ns) > 5 * s.jitter_ns + nominal) {
+            std::printf("  FAIL %s: gap at %llu lasting %.0f ns, expected %llu lasting %.0f ns\n",
+                        s.name.c_str(), (unsigned long long)at, g.duration_ns,
+                        (unsigned long long)s.stalls[i].before_sample, s.stalls[i].duration_ns);
+            r.ok = false;
+        }
+    }
+    if (r.missing != expected_missing) {
+        std::printf("  FAIL %s: %llu samples missing, %llu expected\n", s.name.c_str(),
+                    (unsigned long long)r.missing, (unsigned long long)expected_missing);
+        r.ok = false;
+    }
+    if (r.drift_error_ppm > 1.0) {
+        std::printf("  FAIL %s: drift off by %.2f ppm\n", s.name.c_str(), r.drift_error_ppm);
+        r.ok = false;
+    }
+    if (r.smooth_error_ns > r.raw_error_ns / 2) {
+        std::printf("  FAIL %s: smoothing left %.0f ns of %.0f ns jitter\n", s.name.c_str(),
+                    r.smooth_error_ns, r.raw_error_ns);
+        r.ok = false;
+    }
+    return r;
+}
+
+} // namespace
+
+int main() {
+    const std::vector<scenario> scenarios = {
+        {"250sps_2h", 250, 16, 7200, 35.0, 0.0, 4000, 0.001, 1, {}, {}},
+        {"2ksps_wander", 2000, 16, 7200, -12.0, 3.0, 3000, 0.002, 1, {}, {}},
+        {"16ksps_stall_loss", 16000, 32, 600, -20.0, 0.0, 2000, 0.0005, 0xFFFF0000u,
+         {5000, 5001, 5002, 90000}, {{4000000, 20e6}}},
+        {"1ksps_reconfig", 1000, 8, 1800, 50.0, 0.0, 5000, 0.001, 1, {}, {{600000, 4e6}, {1200000, 150e6}}},
+    };
+
+    bool ok = true;
+    std::printf("%-20s %10s %10s %10s %10s %6s %8s\n", "scenario", "drift err", "jitter(ns)",
+                "raw(ns)", "model(ns)", "gaps", "missing");
+    for (const scenario &s : scenarios) {
+        result r = run(s);
+        ok = ok && r.ok;
+        std::printf("%-20s %10.3f %10.0f %10.0f %10.0f %6zu %8llu\n", s.name.c_str(), r.drift_error_ppm,
+                    r.jitter_ns, r.raw_error_ns, r.smooth_error_ns, r.gaps, (unsigned long long)r.missing);
+    }
+
+    std::printf("%s\n", ok ? "Clock model within limits" : "Clock model FAILED");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
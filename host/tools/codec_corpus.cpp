@@ -0,0 +1,305 @@
+// Round-trip check and compression report for eeg_codec.
+//
+//   codec_corpus [recording.csv ...]
+//
+// Runs a built-in synthetic corpus, plus any CSV recordings given on the
+// command line, through eeg_codec_encode/eeg_codec_decode at several batch
+// sizes. Every block must decode bit-exactly and stay within
+// EEG_CODEC_MAX_BYTES; the exit status is non-zero otherwise.
+//
+// CSV recordings hold one sample per row. The last eight columns are taken
+// as channels: integers are raw ADS1299 codes, values with a decimal point
+// are microvolts at gain 24 (as written by the Python plotters).
+
+#include "eeg_codec.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr size_t kChannels = 8;
+constexpr double kVref = 4.5;
+constexpr double kGain = 24.0;
+constexpr double kUvPerCode = kVref / kGain / (1 << 23) * 1e6;
+constexpr int32_t kCodeMax = (1 << 23) - 1;
+constexpr int32_t kCodeMin = -(1 << 23);
+constexpr size_t kBatchSizes[] = {1, 4, 16, 32, 64, 255};
+constexpr double kPi = 3.14159265358979323846;
+
+struct signal {
+    std::string name;
+    std::vector<int32_t> samples;   // Interleaved [sample][channel]
+    size_t num_samples() const { return samples.size() / kChannels; }
+};
+
+int32_t to_code(double microvolts) {
+    double code = std::round(microvolts / kUvPerCode);
+    return static_cast<int32_t>(std::clamp(code, double(kCodeMin), double(kCodeMax)));
+}
+
+/* Scalp EEG as the ADS1299 sees it at gain 24: electrode offset, pink
+   background, alpha and theta rhythms, mains pickup and amplifier noise
+   that grows with the data rate. */
+signal make_eeg(const std::string &name, double rate, double seconds, double mains_hz, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> unit(0.0, 1.0);
+    size_t n = static_cast<size_t>(rate * seconds);
+    double amp_noise_uv = 0.14 * std::sqrt(rate / 250.0);
+
+    signal s{name, std::vector<int32_t>(n * kChannels)};
+    for (size_t ch = 0; ch < kChannels; ch++) {
+        double offset_uv = 2000.0 * (double(ch) - 3.5);
+        double pink[3] = {0.0, 0.0, 0.0};
+
+        for (size_t i = 0; i < n; i++) {
+            double t = double(i) / rate;
+            double w = unit(rng);
+
+            // Three one-pole stages with spread corner frequencies approximate 1/f
+            pink[0] = 0.997 * pink[0] + 0.10 * w;
+            pink[1] = 0.963 * pink[1] + 0.30 * w;
+            pink[2] = 0.570 * pink[2] + 1.00 * w;
+            double background = 1.5 * (pink[0] + pink[1] + pink[2]);
+
+            double uv = offset_uv + background +
+                        20.0 * std::sin(2 * kPi * 10.0 * t + 0.7 * ch) +
+                        8.0 * std::sin(2 * kPi * 6.0 * t + 1.3 * ch) +
+                        5.0 * std::sin(2 * kPi * mains_hz * t + 0.2 * ch) +
+                        amp_noise_uv * unit(rng);
+            s.samples[i * kChannels + ch] = to_code(uv);
+        }
+    }
+    return s;
+}
+
+// EEG with blinks: large slow deflections on the frontal channels plus electrode pops
+signal make_artifacts(double rate, double seconds, uint32_t seed) {
+    signal s = make_eeg("eeg_artifacts_500sps", rate, seconds, 60.0, seed);
+    std::mt19937 rng(seed + 1);
+    std::uniform_int_distribution<size_t> where(0, s.num_samples() - 1);
+
+    for (int blink = 0; blink < 8; blink++) {
+        size_t start = where(rng);
+        for (size_t i = 0; i < size_t(rate * 0.3) && start + i < s.num_samples(); i++) {
+            double shape = std::sin(kPi * double(i) / (rate * 0.3));
+            for (size_t ch = 0; ch < 2; ch++) {
+                int32_t &v = s.samples[(start + i) * kChannels + ch];
+                v = std::clamp(v + to_code(300.0 * shape), kCodeMin, kCodeMax);
+            }
+        }
+    }
+    for (int pop = 0; pop < 4; pop++) {
+        size_t start = where(rng);
+        size_t ch = pop % kChannels;
+        for (size_t i = start; i < s.num_samples(); i++) {
+            int32_t &v = s.samples[i * kChannels + ch];
+            v = std::clamp(v + to_code(5000.0), kCodeMin, kCodeMax);
+        }
+    }
+    return s;
+}
+
+// CONFIG2 internal test signal: VREF/2400 square at fCLK/2^21 on every channel
+signal make_test_signal(double rate, double seconds) {
+    size_t n = static_cast<size_t>(rate * seconds);
+    double half_period = rate / (2.048e6 / (1 << 21)) / 2;
+    signal s{"test_signal_1ksps", std::vector<int32_t>(n * kChannels)};
+    std::mt19937 rng(7);
+    std::normal_distribution<double> noise(0.0, 0.2);
+
+    for (size_t i = 0; i < n; i++) {
+        double level = (size_t(double(i) / half_period) & 1) ? -1.0 : 1.0;
+        for (size_t ch = 0; ch < kChannels; ch++) {
+            s.samples[i * kChannels + ch] = to_code(level * kVref / 2400 * 1e6 / 2 + noise(rng));
+        }
+    }
+    return s;
+}
+
+// Inputs shorted (MUX=001): amplifier noise only
+signal make_shorted(double rate, double seconds) {
+    size_t n = static_cast<size_t>(rate * seconds);
+    signal s{"shorted_inputs_250sps", std::vector<int32_t>(n * kChannels)};
+    std::mt19937 rng(11);
+    std::normal_distribution<double> noise(0.0, 0.14);
+
+    for (auto &v : s.samples) {
+        v = to_code(noise(rng));
+    }
+    return s;
+}
+
+// Floating electrodes pinned to the rails, with one channel toggling between them
+signal make_railed(double seconds) {
+    size_t n = static_cast<size_t>(250 * seconds);
+    signal s{"railed_inputs", std::vector<int32_t>(n * kChannels)};
+
+    for (size_t i = 0; i < n; i++) {
+        for (size_t ch = 0; ch < kChannels; ch++) {
+            int32_t v = (ch & 1) ? kCodeMax : kCodeMin;
+            if (ch == 7) {
+                v = ((i / 37) & 1) ? kCodeMax : kCodeMin;
+            }
+            s.samples[i * kChannels + ch] = v;
+        }
+    }
+    return s;
+}
+
+// Worst cases for the predictor: full-scale white noise and alternating extremes
+signal make_worst_case(double seconds) {
+    size_t n = static_cast<size_t>(250 * seconds);
+    signal s{"worst_case", std::vector<int32_t>(n * kChannels)};
+    std::mt19937 rng(13);
+    std::uniform_int_distribution<int32_t> code(kCodeMin, kCodeMax);
+
+    for (size_t i = 0; i < n; i++) {
+        for (size_t ch = 0; ch < kChannels; ch++) {
+            s.samples[i * kChannels + ch] = (ch < 4) ? code(rng) : ((i & 1) ? kCodeMax : kCodeMin);
+        }
+    }
+    return s;
+}
+
+bool load_csv(const std::string &path, signal &s) {
+    std::ifstream in(path);
+    if (!in) {
+        std::fprintf(stderr, "Cannot open %s\n", path.c_str());
+        return false;
+    }
+
+    s.name = path;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::vector<std::string> fields;
+        std::stringstream row(line);
+        std::string field;
+        while (std::getline(row, field, ',')) {
+            fields.push_back(field);
+        }
+        if (fields.size() < kChannels) {
+            continue;
+        }
+
+        int32_t values[kChannels];
+        bool numeric = true;
+        for (size_t ch = 0; ch < kChannels && numeric; ch++) {
+            const std::string &f = fields[fields.size() - kChannels + ch];
+            char *end = nullptr;
+            double v = std::strtod(f.c_str(), &end);
+            numeric = end != f.c_str();
+            bool microvolts = f.find('.') != std::string::npos;
+            values[ch] = microvolts ? to_code(v) : std::clamp(int32_t(v), kCodeMin, kCodeMax);
+        }
+        if (numeric) {
+            s.samples.insert(s.samples.end(), values, values + kChannels);
+        }
+    }
+
+    if (s.samples.empty()) {
+        std::fprintf(stderr, "No samples in %s\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+struct result {
+    size_t raw_bytes = 0;
+    size_t coded_bytes = 0;
+    size_t worst_block = 0;         // Largest block relative to its raw size, in bytes over
+    double encode_ns = 0;
+    bool ok = true;
+};
+
+result run(const signal &s, size_t batch) {
+    result r;
+    std::vector<uint8_t> coded(EEG_CODEC_MAX_BYTES(batch, kChannels));
+    std::vector<int32_t> decoded(batch * kChannels);
+    size_t n = s.num_samples();
+
+    for (size_t first = 0; first < n; first += batch) {
+        size_t count = std::min(batch, n - first);
+        const int32_t *block = &s.samples[first * kChannels];
+
+        auto t0 = std::chrono::steady_clock::now();
+        int len = eeg_codec_encode(block, count, kChannels, coded.data(), coded.size());
+        auto t1 = std::chrono::steady_clock::now();
+        r.encode_ns += std::chrono::duration<double, std::nano>(t1 - t0).count();
+
+        if (len < 0 || size_t(len) > EEG_CODEC_MAX_BYTES(count, kChannels)) {
+            std::printf("  FAIL %s batch %zu @%zu: encode returned %d\n", s.name.c_str(), batch, first, len);
+            r.ok = false;
+            return r;
+        }
+
+        int ret = eeg_codec_decode(coded.data(), size_t(len), count, kChannels, decoded.data());
+        if (ret != 0 || !std::equal(block, block + count * kChannels, decoded.begin())) {
+            std::printf("  FAIL %s batch %zu @%zu: round trip mismatch (%d)\n", s.name.c_str(), batch, first, ret);
+            r.ok = false;
+            return r;
+        }
+
+        // A truncated block must be rejected, never read past its end
+        if (len > 1 && eeg_codec_decode(coded.data(), size_t(len) / 2, count, kChannels, decoded.data()) == 0) {
+            std::printf("  FAIL %s batch %zu @%zu: truncated block decoded\n", s.name.c_str(), batch, first);
+            r.ok = false;
+            return r;
+        }
+
+        size_t raw = count * kChannels * 3;
+        r.raw_bytes += raw;
+        r.coded_bytes += size_t(len);
+        if (size_t(len) > raw) {
+            r.worst_block = std::max(r.worst_block, size_t(len) - raw);
+        }
+    }
+    return r;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::vector<signal> corpus = {
+        make_eeg("eeg_250sps", 250, 60, 50.0, 1),
+        make_eeg("eeg_1ksps", 1000, 30, 60.0, 2),
+        make_eeg("eeg_4ksps", 4000, 10, 50.0, 3),
+        make_eeg("eeg_8ksps", 8000, 5, 60.0, 4),
+        make_artifacts(500, 30, 5),
+        make_test_signal(1000, 10),
+        make_shorted(250, 30),
+        make_railed(10),
+        make_worst_case(10),
+    };
+
+    for (int i = 1; i < argc; i++) {
+        signal s;
+        if (!load_csv(argv[i], s)) {
+            return 1;
+        }
+        corpus.push_back(std::move(s));
+    }
+
+    bool ok = true;
+    std::printf("%-24s %6s %10s %8s %12s %10s\n", "signal", "batch", "samples", "ratio", "worst(+B)", "ns/sample");
+    for (const signal &s : corpus) {
+        for (size_t batch : kBatchSizes) {
+            result r = run(s, batch);
+            ok = ok && r.ok;
+            std::printf("%-24s %6zu %10zu %7.2fx %12zu %10.1f\n", s.name.c_str(), batch, s.num_samples(),
+                        r.coded_bytes ? double(r.raw_bytes) / double(r.coded_bytes) : 0.0,
+                        r.worst_block, r.encode_ns / double(s.num_samples()));
+        }
+    }
+
+    std::printf("%s\n", ok ? "All blocks round-tripped" : "Round trip FAILED");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
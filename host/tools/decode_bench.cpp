@@ -0,0 +1,546 @@
+// Correctness check and throughput benchmark for stream_decoder.
+//
+//   decode_bench
+//
+// Builds serial streams the way the firmware and the Arduino sketch write
+// them: single-sample packets, packed and compressed batches, markers,
+// telemetry and 37-byte Arduino frames, all carrying a known signal.
+//
+// The check stream mixes every kind, then gets damaged: bit flips, dropped
+// bytes and noise between packets. It is fed in random chunk sizes, split
+// anywhere, and every packet left intact must come out with exactly its
+// samples while each damaged one costs only itself. The exit status is
+// non-zero otherwise.
+//
+// Batches from daisy chains of two to four ADS1299s, packed and compressed,
+// are decoded with each chip selected in turn and must give that chip's
+// channels and status word.
+//
+// The benchmark decodes a clean stream of each kind in 4 KiB chunks, as
+// read from a serial port, on one core and reports packets and samples per
+// second, the 32-channel chain included.
+
+#include "packet_crc.h"
+#include "stream_decoder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using cerelog::kChannels;
+
+struct sample {
+    uint32_t number;
+    int32_t channels[kChannels];
+};
+
+struct packet_record {
+    size_t offset;                  // Where it starts in the stream
+    size_t length;
+    uint32_t first_sample;          // Index into the truth samples
+    uint32_t samples;
+    bool damaged = false;
+};
+
+struct stream {
+    std::vector<uint8_t> bytes;
+    std::vector<packet_record> packets;
+    size_t markers = 0;
+    size_t telemetry = 0;
+};
+
+enum class kind { single, batch, compressed, arduino };
+
+// Slow sines and noise, so compressed batches compress as they do on real EEG
+std::vector<sample> make_samples(size_t count) {
+    std::mt19937 rng(7);
+    std::normal_distribution<double> noise(0.0, 200.0);
+    std::vector<sample> samples(count);
+    for (size_t i = 0; i < count; i++) {
+        samples[i].number = uint32_t(1000 + i);
+        for (size_t ch = 0; ch < kChannels; ch++) {
+            double v = 40000.0 * std::sin(double(i) * 0.01 * double(ch + 1)) + noise(rng);
+            samples[i].channels[ch] = std::clamp(int32_t(v), -(1 << 23), (1 << 23) - 1);
+        }
+    }
+    return samples;
+}
+
+void put_be24(std::vector<uint8_t> &out, int32_t value) {
+    out.push_back(uint8_t(uint32_t(value) >> 16));
+    out.push_back(uint8_t(uint32_t(value) >> 8));
+    out.push_back(uint8_t(value));
+}
+
+void finish_firmware_packet(std::vector<uint8_t> &out, size_t start) {
+    uint16_t crc = packet_crc_compute(out.data() + start, out.size() - start);
+    out.push_back(uint8_t(crc));
+    out.push_back(uint8_t(crc >> 8));
+    out.push_back(PACKET_END_BYTE1);
+    out.push_back(PACKET_END_BYTE2);
+}
+
+void append_single(std::vector<uint8_t> &out, const sample &s) {
+    ads1299_packet_t packet = {};
+    packet.start_bytes[0] = PACKET_START_BYTE1;
+    packet.start_bytes[1] = PACKET_START_BYTE2;
+    packet.packet_type = PACKET_TYPE_ADS1299;
+    packet.payload_length = sizeof(ads1299_sample_t) + PACKET_TIMESTAMP_SIZE;
+    packet.timestamp_us = uint64_t(s.number) * 500;
+    packet.sample.sample_number = s.number;
+    packet.sample.status = 0xC00000;
+    std::memcpy(packet.sample.channels, s.channels, sizeof(s.channels));
+    packet.crc16 = packet_crc_compute(reinterpret_cast<const uint8_t *>(&packet),
+                                      PACKET_HEADER_SIZE + PACKET_TIMESTAMP_SIZE + sizeof(ads1299_sample_t));
+    packet.end_bytes[0] = PACKET_END_BYTE1;
+    packet.end_bytes[1] = PACKET_END_BYTE2;
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(&packet);
+    out.insert(out.end(), p, p + sizeof(packet));
+}
+
+void append_batch(std::vector<uint8_t> &out, const sample *s, size_t count, bool compress) {
+    size_t start = out.size();
+    ads1299_batch_header_t header = {};
+    header.start_bytes[0] = PACKET_START_BYTE1;
+    header.start_bytes[1] = PACKET_START_BYTE2;
+    header.packet_type = PACKET_TYPE_ADS1299_BATCH;
+    header.sample_count = uint8_t(count);
+    header.timestamp_ns = uint64_t(s[0].number) * 500000;
+    header.sample_number = s[0].number;
+    header.status[0] = 0xC0;
+
+    std::vector<int32_t> channels;
+    for (size_t i = 0; i < count; i++) {
+        channels.insert(channels.end(), s[i].channels, s[i].channels + kChannels);
+    }
+
+    std::vector<uint8_t> coded(EEG_CODEC_MAX_BYTES(count, kChannels));
+    int coded_len = compress ? eeg_codec_encode(channels.data(), count, kChannels, coded.data(), coded.size()) : -1;
+    if (coded_len > 0) {
+        header.packet_type |= PACKET_FLAG_COMPRESSED;
+    }
+
+    const uint8_t *h = reinterpret_cast<const uint8_t *>(&header);
+    out.insert(out.end(), h, h + sizeof(header));
+    if (coded_len > 0) {
+        out.push_back(uint8_t(coded_len));
+        out.push_back(uint8_t(coded_len >> 8));
+        out.insert(out.end(), coded.begin(), coded.begin() + coded_len);
+    } else {
+        for (int32_t v : channels) {
+            put_be24(out, v);
+        }
+    }
+    finish_firmware_packet(out, start);
+}
+
+/* A batch from a daisy chain of chips: chip c of sample i carries
+   s[i * chips + c]'s channels, and its status word is 0xC00000 | c */
+void append_chain_batch(std::vector<uint8_t> &out, const sample *s, size_t count, size_t chips, uint32_t number,
+                        bool compress) {
+    size_t start = out.size();
+    size_t chain_channels = chips * kChannels;
+    ads1299_batch_header_t header = {};
+    header.start_bytes[0] = PACKET_START_BYTE1;
+    header.start_bytes[1] = PACKET_START_BYTE2;
+    header.packet_type = PACKET_TYPE_ADS1299_BATCH | PACKET_CHAIN_BITS(chips);
+    header.sample_count = uint8_t(count);
+    header.timestamp_ns = uint64_t(number) * 500000;
+    header.sample_number = number;
+    header.status[0] = 0xC0;
+
+    std::vector<int32_t> channels;
+    for (size_t i = 0; i < count * chips; i++) {
+        channels.insert(channels.end(), s[i].channels, s[i].channels + kChannels);
+    }
+
+    std::vector<uint8_t> coded(EEG_CODEC_MAX_BYTES(count, chain_channels));
+    int coded_len = compress ? eeg_codec_encode(channels.data(), count, chain_channels, coded.data(), coded.size()) : -1;
+    if (coded_len > 0) {
+        header.packet_type |= PACKET_FLAG_COMPRESSED;
+    }
+
+    const uint8_t *h = reinterpret_cast<const uint8_t *>(&header);
+    out.insert(out.end(), h, h + sizeof(header));
+    for (size_t c = 1; c < chips; c++) {
+        put_be24(out, int32_t(0xC00000 | c));
+    }
+    if (coded_len > 0) {
+        out.push_back(uint8_t(coded_len));
+        out.push_back(uint8_t(coded_len >> 8));
+        out.insert(out.end(), coded.begin(), coded.begin() + coded_len);
+    } else {
+        for (int32_t v : channels) {
+            put_be24(out, v);
+        }
+    }
+    finish_firmware_packet(out, start);
+}
+
+void append_arduino(std::vector<uint8_t> &out, const sample &s) {
+    size_t start = out.size();
+    out.push_back(0xAB);
+    out.push_back(0xCD);
+    out.push_back(cerelog::kArduinoPayloadLength);
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        out.push_back(uint8_t(s.number >> shift));
+    }
+    out.push_back(0xC0);
+    out.push_back(0x00);
+    out.push_back(0x00);
+    for (int32_t v : s.channels) {
+        put_be24(out, v);
+    }
+    uint8_t sum = 0;
+    for (size_t i = start + 2; i < out.size(); i++) {
+        sum = uint8_t(sum + out[i]);
+    }
+    out.push_back(sum);
+    out.push_back(0xDC);
+    out.push_back(0xBA);
+}
+
+void append_marker(std::vector<uint8_t> &out, uint32_t number) {
+    ads1299_marker_packet_t marker = {};
+    marker.start_bytes[0] = PACKET_START_BYTE1;
+    marker.start_bytes[1] = PACKET_START_BYTE2;
+    marker.packet_type = PACKET_TYPE_MARKER;
+    marker.marker_type = MARKER_RECONFIG;
+    marker.sample_number = number;
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(&marker);
+    size_t start = out.size();
+    out.insert(out.end(), p, p + offsetof(ads1299_marker_packet_t, crc16));
+    finish_firmware_packet(out, start);
+}
+
+void append_telemetry(std::vector<uint8_t> &out) {
+    telemetry_packet_t telemetry = {};
+    telemetry.start_bytes[0] = PACKET_START_BYTE1;
+    telemetry.start_bytes[1] = PACKET_START_BYTE2;
+    telemetry.packet_type = TELEMETRY_PACKET_TYPE;
+    telemetry.stage_count = TELEMETRY_STAGE_COUNT;
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(&telemetry);
+    size_t start = out.size();
+    out.insert(out.end(), p, p + offsetof(telemetry_packet_t, crc16));
+    finish_firmware_packet(out, start);
+}
+
+stream build(const std::vector<sample> &samples, const std::vector<kind> &kinds, size_t batch, std::mt19937 &rng) {
+    stream s;
+    size_t i = 0;
+    while (i < samples.size()) {
+        kind k = kinds[rng() % kinds.size()];
+        size_t count = (k == kind::batch || k == kind::compressed) ? std::min(batch, samples.size() - i) : 1;
+        packet_record record{s.bytes.size(), 0, uint32_t(i), uint32_t(count)};
+
+        switch (k) {
+        case kind::single:
+            append_single(s.bytes, samples[i]);
+            break;
+        case kind::batch:
+            append_batch(s.bytes, &samples[i], count, false);
+            break;
+        case kind::compressed:
+            append_batch(s.bytes, &samples[i], count, true);
+            break;
+        case kind::arduino:
+            append_arduino(s.bytes, samples[i]);
+            break;
+        }
+        record.length = s.bytes.size() - record.offset;
+        s.packets.push_back(record);
+        i += count;
+
+        if (kinds.size() > 1 && rng() % 50 == 0) {
+            append_marker(s.bytes, uint32_t(samples[std::min(i, samples.size() - 1)].number));
+            s.markers++;
+        }
+        if (kinds.size() > 1 && rng() % 80 == 0) {
+            append_telemetry(s.bytes);
+            s.telemetry++;
+        }
+    }
+    return s;
+}
+
+// Flips a bit in or cuts a byte out of some packets, and sprays noise between others
+std::vector<uint8_t> damage(stream &s, std::mt19937 &rng) {
+    std::vector<uint8_t> out;
+    out.reserve(s.bytes.size() + s.bytes.size() / 8);
+    size_t next = 0;
+    for (packet_record &p : s.packets) {
+        out.insert(out.end(), s.bytes.begin() + next, s.bytes.begin() + p.offset);
+        next = p.offset + p.length;
+
+        if (rng() % 30 == 0) {
+            // Noise that is heavy in start bytes, to tempt false syncs
+            size_t n = 1 + rng() % 60;
+            for (size_t j = 0; j < n; j++) {
+                static const uint8_t tempting[] = {0xAA, 0x55, 0xAB, 0xCD, 0x02, 0x82};
+                out.push_back(rng() % 2 ? tempting[rng() % 6] : uint8_t(rng()));
+            }
+        }
+
+        std::vector<uint8_t> packet(s.bytes.begin() + p.offset, s.bytes.begin() + next);
+        switch (rng() % 40) {
+        case 0:
+            packet[rng() % packet.size()] ^= uint8_t(1u << (rng() % 8));
+            p.damaged = true;
+            break;
+        case 1:
+            packet.erase(packet.begin() + rng() % packet.size());
+            p.damaged = true;
+            break;
+        default:
+            break;
+        }
+        out.insert(out.end(), packet.begin(), packet.end());
+    }
+    out.insert(out.end(), s.bytes.begin() + next, s.bytes.end());
+    return out;
+}
+
+struct decoded {
+    std::vector<uint32_t> numbers;
+    std::vector<int32_t> channels;
+};
+
+decoded decode_chunked(cerelog::stream_decoder &decoder, const std::vector<uint8_t> &bytes, std::mt19937 &rng,
+                       size_t max_chunk) {
+    const size_t capacity = 1024;
+    std::vector<int32_t> channels(capacity * kChannels);
+    std::vector<uint32_t> numbers(capacity);
+    cerelog::sample_block out;
+    out.channels = channels.data();
+    out.sample_number = numbers.data();
+    out.capacity = capacity;
+
+    decoded result;
+    size_t pos = 0;
+    while (pos < bytes.size()) {
+        size_t chunk = std::min(bytes.size() - pos, size_t(1 + rng() % max_chunk));
+        size_t done = 0;
+        while (done < chunk) {
+            size_t consumed = 0;
+            size_t n = decoder.decode(bytes.data() + pos + done, chunk - done, out, &consumed);
+            result.numbers.insert(result.numbers.end(), numbers.begin(), numbers.begin() + n);
+            result.channels.insert(result.channels.end(), channels.begin(), channels.begin() + n * kChannels);
+            done += consumed;
+        }
+        pos += chunk;
+    }
+    return result;
+}
+
+bool check() {
+    std::mt19937 rng(11);
+    std::vector<sample> samples = make_samples(200000);
+    stream s = build(samples, {kind::single, kind::batch, kind::compressed, kind::arduino}, 32, rng);
+    std::vector<uint8_t> bytes = damage(s, rng);
+
+    /* Intact samples must come out. A damaged packet may still decode when
+       the byte it lost was the final 0xAA and the next start byte stands
+       in; its CRC still holds, so its samples are allowed but not required. */
+    enum : uint8_t { forbidden, required, allowed };
+    std::vector<uint8_t> expect(samples.size(), forbidden);
+    size_t intact = 0, damaged = 0;
+    for (const packet_record &p : s.packets) {
+        (p.damaged ? damaged : intact)++;
+        for (uint32_t i = 0; i < p.samples; i++) {
+            expect[p.first_sample + i] = p.damaged ? allowed : required;
+        }
+    }
+
+    bool ok = true;
+    for (size_t max_chunk : {size_t(1), size_t(7), size_t(64), size_t(4096), size_t(65536)}) {
+        cerelog::stream_decoder decoder;
+        std::mt19937 chunk_rng{uint32_t(max_chunk)};
+        decoded d = decode_chunked(decoder, bytes, chunk_rng, max_chunk);
+
+        // Every intact sample, in order, with exact values, and nothing invented
+        size_t next = 0, wrong = 0, missing = 0, extra = 0;
+        for (size_t i = 0; i < d.numbers.size(); i++) {
+            size_t index = d.numbers[i] - samples[0].number;
+            if (index >= samples.size() || expect[index] == forbidden || index < next) {
+                extra++;
+                continue;
+            }
+            for (; next < index; next++) {
+                missing += expect[next] == required;
+            }
+            next = index + 1;
+            wrong += std::memcmp(&d.channels[i * kChannels], samples[index].channels, sizeof(samples[index].channels)) != 0;
+        }
+        for (; next < samples.size(); next++) {
+            missing += expect[next] == required;
+        }
+
+        const cerelog::decoder_stats &st = decoder.stats();
+        bool pass = wrong == 0 && missing == 0 && extra == 0 && st.marker_packets == s.markers &&
+                    st.telemetry_packets == s.telemetry && st.bytes == bytes.size();
+        std::printf("chunks <= %-6zu %zu samples, %zu wrong, %zu missing, %zu extra, %llu/%zu markers, "
+                    "%llu/%zu telemetry, %llu bad, %llu skipped bytes: %s\n",
+                    max_chunk, d.numbers.size(), wrong, missing, extra,
+                    (unsigned long long)st.marker_packets, s.markers, (unsigned long long)st.telemetry_packets,
+                    s.telemetry, (unsigned long long)st.bad_packets, (unsigned long long)st.skipped_bytes,
+                    pass ? "ok" : "FAIL");
+        ok = ok && pass;
+    }
+    std::printf("%zu packets, %zu damaged\n", intact + damaged, damaged);
+    return ok;
+}
+
+// Each chip of a chained batch, packed and compressed, comes out when selected; chips past the chain as zeros
+bool check_chain() {
+    const size_t count = 32;
+    std::vector<sample> samples = make_samples(2 * count * ADS1299_MAX_CHAIN);
+    const size_t capacity = 1024;
+    std::vector<int32_t> channels(capacity * kChannels);
+    std::vector<uint32_t> numbers(capacity), status(capacity);
+    cerelog::sample_block out;
+    out.channels = channels.data();
+    out.sample_number = numbers.data();
+    out.status = status.data();
+    out.capacity = capacity;
+    bool ok = true;
+
+    for (size_t chips = 2; chips <= ADS1299_MAX_CHAIN; chips++) {
+        std::vector<uint8_t> bytes;
+        append_chain_batch(bytes, samples.data(), count, chips, 1, false);
+        append_chain_batch(bytes, samples.data() + count * chips, count, chips, uint32_t(1 + count), true);
+        bool compressed = (bytes[BATCH_CHAIN_PACKET_SIZE(count, chips) + 2] & PACKET_FLAG_COMPRESSED) != 0;
+
+        size_t wrong = 0;
+        bool counts = true;
+        for (size_t chip = 0; chip < ADS1299_MAX_CHAIN; chip++) {
+            cerelog::stream_decoder decoder;
+            decoder.select_chip(chip);
+            size_t consumed = 0;
+            size_t n = decoder.decode(bytes.data(), bytes.size(), out, &consumed);
+            const cerelog::decoder_stats &st = decoder.stats();
+            counts = counts && n == 2 * count && consumed == bytes.size() && st.chained_packets == 2 &&
+                     st.bad_packets == 0 && st.skipped_bytes == 0;
+            for (size_t i = 0; i < n; i++) {
+                int32_t expected[kChannels] = {};
+                if (chip < chips) {
+                    std::memcpy(expected, samples[i * chips + chip].channels, sizeof(expected));
+                }
+                uint32_t expected_status = chip < chips ? uint32_t(0xC00000 | chip) : 0;
+                wrong += numbers[i] != i + 1 || status[i] != expected_status ||
+                         std::memcmp(&channels[i * kChannels], expected, sizeof(expected)) != 0;
+            }
+        }
+        bool pass = counts && compressed && wrong == 0;
+        std::printf("chain of %zu chips, packed and compressed, each chip selected: %zu wrong samples: %s\n",
+                    chips, wrong, pass ? "ok" : "FAIL");
+        ok = ok && pass;
+    }
+
+    cerelog::stream_decoder decoder;
+    bool rejected = false;
+    try {
+        decoder.select_chip(ADS1299_MAX_CHAIN);
+    } catch (const std::invalid_argument &) {
+        rejected = true;
+    }
+    if (!rejected) {
+        std::printf("select_chip accepted a chip past the longest chain: FAIL\n");
+    }
+    return ok && rejected;
+}
+
+void benchmark() {
+    std::mt19937 rng(3);
+    std::vector<sample> samples = make_samples(1 << 20);
+
+    struct run {
+        const char *name;
+        kind k;
+        size_t batch;
+    };
+    const run runs[] = {
+        {"arduino 37B", kind::arduino, 1},
+        {"single", kind::single, 1},
+        {"batch x16", kind::batch, 16},
+        {"batch x32", kind::batch, 32},
+        {"compressed x16", kind::compressed, 16},
+    };
+
+    const size_t capacity = 8192;
+    std::vector<int32_t> channels(capacity * kChannels);
+    std::vector<uint32_t> numbers(capacity);
+    std::vector<uint64_t> times(capacity);
+    cerelog::sample_block out;
+    out.channels = channels.data();
+    out.sample_number = numbers.data();
+    out.timestamp_ns = times.data();
+    out.capacity = capacity;
+
+    std::printf("\n%-16s %12s %14s %12s\n", "stream", "MB/s", "packets/s", "samples/s");
+    for (const run &r : runs) {
+        stream s = build(samples, {r.k}, r.batch, rng);
+        double best = 1e30;
+        uint64_t total = 0;
+        for (int rep = 0; rep < 5; rep++) {
+            cerelog::stream_decoder decoder;
+            auto start = std::chrono::steady_clock::now();
+            for (size_t pos = 0; pos < s.bytes.size();) {
+                size_t chunk = std::min<size_t>(4096, s.bytes.size() - pos);
+                size_t consumed = 0;
+                decoder.decode(s.bytes.data() + pos, chunk, out, &consumed);
+                pos += consumed;
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            best = std::min(best, seconds);
+            total = decoder.stats().samples;
+        }
+        std::printf("%-16s %12.1f %14.0f %12.0f\n", r.name, double(s.bytes.size()) / best / 1e6,
+                    double(s.packets.size()) / best, double(total) / best);
+    }
+
+    // 32 channels from four chained chips, all decoded, one chip handed over
+    for (bool compress : {false, true}) {
+        const size_t chips = ADS1299_MAX_CHAIN, batch = 16;
+        std::vector<uint8_t> bytes;
+        for (size_t first = 0; first + batch * chips <= samples.size(); first += batch * chips) {
+            append_chain_batch(bytes, samples.data() + first, batch, chips, uint32_t(1 + first / chips), compress);
+        }
+        double best = 1e30;
+        uint64_t total = 0, packets = 0;
+        for (int rep = 0; rep < 5; rep++) {
+            cerelog::stream_decoder decoder;
+            auto start = std::chrono::steady_clock::now();
+            for (size_t pos = 0; pos < bytes.size();) {
+                size_t chunk = std::min<size_t>(4096, bytes.size() - pos);
+                size_t consumed = 0;
+                decoder.decode(bytes.data() + pos, chunk, out, &consumed);
+                pos += consumed;
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            best = std::min(best, seconds);
+            total = decoder.stats().samples;
+            packets = decoder.stats().chained_packets;
+        }
+        std::printf("%-16s %12.1f %14.0f %12.0f\n", compress ? "32ch compr. x16" : "32ch batch x16",
+                    double(bytes.size()) / best / 1e6, double(packets) / best, double(total) / best);
+    }
+}
+
+} // namespace
+
+int main() {
+    bool ok = check();
+    ok = check_chain() && ok;
+    std::printf("%s\n", ok ? "Decoder recovered every intact packet" : "Decoder check FAILED");
+    benchmark();
+    return ok ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,323 @@
+// Correctness check and throughput benchmark for the chunked recording format.
+//
+//   recording_bench [scratch file, default recording_bench.crec]
+//
+// Checks, each failing the exit status:
+//   - a recording written in random block sizes reads back exactly: codes,
+//     status, timestamps, and a sequence that unwraps the 32-bit sample
+//     number, keeps the device's gaps and carries on over a restart;
+//   - random ranges read the same as the whole, and finding a sequence or
+//     a time agrees with a linear search;
+//   - a copy taken while the writer was still open, with no footer, opens
+//     with every sample up to the last flush;
+//   - with the footer cut off, or a damaged index, every sample is still
+//     there; with the last chunk's data damaged, the full chunks before it.
+//
+// The benchmark records a minute of 8 channels at 16 kSPS, the fastest
+// ADS1299 rate, in the 64-sample batches the decoder hands out, and
+// reports the write rate against the link's, then times reading it back
+// whole and in random one-second ranges.
+
+#include "recording.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using cerelog::kChannels;
+using cerelog::recording_config;
+using cerelog::recording_reader;
+using cerelog::recording_writer;
+using cerelog::sample_block;
+
+// Known samples in the decoder's output layout, with the sequence each should get
+struct samples {
+    std::vector<int32_t> channels;
+    std::vector<uint32_t> number;
+    std::vector<uint64_t> timestamp;
+    std::vector<uint32_t> status;
+    std::vector<uint64_t> sequence;
+
+    size_t size() const { return number.size(); }
+
+    sample_block block(size_t first) {
+        sample_block b;
+        b.channels = channels.data() + first * kChannels;
+        b.sample_number = number.data() + first;
+        b.timestamp_ns = timestamp.data() + first;
+        b.status = status.data() + first;
+        b.capacity = size() - first;
+        return b;
+    }
+};
+
+int32_t code(size_t i, size_t ch) {
+    uint32_t h = uint32_t(i * kChannels + ch) * 0x9E3779B1U;
+    h ^= h >> 15;
+    return int32_t(h << 8) >> 8;
+}
+
+/* Counts up from just below the 32-bit wrap, skips a few numbers now and
+   then, and restarts from 1 two thirds of the way through */
+samples make_samples(size_t count) {
+    samples s;
+    uint32_t number = 0xFFFFF000U;
+    uint64_t sequence = number;
+    for (size_t i = 0; i < count; i++) {
+        if (i == count * 2 / 3) {
+            number = 1;
+            sequence++;
+        } else if (i && i % 10007 == 0) {
+            number += 4;
+            sequence += 4;
+        } else if (i) {
+            number++;
+            sequence++;
+        }
+        for (size_t ch = 0; ch < kChannels; ch++) {
+            s.channels.push_back(i % 997 == 0 ? (ch & 1 ? 0x7FFFFF : -0x800000) : code(i, ch));
+        }
+        s.number.push_back(number);
+        // 16 kSPS, stamped per batch of 16 as the firmware does
+        s.timestamp.push_back(1000000000ULL + i / 16 * 16 * 62500);
+        s.status.push_back(0xC00000U | uint32_t(i & 0xFFFFF));
+        s.sequence.push_back(sequence);
+    }
+    return s;
+}
+
+void write_recording(const std::string &path, samples &s, const recording_config &config, std::mt19937 &rng) {
+    recording_writer writer(path, config);
+    for (size_t done = 0; done < s.size();) {
+        size_t n = std::min<size_t>(s.size() - done, rng() % 300);
+        writer.append(s.block(done), n);
+        done += n;
+    }
+    writer.close();
+}
+
+std::vector<uint8_t> load(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void save(const std::string &path, const std::vector<uint8_t> &bytes, size_t length) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(bytes.data()), std::streamsize(length));
+}
+
+// Compares reader[position, position + count) with s; returns mismatching samples
+size_t compare(const recording_reader &reader, const samples &s, uint64_t position, size_t count) {
+    std::vector<int32_t> channels(count * kChannels);
+    std::vector<uint32_t> number(count), status(count);
+    std::vector<uint64_t> timestamp(count), sequence(count);
+    sample_block out;
+    out.channels = channels.data();
+    out.sample_number = number.data();
+    out.timestamp_ns = timestamp.data();
+    out.status = status.data();
+    out.capacity = count;
+
+    size_t n = reader.read(position, count, out, sequence.data());
+    size_t bad = n == count ? 0 : count;
+    for (size_t i = 0; i < n; i++) {
+        size_t j = size_t(position) + i;
+        if (std::memcmp(&channels[i * kChannels], &s.channels[j * kChannels], kChannels * sizeof(int32_t)) ||
+            number[i] != uint32_t(s.sequence[j]) || timestamp[i] != s.timestamp[j] ||
+            status[i] != s.status[j] || sequence[i] != s.sequence[j]) {
+            bad++;
+        }
+    }
+    return bad;
+}
+
+size_t check_round_trip(const std::string &path) {
+    std::mt19937 rng(1);
+    samples s = make_samples(100000);
+    recording_config config;
+    config.chunk_samples = 1000;
+    write_recording(path, s, config, rng);
+
+    recording_reader reader(path);
+    size_t failures = 0;
+    size_t bad = compare(reader, s, 0, s.size());
+    std::printf("  round trip: %llu samples in %zu chunks, %zu differ, footer %s\n",
+                (unsigned long long)reader.size(), reader.chunks(), bad, reader.recovered() ? "missing" : "used");
+    if (reader.size() != s.size() || bad || reader.recovered()) {
+        std::printf("  FAIL recording does not read back as written\n");
+        failures++;
+    }
+
+    // The raw frames are the ADS1299's own layout: status, then big-endian channels
+    size_t frame_count = 0;
+    const uint8_t *frames = reader.frames(1500, &frame_count);
+    int32_t ch3 = int32_t(uint32_t(frames[12]) << 24 | uint32_t(frames[13]) << 16 | uint32_t(frames[14]) << 8) >> 8;
+    if (frame_count != 500 || ch3 != s.channels[1500 * kChannels + 3]) {
+        std::printf("  FAIL raw frame access\n");
+        failures++;
+    }
+
+    size_t bad_ranges = 0, bad_finds = 0;
+    for (int k = 0; k < 2000; k++) {
+        uint64_t position = rng() % (s.size() + 10);
+        size_t count = 1 + rng() % 3000;
+        size_t expected = position >= s.size() ? 0 : std::min<size_t>(count, s.size() - size_t(position));
+        bad_ranges += compare(reader, s, position, expected) != 0;
+
+        uint64_t sequence = s.sequence[0] + rng() % (s.sequence.back() - s.sequence[0] + 2);
+        uint64_t time = s.timestamp[0] - 5 + rng() % (s.timestamp.back() - s.timestamp[0] + 10);
+        uint64_t by_sequence = uint64_t(std::lower_bound(s.sequence.begin(), s.sequence.end(), sequence) -
+                                        s.sequence.begin());
+        uint64_t by_time = uint64_t(std::lower_bound(s.timestamp.begin(), s.timestamp.end(), time) -
+                                    s.timestamp.begin());
+        bad_finds += reader.find_sequence(sequence) != by_sequence || reader.find_time(time) != by_time;
+    }
+    std::printf("  2000 random ranges: %zu differ; sequence and time lookups: %zu wrong\n", bad_ranges, bad_finds);
+    if (bad_ranges || bad_finds) {
+        std::printf("  FAIL random access\n");
+        failures++;
+    }
+    return failures;
+}
+
+size_t check_recovery(const std::string &path) {
+    std::string copy = path + ".copy";
+    samples s = make_samples(25000);
+    recording_config config;
+    config.chunk_samples = 4096;
+    config.flush_samples = 250;
+    size_t failures = 0;
+
+    // An interrupted recording: the file as it stands after 21200 samples, appended 100 at a time
+    const size_t appended = 21200;
+    {
+        recording_writer writer(path, config);
+        for (size_t done = 0; done < appended; done += 100) {
+            writer.append(s.block(done), 100);
+        }
+        std::vector<uint8_t> bytes = load(path);
+        save(copy, bytes, bytes.size());
+    }
+    {
+        recording_reader reader(copy);
+        bool ok = reader.recovered() && reader.size() + config.flush_samples >= appended &&
+                  reader.size() <= appended && compare(reader, s, 0, size_t(reader.size())) == 0;
+        std::printf("  writer still open: %llu of %zu samples readable, flushing every %zu\n",
+                    (unsigned long long)reader.size(), appended, config.flush_samples);
+        if (!ok) {
+            std::printf("  FAIL interrupted recording\n");
+            failures++;
+        }
+    }
+
+    std::mt19937 rng(2);
+    write_recording(path, s, config, rng);
+    std::vector<uint8_t> whole = load(path);
+    size_t full_chunks = s.size() / config.chunk_samples;
+
+    struct damage {
+        const char *name;
+        size_t length;
+        size_t offset;                  // Byte flipped, SIZE_MAX for none
+        size_t expected;
+    };
+    size_t last_chunk = cerelog::kRecordingHeaderBytes + full_chunks * size_t(recording_reader(path).header().chunk_bytes);
+    const damage cases[] = {
+        {"footer cut off", whole.size() - 20, SIZE_MAX, s.size()},
+        {"index damaged", whole.size(), whole.size() - 40, s.size()},
+        {"last chunk damaged", whole.size() - 20, last_chunk + 100, full_chunks * config.chunk_samples},
+        {"last chunk cut short", last_chunk + 2000, SIZE_MAX, full_chunks * config.chunk_samples},
+    };
+    for (const damage &d : cases) {
+        std::vector<uint8_t> bytes = whole;
+        if (d.offset != SIZE_MAX) {
+            bytes[d.offset] ^= 0x10;
+        }
+        save(copy, bytes, d.length);
+        recording_reader reader(copy);
+        bool ok = reader.recovered() && reader.size() == d.expected &&
+                  compare(reader, s, 0, size_t(reader.size())) == 0;
+        std::printf("  %s: %llu of %zu samples recovered\n", d.name, (unsigned long long)reader.size(), s.size());
+        if (!ok) {
+            std::printf("  FAIL %s, expected %zu samples\n", d.name, d.expected);
+            failures++;
+        }
+    }
+
+    std::remove(copy.c_str());
+    return failures;
+}
+
+void benchmark(const std::string &path) {
+    const double rate = 16000.0, seconds = 60.0;
+    const size_t batch = 64;
+    size_t count = size_t(rate * seconds);
+    samples s = make_samples(count);
+
+    recording_config config;
+    config.sample_rate_hz = rate;
+    config.flush_samples = size_t(rate / 4);
+    auto start = std::chrono::steady_clock::now();
+    uint64_t bytes = 0;
+    {
+        recording_writer writer(path, config);
+        for (size_t done = 0; done < count; done += batch) {
+            writer.append(s.block(done), std::min(batch, count - done));
+        }
+        writer.close();
+        bytes = writer.bytes_written();
+    }
+    double write_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // The 0xAA 0x55 single-sample packet, the link's least compact format, at this rate
+    double link_bytes_per_s = rate * double(PACKET_OVERHEAD + ADS1299_TOTAL_DATA_BYTES);
+    std::printf("\n%.0f s of %zu channels at %.0f SPS in %zu-sample batches, flushed every %zu samples:\n", seconds,
+                kChannels, rate, batch, config.flush_samples);
+    std::printf("  write: %.1f MB in %.3f s, %.0f MB/s, %.0fx the link's %.2f MB/s of single-sample packets\n",
+                double(bytes) / 1e6, write_s, double(bytes) / write_s / 1e6, double(bytes) / write_s / link_bytes_per_s,
+                link_bytes_per_s / 1e6);
+    std::printf("         %.0fx real time, %.1f bytes per sample on disk\n", seconds / write_s, double(bytes) / count);
+
+    recording_reader reader(path);
+    std::vector<int32_t> channels(count * kChannels);
+    std::vector<uint64_t> timestamp(count);
+    sample_block out;
+    out.channels = channels.data();
+    out.timestamp_ns = timestamp.data();
+    out.capacity = count;
+    start = std::chrono::steady_clock::now();
+    size_t n = reader.read(0, count, out);
+    double read_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::printf("  read whole: %zu samples in %.3f s, %.3g samples/s\n", n, read_s, double(n) / read_s);
+
+    std::mt19937 rng(3);
+    const int ranges = 1000;
+    size_t second = size_t(rate);
+    start = std::chrono::steady_clock::now();
+    for (int k = 0; k < ranges; k++) {
+        uint64_t t = s.timestamp[rng() % (count - second)];
+        reader.read(reader.find_time(t), second, out);
+    }
+    double range_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::printf("  %d random 1 s ranges by time: %.1f us each\n", ranges, range_s / ranges * 1e6);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::string path = argc > 1 ? argv[1] : "recording_bench.crec";
+    size_t failures = check_round_trip(path) + check_recovery(path);
+    std::printf("%s\n", failures ? "Recording check FAILED" : "Recordings read back exactly and survive damage");
+    benchmark(path);
+    std::remove(path.c_str());
+    return failures ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,401 @@
+// Sample-gap recovery check for gap_recovery against a model of the
+// firmware's retransmit window (retransmit.c).
+//
+//   recovery_check
+//
+// A simulated board sends packed batches of 16 samples, one a millisecond,
+// over a link that damages a share of them. Like the firmware it keeps the
+// last packets sent, reads CMD_RESEND frames coming back after a few
+// packets of round trip, and resends at most one held packet per live one.
+// Some of the host's requests are damaged on the way too, so retries are
+// needed.
+//
+// At each loss rate the host (stream_decoder, then gap_recovery) must pass
+// on every sample in order, once and unchanged, except those it gave up
+// on; at 1% packet loss or less it may give up on none. An outage longer
+// than the window must be given up on, with the stream carrying on after
+// it, and a device restart must be followed. Last, the cost of
+// gap_recovery on a clean stream is timed. The exit status is non-zero if
+// any check fails.
+
+#include "command.h"
+#include "gap_recovery.h"
+#include "packet_crc.h"
+#include "stream_decoder.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using cerelog::kChannels;
+
+constexpr size_t kBatch = 16;
+// About what the firmware's 64 KiB window holds of 16-sample packed batches
+constexpr size_t kWindowPackets = 160;
+constexpr size_t kRequestQueue = 16;
+constexpr int kResendCreditMax = 4;
+// Packets sent while a request crosses the link and the command thread polls
+constexpr size_t kRoundTripPackets = 4;
+
+// Channel codes are a function of the sample number, so any sample can be checked on its own
+int32_t channel_value(uint32_t number, size_t ch) {
+    return int32_t((number * 2654435761u + uint32_t(ch) * 40503u) & 0xFFFFFF) - 0x800000;
+}
+
+void put_be24(std::vector<uint8_t> &out, int32_t value) {
+    out.push_back(uint8_t(uint32_t(value) >> 16));
+    out.push_back(uint8_t(uint32_t(value) >> 8));
+    out.push_back(uint8_t(value));
+}
+
+std::vector<uint8_t> make_batch(uint32_t first, size_t count) {
+    std::vector<uint8_t> out;
+    ads1299_batch_header_t header = {};
+    header.start_bytes[0] = PACKET_START_BYTE1;
+    header.start_bytes[1] = PACKET_START_BYTE2;
+    header.packet_type = PACKET_TYPE_ADS1299_BATCH;
+    header.sample_count = uint8_t(count);
+    header.timestamp_ns = uint64_t(first) * 4000000;
+    header.sample_number = first;
+    header.status[0] = 0xC0;
+    const uint8_t *h = reinterpret_cast<const uint8_t *>(&header);
+    out.insert(out.end(), h, h + sizeof(header));
+    for (size_t i = 0; i < count; i++) {
+        for (size_t ch = 0; ch < kChannels; ch++) {
+            put_be24(out, channel_value(first + uint32_t(i), ch));
+        }
+    }
+    uint16_t crc = packet_crc_compute(out.data(), out.size());
+    out.push_back(uint8_t(crc));
+    out.push_back(uint8_t(crc >> 8));
+    out.push_back(PACKET_END_BYTE1);
+    out.push_back(PACKET_END_BYTE2);
+    return out;
+}
+
+// The firmware's transmission and command threads as far as resending goes
+class model_device {
+public:
+    uint32_t resent = 0;
+    uint32_t missed = 0;
+    uint32_t dropped = 0;
+    uint64_t live_samples = 0;
+
+    // Appends the next live packet, if live, then a resend if one is due
+    void send(bool live, std::vector<std::vector<uint8_t>> &packets) {
+        if (live) {
+            std::vector<uint8_t> packet = make_batch(next_number_, kBatch);
+            window_.push_back(stored{next_number_, packet});
+            if (window_.size() > kWindowPackets) {
+                window_.pop_front();
+            }
+            packets.push_back(packet);
+            next_number_ += kBatch;
+            live_samples += kBatch;
+            credit_ = std::min(credit_ + 1, kResendCreditMax);
+        } else {
+            credit_ = std::max(credit_, 1);
+        }
+        const std::vector<uint8_t> *resend = credit_ ? next_resend() : nullptr;
+        if (resend) {
+            credit_--;
+            resent++;
+            packets.push_back(*resend);
+        }
+    }
+
+    // Command bytes from the host, possibly damaged
+    void receive(const uint8_t *data, size_t length) {
+        commands_.insert(commands_.end(), data, data + length);
+        while (commands_.size() >= 4) {
+            size_t length_byte = commands_[3];
+            if (commands_[0] != PACKET_START_BYTE1 || commands_[1] != PACKET_START_BYTE2 ||
+                commands_[2] != PACKET_TYPE_COMMAND || length_byte == 0 || length_byte > COMMAND_MAX_PAYLOAD) {
+                commands_.erase(commands_.begin());
+                continue;
+            }
+            size_t frame_length = length_byte + COMMAND_OVERHEAD;
+            if (commands_.size() < frame_length) {
+                break;
+            }
+            std::vector<uint8_t> frame(commands_.begin(), commands_.begin() + frame_length);
+            uint16_t crc = uint16_t(frame[4 + length_byte] | frame[5 + length_byte] << 8);
+            if (packet_crc_compute(frame.data(), 4 + length_byte) != crc ||
+                frame[6 + length_byte] != PACKET_END_BYTE1 || frame[7 + length_byte] != PACKET_END_BYTE2) {
+                commands_.erase(commands_.begin());
+                continue;
+            }
+            commands_.erase(commands_.begin(), commands_.begin() + frame_length);
+            if (frame[4] != CMD_RESEND) {
+                continue;
+            }
+            for (size_t i = 5; i + RESEND_RANGE_SIZE <= 4 + length_byte; i += RESEND_RANGE_SIZE) {
+                const uint8_t *r = &frame[i];
+                range request = {uint32_t(r[0] | r[1] << 8 | r[2] << 16 | uint32_t(r[3]) << 24),
+                                 uint32_t(r[4] | r[5] << 8)};
+                if (queue_.size() == kRequestQueue) {
+                    dropped++;
+                } else if (request.count) {
+                    queue_.push_back(request);
+                }
+            }
+        }
+    }
+
+    void restart() {
+        next_number_ = 1;
+        window_.clear();
+        queue_.clear();
+        current_.count = 0;
+    }
+
+private:
+    struct stored {
+        uint32_t first;
+        std::vector<uint8_t> bytes;
+    };
+    struct range {
+        uint32_t first;
+        uint32_t count;
+    };
+
+    // retransmit_next(): the oldest held packet reaching past the start of the range
+    const std::vector<uint8_t> *next_resend() {
+        while (true) {
+            if (current_.count == 0) {
+                if (queue_.empty()) {
+                    return nullptr;
+                }
+                current_ = queue_.front();
+                queue_.pop_front();
+            }
+            size_t i = 0;
+            while (i < window_.size() && int32_t(window_[i].first + kBatch - current_.first) <= 0) {
+                i++;
+            }
+            int32_t before = i < window_.size() ? int32_t(window_[i].first - current_.first) : INT32_MAX;
+            if (before >= int32_t(current_.count)) {
+                missed += current_.count;
+                current_.count = 0;
+                continue;
+            }
+            if (before > 0) {
+                missed += uint32_t(before);
+            }
+            uint32_t end = window_[i].first + kBatch;
+            uint32_t covered = end - current_.first;
+            current_.count = covered >= current_.count ? 0 : current_.count - covered;
+            current_.first = end;
+            return &window_[i].bytes;
+        }
+    }
+
+    uint32_t next_number_ = 1000;
+    std::deque<stored> window_;
+    std::deque<range> queue_;
+    range current_ = {0, 0};
+    int credit_ = 0;
+    std::vector<uint8_t> commands_;
+};
+
+struct scenario {
+    const char *name;
+    size_t packets;
+    double loss;                    // Share of data packets damaged
+    double command_loss;            // Share of request frames damaged
+    size_t outage_start = 0;        // Packets in [start, end) all damaged
+    size_t outage_end = 0;
+    size_t restart_at = 0;          // Packet index the device restarts at, 0 for never
+};
+
+struct outcome {
+    uint64_t sent = 0;
+    uint64_t passed = 0;
+    uint64_t wrong = 0;             // Out of order, repeated or changed
+    cerelog::recovery_stats recovery;
+    cerelog::decoder_stats decoder;
+    uint32_t resent = 0;
+    uint32_t missed = 0;
+};
+
+outcome run(const scenario &sc) {
+    std::mt19937 rng(23);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    model_device device;
+    cerelog::stream_decoder decoder;
+    cerelog::gap_recovery recovery(std::chrono::milliseconds(150), std::chrono::milliseconds(20));
+
+    std::vector<int32_t> channels(cerelog::kMaxPacketSamples * 4 * kChannels);
+    std::vector<uint32_t> numbers(cerelog::kMaxPacketSamples * 4);
+    std::vector<uint64_t> times(numbers.size());
+    cerelog::sample_block block{channels.data(), numbers.data(), times.data(), nullptr, numbers.size()};
+    std::vector<int32_t> out_channels(channels.size());
+    std::vector<uint32_t> out_numbers(numbers.size());
+    cerelog::sample_block out{out_channels.data(), out_numbers.data(), nullptr, nullptr, out_numbers.size()};
+
+    outcome result;
+    std::deque<std::pair<size_t, std::vector<uint8_t>>> in_flight;
+    bool have_last = false;
+    uint32_t last = 0;
+
+    auto take_output = [&]() {
+        size_t n;
+        std::vector<uint8_t> requests;
+        while ((n = recovery.pop(out, requests)) > 0) {
+            for (size_t i = 0; i < n; i++) {
+                uint32_t number = out_numbers[i];
+                // Only a restart may send the numbers back
+                bool in_order = !have_last || int32_t(number - last) > 0 || number == 1;
+                bool exact = true;
+                for (size_t ch = 0; ch < kChannels; ch++) {
+                    exact = exact && out_channels[i * kChannels + ch] == channel_value(number, ch);
+                }
+                result.wrong += !in_order || !exact;
+                have_last = true;
+                last = number;
+            }
+            result.passed += n;
+        }
+        return requests;
+    };
+
+    // Live packets, then quiet until nothing is left waiting
+    for (size_t step = 0; step < sc.packets + 400; step++) {
+        bool live = step < sc.packets;
+        if (live && sc.restart_at && step == sc.restart_at) {
+            device.restart();
+        }
+        std::vector<std::vector<uint8_t>> packets;
+        device.send(live, packets);
+
+        std::vector<uint8_t> link;
+        for (std::vector<uint8_t> &packet : packets) {
+            bool outage = step >= sc.outage_start && step < sc.outage_end;
+            if (outage || unit(rng) < sc.loss) {
+                packet[packet.size() / 2] ^= 0x10;
+            }
+            link.insert(link.end(), packet.begin(), packet.end());
+        }
+        for (size_t pos = 0; pos < link.size();) {
+            size_t consumed = 0;
+            size_t n = decoder.decode(link.data() + pos, link.size() - pos, block, &consumed);
+            recovery.push(block, n);
+            pos += consumed;
+        }
+
+        std::vector<uint8_t> requests = take_output();
+        if (!requests.empty()) {
+            if (unit(rng) < sc.command_loss) {
+                requests[requests.size() / 2] ^= 0x01;
+            }
+            in_flight.emplace_back(step + kRoundTripPackets, std::move(requests));
+        }
+        while (!in_flight.empty() && in_flight.front().first <= step) {
+            device.receive(in_flight.front().second.data(), in_flight.front().second.size());
+            in_flight.pop_front();
+        }
+
+        if (!live && recovery.held() == 0 && in_flight.empty()) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    recovery.flush();
+    take_output();
+
+    result.sent = device.live_samples;
+    result.recovery = recovery.stats();
+    result.decoder = decoder.stats();
+    result.resent = device.resent;
+    result.missed = device.missed;
+    return result;
+}
+
+bool check() {
+    const scenario scenarios[] = {
+        {"clean", 1000, 0.0, 0.0},
+        {"0.1% loss", 1500, 0.001, 0.05},
+        {"1% loss", 1500, 0.01, 0.05},
+        {"5% loss", 1500, 0.05, 0.05},
+        {"300-packet outage", 1500, 0.0, 0.0, 500, 800},
+        {"device restart", 1000, 0.001, 0.0, 0, 0, 600},
+    };
+    bool ok = true;
+
+    std::printf("%-18s %9s %9s %6s %9s %6s %8s %6s %7s %9s\n", "scenario", "sent", "passed", "gaps", "recovered",
+                "lost", "requests", "dups", "resent", "recovery");
+    for (const scenario &sc : scenarios) {
+        outcome r = run(sc);
+        const cerelog::recovery_stats &st = r.recovery;
+        uint64_t damaged = st.recovered + st.lost;
+        std::printf("%-18s %9llu %9llu %6llu %9llu %6llu %8llu %6llu %7u %8.2f%%\n", sc.name,
+                    (unsigned long long)r.sent, (unsigned long long)r.passed, (unsigned long long)st.gaps,
+                    (unsigned long long)st.recovered, (unsigned long long)st.lost, (unsigned long long)st.requests,
+                    (unsigned long long)st.duplicates, r.resent, damaged ? 100.0 * st.recovered / damaged : 100.0);
+
+        // Every sample sent comes out once, or is counted as given up on
+        bool pass = r.wrong == 0 && r.passed + st.lost == r.sent && r.passed == st.samples;
+        if (sc.loss <= 0.01 && !sc.outage_end) {
+            pass = pass && st.lost == 0;
+        }
+        if (sc.loss > 0) {
+            // Resent packets reach the decoder behind the stream, not as a restart
+            pass = pass && st.recovered > 0 && r.decoder.resent_samples > 0;
+        }
+        if (sc.outage_end) {
+            pass = pass && st.lost > 0 && r.missed > 0 && st.recovered > 0;
+        }
+        if (sc.restart_at) {
+            pass = pass && st.restarts == 1;
+        }
+        if (!pass) {
+            std::printf("  %s: %llu out of order or changed, %llu passed + %llu lost of %llu sent\n", sc.name,
+                        (unsigned long long)r.wrong, (unsigned long long)r.passed, (unsigned long long)st.lost,
+                        (unsigned long long)r.sent);
+        }
+        ok = ok && pass;
+    }
+    return ok;
+}
+
+// Cost of gap_recovery on a clean stream, in blocks of one batch
+void bench() {
+    constexpr size_t kSamples = 4 << 20;
+    std::vector<int32_t> channels(kBatch * kChannels, 1);
+    std::vector<uint32_t> numbers(kBatch);
+    std::vector<uint64_t> times(kBatch);
+    cerelog::sample_block in{channels.data(), numbers.data(), times.data(), nullptr, kBatch};
+    std::vector<int32_t> out_channels(kBatch * kChannels);
+    std::vector<uint32_t> out_numbers(kBatch);
+    cerelog::sample_block out{out_channels.data(), out_numbers.data(), nullptr, nullptr, kBatch};
+    std::vector<uint8_t> requests;
+
+    cerelog::gap_recovery recovery;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t n = 0; n < kSamples; n += kBatch) {
+        for (size_t i = 0; i < kBatch; i++) {
+            numbers[i] = uint32_t(n + i + 1);
+        }
+        recovery.push(in, kBatch);
+        recovery.pop(out, requests);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::printf("\nClean stream: %.1f ns/sample, %.1f M samples/s through gap_recovery\n",
+                seconds * 1e9 / kSamples, kSamples / seconds / 1e6);
+}
+
+} // namespace
+
+int main() {
+    bool ok = check();
+    bench();
+    std::printf("%s\n", ok ? "Every sample recovered, or given up on and counted" : "Recovery check FAILED");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
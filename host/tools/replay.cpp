@@ -0,0 +1,253 @@
+// Offline replay of a recorded stream through the host pipeline.
+//
+//   replay [options] capture.bin|recording.csv
+//   replay [--seconds S]                  synthetic benchmark at every data rate
+//
+//   --rate HZ        sample rate of the stream (250)
+//   --speed X        release samples at X times real time; 0, the default, is as fast as possible
+//   --mains HZ       notch frequency, 0 for none (60)
+//   --record PATH    also write the samples to a chunked recording
+//   --read BYTES     capture bytes per decoder call, as one serial read (4096)
+//   --csv            read the file as CSV whatever its name; files ending .csv always are
+//   --no-filter, --no-spectral
+//
+// Captures are raw serial bytes (e.g. `cat /dev/ttyUSB0 > capture.bin`),
+// in any mix the stream decoder accepts; CSV follows codec_corpus. The
+// samples go through decode, scaling, the filter bank, the Welch spectral
+// engine and the recorder as python_viz.py runs them on a live port, and
+// the report gives each stage's time, samples per second and how many
+// times faster than real time the whole run was, then the last band power
+// of each channel.
+//
+// Without a file, a synthetic capture of batched packets is built for each
+// ADS1299 data rate, S seconds long (an hour by default, capped at 2^21
+// samples), and replayed as fast as possible: a repeatable throughput
+// benchmark of the whole pipeline.
+
+#include "packet_crc.h"
+#include "replay.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using cerelog::capture_source;
+using cerelog::csv_source;
+using cerelog::kBandCount;
+using cerelog::kBandEdges;
+using cerelog::kChannels;
+using cerelog::kReplayStageCount;
+using cerelog::kReplayStageNames;
+using cerelog::replay_config;
+using cerelog::replay_engine;
+using cerelog::replay_report;
+
+constexpr double kPi = 3.14159265358979323846;
+
+void print_report(const replay_report &r, double sample_rate_hz) {
+    double stages = 0.0;
+    for (double s : r.stage_seconds) {
+        stages += s;
+    }
+    std::printf("%-10s %10s %8s %12s\n", "stage", "seconds", "share", "ns/sample");
+    for (size_t s = 0; s < kReplayStageCount; s++) {
+        std::printf("%-10s %10.4f %7.1f%% %12.1f\n", kReplayStageNames[s], r.stage_seconds[s],
+                    stages > 0.0 ? 100.0 * r.stage_seconds[s] / stages : 0.0,
+                    r.samples ? r.stage_seconds[s] * 1e9 / double(r.samples) : 0.0);
+    }
+    double stream = r.stream_seconds(sample_rate_hz);
+    std::printf("%llu samples (%.1f s of stream, %.1f MB in) in %.3f s: %.3g samples/s, %.0fx real time\n",
+                (unsigned long long)r.samples, stream, double(r.input_bytes) / 1e6, r.wall_seconds,
+                double(r.samples) / r.wall_seconds, stream / r.wall_seconds);
+}
+
+void print_band_power(const replay_report &r) {
+    if (!r.spectral_frames) {
+        return;
+    }
+    std::printf("\nLast band power, uV^2 (%llu estimates):\n%4s", (unsigned long long)r.spectral_frames, "ch");
+    for (size_t b = 0; b < kBandCount; b++) {
+        std::printf(" %10s", kBandEdges[b].name);
+    }
+    std::printf("\n");
+    for (size_t ch = 0; ch < kChannels; ch++) {
+        std::printf("%4zu", ch + 1);
+        for (size_t b = 0; b < kBandCount; b++) {
+            std::printf(" %10.3g", r.band_power[ch][b]);
+        }
+        std::printf("\n");
+    }
+}
+
+// About a second per segment at any rate, 75% overlap: 256 and 64 at 250 SPS, as python_viz.py
+void size_spectral(replay_config &config) {
+    config.fft_size = 16;
+    while (double(config.fft_size) < config.sample_rate_hz) {
+        config.fft_size *= 2;
+    }
+    config.hop = config.fft_size / 4;
+}
+
+void put_be24(std::vector<uint8_t> &out, int32_t value) {
+    out.push_back(uint8_t(uint32_t(value) >> 16));
+    out.push_back(uint8_t(uint32_t(value) >> 8));
+    out.push_back(uint8_t(value));
+}
+
+/* Packed batches of 16, as the firmware sends by default: alpha and
+   mains on every channel over noise and an electrode offset */
+std::vector<uint8_t> synthetic_capture(double rate, size_t count) {
+    const size_t batch = 16;
+    std::mt19937 rng(5);
+    std::normal_distribution<double> noise(0.0, 200.0);
+    std::vector<uint8_t> out;
+    out.reserve(count / batch * BATCH_PACKET_SIZE(batch) + BATCH_PACKET_SIZE(batch));
+    double phase_sin[kChannels], phase_cos[kChannels];
+    for (size_t ch = 0; ch < kChannels; ch++) {
+        phase_sin[ch] = std::sin(double(ch));
+        phase_cos[ch] = std::cos(double(ch));
+    }
+
+    for (size_t first = 0; first < count; first += batch) {
+        size_t n = std::min(batch, count - first);
+        size_t start = out.size();
+        ads1299_batch_header_t header = {};
+        header.start_bytes[0] = PACKET_START_BYTE1;
+        header.start_bytes[1] = PACKET_START_BYTE2;
+        header.packet_type = PACKET_TYPE_ADS1299_BATCH;
+        header.sample_count = uint8_t(n);
+        header.timestamp_ns = uint64_t(double(first) * 1e9 / rate);
+        header.sample_number = uint32_t(first + 1);
+        header.status[0] = 0xC0;
+        const uint8_t *h = reinterpret_cast<const uint8_t *>(&header);
+        out.insert(out.end(), h, h + sizeof(header));
+
+        for (size_t i = first; i < first + n; i++) {
+            double t = double(i) / rate;
+            double alpha_sin = std::sin(2.0 * kPi * 10.0 * t), alpha_cos = std::cos(2.0 * kPi * 10.0 * t);
+            double mains = 5000.0 * std::sin(2.0 * kPi * 60.0 * t);
+            for (size_t ch = 0; ch < kChannels; ch++) {
+                // Alpha shifted by ch radians on channel ch
+                double alpha = alpha_sin * phase_cos[ch] + alpha_cos * phase_sin[ch];
+                double v = 20000.0 * alpha + mains + noise(rng) + 100000.0 * double(ch);
+                put_be24(out, int32_t(v));
+            }
+        }
+        uint16_t crc = packet_crc_compute(out.data() + start, out.size() - start);
+        out.push_back(uint8_t(crc));
+        out.push_back(uint8_t(crc >> 8));
+        out.push_back(PACKET_END_BYTE1);
+        out.push_back(PACKET_END_BYTE2);
+    }
+    return out;
+}
+
+void benchmark(double seconds) {
+    std::printf("Synthetic batched captures, decode -> scale -> filter -> spectral, as fast as possible, one core:\n");
+    std::printf("%8s %10s %10s %10s %10s %10s %12s %12s\n", "rate", "stream s", "input", "filter", "spectral",
+                "wall s", "samples/s", "x realtime");
+    for (double rate : {250.0, 500.0, 1000.0, 2000.0, 4000.0, 8000.0, 16000.0}) {
+        size_t count = std::min<size_t>(size_t(seconds * rate), size_t(1) << 21);
+        replay_config config;
+        config.sample_rate_hz = rate;
+        size_spectral(config);
+        replay_engine engine(config);
+        capture_source source(synthetic_capture(rate, count));
+        replay_report r = engine.run(source);
+
+        auto ns = [&](cerelog::replay_stage s) { return r.stage_seconds[size_t(s)] * 1e9 / double(r.samples); };
+        double stream = r.stream_seconds(rate);
+        std::printf("%8.0f %10.0f %8.1fns %8.1fns %8.1fns %10.3f %12.3g %12.0f\n", rate, stream,
+                    ns(cerelog::replay_stage::input), ns(cerelog::replay_stage::filter),
+                    ns(cerelog::replay_stage::spectral), r.wall_seconds, double(r.samples) / r.wall_seconds,
+                    stream / r.wall_seconds);
+        if (r.samples != count || source.stats().bad_packets || source.stats().missing_samples) {
+            std::printf("Replay FAILED: %llu of %zu samples came through\n", (unsigned long long)r.samples, count);
+            std::exit(1);
+        }
+    }
+}
+
+bool ends_with(const std::string &s, const char *suffix) {
+    size_t n = std::strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    replay_config config;
+    std::string path;
+    bool csv = false;
+    double seconds = 3600.0;
+    size_t read_bytes = 4096;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--rate" && has_value) {
+            config.sample_rate_hz = std::atof(argv[++i]);
+        } else if (arg == "--speed" && has_value) {
+            config.speed = std::atof(argv[++i]);
+        } else if (arg == "--mains" && has_value) {
+            config.mains_hz = std::atof(argv[++i]);
+        } else if (arg == "--record" && has_value) {
+            config.record_path = argv[++i];
+        } else if (arg == "--read" && has_value) {
+            read_bytes = size_t(std::atol(argv[++i]));
+        } else if (arg == "--seconds" && has_value) {
+            seconds = std::atof(argv[++i]);
+        } else if (arg == "--csv") {
+            csv = true;
+        } else if (arg == "--no-filter") {
+            config.filter = false;
+        } else if (arg == "--no-spectral") {
+            config.spectral = false;
+        } else if (arg[0] != '-' && path.empty()) {
+            path = arg;
+        } else {
+            std::fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return 2;
+        }
+    }
+
+    if (path.empty()) {
+        benchmark(seconds);
+        return 0;
+    }
+
+    try {
+        size_spectral(config);
+        replay_engine engine(config);
+        if (csv || ends_with(path, ".csv") || ends_with(path, ".CSV")) {
+            csv_source source(path, config.uv_per_code);
+            replay_report r = engine.run(source);
+            print_report(r, config.sample_rate_hz);
+            std::printf("%llu rows skipped\n", (unsigned long long)source.bad_rows());
+            print_band_power(r);
+        } else {
+            capture_source source(path, read_bytes);
+            replay_report r = engine.run(source);
+            print_report(r, config.sample_rate_hz);
+            const cerelog::decoder_stats &d = source.stats();
+            std::printf("decoder: %llu batch, %llu single packets, %llu Arduino frames, %llu bad, "
+                        "%llu bytes skipped, %llu samples missing\n",
+                        (unsigned long long)d.batch_packets, (unsigned long long)d.single_packets,
+                        (unsigned long long)d.arduino_frames, (unsigned long long)d.bad_packets,
+                        (unsigned long long)d.skipped_bytes, (unsigned long long)d.missing_samples);
+            print_band_power(r);
+        }
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
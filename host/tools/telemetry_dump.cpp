@@ -0,0 +1,163 @@
+// Decoder for the firmware's telemetry packets.
+//
+//   telemetry_dump [--csv] [capture.bin]
+//
+// Reads a raw capture of the serial stream (or stdin when no file is given),
+// picks out the telemetry packets between the data packets and prints each
+// interval: pipeline counters, link use, resends and command errors, then per-stage mean, maximum and the log2
+// histogram of stage times. With --csv, writes one row per packet and stage
+// instead, for plotting. Packets with a bad CRC or trailer are counted and
+// skipped; the exit status is non-zero if any were found.
+
+#include "packet_crc.h"
+#include "telemetry_format.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+const char *const kStageNames[TELEMETRY_STAGE_COUNT] = {
+    "drdy_to_spi", "spi", "parse", "format", "uart_tx", "decimate",
+};
+
+double cycles_to_us(uint64_t cycles, uint32_t timing_hz) {
+    return timing_hz ? double(cycles) * 1e6 / timing_hz : 0.0;
+}
+
+// Share of what the baud rate allows that the UART sent, in percent
+double link_use(const telemetry_packet_t &p) {
+    return p.link_bytes_per_s && p.interval_us ? double(p.tx_bytes) * 1e8 / p.interval_us / p.link_bytes_per_s : 0.0;
+}
+
+double link_busy(const telemetry_packet_t &p) {
+    return p.interval_us ? double(p.tx_busy_us) * 100.0 / p.interval_us : 0.0;
+}
+
+void print_text(const telemetry_packet_t &p) {
+    std::printf("t=%.3f s  interval %u us  drdy %u  samples %u  missed %u  overruns %u  "
+                "ring %u/%u  spi errors %u  command crc errors %u\n"
+                "  link %u bytes  %.1f%% of %u B/s  busy %.1f%%  %u stalls  %u drops\n"
+                "  resend %u asked  %u sent  %u gone  %u dropped  command errors %u  markers dropped %u  "
+                "captures ignored %u  first sample %u us\n",
+                double(p.timestamp_ns) / 1e9, p.interval_us, p.drdy_edges, p.samples, p.missed_drdy,
+                p.ring_overruns, p.ring_high_water, p.ring_size, p.spi_errors, p.command_crc_errors,
+                p.tx_bytes, link_use(p), p.link_bytes_per_s, link_busy(p), p.tx_stalls, p.tx_drops,
+                p.resend_requests, p.resent_packets, p.resend_missed, p.resend_dropped, p.command_errors,
+                p.marker_drops, p.capture_ignored, p.first_sample_us);
+    for (int s = 0; s < TELEMETRY_STAGE_COUNT; s++) {
+        const telemetry_stage_stats_t &st = p.stages[s];
+        std::printf("  %-12s %7u  mean %9.2f us  max %9.2f us  |", kStageNames[s], st.count,
+                    st.count ? cycles_to_us(st.total_cycles, p.timing_hz) / st.count : 0.0,
+                    cycles_to_us(st.max_cycles, p.timing_hz));
+        for (int b = 0; b < TELEMETRY_HIST_BUCKETS; b++) {
+            std::printf(" %u", st.histogram[b]);
+        }
+        std::printf("\n");
+    }
+}
+
+void print_csv_header() {
+    std::printf("timestamp_ns,interval_us,drdy_edges,samples,missed_drdy,ring_overruns,tx_bytes,"
+                "ring_high_water,ring_size,spi_errors,command_crc_errors,link_bytes_per_s,link_use_pct,"
+                "link_busy_pct,tx_stalls,tx_drops,resend_requests,resent_packets,resend_missed,resend_dropped,"
+                "command_errors,marker_drops,capture_ignored,first_sample_us,stage,count,mean_us,max_us");
+    for (int b = 0; b < TELEMETRY_HIST_BUCKETS; b++) {
+        // Lower edge of the bucket in timing counter cycles
+        std::printf(",hist_%llu", 1ULL << (b + TELEMETRY_HIST_MIN_LOG2));
+    }
+    std::printf("\n");
+}
+
+void print_csv(const telemetry_packet_t &p) {
+    for (int s = 0; s < TELEMETRY_STAGE_COUNT; s++) {
+        const telemetry_stage_stats_t &st = p.stages[s];
+        std::printf("%llu,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%.2f,%.2f,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%s,%u,%.3f,%.3f",
+                    (unsigned long long)p.timestamp_ns, p.interval_us, p.drdy_edges, p.samples,
+                    p.missed_drdy, p.ring_overruns, p.tx_bytes, p.ring_high_water, p.ring_size,
+                    p.spi_errors, p.command_crc_errors, p.link_bytes_per_s, link_use(p), link_busy(p),
+                    p.tx_stalls, p.tx_drops, p.resend_requests, p.resent_packets, p.resend_missed,
+                    p.resend_dropped, p.command_errors, p.marker_drops, p.capture_ignored, p.first_sample_us,
+                    kStageNames[s], st.count,
+                    st.count ? cycles_to_us(st.total_cycles, p.timing_hz) / st.count : 0.0,
+                    cycles_to_us(st.max_cycles, p.timing_hz));
+        for (int b = 0; b < TELEMETRY_HIST_BUCKETS; b++) {
+            std::printf(",%u", st.histogram[b]);
+        }
+        std::printf("\n");
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    bool csv = false;
+    const char *path = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--csv") == 0) {
+            csv = true;
+        } else {
+            path = argv[i];
+        }
+    }
+
+    FILE *in = path ? std::fopen(path, "rb") : stdin;
+    if (!in) {
+        std::fprintf(stderr, "Cannot open %s\n", path);
+        return 2;
+    }
+
+    constexpr size_t kPacketSize = sizeof(telemetry_packet_t);
+    std::vector<uint8_t> buffer;
+    uint8_t chunk[4096];
+    size_t packets = 0, bad = 0;
+
+    if (csv) {
+        print_csv_header();
+    }
+
+    // Scan for the start bytes and telemetry type; data packets in between are skipped a byte at a time
+    size_t got;
+    while ((got = std::fread(chunk, 1, sizeof(chunk), in)) > 0) {
+        buffer.insert(buffer.end(), chunk, chunk + got);
+        size_t pos = 0;
+        while (pos + kPacketSize <= buffer.size()) {
+            const uint8_t *p = &buffer[pos];
+            if (p[0] != 0xAA || p[1] != 0x55 || p[2] != TELEMETRY_PACKET_TYPE || p[3] != TELEMETRY_STAGE_COUNT) {
+                pos++;
+                continue;
+            }
+
+            telemetry_packet_t packet;
+            std::memcpy(&packet, p, kPacketSize);
+            if (packet.crc16 != packet_crc_compute(p, offsetof(telemetry_packet_t, crc16)) ||
+                packet.end_bytes[0] != 0x55 || packet.end_bytes[1] != 0xAA) {
+                // Sample data can look like a header; only count it if the trailer is right
+                if (packet.end_bytes[0] == 0x55 && packet.end_bytes[1] == 0xAA) {
+                    bad++;
+                }
+                pos++;
+                continue;
+            }
+
+            packets++;
+            if (csv) {
+                print_csv(packet);
+            } else {
+                print_text(packet);
+            }
+            pos += kPacketSize;
+        }
+        buffer.erase(buffer.begin(), buffer.begin() + pos);
+    }
+
+    if (path) {
+        std::fclose(in);
+    }
+    std::fprintf(stderr, "%zu telemetry packets, %zu with a bad CRC\n", packets, bad);
+    return bad ? 1 : 0;
+}
\ No newline at end of file
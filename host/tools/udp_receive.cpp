@@ -0,0 +1,390 @@
+// Receives the firmware's UDP transport (CONFIG_CERELOG_TRANSPORT_UDP).
+//
+//   udp_receive --port N [options]     live: decode the stream, print its rates once a second
+//   udp_receive [--seconds S]          self-check of the reordering, then a localhost throughput run
+//
+//   --window W       datagrams held while waiting for a missing one (64)
+//   --timeout MS     longest a missing datagram is waited for (50)
+//   --seconds S      live: stop after S seconds; check: length of the throughput run (5)
+//
+// The check feeds a scripted stream to the reorder buffer: datagrams
+// dropped, swapped, delayed within the window and beyond it, duplicated,
+// held past the timeout, and a device restart. It expects each counted as
+// such, and the decoded samples in order with exactly the lost ones
+// missing. The throughput run then sends datagrams of whole 16-sample
+// batches, up to 1472 bytes, to a udp_receiver over localhost as fast as
+// the socket takes them, and reports datagrams, bytes and samples per
+// second, and the 16 kSPS streams that rate would carry. The exit status
+// is non-zero if any check fails.
+
+#include "udp_receiver.h"
+#include "packet_crc.h"
+#include "stream_decoder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+using cerelog::datagram_reorder;
+using cerelog::datagram_stats;
+using cerelog::kChannels;
+using cerelog::kMaxPacketSamples;
+using cerelog::udp_receiver;
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr size_t kBatchSamples = 16;
+constexpr size_t kPayloadSize = 1472;       // CONFIG_CERELOG_UDP_PAYLOAD_SIZE default
+
+double seconds_since(clock_type::time_point start) {
+    return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+// Decodes every whole packet in bytes, keeping a trailing partial one
+struct decoding {
+    cerelog::stream_decoder decoder;
+    std::vector<int32_t> channels = std::vector<int32_t>(kMaxPacketSamples * kChannels);
+    std::vector<uint32_t> numbers = std::vector<uint32_t>(kMaxPacketSamples);
+    std::vector<uint32_t> decoded;          // Sample numbers, if kept
+
+    void run(const std::vector<uint8_t> &bytes, bool keep) {
+        cerelog::sample_block out;
+        out.channels = channels.data();
+        out.sample_number = numbers.data();
+        out.capacity = kMaxPacketSamples;
+        size_t pos = 0;
+        while (pos < bytes.size()) {
+            size_t consumed = 0;
+            size_t n = decoder.decode(bytes.data() + pos, bytes.size() - pos, out, &consumed);
+            if (keep) {
+                decoded.insert(decoded.end(), numbers.begin(), numbers.begin() + n);
+            }
+            pos += consumed;
+        }
+    }
+};
+
+void put_be24(std::vector<uint8_t> &out, int32_t value) {
+    out.push_back(uint8_t(uint32_t(value) >> 16));
+    out.push_back(uint8_t(uint32_t(value) >> 8));
+    out.push_back(uint8_t(value));
+}
+
+// One packed batch of count samples from first_number on, as the firmware sends it
+void append_batch(std::vector<uint8_t> &out, uint32_t first_number, size_t count) {
+    size_t start = out.size();
+    ads1299_batch_header_t header = {};
+    header.start_bytes[0] = PACKET_START_BYTE1;
+    header.start_bytes[1] = PACKET_START_BYTE2;
+    header.packet_type = PACKET_TYPE_ADS1299_BATCH;
+    header.sample_count = uint8_t(count);
+    header.timestamp_ns = uint64_t(first_number) * 62500;
+    header.sample_number = first_number;
+    header.status[0] = 0xC0;
+    const uint8_t *h = reinterpret_cast<const uint8_t *>(&header);
+    out.insert(out.end(), h, h + sizeof(header));
+    for (size_t i = 0; i < count; i++) {
+        for (size_t ch = 0; ch < kChannels; ch++) {
+            put_be24(out, int32_t((first_number + i) * kChannels + ch) & 0x7FFFFF);
+        }
+    }
+    uint16_t crc = packet_crc_compute(out.data() + start, out.size() - start);
+    out.push_back(uint8_t(crc));
+    out.push_back(uint8_t(crc >> 8));
+    out.push_back(PACKET_END_BYTE1);
+    out.push_back(PACKET_END_BYTE2);
+}
+
+/* A datagram as udp_tx.c builds it: as many whole batches as fit the
+   payload size, numbered from first_number on. Returns the samples in it. */
+size_t make_datagram(std::vector<uint8_t> &out, uint32_t sequence, uint32_t first_number, size_t batches) {
+    out.assign(sizeof(datagram_header_t), 0);
+    datagram_header_t header = {};
+    header.magic[0] = DATAGRAM_MAGIC1;
+    header.magic[1] = DATAGRAM_MAGIC2;
+    header.version = DATAGRAM_VERSION;
+    header.packet_count = uint8_t(batches);
+    header.sequence = sequence;
+    for (size_t b = 0; b < batches; b++) {
+        append_batch(out, first_number + uint32_t(b * kBatchSamples), kBatchSamples);
+    }
+    std::memcpy(out.data(), &header, sizeof(header));
+    return batches * kBatchSamples;
+}
+
+size_t batches_per_datagram() {
+    return (kPayloadSize - sizeof(datagram_header_t)) / BATCH_PACKET_SIZE(kBatchSamples);
+}
+
+bool expect(bool ok, const char *what) {
+    if (!ok) {
+        std::printf("%s FAILED\n", what);
+    }
+    return ok;
+}
+
+void print_stats(const datagram_stats &s) {
+    std::printf("  %llu datagrams, %llu lost, %llu reordered, %llu late, %llu duplicates, %llu bad, %llu restarts\n",
+                (unsigned long long)s.datagrams, (unsigned long long)s.lost, (unsigned long long)s.reordered,
+                (unsigned long long)s.late, (unsigned long long)s.duplicates, (unsigned long long)s.bad,
+                (unsigned long long)s.restarts);
+}
+
+/* Datagram i carries samples 4i+1 to 4i+4. With a window of 8: 10, 50 and
+   51 never arrive; 21 comes before 20; 30 after 35; 40 only after 50,
+   once given up on; 60 twice; and a datagram too short to have a header. */
+bool check_reorder() {
+    const size_t count = 100, per = 4, window = 8;
+    std::vector<std::vector<uint8_t>> datagrams(count);
+    for (size_t i = 0; i < count; i++) {
+        std::vector<uint8_t> &d = datagrams[i];
+        d.assign(sizeof(datagram_header_t), 0);
+        append_batch(d, uint32_t(i * per + 1), per);
+        datagram_header_t header = {{DATAGRAM_MAGIC1, DATAGRAM_MAGIC2}, DATAGRAM_VERSION, 1, uint32_t(i), 0};
+        std::memcpy(d.data(), &header, sizeof(header));
+    }
+
+    std::vector<size_t> order;
+    for (size_t i = 0; i < count; i++) {
+        if (i == 10 || i == 50 || i == 51 || i == 30 || i == 40) {
+            continue;
+        }
+        if (i == 20) {
+            order.push_back(21);
+            order.push_back(20);
+            i++;
+            continue;
+        }
+        order.push_back(i);
+        if (i == 35) {
+            order.push_back(30);
+        }
+        if (i == 52) {
+            order.push_back(40);
+        }
+        if (i == 60) {
+            order.push_back(60);
+        }
+    }
+
+    datagram_reorder reorder(window, std::chrono::milliseconds(1000));
+    std::vector<uint8_t> bytes;
+    for (size_t i : order) {
+        reorder.push(datagrams[i].data(), datagrams[i].size(), bytes);
+    }
+    const uint8_t runt[4] = {DATAGRAM_MAGIC1, DATAGRAM_MAGIC2, DATAGRAM_VERSION, 0};
+    reorder.push(runt, sizeof(runt), bytes);
+    reorder.flush(bytes);
+
+    decoding d;
+    d.run(bytes, true);
+    std::vector<uint32_t> expected;
+    for (size_t i = 0; i < count; i++) {
+        if (i != 10 && i != 40 && i != 50 && i != 51) {
+            for (size_t k = 0; k < per; k++) {
+                expected.push_back(uint32_t(i * per + k + 1));
+            }
+        }
+    }
+    const datagram_stats &s = reorder.stats();
+    std::printf("Reorder, window %zu:\n", window);
+    print_stats(s);
+    std::printf("  %zu samples decoded, %llu missing\n", d.decoded.size(),
+                (unsigned long long)d.decoder.stats().missing_samples);
+    bool ok = expect(s.lost == 4 && s.reordered == 2 && s.late == 1 && s.duplicates == 1 && s.bad == 1,
+                     "reorder counts");
+    ok &= expect(d.decoded == expected && d.decoder.stats().missing_samples == 4 * per &&
+                     d.decoder.stats().bad_packets == 0,
+                 "reorder samples");
+
+    // A device restart starts over at 0 without counting anything lost
+    uint64_t lost = s.lost;
+    for (size_t i = 0; i < 5; i++) {
+        reorder.push(datagrams[i].data(), datagrams[i].size(), bytes);
+    }
+    ok &= expect(s.restarts == 1 && s.lost == lost && s.duplicates == 1, "reorder restart");
+
+    // A gap is given up on once the datagram after it has waited out the timeout
+    datagram_reorder timed(window, std::chrono::milliseconds(20));
+    bytes.clear();
+    timed.push(datagrams[0].data(), datagrams[0].size(), bytes);
+    timed.push(datagrams[2].data(), datagrams[2].size(), bytes);
+    size_t before = bytes.size();
+    timed.expire(bytes);
+    bool held = bytes.size() == before;
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+    timed.expire(bytes);
+    ok &= expect(held && timed.stats().lost == 1 && bytes.size() == 2 * datagrams[0].size() -
+                     2 * sizeof(datagram_header_t), "reorder timeout");
+    return ok;
+}
+
+#if !defined(_WIN32)
+
+/* Sends datagrams to port over localhost for the given time, as fast as
+   the socket takes them, while the caller receives. */
+bool throughput(double seconds) {
+    udp_receiver receiver(0, 64, std::chrono::milliseconds(50));
+    const size_t batches = batches_per_datagram();
+    std::atomic<bool> done{false};
+    std::atomic<uint64_t> sent{0};
+
+    std::thread sender([&] {
+        int s = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        sockaddr_in peer = {};
+        peer.sin_family = AF_INET;
+        peer.sin_port = htons(receiver.port());
+        peer.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        std::vector<uint8_t> datagram;
+        uint32_t sequence = 0, number = 1;
+        clock_type::time_point start = clock_type::now();
+        while (seconds_since(start) < seconds) {
+            size_t samples = make_datagram(datagram, sequence, number, batches);
+            if (::sendto(s, datagram.data(), datagram.size(), 0, reinterpret_cast<sockaddr *>(&peer),
+                         sizeof(peer)) == ssize_t(datagram.size())) {
+                sequence++;
+                number += uint32_t(samples);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        ::close(s);
+        sent = sequence;
+        done = true;
+    });
+
+    decoding d;
+    std::vector<uint8_t> bytes;
+    clock_type::time_point start = clock_type::now();
+    // Until the sender stops, and then until the socket runs dry
+    while (true) {
+        bytes.clear();
+        size_t got = receiver.receive(bytes, 20);
+        d.run(bytes, false);
+        if (got == 0 && done) {
+            break;
+        }
+    }
+    double elapsed = seconds_since(start);
+    sender.join();
+    bytes.clear();
+    receiver.flush(bytes);
+    d.run(bytes, false);
+
+    const datagram_stats &s = receiver.stats();
+    const cerelog::decoder_stats &ds = d.decoder.stats();
+    uint64_t samples_per = batches * kBatchSamples;
+    std::printf("Localhost, %zu-byte datagrams of %zu %zu-sample batches, %.1f s:\n",
+                sizeof(datagram_header_t) + batches * BATCH_PACKET_SIZE(kBatchSamples), batches, kBatchSamples,
+                elapsed);
+    print_stats(s);
+    std::printf("  %llu sent, %.0f datagrams/s, %.1f MB/s, %.2f M samples/s, %.0f streams at 16 kSPS\n",
+                (unsigned long long)sent.load(), double(s.datagrams) / elapsed,
+                double(s.payload_bytes) / elapsed / 1e6, double(ds.samples) / elapsed / 1e6,
+                double(ds.samples) / elapsed / 16000.0);
+    // Loss is the kernel's to decide; what arrives must decode, with every lost datagram's samples missing
+    bool ok = expect(ds.samples == (s.datagrams - s.duplicates - s.late) * samples_per, "throughput samples");
+    ok &= expect(ds.bad_packets == 0 && ds.missing_samples == s.lost * samples_per, "throughput gaps");
+    ok &= expect(s.datagrams + s.lost <= sent, "throughput counts");
+    return ok;
+}
+
+#endif
+
+int live(uint16_t port, size_t window, int timeout_ms, double seconds) {
+    udp_receiver receiver(port, window, std::chrono::milliseconds(timeout_ms));
+    decoding d;
+    std::vector<uint8_t> bytes;
+    std::printf("Listening on UDP port %u\n", receiver.port());
+
+    clock_type::time_point start = clock_type::now(), last = start;
+    datagram_stats previous;
+    uint64_t previous_samples = 0;
+    while (seconds <= 0 || seconds_since(start) < seconds) {
+        bytes.clear();
+        receiver.receive(bytes, 100);
+        d.run(bytes, false);
+        double dt = seconds_since(last);
+        if (dt >= 1.0) {
+            const datagram_stats &s = receiver.stats();
+            const cerelog::decoder_stats &ds = d.decoder.stats();
+            std::printf("%6.0f datagrams/s %7.3f MB/s %8.0f samples/s  lost %llu reordered %llu late %llu "
+                        "missing samples %llu\n",
+                        double(s.datagrams - previous.datagrams) / dt,
+                        double(s.payload_bytes - previous.payload_bytes) / dt / 1e6,
+                        double(ds.samples - previous_samples) / dt, (unsigned long long)s.lost,
+                        (unsigned long long)s.reordered, (unsigned long long)s.late,
+                        (unsigned long long)ds.missing_samples);
+            std::fflush(stdout);
+            previous = s;
+            previous_samples = ds.samples;
+            last = clock_type::now();
+        }
+    }
+    bytes.clear();
+    receiver.flush(bytes);
+    d.run(bytes, false);
+    print_stats(receiver.stats());
+    const cerelog::decoder_stats &ds = d.decoder.stats();
+    std::printf("  %llu samples, %llu missing, %llu bad packets\n", (unsigned long long)ds.samples,
+                (unsigned long long)ds.missing_samples, (unsigned long long)ds.bad_packets);
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    int port = -1;
+    size_t window = 64;
+    int timeout_ms = 50;
+    double seconds = 0.0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--port" && has_value) {
+            port = std::atoi(argv[++i]);
+        } else if (arg == "--window" && has_value) {
+            window = size_t(std::atoi(argv[++i]));
+        } else if (arg == "--timeout" && has_value) {
+            timeout_ms = std::atoi(argv[++i]);
+        } else if (arg == "--seconds" && has_value) {
+            seconds = std::atof(argv[++i]);
+        } else {
+            std::fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return 2;
+        }
+    }
+
+    try {
+        if (port >= 0) {
+            return live(uint16_t(port), window, timeout_ms, seconds);
+        }
+        bool ok = check_reorder();
+#if defined(_WIN32)
+        std::fprintf(stderr, "The throughput run needs POSIX sockets; give a port to listen on\n");
+#else
+        ok &= throughput(seconds > 0 ? seconds : 5.0);
+#endif
+        return ok ? 0 : 1;
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,207 @@
+// Exactness check and benchmark for the frame unpack kernels.
+//
+//   unpack_bench [seconds of recording, default 3600]
+//
+// For the 4, 6 and 8-channel parts, every SIMD level the CPU supports is
+// compared against a one-value-at-a-time reference over random frames,
+// full-scale codes and every frame count up to 64, in codes and in
+// microvolts. The exit status is non-zero on any mismatch.
+//
+// The benchmark then unpacks a recording of 8 channels at 2 kSPS (an hour
+// by default) at each level and reports how long it takes, both into
+// arrays for the whole recording (bound by memory bandwidth) and a block
+// at a time as a streaming consumer would.
+
+#include "frame_unpack.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+
+using cerelog::simd_level;
+
+const simd_level kLevels[] = {simd_level::scalar, simd_level::sse41, simd_level::avx2};
+
+// The obvious conversion, as the firmware and the Python scripts do it
+int32_t reference_code(const uint8_t *p) {
+    int32_t value = (p[0] << 16) | (p[1] << 8) | p[2];
+    if (value & 0x800000) {
+        value -= 0x1000000;
+    }
+    return value;
+}
+
+std::vector<uint8_t> make_frames(size_t channels, size_t count, std::mt19937 &rng) {
+    std::vector<uint8_t> frames(count * cerelog::frame_bytes(channels));
+    for (uint8_t &b : frames) {
+        b = uint8_t(rng());
+    }
+    // Full-scale and zero codes in the first frames
+    static const uint8_t edges[][3] = {{0x80, 0x00, 0x00}, {0x7F, 0xFF, 0xFF}, {0xFF, 0xFF, 0xFF}, {0, 0, 0}};
+    for (size_t i = 0; i < std::min<size_t>(count, 4); i++) {
+        for (size_t c = 0; c < channels; c++) {
+            uint8_t *p = &frames[i * cerelog::frame_bytes(channels) + ADS1299_STATUS_BYTES + 3 * c];
+            std::copy(edges[(i + c) % 4], edges[(i + c) % 4] + 3, p);
+        }
+    }
+    return frames;
+}
+
+template <size_t Channels>
+size_t check_channels(std::mt19937 &rng) {
+    const size_t bytes = cerelog::frame_bytes(Channels);
+    uint8_t registers[PACKET_REGISTER_BYTES] = {};
+    for (size_t c = 0; c < Channels; c++) {
+        registers[0x05 + c] = uint8_t((c % 7) << 4);
+    }
+    float scale[Channels];
+    cerelog::scale_from_registers(registers, Channels, 4.5, scale);
+
+    size_t failures = 0;
+    for (size_t count = 0; count <= 64; count++) {
+        // Sized exactly, so a kernel reading past the last frame shows up under a sanitizer
+        std::vector<uint8_t> frames = make_frames(Channels, count, rng);
+
+        for (simd_level level : kLevels) {
+            if (level > cerelog::supported_simd_level()) {
+                continue;
+            }
+            cerelog::set_simd_level(level);
+
+            std::vector<int32_t> codes(Channels * count + 1, 0x5A5A5A5A);
+            std::vector<float> uv(Channels * count + 1, -1.0f);
+            std::vector<uint32_t> status(count + 1, 0xFFFFFFFF);
+            int32_t *code_rows[Channels];
+            float *uv_rows[Channels];
+            for (size_t c = 0; c < Channels; c++) {
+                code_rows[c] = codes.data() + c * count;
+                uv_rows[c] = uv.data() + c * count;
+            }
+            cerelog::unpack_frames<Channels>(frames.data(), count, code_rows, status.data());
+            cerelog::unpack_frames_uv<Channels>(frames.data(), count, scale, uv_rows, nullptr);
+
+            size_t bad = 0;
+            for (size_t i = 0; i < count; i++) {
+                const uint8_t *frame = frames.data() + i * bytes;
+                bad += status[i] != uint32_t(frame[0] << 16 | frame[1] << 8 | frame[2]);
+                for (size_t c = 0; c < Channels; c++) {
+                    int32_t expected = reference_code(frame + ADS1299_STATUS_BYTES + 3 * c);
+                    bad += code_rows[c][i] != expected;
+                    bad += uv_rows[c][i] != float(expected) * scale[c];
+                }
+            }
+            // Nothing written past the end
+            bad += codes.back() != 0x5A5A5A5A || uv.back() != -1.0f || status.back() != 0xFFFFFFFF;
+
+            if (bad && failures++ < 10) {
+                std::printf("  FAIL %zu channels, %zu frames, %s: %zu wrong values\n", Channels, count,
+                            cerelog::simd_level_name(level), bad);
+            }
+        }
+    }
+    cerelog::set_simd_level(simd_level::avx2);
+    return failures;
+}
+
+bool check_exact() {
+    std::mt19937 rng(1);
+    size_t failures = check_channels<4>(rng) + check_channels<6>(rng) + check_channels<8>(rng);
+
+    // 24 V/V on CH1: 4.5 V reference over 2^24 codes of 2 * 4.5 / 24 V
+    uint8_t registers[PACKET_REGISTER_BYTES] = {0x3E, 0x96, 0xC0, 0x60, 0x00, 0x60};
+    float scale[8];
+    cerelog::scale_from_registers(registers, 8, 4.5, scale);
+    if (std::abs(scale[0] - 0.02235174f) > 1e-7f || cerelog::channels_from_id(registers[0]) != 8) {
+        std::printf("  FAIL CHnSET 0x60 should give 0.02235 uV per code, got %.8f\n", double(scale[0]));
+        failures++;
+    }
+    return failures == 0;
+}
+
+template <typename Fn>
+double time_best(Fn &&fn) {
+    double best = 1e30;
+    for (int run = 0; run < 3; run++) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+void benchmark(double seconds) {
+    const size_t rate = 2000;
+    const size_t count = size_t(seconds * rate);
+    std::mt19937 rng(2);
+    std::vector<uint8_t> frames = make_frames(8, count, rng);
+
+    std::vector<int32_t> codes(8 * count);
+    std::vector<float> uv(8 * count);
+    std::vector<uint32_t> status(count);
+    int32_t *code_rows[8];
+    float *rows[8];
+    for (size_t c = 0; c < 8; c++) {
+        code_rows[c] = codes.data() + c * count;
+        rows[c] = uv.data() + c * count;
+    }
+    uint8_t registers[PACKET_REGISTER_BYTES] = {0x3E, 0x96, 0xC0, 0x60, 0x00, 0x60, 0x60, 0x60, 0x60,
+                                                0x60, 0x60, 0x60, 0x60};
+    float scale[8];
+    cerelog::scale_from_registers(registers, 8, 4.5, scale);
+
+    std::printf("\n%.0f s of 8 channels at %zu SPS: %zu frames, %.1f MB\n", seconds, rate, count,
+                double(frames.size()) / 1e6);
+    // Streaming consumers unpack a block at a time into buffers that stay in cache
+    const size_t block = 4096;
+    std::vector<float> block_uv(8 * block);
+    float *block_rows[8];
+    for (size_t c = 0; c < 8; c++) {
+        block_rows[c] = block_uv.data() + c * block;
+    }
+
+    std::printf("(whole: into arrays for the full recording; blocks: %zu frames at a time into one buffer)\n", block);
+    std::printf("%-8s %14s %14s %14s %14s\n", "level", "whole codes s", "whole uV s", "blocks uV s",
+                "Mframes/s");
+    for (simd_level level : kLevels) {
+        if (level > cerelog::supported_simd_level()) {
+            continue;
+        }
+        cerelog::set_simd_level(level);
+        double codes_s = time_best([&] {
+            cerelog::unpack_frames<8>(frames.data(), count, code_rows, status.data());
+        });
+        double uv_s = time_best([&] {
+            cerelog::unpack_frames_uv<8>(frames.data(), count, scale, rows, status.data());
+        });
+        double block_s = time_best([&] {
+            for (size_t i = 0; i < count; i += block) {
+                cerelog::unpack_frames_uv<8>(frames.data() + i * cerelog::frame_bytes(8), std::min(block, count - i),
+                                             scale, block_rows, nullptr);
+            }
+        });
+        std::printf("%-8s %14.3f %14.3f %14.3f %14.1f\n", cerelog::simd_level_name(level), codes_s, uv_s,
+                    block_s, double(count) / block_s / 1e6);
+    }
+    cerelog::set_simd_level(simd_level::avx2);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    double seconds = argc > 1 ? std::atof(argv[1]) : 3600.0;
+
+    std::printf("CPU supports %s\n", cerelog::simd_level_name(cerelog::supported_simd_level()));
+    bool ok = check_exact();
+    std::printf("%s\n", ok ? "All levels match the reference" : "Unpack check FAILED");
+    if (seconds > 0) {
+        benchmark(seconds);
+    }
+    return ok ? 0 : 1;
+}
\ No newline at end of file
@@ -1,3 +1,3 @@
-@echo off
-call "analog-world-zephyr\.venv\Scripts\activate.bat"
+@echo off
+call "analog-world-zephyr\.venv\Scripts\activate.bat"
 cmd
\ No newline at end of file